@@ -20,6 +20,7 @@ precision mediump int;
 // ---------------------------------------------------------------------
 #include "library/utils.shader"
 #include "library/random.shader"
+#include "library/gbuffer.shader"
 
 #define TRANSMITTANCE 0.0	// TODO!
 #define SPECULAR_FACTOR 10.0	// Used for computing the output vector in case of
@@ -37,6 +38,7 @@ uniform sampler2DRect tex_positions;
 uniform sampler2DRect tex_normals;
 uniform sampler2DRect tex_diffuse;
 uniform sampler2DRect tex_specular;
+uniform mat4 inv_proj_matrix;	// for reconstructing the positions (compact layout)
 
 uniform vec3 light_color;
 uniform vec3 light_pos_ws;
@@ -237,8 +239,7 @@ void scatter(in float  r,					// random, in the range [0.0, 1.0]
 void main()
 {
 	// Read the normal:
-	vec4 texel_normal = texture(tex_normals,   gl_FragCoord.xy);
-	vec3 normal       = texel_normal.xyz;		// light-space normal
+	vec3 normal = readGBufferNormal(tex_normals, gl_FragCoord.xy);	// light-space normal
 
 	// Check if there is nothing (normal is 0):
 	if(dot(normal, normal) < 0.5)
@@ -256,14 +257,9 @@ void main()
 	initRand(seed);
 
 	// Texture reads:
-	vec4 texel_position = texture(tex_positions, gl_FragCoord.xy);
-	vec4 texel_diffuse  = texture(tex_diffuse,   gl_FragCoord.xy);
-	vec4 texel_specular = texture(tex_specular,  gl_FragCoord.xy);
-
-	// Get values from the read texels:
-	vec3 position           = texel_position.xyz;	// light-space position
-	vec4 diffuse_value      = texel_diffuse;		// diffuse value
-	vec4 specular_value     = texel_specular;		// specular value
+	vec3 position       = readGBufferPosition(tex_positions, inv_proj_matrix, gl_FragCoord.xy);	// light-space position
+	vec4 diffuse_value  = texture(tex_diffuse, gl_FragCoord.xy);			// diffuse value
+	vec4 specular_value = readGBufferSpecular(tex_specular, gl_FragCoord.xy);	// specular value
 
 	vec3 light_vec          = -position;			// light-space light vector: pos -> light
 	float dist_to_light     = unitize(light_vec);
@@ -0,0 +1,12 @@
+// depth_prepass.frag
+// Only the depth is written: the color writes are disabled during the depth pre-pass.
+
+#version 330 core
+
+precision highp float;
+precision mediump int;
+
+// main:
+void main()
+{
+}
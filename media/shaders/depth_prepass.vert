@@ -0,0 +1,28 @@
+// depth_prepass.vert
+// Program used for the depth pre-pass of RasterRenderer: only the depth of the objects is
+// rendered, before the main pass which is done with the GL_EQUAL depth test.
+// The position is computed exactly like in general.vert (with _INSTANCING_), and is
+// declared invariant in both shaders, so that the depths of both passes are equal.
+// No supported symbols.
+
+#version 330 core
+
+precision highp float;
+precision highp int;
+
+// Uniform blocks: view_matrix and projection_matrix
+#include "library/uniform_blocks.shader"
+
+// Attributes:
+in vec3 vertex_position;
+in mat4 instance_model_matrix;
+
+invariant gl_Position;
+
+// main:
+void main()
+{
+	mat4 modelview_matrix = view_matrix * instance_model_matrix;
+	vec4 eye_space_pos = modelview_matrix * vec4(vertex_position, 1.0);
+	gl_Position = projection_matrix * eye_space_pos;
+}
@@ -12,6 +12,8 @@ precision mediump int;
 #include "library/blinn_phong.shader"
 #include "library/ashikhmin_shirley.shader"
 #include "constants.shader"
+#include "library/uniform_blocks.shader"
+#include "library/gbuffer.shader"
 
 // ---------------------------------------------------------------------
 // Uniforms
@@ -35,18 +37,9 @@ uniform vec4 material_specular;
 	uniform sampler2DRectShadow tex_prev_depth_layer;
 #endif
 
-// - shadow maps:
+// - shadow maps (all in the same atlas, see lights[].shadow_rect):
 #ifdef _SHADOW_MAPPING_
-	#for _NB_LIGHTS_
-		uniform sampler2DShadow shadow_map_@;
-	#endfor
-#endif
-
-// - light colors:
-#ifdef _FORWARD_SHADING_
-	#for _NB_LIGHTS_
-		uniform vec3 light_color_@;
-	#endfor
+	uniform sampler2DShadow shadow_atlas;
 #endif
 
 // - debug
@@ -89,10 +82,14 @@ smooth in vec3 var_eye_space_pos;
 	out vec4 frag_color;
 
 #else	// deferred shading:
-	out vec4 frag_position;		// position.x  | position.y  | position.z  | free
+	#ifndef _COMPACT_GBUFFER_
+		out vec4 frag_position;	// position.x  | position.y  | position.z  | free
+	#endif
 	out vec4 frag_normal;		// normal.x    | normal.y    | normal.z    | free
 	out vec4 frag_diffuse;		// diffuse.r   | diffuse.g   | diffuse.b   | alpha value
 	out vec4 frag_specular;		// specular.r  | specular.g  | specular.b  | specular exponent
+	// NB: in the compact layout (see library/gbuffer.shader), there is no position, the
+	// normal is encoded in 2 components and the specular exponent is encoded.
 	// Visibility map:
 	#ifdef _SHADOW_MAPPING_
 		out vec4 frag_visibility;
@@ -135,10 +132,16 @@ void main()
 		vec3 view_vec = normalize(-var_eye_space_pos);
 	// --------- Deferred shading ----------
 	#else
-		frag_position = vec4(var_eye_space_pos, 0.0);
-		frag_normal   = vec4(normal, 0.0);
-		frag_diffuse  = diffuse_value;
-		frag_specular = material_specular;
+		#ifdef _COMPACT_GBUFFER_
+			frag_normal   = vec4(encodeGBufferNormal(normal), 0.0, 0.0);
+			frag_diffuse  = diffuse_value;
+			frag_specular = encodeGBufferSpecular(material_specular);
+		#else
+			frag_position = vec4(var_eye_space_pos, 0.0);
+			frag_normal   = vec4(normal, 0.0);
+			frag_diffuse  = diffuse_value;
+			frag_specular = material_specular;
+		#endif
 		// frag_visibility is updated later on.
 	#endif
 
@@ -163,8 +166,10 @@ void main()
 										shadow_texcoords_proj_@.p >= 0.0 &&
 										shadow_texcoords_proj_@.p <= 1.0);
 
-			// - determine if the fragment is visible from the light (shadow mapping):
-			float lit_@ = texture(shadow_map_@, shadow_texcoords_proj_@);
+			// - determine if the fragment is visible from the light (shadow mapping),
+			// reading from the region of the light's shadow map in the atlas:
+			float lit_@ = texture(shadow_atlas, vec3(lights[@].shadow_rect.xy + shadow_texcoords_proj_@.st * lights[@].shadow_rect.zw,
+													 shadow_texcoords_proj_@.p));
 		#endif
 
 
@@ -188,7 +193,7 @@ void main()
 				material_specular);
 
 			// - compute the final contribution of the light (multiply by the light's power):
-			vec4 lit_value_@ = vec4(light_color_@ * brdf_eval_@.rgb, brdf_eval_@.a);
+			vec4 lit_value_@ = vec4(lights[@].color.rgb * brdf_eval_@.rgb, brdf_eval_@.a);
 
 			// - add the light's contribution to the fragment:
 			#ifdef _SHADOW_MAPPING_
@@ -4,11 +4,14 @@
 // _NB_LIGHTS_           : Number of lights to support
 // _FORWARD_SHADING_     : Classic forward shading rasterization
 // _RENDER_TO_GBUFFER_   : Supports rendering to a G-buffer
+// _COMPACT_GBUFFER_     : Compact layout of the G-buffer (see library/gbuffer.shader), has a
+//                         meaning only if _RENDER_TO_GBUFFER_ is defined
 // _SHADOW_MAPPING_      : Use shadow mapping.
 // _VISIBILITY_MAPS_     : Use visibility maps (has a meaning only if _RENDER_TO_GBUFFER_ is
 //                         defined, but it can be defined otherwise, it is just ignored then).
 // _BRDF_FUNCTION_       : Name of the BRDF function to use (e.g. "blinn_phong")
 // _DEBUG_TEXTURE_       : Adds a debug texture
+// _INSTANCING_          : The model matrix is a per-instance vertex attribute instead of a uniform
 // TEXTURE_MAPPING       : Supports texture mapping for the diffuse component
 // NORMAL_MAPPING        : Supports normal mapping
 // DEPTH_PEELING         : Test the fragment against a provided additional depth buffer
@@ -34,29 +37,15 @@ precision highp float;
 precision highp int;
 
 // ---------------------------------------------------------------------
-// Uniforms
-// - transformation matrices
-uniform mat4 view_matrix;
-uniform mat4 model_matrix;
-uniform mat4 projection_matrix;
-
-// - light positions:
-#ifdef _FORWARD_SHADING_
-	#for _NB_LIGHTS_
-		uniform vec3 light_pos_@;
-	#endfor
-#endif
+// Uniform blocks: view_matrix, projection_matrix and lights[] (positions, colors and
+// "shadow" matrices)
+#include "library/uniform_blocks.shader"
 
-// - "shadow" matrices
-// world space      => light view space		[light view matrix]
-// light view space => light clip space		[light proj matrix]
-// light clip space => shadow map space		[bias matrix]
-// Hence: shadow_matrix = bias_matrix * light_proj_matrix * light_view_matrix
-// See RasterRenderer::bindShadowMaps()
-#ifdef _SHADOW_MAPPING_
-	#for _NB_LIGHTS_
-		uniform mat4 shadow_matrix_@;
-	#endfor
+// ---------------------------------------------------------------------
+// Uniforms
+// - model matrix
+#ifndef _INSTANCING_
+	uniform mat4 model_matrix;
 #endif
 
 // ---------------------------------------------------------------------
@@ -74,6 +63,11 @@ in vec3 vertex_position;
 	in vec2 vertex_texcoords;
 #endif
 
+// - model matrix of the instance
+#ifdef _INSTANCING_
+	in mat4 instance_model_matrix;
+#endif
+
 // ---------------------------------------------------------------------
 // Varying variables
 #ifndef NORMAL_MAPPING
@@ -90,6 +84,9 @@ in vec3 vertex_position;
 // - interpolated position
 smooth out vec3 var_eye_space_pos;
 
+// - the projected position must be the same as in depth_prepass.vert
+invariant gl_Position;
+
 // - interpolated texture coordinates
 #if (defined TEXTURE_MAPPING) || (defined NORMAL_MAPPING)
 	smooth out vec2 var_texcoords;
@@ -106,6 +103,10 @@ smooth out vec3 var_eye_space_pos;
 // Main function:
 void main()
 {
+	#ifdef _INSTANCING_
+		mat4 model_matrix = instance_model_matrix;
+	#endif
+
 	// Compute the modelview matrix:
 	mat4 modelview_matrix = view_matrix * model_matrix;
 
@@ -124,7 +125,7 @@ void main()
 	// (they are normalized later, in the fragment shader)
 	#ifdef _FORWARD_SHADING_
 		#for _NB_LIGHTS_
-			vec3 eye_space_light_pos_@ = vec3(view_matrix * vec4(light_pos_@, 1.0));
+			vec3 eye_space_light_pos_@ = vec3(view_matrix * lights[@].position);
 			var_light_vec_@ = eye_space_light_pos_@ - eye_space_pos.xyz;
 		#endfor
 	#endif
@@ -137,7 +138,7 @@ void main()
 	// Calculate the texture coordinates we use for fetching from the shadow maps:
 	#ifdef _SHADOW_MAPPING_
 		#for _NB_LIGHTS_
-			var_shadow_texcoords_@ = shadow_matrix_@ * model_matrix * vec4(vertex_position, 1.0);
+			var_shadow_texcoords_@ = lights[@].shadow_matrix * model_matrix * vec4(vertex_position, 1.0);
 		#endfor
 	#endif
 
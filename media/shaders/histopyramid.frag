@@ -0,0 +1,40 @@
+// histopyramid.frag
+// Computes a level of a histopyramid (see HistoPyramid.h):
+// - _BASE_LEVEL_ defined: 1 for the valid texels of the mask, 0 otherwise (and outside of the mask)
+// - otherwise: sum of the 2x2 texels of the previous level
+
+#version 330 core
+
+precision highp float;
+precision highp int;
+
+#ifdef _BASE_LEVEL_
+	uniform sampler2DRect tex_mask;
+	uniform vec4 mask_weights;		// a texel is valid if dot(texel, mask_weights) > mask_threshold
+	uniform float mask_threshold;
+#else
+	uniform usampler2D tex_prev_level;	// the base level is the previous level
+#endif
+
+out uint frag_output;
+
+void main()
+{
+	ivec2 coords = ivec2(gl_FragCoord.xy);
+
+#ifdef _BASE_LEVEL_
+	frag_output = 0u;
+	if(all(lessThan(coords, textureSize(tex_mask))))
+	{
+		vec4 texel = texelFetch(tex_mask, coords);
+		if(dot(texel, mask_weights) > mask_threshold)
+			frag_output = 1u;
+	}
+#else
+	ivec2 p = 2*coords;
+	frag_output = texelFetch(tex_prev_level, p,               0).r
+	            + texelFetch(tex_prev_level, p + ivec2(1, 0), 0).r
+	            + texelFetch(tex_prev_level, p + ivec2(0, 1), 0).r
+	            + texelFetch(tex_prev_level, p + ivec2(1, 1), 0).r;
+#endif
+}
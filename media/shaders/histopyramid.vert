@@ -0,0 +1,31 @@
+// histopyramid.vert
+// Supported symbols:
+// _COMPACT_ : writes the index of the valid texel number gl_VertexID, with transform feedback
+//             (no attribute, no rasterization)
+// otherwise : full-screen quad for building the levels (see histopyramid.frag)
+
+#version 330 core
+
+precision highp float;
+precision highp int;
+
+#include "library/histopyramid.shader"
+
+#ifdef _COMPACT_
+	uniform int mask_width;
+
+	flat out uint out_index;	// y*mask_width + x
+#else
+	in vec2 vertex_position;
+#endif
+
+void main()
+{
+#ifdef _COMPACT_
+	ivec2 p = getHistoPyramidTexel(uint(gl_VertexID));
+	out_index = uint(p.y*mask_width + p.x);
+	gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+#else
+	gl_Position = vec4(vertex_position, 0.0, 1.0);
+#endif
+}
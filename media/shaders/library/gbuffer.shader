@@ -0,0 +1,113 @@
+// gbuffer.shader
+// Writing and reading the G-buffers (see GBuffer.h), in the default layout or in the
+// compact layout (_COMPACT_GBUFFER_ defined):
+// - default: positions, normals, diffuse and specular in RGBA16F textures
+// - compact: no positions texture (the positions are reconstructed from the depth and the
+//   inverse of the projection matrix used for rendering the G-buffer), octahedral-encoded
+//   normals in RG16, diffuse and specular in RGBA8 (with log2 of the specular exponent)
+// In both layouts, the functions reading the G-buffer return vec3(0.0) for the positions and
+// the normals where there is nothing, like the cleared textures of the default layout.
+
+#ifndef _GBUFFER_SHADER_
+#define _GBUFFER_SHADER_
+
+#define GBUFFER_MAX_LOG2_EXPONENT 13.0	// specular exponents are in [1, 8192]
+
+// ---------------------------------------------------------------------
+// Octahedral encoding of the normals (the octahedron is unfolded on the square [-1, 1]²):
+vec2 octahedronWrap(in vec2 v)
+{
+	return (vec2(1.0) - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Encoded normal, in [0, 1]². It is never exactly (0, 0), which is the value of the
+// cleared texture.
+vec2 encodeGBufferNormal(in vec3 n)
+{
+	n /= (abs(n.x) + abs(n.y) + abs(n.z));
+	vec2 e = (n.z >= 0.0 ? n.xy : octahedronWrap(n.xy));
+	return max(0.5*e + vec2(0.5), vec2(1.0/65535.0));
+}
+
+vec3 decodeGBufferNormal(in vec2 e)
+{
+	if(e.x == 0.0 && e.y == 0.0)
+		return vec3(0.0);
+
+	e = 2.0*e - vec2(1.0);
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if(n.z < 0.0)
+		n.xy = octahedronWrap(n.xy);
+	return normalize(n);
+}
+
+// ---------------------------------------------------------------------
+// Specular color and exponent:
+vec4 encodeGBufferSpecular(in vec4 specular)
+{
+	return vec4(specular.rgb, log2(max(specular.a, 1.0)) / GBUFFER_MAX_LOG2_EXPONENT);
+}
+
+vec4 decodeGBufferSpecular(in vec4 texel)
+{
+	return vec4(texel.rgb, exp2(texel.a * GBUFFER_MAX_LOG2_EXPONENT));
+}
+
+// ---------------------------------------------------------------------
+// Reading from the G-buffer.
+// - tex_positions is GBuffer::getTexPositions(): the positions texture in the default layout,
+//   the depth texture in the compact layout
+// - inv_proj_matrix is GBuffer::getInvProjMatrix() (ignored in the default layout)
+// - the positions are in eye space (light space for the G-buffer of a light)
+vec3 readGBufferPosition(in sampler2DRect tex_positions, in mat4 inv_proj_matrix, in vec2 coords)
+{
+	#ifdef _COMPACT_GBUFFER_
+		float depth = texture(tex_positions, coords).r;
+		if(depth == 1.0)
+			return vec3(0.0);
+
+		vec3 ndc = 2.0*vec3(coords / vec2(textureSize(tex_positions)), depth) - vec3(1.0);
+		vec4 pos = inv_proj_matrix * vec4(ndc, 1.0);
+		return pos.xyz / pos.w;
+	#else
+		return texture(tex_positions, coords).xyz;
+	#endif
+}
+
+vec3 readGBufferPosition(in sampler2DRect tex_positions, in mat4 inv_proj_matrix, in ivec2 texel_coords)
+{
+	#ifdef _COMPACT_GBUFFER_
+		return readGBufferPosition(tex_positions, inv_proj_matrix, vec2(texel_coords) + vec2(0.5));
+	#else
+		return texelFetch(tex_positions, texel_coords).xyz;
+	#endif
+}
+
+vec3 readGBufferNormal(in sampler2DRect tex_normals, in vec2 coords)
+{
+	#ifdef _COMPACT_GBUFFER_
+		return decodeGBufferNormal(texture(tex_normals, coords).rg);
+	#else
+		return texture(tex_normals, coords).xyz;
+	#endif
+}
+
+vec3 readGBufferNormal(in sampler2DRect tex_normals, in ivec2 texel_coords)
+{
+	#ifdef _COMPACT_GBUFFER_
+		return decodeGBufferNormal(texelFetch(tex_normals, texel_coords).rg);
+	#else
+		return texelFetch(tex_normals, texel_coords).xyz;
+	#endif
+}
+
+vec4 readGBufferSpecular(in sampler2DRect tex_specular, in vec2 coords)
+{
+	#ifdef _COMPACT_GBUFFER_
+		return decodeGBufferSpecular(texture(tex_specular, coords));
+	#else
+		return texture(tex_specular, coords);
+	#endif
+}
+
+#endif // _GBUFFER_SHADER_
@@ -0,0 +1,49 @@
+// histopyramid.shader
+// Traversal of a histopyramid built by HistoPyramid (see HistoPyramid.h): finds the position of
+// the key-th valid texel of the mask, for keys in [0, number of valid texels).
+
+#ifndef _HISTOPYRAMID_SHADER_
+#define _HISTOPYRAMID_SHADER_
+
+uniform usampler2D tex_histopyramid;	// number of valid texels covered by each texel of each level
+uniform int hp_nb_levels;
+
+// Texel of the base level (and of the mask) of the key-th valid texel
+ivec2 getHistoPyramidTexel(in uint key)
+{
+	ivec2 p = ivec2(0);
+
+	// From the level below the top (1x1) down to the base level, go to the child whose range
+	// of keys contains the key, in the order (0, 0), (1, 0), (0, 1), (1, 1):
+	for(int level = hp_nb_levels-2 ; level >= 0 ; level--)
+	{
+		p *= 2;
+
+		uint a = texelFetch(tex_histopyramid, p,               level).r;
+		uint b = texelFetch(tex_histopyramid, p + ivec2(1, 0), level).r;
+		uint c = texelFetch(tex_histopyramid, p + ivec2(0, 1), level).r;
+
+		if(key < a)
+		{
+		}
+		else if(key < a+b)
+		{
+			key -= a;
+			p.x += 1;
+		}
+		else if(key < a+b+c)
+		{
+			key -= a+b;
+			p.y += 1;
+		}
+		else
+		{
+			key -= a+b+c;
+			p += ivec2(1);
+		}
+	}
+
+	return p;
+}
+
+#endif // _HISTOPYRAMID_SHADER_
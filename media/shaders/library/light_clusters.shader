@@ -0,0 +1,76 @@
+// light_clusters.shader
+// Reading the lists of lights of the clusters built by LightClusters (see LightClusters.h).
+// Needs _CLUSTER_TILE_SIZE_ and _CLUSTER_NB_SLICES_ (see LightClusters::addSymbols()).
+// NB: the clusters only contain the unshadowed lights (the first _NB_LIGHTS_ lights are not binned).
+
+#ifndef _LIGHT_CLUSTERS_SHADER_
+#define _LIGHT_CLUSTERS_SHADER_
+
+uniform samplerBuffer  cluster_lights;	// 4 texels per light: position and range, color and tan(half-angle), X and Y axes
+uniform usamplerBuffer cluster_headers;	// 1 texel per cluster: offset and number of its lights
+uniform usamplerBuffer cluster_indices;	// indices of the lights, cluster after cluster
+uniform vec4 cluster_params;			// number of tiles (xy), z_near, scale of the depth slices
+
+// Offset (x) and number (y) of the lights of the cluster containing the fragment at the given
+// window coordinates and eye-space depth
+uvec2 getClusterLights(in vec2 frag_coord, in float eye_space_z)
+{
+	ivec2 tile = ivec2(frag_coord) / _CLUSTER_TILE_SIZE_;
+
+	float dist = max(-eye_space_z, cluster_params.z);
+	int slice = min(int(log(dist / cluster_params.z) * cluster_params.w), _CLUSTER_NB_SLICES_-1);
+
+	int cluster = (slice * int(cluster_params.y) + tile.y) * int(cluster_params.x) + tile.x;
+	return texelFetch(cluster_headers, cluster).xy;
+}
+
+// Index of the i-th light in the lists of the clusters
+int getClusterLightIndex(in uint i)
+{
+	return int(texelFetch(cluster_indices, int(i)).r);
+}
+
+// Eye-space position (xyz) and range (w) of a light
+vec4 getClusterLightPosition(in int light)
+{
+	return texelFetch(cluster_lights, 4*light);
+}
+
+vec3 getClusterLightColor(in int light)
+{
+	return texelFetch(cluster_lights, 4*light+1).rgb;
+}
+
+// 1.0 if the eye-space position is inside the frustum of the light (the same square frustum as its
+// shadow map, up to its range), 0.0 otherwise. Omnidirectional lights only test the range.
+float getClusterLightFrustum(in int light, in vec3 position)
+{
+	vec4 light_pos_range   = texelFetch(cluster_lights, 4*light);
+	float tan_half_angle   = texelFetch(cluster_lights, 4*light+1).a;
+	vec3 light_x           = texelFetch(cluster_lights, 4*light+2).xyz;
+	vec3 light_y           = texelFetch(cluster_lights, 4*light+3).xyz;
+
+	vec3 v = position - light_pos_range.xyz;
+	if(tan_half_angle == 0.0)
+		return float(dot(v, v) <= light_pos_range.w*light_pos_range.w);
+
+	// Light space coordinates (the light looks towards -Z):
+	float depth = -dot(v, cross(light_x, light_y));
+	float limit = depth * tan_half_angle;
+
+	return float(depth >= 0.0 && depth <= light_pos_range.w &&
+				 abs(dot(v, light_x)) <= limit &&
+				 abs(dot(v, light_y)) <= limit);
+}
+
+#ifdef _CLUSTER_LIGHT_FALLOFF_
+// Optional attenuation of a light with the distance, going smoothly to 0 at the range of the light
+// (USE_CLUSTERED_LIGHT_FALLOFF in Config.h)
+float getClusterLightAttenuation(in float dist, in float range)
+{
+	float x = clamp(1.0 - pow(dist / range, 4.0), 0.0, 1.0);
+	return x*x;
+}
+#endif
+
+#endif // _LIGHT_CLUSTERS_SHADER_
@@ -0,0 +1,67 @@
+// russian_roulette.shader
+// Scattering of the photons with Russian roulette sampling, for the bounces after the first one
+// (see photon_bounces.vert): the photon is reflected diffusely with the probability mean(rho_L),
+// specularly with the probability mean(rho_S), and is absorbed otherwise.
+// Unlike scatter() in bounce_map.frag, the photons can be absorbed, so that the paths end.
+
+#ifndef _RUSSIAN_ROULETTE_SHADER_
+#define _RUSSIAN_ROULETTE_SHADER_
+
+#include "utils.shader"
+#include "random.shader"
+
+#define RR_SPECULAR_FACTOR 10.0					// same as SPECULAR_FACTOR in bounce_map.frag
+#define RR_SPECULAR_FACTOR_PATH_DENSITY 0.3		// same as SPECULAR_FACTOR_PATH_DENSITY in bounce_map.frag
+
+// Returns false if the photon is absorbed.
+bool scatterRussianRoulette(in float  r,					// random, in the range [0.0, 1.0]
+							in vec3   normal,				// normal
+							in vec3   w_i,					// incident direction (towards where the photon comes from)
+							in vec3   power_i,				// incident power (color)
+							in vec3   rho_L,				// probability of a lambertian scattering
+							in vec3   rho_S,				// probability of a specular scattering
+							in float  specular_exp_value,	// specular exponent, in [0, 1]
+							out vec3  w_o,					// output direction
+							out vec3  power_o,				// output power (color)
+							out float path_density)		// path density estimation
+{
+	w_o = vec3(0.0);
+	power_o = vec3(0.0);
+	path_density = 0.0;
+
+	// Lambertian scattering:
+	// (as in bounce_map.frag, the colors of the power are redistributed so that its
+	// mean stays the same: the probability of survival already accounts for the energy loss)
+	float rho_L_mean = mean(rho_L);
+	r -= rho_L_mean;
+	if(r <= 0.0)
+	{
+		power_o = power_i * rho_L / rho_L_mean;
+		w_o = cosHemiRandom(normal);
+		path_density = rho_L_mean * 0.01;
+		return true;
+	}
+
+	// Specular scattering:
+	float rho_S_mean = mean(rho_S);
+	r -= rho_S_mean;
+	if(r <= 0.0)
+	{
+		power_o = power_i * rho_S / rho_S_mean;
+
+		vec3 w_h = cosPowHemiRandom(normal, RR_SPECULAR_FACTOR*specular_exp_value);
+		w_o = reflect(-w_i, w_h);
+
+		// Reflected below the surface: absorbed
+		if(dot(w_o, normal) <= 0.0)
+			return false;
+
+		path_density = min(1.0, RR_SPECULAR_FACTOR_PATH_DENSITY * specular_exp_value * rho_S_mean);
+		return true;
+	}
+
+	// Absorption:
+	return false;
+}
+
+#endif // _RUSSIAN_ROULETTE_SHADER_
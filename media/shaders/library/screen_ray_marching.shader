@@ -0,0 +1,231 @@
+// screen_ray_marching.shader
+// Tracing of eye-space rays in screen space, against the min-max depth pyramid of the screen
+// G-buffer (see MinMaxMipmaps.h). Used by ray_marching.frag and photon_bounces.vert.
+// - _HIZ_RAY_MARCHING_ defined: hierarchical traversal. The ray steps over the cells of the coarse
+//   levels, descends to a finer level when the ray potentially intersects the surfaces of a cell,
+//   and ascends again after skipping an empty cell, which takes O(log n) steps per ray.
+// - otherwise: linear DDA over the pixels of the level 0, for comparison.
+
+#ifndef _SCREEN_RAY_MARCHING_SHADER_
+#define _SCREEN_RAY_MARCHING_SHADER_
+
+uniform sampler2D tex_min_max;		// min-max pyramid: min (r) and max (g) distance from the eye
+uniform int min_max_nb_levels;
+
+// ---------------------------------------------------------------------
+#define MAX_DISTANCE 5.0
+#define MIN_DISTANCE 0.1	// TODO: this should depend on the angle (ray_dir, normal)
+#define THICKNESS 0.1		// thickness given to the surfaces seen from the eye
+
+#ifdef _HIZ_RAY_MARCHING_
+	#define MAX_ITERATIONS 128
+#else
+	#define MAX_ITERATIONS 2048
+#endif
+
+// ---------------------------------------------------------------------
+// Ray in screen space, parametrized by t in [0, 1]: the window coordinates (in pixels of the
+// level 0) and the inverse of the distance from the eye are both linear in t.
+struct ScreenRay
+{
+	vec2 start;
+	vec2 delta;
+	float inv_dist_start;
+	float inv_dist_delta;
+};
+
+float rayDistance(in ScreenRay r, in float t)
+{
+	return 1.0 / (r.inv_dist_start + t*r.inv_dist_delta);
+}
+
+// Restrict [t_min, t_max] to the part of the ray which is inside the screen.
+// Returns false if there is no such part.
+bool clipRayToScreen(in ScreenRay r, in vec2 screen_size, inout float t_min, inout float t_max)
+{
+	for(int i=0 ; i < 2 ; i++)
+	{
+		if(abs(r.delta[i]) < 1e-6)
+		{
+			if(r.start[i] < 0.0 || r.start[i] > screen_size[i])
+				return false;
+		}
+		else
+		{
+			float t0 = (0.0 - r.start[i]) / r.delta[i];
+			float t1 = (screen_size[i] - r.start[i]) / r.delta[i];
+			t_min = max(t_min, min(t0, t1));
+			t_max = min(t_max, max(t0, t1));
+		}
+	}
+	return t_min < t_max;
+}
+
+// Can the part of the ray between t0 and t1 intersect surfaces whose distances from the eye
+// are in [min_max.x, min_max.y + THICKNESS]?
+bool rayIntersects(in ScreenRay r, in float t0, in float t1, in vec2 min_max)
+{
+	float d0 = rayDistance(r, t0);
+	float d1 = rayDistance(r, t1);
+	return max(d0, d1) >= min_max.x && min(d0, d1) <= min_max.y + THICKNESS;
+}
+
+// Where the part of the ray between t0 and t1 crosses the distance d (clamped to [t0, t1])
+float refineHit(in ScreenRay r, in float t0, in float t1, in float d)
+{
+	if(abs(r.inv_dist_delta) < 1e-9)
+		return t0;
+	return clamp((1.0/d - r.inv_dist_start) / r.inv_dist_delta, t0, t1);
+}
+
+// ---------------------------------------------------------------------
+// Trace the ray between t_min and t_max: returns the t of the first intersection, or -1.0.
+#ifdef _HIZ_RAY_MARCHING_
+float traceRay(in ScreenRay r, in float t_min, in float t_max, out int nb_iterations)
+{
+	ivec2 screen_size = textureSize(tex_min_max, 0);
+	float t_eps = 0.01 / max(length(r.delta), 1e-6);	// 1/100th of a pixel
+
+	int level = 0;
+	float t = t_min;
+
+	nb_iterations = 0;
+	while(t < t_max && nb_iterations < MAX_ITERATIONS)
+	{
+		nb_iterations++;
+
+		// Cell of the current level containing the current position:
+		ivec2 level_size = textureSize(tex_min_max, level);
+		ivec2 pixel = max(ivec2(r.start + t*r.delta), ivec2(0));
+		ivec2 cell = min(pixel >> level, level_size - ivec2(1));
+
+		// Bounds of the cell, in pixels of the level 0 (the last cells also cover the extra
+		// columns/rows of the finer levels):
+		vec2 cell_min = vec2(cell << level);
+		vec2 cell_max = vec2((cell + ivec2(1)) << level);
+		if(cell.x == level_size.x-1)
+			cell_max.x = float(screen_size.x);
+		if(cell.y == level_size.y-1)
+			cell_max.y = float(screen_size.y);
+
+		// Where the ray leaves the cell:
+		float t_exit = t_max;
+		if(abs(r.delta.x) >= 1e-6)
+			t_exit = min(t_exit, ((r.delta.x > 0.0 ? cell_max.x : cell_min.x) - r.start.x) / r.delta.x);
+		if(abs(r.delta.y) >= 1e-6)
+			t_exit = min(t_exit, ((r.delta.y > 0.0 ? cell_max.y : cell_min.y) - r.start.y) / r.delta.y);
+
+		vec2 min_max = texelFetch(tex_min_max, cell, level).rg;
+
+		if(rayIntersects(r, t, t_exit, min_max))
+		{
+			// Potential intersection: this is a hit at the level 0, otherwise descend
+			if(level == 0)
+				return refineHit(r, t, t_exit, min_max.x);
+			level--;
+		}
+		else
+		{
+			// Empty space: skip the cell and ascend
+			t = t_exit + t_eps;
+			level = min(level+1, min_max_nb_levels-1);
+		}
+	}
+
+	return -1.0;
+}
+#else
+float traceRay(in ScreenRay r, in float t_min, in float t_max, out int nb_iterations)
+{
+	ivec2 screen_size = textureSize(tex_min_max, 0);
+
+	// ray_inc: by how much we need to increment t to do one step
+	// => the greater of dx and dy is equal to 1 pixel
+	float ray_inc = 1.0 / max(max(abs(r.delta.x), abs(r.delta.y)), 1e-6);
+
+	nb_iterations = 0;
+	for(float t = t_min ; t < t_max && nb_iterations < MAX_ITERATIONS ; t += ray_inc)
+	{
+		nb_iterations++;
+
+		float t_next = min(t + ray_inc, t_max);
+		ivec2 pixel = clamp(ivec2(r.start + t*r.delta), ivec2(0), screen_size - ivec2(1));
+		vec2 min_max = texelFetch(tex_min_max, pixel, 0).rg;
+
+		if(rayIntersects(r, t, t_next, min_max))
+			return refineHit(r, t, t_next, min_max.x);
+	}
+
+	return -1.0;
+}
+#endif
+
+// ---------------------------------------------------------------------
+// Trace the eye-space ray starting at origin in the direction dir (normalized), between
+// MIN_DISTANCE and MAX_DISTANCE. Returns true if it hits a surface, in which case ray_end is the
+// intersection; otherwise ray_end is the end of the ray.
+bool marchScreenRay(in vec3 origin, in vec3 dir, in mat4 eye_proj, out vec3 ray_end, out int nb_iterations)
+{
+	// Compute the coordinates of the first and second vertices:
+	vec3 first_vertex_pos  = origin + MIN_DISTANCE * dir;
+	vec3 second_vertex_pos = origin + MAX_DISTANCE * dir;
+
+	// Project the coordinates:
+	vec4 first_vertex_proj_pos  = eye_proj * vec4(first_vertex_pos,  1.0);
+	vec4 second_vertex_proj_pos = eye_proj * vec4(second_vertex_pos, 1.0);
+
+	// Default: no intersection
+	ray_end = second_vertex_pos;
+	nb_iterations = 0;
+
+	// Clip the ray against the near plane (z >= -w):
+	float d_first  = first_vertex_proj_pos.z  + first_vertex_proj_pos.w;
+	float d_second = second_vertex_proj_pos.z + second_vertex_proj_pos.w;
+
+	if(d_first < 0.0 && d_second < 0.0)
+		return false;
+
+	if(d_first < 0.0)
+	{
+		float s = d_first / (d_first - d_second);
+		first_vertex_pos      = mix(first_vertex_pos,      second_vertex_pos,      s);
+		first_vertex_proj_pos = mix(first_vertex_proj_pos, second_vertex_proj_pos, s);
+	}
+	else if(d_second < 0.0)
+	{
+		float s = d_first / (d_first - d_second);
+		second_vertex_pos      = mix(first_vertex_pos,      second_vertex_pos,      s);
+		second_vertex_proj_pos = mix(first_vertex_proj_pos, second_vertex_proj_pos, s);
+	}
+
+	// Screen-space ray (w is the distance from the eye):
+	vec2 screen_size = vec2(textureSize(tex_min_max, 0));
+
+	vec2 first_vertex_win  = (0.5*first_vertex_proj_pos.xy  / first_vertex_proj_pos.w  + 0.5) * screen_size;
+	vec2 second_vertex_win = (0.5*second_vertex_proj_pos.xy / second_vertex_proj_pos.w + 0.5) * screen_size;
+
+	ScreenRay r;
+	r.start = first_vertex_win;
+	r.delta = second_vertex_win - first_vertex_win;
+	r.inv_dist_start = 1.0 / first_vertex_proj_pos.w;
+	r.inv_dist_delta = 1.0 / second_vertex_proj_pos.w - r.inv_dist_start;
+
+	// Trace it:
+	float t_min = 0.0;
+	float t_max = 1.0;
+	float t_hit = -1.0;
+
+	if(clipRayToScreen(r, screen_size, t_min, t_max))
+		t_hit = traceRay(r, t_min, t_max, nb_iterations);
+
+	if(t_hit < 0.0)
+		return false;
+
+	// Eye-space position of the intersection (perspective-correct interpolation):
+	ray_end = mix(first_vertex_pos  / first_vertex_proj_pos.w,
+	              second_vertex_pos / second_vertex_proj_pos.w,
+	              t_hit) / (r.inv_dist_start + t_hit*r.inv_dist_delta);
+	return true;
+}
+
+#endif // _SCREEN_RAY_MARCHING_SHADER_
@@ -0,0 +1,34 @@
+// uniform_blocks.shader
+// Uniform blocks shared by the programs. They are uploaded once per frame and bound
+// to fixed binding points (see UniformBlocks.h and ShaderLocations.h).
+
+#ifndef _UNIFORM_BLOCKS_SHADER_
+#define _UNIFORM_BLOCKS_SHADER_
+
+#define NB_MAX_SHADOWED_LIGHTS 4	// IMPORTANT: must be equal to NB_MAX_SHADOWED_LIGHTS in Boundaries.h
+
+// ---------------------------------------------------------------------
+// Viewpoint used for rendering (the camera or a light):
+layout(std140) uniform CameraBlock
+{
+	mat4 view_matrix;
+	mat4 projection_matrix;
+	mat4 inv_view_matrix;
+};
+
+// ---------------------------------------------------------------------
+// Shadowed lights (the first lights of the scene):
+struct LightParams
+{
+	vec4 position;		// world space, w = 1
+	vec4 color;			// rgb
+	mat4 shadow_matrix;	// world space => shadow map space (bias * light proj * light view)
+	vec4 shadow_rect;	// region of the shadow map in the shadow atlas: offset (xy) and scale (zw)
+};
+
+layout(std140) uniform LightsBlock
+{
+	LightParams lights[NB_MAX_SHADOWED_LIGHTS];
+};
+
+#endif // _UNIFORM_BLOCKS_SHADER_
@@ -1,17 +1,56 @@
 // min_max_mipmaps.frag
+// Computes a level of the min-max depth pyramid (see MinMaxMipmaps.h):
+// - _FIRST_LEVEL_ defined: from the depth buffer of a G-buffer
+// - otherwise: from the previous level
+// The output contains the minimum (r) and the maximum (g) distance from the eye.
 
 #version 330 core
 
 precision highp float;
-precision mediump int;
+precision highp int;
 
-uniform sampler2DRect tex_position;
+#ifdef _FIRST_LEVEL_
+	uniform sampler2DRect tex_depth;
+	uniform mat4 inv_proj_matrix;
+#else
+	uniform sampler2D tex_prev_level;	// the base level is the previous level
+#endif
 
-smooth in vec2 texcoords;
-
-out vec4 frag_output;
+out vec2 frag_output;
 
 void main()
 {
-	frag_output = vec4(-texture(tex_position, texcoords).zz, 0, 1);
+	ivec2 coords = ivec2(gl_FragCoord.xy);
+
+#ifdef _FIRST_LEVEL_
+	// Reconstruct the distance from the depth:
+	vec4 ndc = vec4(2.0*gl_FragCoord.xy / vec2(textureSize(tex_depth)) - vec2(1.0),
+					2.0*texelFetch(tex_depth, coords).r - 1.0,
+					1.0);
+	vec4 pos = inv_proj_matrix * ndc;
+
+	frag_output = vec2(-pos.z / pos.w);
+#else
+	// Texels of the previous level covered by this one, including the extra column/row
+	// of the previous level for the last texels:
+	ivec2 prev_size = textureSize(tex_prev_level, 0);
+	ivec2 size = max(prev_size / 2, ivec2(1));
+
+	ivec2 begin = 2*coords;
+	ivec2 end = min(begin + ivec2(2), prev_size);
+	if(coords.x == size.x-1)
+		end.x = prev_size.x;
+	if(coords.y == size.y-1)
+		end.y = prev_size.y;
+
+	vec2 min_max = texelFetch(tex_prev_level, begin, 0).rg;
+	for(int y = begin.y ; y < end.y ; y++)
+		for(int x = begin.x ; x < end.x ; x++)
+		{
+			vec2 v = texelFetch(tex_prev_level, ivec2(x, y), 0).rg;
+			min_max = vec2(min(min_max.x, v.x), max(min_max.y, v.y));
+		}
+
+	frag_output = min_max;
+#endif
 }
@@ -0,0 +1,176 @@
+// photon_bounces.vert
+// One step of the propagation of the photons over several bounces (see PhotonBounces.h).
+// Each vertex is a photon, written with transform feedback by photon_bounces.geom, which only
+// emits the live ones (var_alive == 1.0).
+// Supported symbols:
+// _SCATTER_          : scatter the photons at the surfaces they hit, with Russian roulette sampling
+// _TRACE_            : trace the scattered photons in screen space to their next hit
+// _FROM_PHOTONS_MAP_ : (_SCATTER_ only) the hits are read from a photons map and its bounce map
+//                      (one vertex per texel) instead of the vertex attributes
+// _HIZ_RAY_MARCHING_ : (_TRACE_ only) see library/screen_ray_marching.shader
+// _COMPACT_GBUFFER_  : compact layout of the G-buffer (see library/gbuffer.shader)
+// The photons are 3 vec4:
+// - position:  eye-space position (xyz), path density (w)
+// - power:     power (rgb), stamp of the pass which wrote the photon (a, see PhotonBounces.h)
+// - direction: direction where the photon comes from (hits, written by _TRACE_)
+//              or where it goes (scattered photons, written by _SCATTER_)
+
+#version 330 core
+
+// ---------------------------------------------------------------------
+// Default precision
+precision highp float;
+precision highp int;
+
+// ---------------------------------------------------------------------
+#include "library/gbuffer.shader"
+#include "library/russian_roulette.shader"
+#include "library/screen_ray_marching.shader"
+
+#define MIN_POWER 0.01	// same threshold as ray_marching.frag
+
+// ---------------------------------------------------------------------
+// Uniforms:
+uniform mat4 eye_proj_matrix;
+
+// - stamps of the photons: the input photons without input_stamp are left over by other passes
+uniform float input_stamp;
+uniform float output_stamp;
+
+#ifdef _SCATTER_
+	// - screen G-buffer:
+	uniform sampler2DRect tex_gbuffer_normal;
+	uniform sampler2DRect tex_gbuffer_diffuse;
+	uniform sampler2DRect tex_gbuffer_specular;
+
+	uniform float seed_offset;
+
+	#ifdef _FROM_PHOTONS_MAP_
+		// - photons map (see ray_marching.frag) and its bounce map:
+		uniform sampler2DRect tex_photons_map_0;	// start of the ray
+		uniform sampler2DRect tex_photons_map_1;	// intersection, 1 if there is one
+		uniform sampler2DRect tex_bounce_map_0;		// power
+		uniform sampler2DRect tex_bounce_map_1;		// path density (a)
+		uniform int photons_map_size;
+		uniform usamplerBuffer tex_photon_indices;	// texels of the hits (see HistoPyramid)
+	#endif
+#endif
+
+// ---------------------------------------------------------------------
+// Attributes:
+in vec4 photon_position;
+in vec4 photon_power;
+in vec4 photon_direction;
+
+// ---------------------------------------------------------------------
+// Varyings:
+out vec4 var_position;
+out vec4 var_power;
+out vec4 var_direction;
+out float var_alive;
+
+// ---------------------------------------------------------------------
+#ifdef _SCATTER_
+void main()
+{
+	var_position  = vec4(0.0);
+	var_power     = vec4(0.0);
+	var_direction = vec4(0.0);
+	var_alive     = 0.0;
+
+	// Read the hit:
+	#ifdef _FROM_PHOTONS_MAP_
+		// Only the photons which hit something are processed, gl_VertexID is their rank:
+		int index = int(texelFetch(tex_photon_indices, gl_VertexID).r);
+
+		ivec2 texcoords;
+		texcoords.y = index / photons_map_size;
+		texcoords.x = index - texcoords.y * photons_map_size;
+
+		vec4 texel_photons_map_1 = texelFetch(tex_photons_map_1, texcoords);
+		vec3 power = texelFetch(tex_bounce_map_0, texcoords).rgb * texel_photons_map_1.a;
+		if(dot(power, power) < MIN_POWER)
+			return;
+
+		vec3 position = texel_photons_map_1.xyz;
+		vec3 coming_dir = normalize(texelFetch(tex_photons_map_0, texcoords).xyz - position);
+		float path_density = texelFetch(tex_bounce_map_1, texcoords).a;
+	#else
+		if(photon_power.a != input_stamp)
+			return;
+
+		vec3 power = photon_power.rgb;
+		if(dot(power, power) < MIN_POWER)
+			return;
+
+		vec3 position = photon_position.xyz;
+		vec3 coming_dir = photon_direction.xyz;
+		float path_density = photon_position.w;
+	#endif
+
+	// Read the surface from the screen G-buffer:
+	vec4 proj_pos = eye_proj_matrix * vec4(position, 1.0);
+	vec2 wincoords = (0.5*proj_pos.xy / proj_pos.w + 0.5) * vec2(textureSize(tex_gbuffer_normal));
+
+	vec3 normal = readGBufferNormal(tex_gbuffer_normal, wincoords);
+	if(dot(normal, normal) < 0.5)
+		return;
+
+	// Photons arriving behind the surface are absorbed:
+	float cos_i = dot(coming_dir, normal);
+	if(cos_i <= 0.0)
+		return;
+
+	vec4 diffuse_value  = texture(tex_gbuffer_diffuse, wincoords);
+	vec4 specular_value = readGBufferSpecular(tex_gbuffer_specular, wincoords);
+
+	// Scatter with Russian roulette:
+	initRand(vec2(float(gl_VertexID & 4095), float(gl_VertexID >> 12)) + vec2(seed_offset));
+
+	vec3 w_o = vec3(0.0);
+	vec3 power_o = vec3(0.0);
+	float path_density_o = 0.0;
+
+	if(!scatterRussianRoulette(rand1(),
+							   normal,
+							   coming_dir,	// w_i
+							   power,
+							   diffuse_value.rgb,								// rho_L
+							   computeFresnel(specular_value.rgb, cos_i),		// rho_S
+							   specular_value.a,
+							   w_o,
+							   power_o,
+							   path_density_o))
+		return;
+
+	// The path density of the whole path:
+	var_position  = vec4(position, path_density * path_density_o);
+	var_power     = vec4(power_o, output_stamp);
+	var_direction = vec4(w_o, 0.0);
+	var_alive     = 1.0;
+}
+#endif
+
+// ---------------------------------------------------------------------
+#ifdef _TRACE_
+void main()
+{
+	var_position  = vec4(0.0);
+	var_power     = vec4(0.0);
+	var_direction = vec4(0.0);
+	var_alive     = 0.0;
+
+	if(photon_power.a != input_stamp)
+		return;
+
+	vec3 ray_end = vec3(0.0);
+	int nb_iterations = 0;
+	bool hit = marchScreenRay(photon_position.xyz, photon_direction.xyz, eye_proj_matrix, ray_end, nb_iterations);
+
+	// The photon now resides at the intersection, and comes from its previous position:
+	var_position  = vec4(ray_end, photon_position.w);
+	var_power     = vec4(photon_power.rgb, output_stamp);
+	var_direction = vec4(normalize(photon_position.xyz - ray_end), 0.0);
+	var_alive     = (hit ? 1.0 : 0.0);
+}
+#endif
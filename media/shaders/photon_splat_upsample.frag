@@ -0,0 +1,68 @@
+// photon_splat_upsample.frag
+// Bilateral upsampling of the half-resolution accumulation buffer of the photon volumes
+// (see PhotonVolumesRenderer): each pixel gets the bilinear combination of the 4 closest
+// texels of the accumulation buffer, weighted by how close the distance from the eye of the
+// pixel lit by each texel (the first pixel of its 2x2 block) is to the distance of the pixel.
+// The distances are read from the level 0 of the min-max pyramid (see MinMaxMipmaps.h).
+
+#version 330 core
+
+// ---------------------------------------------------------------------
+// Default precision
+precision highp float;
+precision highp int;
+
+// ---------------------------------------------------------------------
+// Relative difference of distance from which a texel is not taken into account:
+#define DEPTH_TOLERANCE 0.05
+
+// ---------------------------------------------------------------------
+// Uniforms:
+uniform sampler2DRect tex_accumulation;
+uniform sampler2D tex_min_max;
+
+// ---------------------------------------------------------------------
+// Fragment shader output:
+out vec4 frag_color;
+
+void main()
+{
+	ivec2 accumulation_size = textureSize(tex_accumulation);
+	float dist = texelFetch(tex_min_max, ivec2(gl_FragCoord.xy), 0).r;
+
+	// Bilinear footprint in the accumulation buffer:
+	vec2 coords = 0.5*gl_FragCoord.xy - vec2(0.5);
+	ivec2 base = ivec2(floor(coords));
+	vec2 f = coords - vec2(base);
+
+	vec3 sum = vec3(0.0);
+	float sum_weights = 0.0;
+
+	vec3 closest = vec3(0.0);	// texel whose distance is the closest to the pixel's one
+	float closest_diff = 1e30;
+
+	for(int j=0 ; j < 2 ; j++)
+		for(int i=0 ; i < 2 ; i++)
+		{
+			ivec2 texel = clamp(base + ivec2(i, j), ivec2(0), accumulation_size - ivec2(1));
+			vec3 value = texelFetch(tex_accumulation, texel).rgb;
+
+			float texel_dist = texelFetch(tex_min_max, 2*texel, 0).r;
+			float diff = abs(texel_dist - dist);
+
+			float bilinear_weight = (i == 0 ? 1.0 - f.x : f.x) * (j == 0 ? 1.0 - f.y : f.y);
+			float depth_weight = max(1.0 - diff / (DEPTH_TOLERANCE * dist), 0.0);
+
+			sum += bilinear_weight * depth_weight * value;
+			sum_weights += bilinear_weight * depth_weight;
+
+			if(diff < closest_diff)
+			{
+				closest = value;
+				closest_diff = diff;
+			}
+		}
+
+	// If no texel is on the same surface, take the closest one:
+	frag_color = vec4(sum_weights > 1e-4 ? sum / sum_weights : closest, 0.0);
+}
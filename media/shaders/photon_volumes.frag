@@ -12,6 +12,7 @@ precision mediump int;
 #include "library/blinn_phong.shader"
 #include "library/ashikhmin_shirley.shader"
 #include "constants.shader"
+#include "library/gbuffer.shader"
 
 // ---------------------------------------------------------------------
 // Uniforms:
@@ -19,6 +20,7 @@ uniform sampler2DRect tex_gbuffer_position;
 uniform sampler2DRect tex_gbuffer_normal;
 uniform sampler2DRect tex_gbuffer_diffuse;
 uniform sampler2DRect tex_gbuffer_specular;
+uniform mat4 gbuffer_inv_proj;	// for reconstructing the positions (compact layout)
 uniform sampler1D tex_kernel;
 
 // ---------------------------------------------------------------------
@@ -46,14 +48,19 @@ void main_back()
 // ---------------------------------------------------------------------
 void main()
 {
-	// Texture fetches:
-	vec4 texel_position = texture(tex_gbuffer_position, gl_FragCoord.xy);
-	vec4 texel_normal   = texture(tex_gbuffer_normal,   gl_FragCoord.xy);
-	vec4 texel_diffuse  = texture(tex_gbuffer_diffuse,  gl_FragCoord.xy);
-	vec4 texel_specular = texture(tex_gbuffer_specular, gl_FragCoord.xy);
+	// Coordinates in the G-buffer: at half resolution, each pixel is lit like the first
+	// pixel of the 2x2 block it covers (see photon_splat_upsample.frag)
+#ifdef _HALF_RESOLUTION_
+	vec2 gbuffer_coords = 2.0*floor(gl_FragCoord.xy) + vec2(0.5);
+#else
+	vec2 gbuffer_coords = gl_FragCoord.xy;
+#endif
 
-	vec3 eye_space_pos = texel_position.rgb;
-	vec3 eye_space_normal = texel_normal.rgb;
+	// Texture fetches:
+	vec3 eye_space_pos    = readGBufferPosition(tex_gbuffer_position, gbuffer_inv_proj, gbuffer_coords);
+	vec3 eye_space_normal = readGBufferNormal(tex_gbuffer_normal, gbuffer_coords);
+	vec4 texel_diffuse    = texture(tex_gbuffer_diffuse, gbuffer_coords);
+	vec4 texel_specular   = readGBufferSpecular(tex_gbuffer_specular, gbuffer_coords);
 
 	vec3 photon_to_point = eye_space_pos - var_eye_space_photon_pos;
 	float dist_photon_to_point = length(photon_to_point);
@@ -5,6 +5,15 @@
 // _INTERSECTION_MAP_WIDTH_, _INTERSECTION_MAP_HEIGHT_ : size of the intersection map
 // _BRDF_FUNCTION_                                     : Name of the BRDF function to use
 //                                                       (e.g. "blinn_phong")
+// _COMPACT_GBUFFER_                                   : Compact layout of the G-buffer
+//                                                       (see library/gbuffer.shader)
+// _FROM_INTERSECTION_MAP_                             : the photons are read from the intersection map
+// _FROM_PHOTONS_MAP_                                  : the photons are read from a photons map and
+//                                                       its bounce map
+// _FROM_PHOTON_BUFFER_                                : the photons are read from the hits of the next
+//                                                       bounces (see photon_bounces.vert)
+// _HALF_RESOLUTION_                                   : rendering to a half-resolution accumulation buffer
+//                                                       (used by the fragment shader)
 
 #version 330 core
 
@@ -15,6 +24,7 @@ precision highp int;
 
 // ---------------------------------------------------------------------
 #include "constants.shader"
+#include "library/gbuffer.shader"
 
 // BEGIN VALUES FOR THE CAUSTICS EXPERIMENT
 //~ // Upper and lower sizes of the major axis of a photon volume in eye space length units
@@ -46,13 +56,31 @@ precision highp int;
 uniform mat4 eye_view_matrix;
 uniform mat4 eye_proj_matrix;
 
-// - from the intersection map:
-#ifdef _DEBUG_USE_DEBUG_FBO_ATTACHMENT_
-	uniform sampler2DRect tex_debug;
+#ifdef _FROM_PHOTON_BUFFER_
+	// - from the hits of PhotonBounces (see photon_bounces.vert), 3 texels per photon:
+	uniform samplerBuffer tex_photons;
+	uniform float photons_stamp;	// only the photons with this stamp are valid
+#endif
+
+#ifdef _FROM_PHOTONS_MAP_
+	// - from the photons map (see ray_marching.frag) and the bounce map:
+	uniform sampler2DRect tex_photons_map_0;	// start of the ray, number of iterations
+	uniform sampler2DRect tex_photons_map_1;	// intersection, 1 if there is one
+	uniform sampler2DRect tex_bounce_map_0;		// power
+	uniform sampler2DRect tex_bounce_map_1;		// light-space direction, path density
+	uniform int photons_map_size;
+	uniform usamplerBuffer tex_photon_indices;	// texels of the hits (see HistoPyramid)
+#endif
+
+#ifdef _FROM_INTERSECTION_MAP_
+	// - from the intersection map:
+	#ifdef _DEBUG_USE_DEBUG_FBO_ATTACHMENT_
+		uniform sampler2DRect tex_debug;
+	#endif
+	uniform sampler2DRect tex_power;
+	uniform sampler2DRect tex_position;
+	uniform sampler2DRect tex_coming_dir;
 #endif
-uniform sampler2DRect tex_power;
-uniform sampler2DRect tex_position;
-uniform sampler2DRect tex_coming_dir;
 
 // - from the camera GBuffer:
 uniform sampler2DRect tex_gbuffer_normal;
@@ -77,6 +105,27 @@ flat out float var_inv_major_radius;
 // ---------------------------------------------------------------------
 void main()
 {
+#ifdef _FROM_PHOTON_BUFFER_
+	// Read the power of the photon (all the photons of the buffer hit a surface):
+	vec4 texel_photon_position = texelFetch(tex_photons, 3*gl_InstanceID);
+	vec4 texel_photon_power = texelFetch(tex_photons, 3*gl_InstanceID+1);
+	vec3 power = (texel_photon_power.a == photons_stamp ? texel_photon_power.rgb : vec3(0.0));
+#endif
+
+#ifdef _FROM_PHOTONS_MAP_
+	// Only the photons which hit something are drawn, gl_InstanceID is their rank:
+	int index = int(texelFetch(tex_photon_indices, gl_InstanceID).r);
+
+	ivec2 texcoords;
+	texcoords.y = index/photons_map_size;
+	texcoords.x = index - texcoords.y * photons_map_size;
+
+	// Read the power of the photon:
+	vec4 texel_photons_map_1 = texelFetch(tex_photons_map_1, texcoords);
+	vec3 power = texelFetch(tex_bounce_map_0, texcoords).rgb * texel_photons_map_1.a;
+#endif
+
+#ifdef _FROM_INTERSECTION_MAP_
 	ivec2 texcoords;
 	texcoords.x = gl_InstanceID/_INTERSECTION_MAP_HEIGHT_;
 	texcoords.y = gl_InstanceID - texcoords.x * _INTERSECTION_MAP_HEIGHT_;
@@ -84,6 +133,7 @@ void main()
 	// Read the power of the photon:
 	vec4 texel_power = texelFetch(tex_power, texcoords);
 	vec3 power = texel_power.rgb;
+#endif
 
 	// If there is no power, "discard" the volume (draw it somewhere it is clipped):
 	if(dot(power, power) < 0.1)
@@ -93,6 +143,26 @@ void main()
 	// If it is not clipped:
 	else
 	{
+	#ifdef _FROM_PHOTON_BUFFER_
+		// The photon resides at the intersection, and comes from the previous one:
+		vec4 texel_coming_dir = vec4(texelFetch(tex_photons, 3*gl_InstanceID+2).xyz,
+		                             texel_photon_position.w);
+		float path_density = texel_coming_dir.a;
+
+		vec4 photon_eye_space_pos = vec4(texel_photon_position.xyz, 1.0);
+	#endif
+
+	#ifdef _FROM_PHOTONS_MAP_
+		// The photon comes from the start of the ray, and resides at the intersection:
+		vec3 ray_start = texelFetch(tex_photons_map_0, texcoords).xyz;
+		vec4 texel_coming_dir = vec4(normalize(ray_start - texel_photons_map_1.xyz),
+		                             texelFetch(tex_bounce_map_1, texcoords).a);
+		float path_density = texel_coming_dir.a;
+
+		vec4 photon_eye_space_pos = vec4(texel_photons_map_1.xyz, 1.0);
+	#endif
+
+	#ifdef _FROM_INTERSECTION_MAP_
 		// Read the photon's coming direction and path density:
 		vec4 texel_coming_dir = texelFetch(tex_coming_dir, texcoords);
 		float path_density = texel_coming_dir.a;
@@ -100,6 +170,7 @@ void main()
 		// Read the photon's eye-space position:
 		vec4 texel_position = texelFetch(tex_position, texcoords);
 		vec4 photon_eye_space_pos = vec4(texel_position.rgb, 1.0);
+	#endif
 
 		// Compute the window coordinates, which we use for fetching
 		// from the camera GBuffer:
@@ -110,7 +181,7 @@ void main()
 		ivec2 photon_wincoords_int = ivec2(photon_wincoords);
 
 		// Fetch the normal to the surface where the photon resides from the GBuffer:
-		vec3 photon_normal = texelFetch(tex_gbuffer_normal, photon_wincoords_int).rgb;
+		vec3 photon_normal = readGBufferNormal(tex_gbuffer_normal, photon_wincoords_int);
 
 		float major_radius = mix(MAX_MAJOR_RADIUS, MIN_MAJOR_RADIUS, path_density);
 
@@ -11,6 +11,7 @@
 // _DEBUG_DONT_DISCARD_FRAGMENTS_    : Fragments are not discarded in the fragment
 //                                     shader, but the fragment shader outputs black instead.
 // _DEBUG_USE_DEBUG_FBO_ATTACHMENT_  : var_debug_color is used and outputed to frag_debug.
+// _COMPACT_GBUFFER_                 : Compact layout of the G-buffers (see library/gbuffer.shader)
 
 #version 330 core
 
@@ -22,6 +23,7 @@ precision highp int;
 // ---------------------------------------------------------------------
 #include "../library/utils.shader"
 #include "../library/clipping.shader"
+#include "../library/gbuffer.shader"
 
 #define MAX_DISTANCE 5.0
 //~ #define MAX_DISTANCE 1.0
@@ -35,6 +37,7 @@ precision highp int;
 uniform sampler2DRect bounce_map_0;
 uniform sampler2DRect bounce_map_1;
 uniform sampler2DRect tex_light_positions;	// positions from the light's GBuffer
+uniform mat4 light_inv_proj;			// for reconstructing the positions (compact layout)
 
 uniform int bounce_map_size;
 uniform mat4 light_to_eye_matrix;
@@ -99,10 +102,7 @@ void main()
 		float path_density = texel_bounce_map_1.a;
 
 		// Read the position from the light GBuffer
-		// TODO: replace this with a recomputation using the Z-buffer, bm_texcoords,
-		// and some matrix!
-		vec4 texel_position = texelFetch(tex_light_positions, bm_texcoords);
-		vec3 light_space_pos = texel_position.rgb;	// OK
+		vec3 light_space_pos = readGBufferPosition(tex_light_positions, light_inv_proj, bm_texcoords);	// OK
 
 		// Change the position from light space to eye space:
 		// NB: this is the position of the intersection, not the position of any vertex!
@@ -0,0 +1,80 @@
+// reduce.frag
+// A step of the generic texture reduction of TextureReducer (see TextureReducer.h): each output
+// texel reduces the (up to) 2x2 texels of the input it covers, with one operation per output.
+// The operation of the output i is given by the bits 2i and 2i+1 of reduce_ops (see ReduceOp):
+// 0: sum, 1: minimum, 2: maximum, 3: average (sum, multiplied by output_scale at the last step).
+
+#version 330 core
+
+precision highp float;
+precision highp int;
+
+#define REDUCE_SUM     0
+#define REDUCE_MIN     1
+#define REDUCE_MAX     2
+#define REDUCE_AVERAGE 3
+
+// Inputs: the texture to reduce for the first step, then the previous outputs
+uniform sampler2DRect tex_input_0;
+uniform sampler2DRect tex_input_1;
+uniform sampler2DRect tex_input_2;
+uniform sampler2DRect tex_input_3;
+
+uniform int input_width;	// size of the part of the inputs to reduce
+uniform int input_height;
+
+uniform int nb_ops;		// number of outputs (the other ones are not drawn)
+uniform int reduce_ops;
+uniform float output_scale;
+
+out vec4 frag_output_0;
+out vec4 frag_output_1;
+out vec4 frag_output_2;
+out vec4 frag_output_3;
+
+vec4 reduce2x2(in sampler2DRect tex_input, in int op, in ivec2 begin, in ivec2 end)
+{
+	vec4 result = texelFetch(tex_input, begin);
+
+	for(int y = begin.y ; y < end.y ; y++)
+	{
+		for(int x = begin.x ; x < end.x ; x++)
+		{
+			if(x == begin.x && y == begin.y)
+				continue;
+
+			vec4 texel = texelFetch(tex_input, ivec2(x, y));
+
+			if(op == REDUCE_MIN)
+				result = min(result, texel);
+			else if(op == REDUCE_MAX)
+				result = max(result, texel);
+			else
+				result += texel;
+		}
+	}
+
+	if(op == REDUCE_AVERAGE)
+		result *= output_scale;
+
+	return result;
+}
+
+void main()
+{
+	// Texels of the input covered by this one (the last ones may be outside of it):
+	ivec2 begin = 2*ivec2(gl_FragCoord.xy);
+	ivec2 end = min(begin + ivec2(2), ivec2(input_width, input_height));
+
+	frag_output_0 = reduce2x2(tex_input_0, reduce_ops & 3, begin, end);
+	frag_output_1 = vec4(0.0);
+	frag_output_2 = vec4(0.0);
+	frag_output_3 = vec4(0.0);
+
+	if(nb_ops > 1)
+		frag_output_1 = reduce2x2(tex_input_1, (reduce_ops >> 2) & 3, begin, end);
+	if(nb_ops > 2)
+		frag_output_2 = reduce2x2(tex_input_2, (reduce_ops >> 4) & 3, begin, end);
+	if(nb_ops > 3)
+		frag_output_3 = reduce2x2(tex_input_3, (reduce_ops >> 6) & 3, begin, end);
+}
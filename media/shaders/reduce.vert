@@ -0,0 +1,13 @@
+// reduce.vert
+
+#version 330 core
+
+precision highp float;
+precision highp int;
+
+in vec2 vertex_position;
+
+void main()
+{
+	gl_Position = vec4(vertex_position, 0.0, 1.0);
+}
@@ -8,6 +8,12 @@ precision mediump int;
 #include "library/blinn_phong.shader"
 #include "library/ashikhmin_shirley.shader"
 #include "constants.shader"
+#include "library/uniform_blocks.shader"
+#include "library/gbuffer.shader"
+
+#ifdef _CLUSTERED_LIGHTING_
+	#include "library/light_clusters.shader"
+#endif
 
 // ---------------------------------------------------------------------
 // Uniforms:
@@ -15,6 +21,7 @@ uniform sampler2DRect tex_positions;
 uniform sampler2DRect tex_normals;
 uniform sampler2DRect tex_diffuse;
 uniform sampler2DRect tex_specular;
+uniform mat4 gbuffer_inv_proj;	// for reconstructing the positions (compact layout)
 
 // - debug texture:
 #ifdef _DEBUG_TEXTURE_
@@ -24,20 +31,12 @@ uniform sampler2D tex_debug;
 // - background color:
 uniform vec3 back_color;
 
-// - light positions:
-#for _NB_LIGHTS_
-	uniform vec3 eye_space_light_pos_@;
-#endfor
-
 // - visibility maps/shadow maps:
 #ifdef _SHADOW_MAPPING_
 	#ifdef _VISIBILITY_MAPS_
 		uniform sampler2DRect visibility_map;
 	#else
-		#for _NB_LIGHTS_
-			uniform mat4 shadow_matrix_@;
-			uniform sampler2DShadow shadow_map_@;
-		#endfor
+		uniform sampler2DShadow shadow_atlas;	// all the shadow maps, see lights[].shadow_rect
 	#endif
 #endif
 
@@ -46,11 +45,6 @@ uniform vec3 back_color;
 	uniform sampler2DRect tex_pixels_done;
 #endif
 
-// - light colors:
-#for _NB_LIGHTS_
-	uniform vec3 light_color_@;
-#endfor
-
 // ---------------------------------------------------------------------
 // Varyings:
 smooth in vec2 var_texcoords;
@@ -74,8 +68,7 @@ void main()
 	#endif
 
 	// Read the normal:
-	vec4 texel_normal = texture(tex_normals,   var_texcoords);
-	vec3 normal       = texel_normal.xyz;		// eye-space normal
+	vec3 normal = readGBufferNormal(tex_normals, var_texcoords);	// eye-space normal
 
 	// Check if there is nothing (normal is 0), and set the back color if it's the case:
 	if(dot(normal, normal) < 0.5)
@@ -95,14 +88,11 @@ void main()
 	#endif
 
 	// Other texture reads:
-	vec4 texel_position = texture(tex_positions, var_texcoords);
-	vec4 texel_specular = texture(tex_specular,  var_texcoords);
+	vec3 position       = readGBufferPosition(tex_positions, gbuffer_inv_proj, var_texcoords);	// eye-space position
+	vec4 specular_value = readGBufferSpecular(tex_specular, var_texcoords);	// specular value
 
 	// Get values from the read texels:
-	vec3 position           = texel_position.xyz;	// eye-space position
-
 	vec4 diffuse_value      = texel_diffuse;		// diffuse value
-	vec4 specular_value     = texel_specular;		// specular value
 	vec3 view_vec           = normalize(-position);	// eye-space view vector: pos -> eye
 
 	// Compute the final color:
@@ -113,10 +103,16 @@ void main()
 		vec4 visibility = texture(visibility_map, var_texcoords);
 	#endif
 
+	// World space position, for looking up the shadow maps:
+	#if (defined _SHADOW_MAPPING_) && (!defined _VISIBILITY_MAPS_)
+		vec4 world_position = inv_view_matrix * vec4(position, 1.0);
+	#endif
+
 	// For each light, add the light's contribution:
 	#for _NB_LIGHTS_
 
 		// - compute the light vector:
+		vec3 eye_space_light_pos_@ = vec3(view_matrix * lights[@].position);
 		vec3 light_vec_@ = normalize(eye_space_light_pos_@ - position);
 
 		// - evaluate the BRDF:
@@ -128,7 +124,7 @@ void main()
 			specular_value);
 
 		// - compute the final contribution of the light (multiply by the light's power):
-		vec4 lit_value_@ = vec4(light_color_@ * brdf_eval_@.rgb, 0.0);
+		vec4 lit_value_@ = vec4(lights[@].color.rgb * brdf_eval_@.rgb, 0.0);
 
 		// --------- Shadow mapping ----------
 		#ifdef _SHADOW_MAPPING_
@@ -138,7 +134,7 @@ void main()
 				frag_color += visibility[@] * lit_value_@;
 			#else
 				// - compute the coordinates of the corresponding texel in the shadow map:
-				vec4 shadow_texcoords_@ = shadow_matrix_@ * vec4(position, 1.0);
+				vec4 shadow_texcoords_@ = lights[@].shadow_matrix * world_position;
 
 				vec3 shadow_texcoords_proj_@ = vec3(
 					shadow_texcoords_@.x / shadow_texcoords_@.w,
@@ -154,8 +150,10 @@ void main()
 											shadow_texcoords_proj_@.p >= 0.0 &&
 											shadow_texcoords_proj_@.p <= 1.0);
 
-				// - determine if the fragment is visible from the light (shadow mapping):
-				float lit_@ = texture(shadow_map_@, shadow_texcoords_proj_@);
+				// - determine if the fragment is visible from the light (shadow mapping),
+				// reading from the region of the light's shadow map in the atlas:
+				float lit_@ = texture(shadow_atlas, vec3(lights[@].shadow_rect.xy + shadow_texcoords_proj_@.st * lights[@].shadow_rect.zw,
+														 shadow_texcoords_proj_@.p));
 
 				// - add the light's contribution to the fragment:
 				frag_color += lit_@ * in_frustum_@ * lit_value_@;
@@ -170,6 +168,40 @@ void main()
 		#endif
 	#endfor
 
+	#ifdef _CLUSTERED_LIGHTING_
+	// For each unshadowed light of the cluster of the fragment, add the light's contribution.
+	// NB: the _NB_LIGHTS_ shadowed lights are not in the clusters.
+	uvec2 cluster = getClusterLights(gl_FragCoord.xy, position.z);
+
+	for(uint i=0u ; i < cluster.y ; i++)
+	{
+		int light = getClusterLightIndex(cluster.x + i);
+
+		// - compute the light vector:
+		vec4 light_pos_range = getClusterLightPosition(light);
+		vec3 light_vec = normalize(light_pos_range.xyz - position);
+
+		// - evaluate the BRDF:
+		vec4 brdf_eval = _BRDF_FUNCTION_(
+			light_vec,
+			view_vec,
+			normal,
+			diffuse_value,
+			specular_value);
+
+		// - compute the final contribution of the light (multiply by the light's power),
+		// only inside the light's frustum, like the shadowed lights:
+		vec4 lit_value = getClusterLightFrustum(light, position) * vec4(getClusterLightColor(light) * brdf_eval.rgb, 0.0);
+
+		#ifdef _CLUSTER_LIGHT_FALLOFF_
+			lit_value *= getClusterLightAttenuation(distance(light_pos_range.xyz, position), light_pos_range.w);
+		#endif
+
+		// - add the light's contribution to the fragment:
+		frag_color += lit_value;
+	}
+	#endif
+
 	// Set the output alpha value:
 	frag_color.a = texel_diffuse.a;
 }
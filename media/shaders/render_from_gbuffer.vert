@@ -2,7 +2,7 @@
 // Program used for rendering a scene in a full-screen quad using
 // a G-buffer and light positions.
 // Supported symbols:
-// _NB_LIGHTS_           : Number of lights to support
+// _NB_LIGHTS_           : Number of shadowed lights to support
 // _SHADOW_MAPPING_      : Use shadow mapping.
 // _VISIBILITY_MAPS_     : Uses visibility maps for the shadow mapping
 // _BRDF_FUNCTION_       : Name of the BRDF function to use (e.g. "blinn_phong")
@@ -10,6 +10,10 @@
 //                         is opaque (alpha == 1)
 // _TEST_PIXELS_DONE_    : Discards the fragment if the corresponding fragment
 //                         in the "pixels_done" texture is marked
+// _COMPACT_GBUFFER_     : Compact layout of the G-buffer (see library/gbuffer.shader)
+// _CLUSTERED_LIGHTING_  : Lights all the lights of the scene, read from the lists of the
+//                         clusters (see library/light_clusters.shader), instead of the
+//                         _NB_LIGHTS_ shadowed lights only
 
 #version 330 core
 
@@ -0,0 +1,14 @@
+// init_routing.frag
+// Full-screen pass only writing the stencil value of the samples of the A-buffer
+// (see StencilRoutedRenderer::writeFragments())
+
+#version 330 core
+
+// ---------------------------------------------------------------------
+// Default precision
+precision highp float;
+precision mediump int;
+
+void main()
+{
+}
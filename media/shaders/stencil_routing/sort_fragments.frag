@@ -1,4 +1,10 @@
 // sort_fragments.frag
+// Reads the fragments stored in the samples of the A-buffer and sorts them from front to back.
+// Supported symbols:
+// _NB_SAMPLES_    : number of samples of the A-buffer (maximum number of fragments per pixel)
+// _EXTRACT_LAYER_ : writes the normal and the depth of the num_layer-th fragment (the layers have
+//                   the same content as the ones of the depth peeling)
+// otherwise       : composites the fragments as semi-transparent surfaces, over back_color
 
 #version 330 core
 
@@ -7,11 +13,84 @@
 precision highp float;
 precision mediump int;
 
+// ---------------------------------------------------------------------
+// Uniforms
+uniform sampler2DMS tex_fragments;	// normal (xyz), depth (w), 2.0 for the empty samples
+
+#ifdef _EXTRACT_LAYER_
+	uniform int num_layer;
+#else
+	uniform vec3 back_color;
+	uniform float layer_opacity;
+#endif
+
 // ---------------------------------------------------------------------
 // Fragment shader output:
-out vec4 frag_color;
+#ifdef _EXTRACT_LAYER_
+	out vec4 frag_normal;
+#else
+	out vec4 frag_color;
+#endif
 
 void main()
 {
-	frag_color = vec4(1.0, 0.0, 0.0, 0.0);
+	ivec2 coords = ivec2(gl_FragCoord.xy);
+
+	// Read the fragments of the pixel:
+	vec4 fragments[_NB_SAMPLES_];
+	int nb_fragments = 0;
+
+	for(int i=0 ; i < _NB_SAMPLES_ ; i++)
+	{
+		vec4 fragment = texelFetch(tex_fragments, coords, i);
+		if(fragment.w <= 1.0)
+		{
+			fragments[nb_fragments] = fragment;
+			nb_fragments++;
+		}
+	}
+
+	// Insertion sort, by increasing depth:
+	for(int i=1 ; i < nb_fragments ; i++)
+	{
+		vec4 fragment = fragments[i];
+
+		int j = i-1;
+		while(j >= 0 && fragments[j].w > fragment.w)
+		{
+			fragments[j+1] = fragments[j];
+			j--;
+		}
+		fragments[j+1] = fragment;
+	}
+
+#ifdef _EXTRACT_LAYER_
+	// Same values as the depth peeling for the missing layers:
+	if(num_layer < nb_fragments)
+	{
+		frag_normal = vec4(fragments[num_layer].xyz, 0.0);
+		gl_FragDepth = fragments[num_layer].w;
+	}
+	else
+	{
+		frag_normal = vec4(0.0);
+		gl_FragDepth = 1.0;
+	}
+#else
+	// Front to back compositing:
+	vec3 color = vec3(0.0);
+	float transmittance = 1.0;
+
+	for(int i=0 ; i < nb_fragments ; i++)
+	{
+		vec3 shade = vec3(0.2 + 0.8*abs(fragments[i].z));
+
+		color += transmittance * layer_opacity * shade;
+		transmittance *= 1.0 - layer_opacity;
+	}
+
+	color += transmittance * back_color;
+
+	frag_color = vec4(color, 1.0);
+#endif
 }
@@ -1,4 +1,6 @@
 // write_fragments.frag
+// Writes a fragment to the A-buffer: the stencil routing (see StencilRoutedRenderer.h) selects
+// the sample it is stored in.
 
 #version 330 core
 
@@ -7,11 +9,18 @@
 precision highp float;
 precision mediump int;
 
+// ---------------------------------------------------------------------
+// Varying variables
+smooth in vec3 var_eye_position;
+
 // ---------------------------------------------------------------------
 // Fragment shader output:
-out vec4 frag_color;
+out vec4 frag_fragment;	// eye space normal (xyz), window space depth (w)
 
 void main()
 {
-	frag_color = vec4(1.0, 0.0, 0.0, 0.0);
+	// Face normal, facing the camera (the VAOs of the normal-mapped materials have no normals):
+	vec3 normal = normalize(cross(dFdx(var_eye_position), dFdy(var_eye_position)));
+
+	frag_fragment = vec4(normal, gl_FragCoord.z);
 }
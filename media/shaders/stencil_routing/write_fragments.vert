@@ -1,4 +1,7 @@
 // write_fragments.vert
+// The scene is drawn by RasterRenderer::renderGeometryArray(): the position is computed exactly
+// like in general.vert (with _INSTANCING_), and is declared invariant in both shaders, so that
+// the depths of the A-buffer can be tested with GL_EQUAL by the programs of the materials.
 
 #version 330 core
 
@@ -7,13 +10,28 @@
 precision highp float;
 precision highp int;
 
+// ---------------------------------------------------------------------
+// Uniform blocks: view_matrix and projection_matrix
+#include "library/uniform_blocks.shader"
+
 // ---------------------------------------------------------------------
 // Attributes:
 in vec3 vertex_position;
+in mat4 instance_model_matrix;
+
+invariant gl_Position;
+
+// ---------------------------------------------------------------------
+// Varying variables
+smooth out vec3 var_eye_position;
 
 // ---------------------------------------------------------------------
 // main:
 void main()
 {
-	gl_Position = vec4(vertex_position, 1.0);
+	mat4 modelview_matrix = view_matrix * instance_model_matrix;
+	vec4 eye_space_pos = modelview_matrix * vec4(vertex_position, 1.0);
+	var_eye_position = eye_space_pos.xyz;
+
+	gl_Position = projection_matrix * eye_space_pos;
 }
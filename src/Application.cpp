@@ -18,6 +18,7 @@
 #include "renderer/RasterRenderer.h"
 #include "renderer/RaytraceRenderer.h"
 #include "renderer/StencilRoutedRenderer.h"
+#include "renderer/utils/UniformBlocks.h"
 
 #include "scene/Scene.h"
 #include "scene/SceneLoader.h"
@@ -52,6 +53,9 @@ int Application::run()
 	// Initialize glutil:
 	glutil::init();
 
+	// Create the uniform buffers shared by the programs:
+	UniformBlocks::init();
+
 	// Setup the scenes, the renderers and the camera animators
 	createScenes();
 	createRenderers();
@@ -89,6 +93,9 @@ int Application::run()
 
 	cleanup();
 
+	// Delete the uniform buffers:
+	UniformBlocks::shutdown();
+
 	// Shutdown glutil:
 	glutil::shutdown();
 
@@ -101,6 +108,9 @@ void Application::render()
 	Renderer* current_renderer = renderers[num_current_renderer];
 	Scene* current_scene = scenes[num_current_scene];
 
+	// Count the state changes of this frame only:
+	glutil::resetStateCacheStats();
+
 	current_renderer->render(current_scene);
 
 	if(debug_draw_3D)
@@ -119,6 +129,8 @@ void Application::update(double elapsed)
 
 	SceneAnimator* scene_animator = scene_animators[num_current_scene_animator];
 	scene_animator->update(elapsed);
+
+	scenes[num_current_scene]->updateTransforms();
 }
 
 void Application::countFPS()
@@ -148,18 +160,21 @@ void Application::updateWinTitle(double render_time)
 	stringstream ss;
 	string scene_name = scenes[num_current_scene]->getName();
 	string renderer_name = renderers[num_current_renderer]->getName();
+	const glutil::StateCacheStats& state_stats = glutil::getStateCacheStats();
 
 	if(fps >= 0)
 		ss	<< WIN_TITLE
 			<< " | " << renderer_name
 			<< " | FPS:" << fps
 			<< " | " << scene_name
-			<< " | " << render_time << "s/frame";
+			<< " | " << render_time << "s/frame"
+			<< " | GL state: " << state_stats.nb_issued << " issued, " << state_stats.nb_skipped << " skipped";
 	else
 		ss	<< WIN_TITLE
 			<< " | " << renderer_name
 			<< " | " << scene_name
-			<< " | " << render_time << "s/frame";
+			<< " | " << render_time << "s/frame"
+			<< " | GL state: " << state_stats.nb_issued << " issued, " << state_stats.nb_skipped << " skipped";
 
 	glfwSetWindowTitle(GLFWWindow::getInstance()->getWindow(), ss.str().c_str());
 	ss.str("");
@@ -254,8 +269,8 @@ void Application::createRenderers()
 	// 3: Depth peeling renderer (DEPRECATED)
 	renderers.push_back(new DepthPeelingRenderer(WIN_WIDTH, WIN_HEIGHT, BACK_COLOR, NB_DEPTH_LAYERS));
 
-	// 4: Stencil-routed A-Buffer renderer
-	renderers.push_back(new StencilRoutedRenderer(WIN_WIDTH, WIN_HEIGHT));
+	// 4: Stencil-routed A-Buffer renderer (same layers as the depth peeling, in a single geometry pass)
+	renderers.push_back(new StencilRoutedRenderer(WIN_WIDTH, WIN_HEIGHT, BACK_COLOR, NB_DEPTH_LAYERS));
 
 	// 5: Multi layer renderer (deferred shading + depth peeling)
 	renderers.push_back(new MultiLayerRenderer(WIN_WIDTH,
@@ -448,6 +463,13 @@ void Application::onKeyEvent(int key, int action)
 		else if(key == 'D')
 			debug_draw_3D = !debug_draw_3D;
 
+		// E (Early depth): toggle the depth pre-pass of the raster renderers on/off
+		else if(key == 'E')
+		{
+			RasterRenderer::setDepthPrepassEnabled( ! RasterRenderer::isDepthPrepassEnabled());
+			cout << "depth pre-pass: " << (RasterRenderer::isDepthPrepassEnabled() ? "on" : "off") << endl;
+		}
+
 		// F1 / F2: change scene
 		else if(key == GLFW_KEY_F1)
 			msg = prevValue(&num_current_scene, nb_scenes);
@@ -595,6 +617,7 @@ void Application::printHelp()
 
 	cout << "O (Overlay): toggle 2D debug drawing on/off [now: " << (debug_draw_2D ? "on" : "off") << "]" << endl;
 	cout << "D: toggle 3D debug drawing on/off [now: " << (debug_draw_3D ? "on" : "off") << "]" << endl;
+	cout << "E (Early depth): toggle the depth pre-pass on/off [now: " << (RasterRenderer::isDepthPrepassEnabled() ? "on" : "off") << "]" << endl;
 	cout << "M: print GPU memory information" << endl;
 	cout << "--------------" << endl;
 
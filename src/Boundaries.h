@@ -4,9 +4,13 @@
 #ifndef BOUNDARIES_H
 #define BOUNDARIES_H
 
-// Maximum number of lights
-#define NB_MAX_LIGHTS 4	// IMPORTANT: if we want to increase this value over 4, we need to extend
-						// the "visibility map" mechanism for the deferred shading renderer.
+// Maximum number of lights in a scene (with clustered deferred shading, see LightClusters.h)
+#define NB_MAX_LIGHTS 256
+
+// Maximum number of shadowed lights: only the first lights of a scene have a shadow map and are
+// in the lights uniform block, so the forward shading only takes them into account.
+#define NB_MAX_SHADOWED_LIGHTS 4	// IMPORTANT: if we want to increase this value over 4, we need to
+									// extend the "visibility map" mechanism for the deferred shading renderer.
 
 // Maximum number of VAOs for one Geometry object
 // A VAO index has to be below this value.
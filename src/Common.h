@@ -10,21 +10,32 @@
 #include <iostream>
 
 typedef glm::uint32   uint;
+typedef glm::uint64   uint64;
 typedef glm::uint8    uchar;
 typedef glm::f32vec2  vec2;
 typedef glm::f32vec3  vec3;
 typedef glm::f32vec4  vec4;
 typedef glm::f32mat3  mat3;
 typedef glm::f32mat4  mat4;
-typedef glm::u8vec3   Pixel;
+
+// 8 bits per channel pixel, stored as BGRA (the layout of the fast upload path of most drivers,
+// see glutil::Quad)
+struct Pixel
+{
+	uchar b, g, r, a;
+
+	Pixel() : b(0), g(0), r(0), a(255) {}
+	Pixel(uchar r, uchar g, uchar b, uchar a=255) : b(b), g(g), r(r), a(a) {}
+};
 
 // Check the size of some common types :
 inline void __ValidateSizes__()
 {
 	ASSERT_STATIC(sizeof(uint) == 4);
+	ASSERT_STATIC(sizeof(uint64) == 8);
 	ASSERT_STATIC(sizeof(vec3) == 3*sizeof(float));
 	ASSERT_STATIC(sizeof(vec4) == 4*sizeof(float));
-	ASSERT_STATIC(sizeof(Pixel) == 3*sizeof(unsigned char));
+	ASSERT_STATIC(sizeof(Pixel) == 4*sizeof(unsigned char));
 }
 
 // iostream support for GLM types :
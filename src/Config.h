@@ -46,6 +46,40 @@
 // the full-screen quad?
 #define USE_VISIBILITY_MAPS false
 
+// Should we pack the static geometries and submit the draws with multi-draw indirect,
+// when supported (OpenGL 4.3 or GL_ARB_multi_draw_indirect and GL_ARB_base_instance)?
+#define USE_MULTI_DRAW_INDIRECT true
+
+// Should the G-buffers use the compact layout (positions reconstructed from the depth, encoded
+// normals in RG16, diffuse and specular in RGBA8) instead of four RGBA16F textures?
+#define USE_COMPACT_GBUFFER false
+
+// Should the deferred shading renderer cull the lights in clusters of the view frustum and light
+// all the lights of the scene (see LightClusters.h), instead of only the shadowed lights?
+#define USE_CLUSTERED_LIGHTING false
+
+// With the clustered lighting, should the unshadowed lights be attenuated with the distance,
+// down to 0 at their range? (otherwise, like the shadowed lights, they have no attenuation)
+#define USE_CLUSTERED_LIGHT_FALLOFF false
+
+// Should RasterRenderer render the depth of the opaque objects before shading them, so that
+// the main pass is done with the GL_EQUAL depth test? (can be toggled at runtime with the E key)
+#define USE_DEPTH_PREPASS false
+
+// Should MultiLayerRenderer compute the depth of its back layers with the stencil-routed A-buffer
+// (a single geometry pass, see StencilRoutedRenderer.h), and render their G-buffers with the
+// GL_EQUAL depth test, instead of the depth peeling? The fragments beyond the number of samples
+// of the A-buffer are lost, so that the layers can differ where the depth complexity is higher.
+#define USE_STENCIL_ROUTED_LAYERS false
+
+// Should the photons be traced in screen space with the hierarchical traversal of the min-max
+// depth pyramid (see library/screen_ray_marching.shader), instead of a linear DDA over the pixels?
+#define USE_HIZ_RAY_MARCHING true
+
+// Should the CPU raytracer write its pixels directly into the mapped pixel buffer objects of its
+// fullscreen quad (see glutil::Quad), uploaded to the texture while the next frame is traced?
+#define USE_PBO_STREAMING false
+
 // Enable vertical synchronization?
 #define ENABLE_VSYNC true
 
@@ -1,5 +1,6 @@
 // ShaderLocations.h
-// We group in this file the vertex attribute locations and the fragment data locations.
+// We group in this file the vertex attribute locations, the fragment data locations
+// and the binding points of the uniform blocks.
 
 #ifndef SHADER_LOCATIONS_H
 #define SHADER_LOCATIONS_H
@@ -10,6 +11,7 @@
 #define GENERAL_PROFILE_ATTRIB_POSITION  0
 #define GENERAL_PROFILE_ATTRIB_NORMAL    1
 #define GENERAL_PROFILE_ATTRIB_TEXCOORDS 2
+#define GENERAL_PROFILE_ATTRIB_INSTANCE_MODEL_MATRIX 3	// _INSTANCING_ only: a mat4 uses locations 3 to 6
 
 // Fragment data (fragment shader output):
 // - forward rendering
@@ -32,6 +34,22 @@
 // Fragment data (fragment shader output):
 #define DEPTH_PEELING_FRAG_DATA_NORMAL 0
 
+// ---------------------------------------------------------------------
+// STENCIL ROUTED A-BUFFER:
+// Vertex attributes (scene geometry, with the same VAOs as the general profile, or full-screen quad):
+#define STENCIL_ROUTED_ATTRIB_POSITION              GENERAL_PROFILE_ATTRIB_POSITION
+#define STENCIL_ROUTED_ATTRIB_INSTANCE_MODEL_MATRIX GENERAL_PROFILE_ATTRIB_INSTANCE_MODEL_MATRIX
+
+// Fragment data (fragment shader output):
+#define STENCIL_ROUTED_FRAG_DATA_FRAGMENT 0	// write_fragments.frag
+#define STENCIL_ROUTED_FRAG_DATA_NORMAL   0	// sort_fragments.frag, _EXTRACT_LAYER_
+#define STENCIL_ROUTED_FRAG_DATA_COLOR    0	// sort_fragments.frag, otherwise
+
+// ---------------------------------------------------------------------
+// DEPTH PRE-PASS (same VAOs as the general profile):
+#define DEPTH_PREPASS_ATTRIB_POSITION              GENERAL_PROFILE_ATTRIB_POSITION
+#define DEPTH_PREPASS_ATTRIB_INSTANCE_MODEL_MATRIX GENERAL_PROFILE_ATTRIB_INSTANCE_MODEL_MATRIX
+
 // ---------------------------------------------------------------------
 // SHADOW MAPS:
 #define SHADOW_MAP_ATTRIB_POSITION 0
@@ -52,15 +70,41 @@
 #define PHOTONS_MAP_FRAG_DATA_OUTPUT0 0
 #define PHOTONS_MAP_FRAG_DATA_OUTPUT1 1
 
+// ---------------------------------------------------------------------
+// PHOTON BOUNCES (transform feedback, no fragment data):
+#define PHOTON_BOUNCES_ATTRIB_POSITION  0
+#define PHOTON_BOUNCES_ATTRIB_POWER     1
+#define PHOTON_BOUNCES_ATTRIB_DIRECTION 2
+
 // ---------------------------------------------------------------------
 // MIN-MAX MIPMAPS
 #define MIN_MAX_MIPMAPS_ATTRIB_POSITION 0
 
 #define MIN_MAX_MIPMAPS_FRAG_DATA_OUTPUT 0
 
+// ---------------------------------------------------------------------
+// HISTOPYRAMID
+#define HISTO_PYRAMID_ATTRIB_POSITION 0
+
+#define HISTO_PYRAMID_FRAG_DATA_OUTPUT 0
+
+// ---------------------------------------------------------------------
+// TEXTURE REDUCER (generic reduction, see TextureReducer::reduce())
+#define TEXTURE_REDUCER_ATTRIB_POSITION 0
+
+#define TEXTURE_REDUCER_FRAG_DATA_OUTPUT0 0
+#define TEXTURE_REDUCER_FRAG_DATA_OUTPUT1 1
+#define TEXTURE_REDUCER_FRAG_DATA_OUTPUT2 2
+#define TEXTURE_REDUCER_FRAG_DATA_OUTPUT3 3
+
 // Debug:
 #define DEBUG_PHOTONS_MAP_ATTRIB_POSITION 0
 
 #define DEBUG_PHOTONS_MAP_FRAG_DATA_COLOR 0
 
+// ---------------------------------------------------------------------
+// UNIFORM BLOCKS (see UniformBlocks.h and media/shaders/library/uniform_blocks.shader):
+#define UNIFORM_BLOCK_BINDING_CAMERA 0	// "CameraBlock"
+#define UNIFORM_BLOCK_BINDING_LIGHTS 1	// "LightsBlock"
+
 #endif // SHADER_LOCATIONS_H
@@ -82,8 +82,8 @@ void LightSceneAnimator::onSceneChanged()
 
 	for(uint i=0 ; i < nb_lights ; i++)
 	{
-		original_light_pos[i] = lights[i]->getPosition();
-		original_light_orientations[i] = lights[i]->getOrientation();
+		original_light_pos[i] = lights[i]->getLocalPosition();
+		original_light_orientations[i] = lights[i]->getLocalOrientation();
 	}
 
 	depth_mode = DEFAULT_DEPTH_MODE;
@@ -199,7 +199,7 @@ void LightSceneAnimator::onMouseButtonEvent(int button, int action)
 
 		// Record original mouse position and original light position
 		glfwGetCursorPos(GLFWWindow::getInstance()->getWindow(), &original_mouse_x, &original_mouse_y);
-		light_pos_before_drag = lights[num_light]->getPosition();
+		light_pos_before_drag = lights[num_light]->getLocalPosition();
 	}
 }
 
@@ -254,7 +254,7 @@ void LightSceneAnimator::onKeyEvent(int key, int action)
 		else if(key == 'X' || key == 'Y' || key == 'Z')
 		{
 			cout << "Rotating the light on the " << char(key) << " axis - left click to end, right click to cancel" << endl;
-			prev_orientation = lights[num_light]->getOrientation();
+			prev_orientation = lights[num_light]->getLocalOrientation();
 
 			// Record original mouse position and original light position
 			glfwGetCursorPos(GLFWWindow::getInstance()->getWindow(), &original_mouse_x, &original_mouse_y);
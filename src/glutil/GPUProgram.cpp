@@ -1,6 +1,7 @@
 // GPUProgram.cpp
 
 #include "GPUProgram.h"
+#include "StateCache.h"
 #include "../log/Log.h"
 #include <cstdarg>
 #include <cassert>
@@ -8,6 +9,7 @@
 #include <fstream>
 #include <cstring>
 #include <algorithm>
+#include <vector>
 using namespace std;
 
 // Define this to print preprocessed source
@@ -22,17 +24,26 @@ namespace glutil
 
 GPUProgram::GPUProgram(const char* vertex_filename, const char* fragment_filename, bool debug_print)
 : ref_count(0),
-  id_program(0), id_vertex(0), id_fragment(0),
+  id_program(0), id_vertex(0), id_geometry(0), id_fragment(0), id_compute(0),
   debug_print(debug_print), compiled(false), linked(false),
   uniforms(NULL), nb_uniforms(0),
+  uniform_slots(NULL), uniform_slots_mask(0),
   preproc(NULL),
   vertex_filename(vertex_filename),
-  fragment_filename(fragment_filename)
+  geometry_filename(""),
+  fragment_filename(fragment_filename),
+  compute_filename("")
 {
 	// Create shaders and program:
-	id_vertex = glCreateShader(GL_VERTEX_SHADER);		assert(id_vertex != 0);
-	id_fragment = glCreateShader(GL_FRAGMENT_SHADER);	assert(id_fragment != 0);
-	id_program = glCreateProgram();						assert(id_program != 0);
+	if(!this->vertex_filename.empty())
+	{
+		id_vertex = glCreateShader(GL_VERTEX_SHADER);		assert(id_vertex != 0);
+	}
+	if(!this->fragment_filename.empty())
+	{
+		id_fragment = glCreateShader(GL_FRAGMENT_SHADER);	assert(id_fragment != 0);
+	}
+	id_program = glCreateProgram();							assert(id_program != 0);
 
 	// Create preprocessor:
 	preproc = new Preprocessor(true);
@@ -41,12 +52,15 @@ GPUProgram::GPUProgram(const char* vertex_filename, const char* fragment_filenam
 GPUProgram::~GPUProgram()
 {
 	delete [] uniforms;
+	delete [] uniform_slots;
 
 	delete preproc;
 
-	glDeleteProgram(id_program);
+	glutil::deleteProgram(id_program);
 	glDeleteShader(id_vertex);
+	glDeleteShader(id_geometry);
 	glDeleteShader(id_fragment);
+	glDeleteShader(id_compute);
 }
 
 // ---------------------------------------------------------------------
@@ -60,22 +74,60 @@ GLuint GPUProgram::getVertexShader() const
 	return id_vertex;
 }
 
+GLuint GPUProgram::getGeometryShader() const
+{
+	return id_geometry;
+}
+
 GLuint GPUProgram::getFragmentShader() const
 {
 	return id_fragment;
 }
 
+GLuint GPUProgram::getComputeShader() const
+{
+	return id_compute;
+}
+
 // ---------------------------------------------------------------------
 const std::string& GPUProgram::getVertexFilename() const
 {
 	return vertex_filename;
 }
 
+const std::string& GPUProgram::getGeometryFilename() const
+{
+	return geometry_filename;
+}
+
 const std::string& GPUProgram::getFragmentFilename() const
 {
 	return fragment_filename;
 }
 
+const std::string& GPUProgram::getComputeFilename() const
+{
+	return compute_filename;
+}
+
+// ---------------------------------------------------------------------
+void GPUProgram::setGeometryShader(const char* geometry_filename)
+{
+	assert(!compiled && id_geometry == 0);
+
+	this->geometry_filename = geometry_filename;
+	id_geometry = glCreateShader(GL_GEOMETRY_SHADER);	assert(id_geometry != 0);
+}
+
+void GPUProgram::setComputeShader(const char* compute_filename)
+{
+	assert(!compiled && id_compute == 0);
+	assert(id_vertex == 0 && id_geometry == 0 && id_fragment == 0);
+
+	this->compute_filename = compute_filename;
+	id_compute = glCreateShader(GL_COMPUTE_SHADER);	assert(id_compute != 0);
+}
+
 // ---------------------------------------------------------------------
 Preprocessor* GPUProgram::getPreprocessor()
 {
@@ -91,16 +143,32 @@ const Preprocessor* GPUProgram::getPreprocessor() const
 bool GPUProgram::compileAndAttach()
 {
 	// Load shader sources, preprocess them and send them to the GPU:
-	// - vertex shader:
-	if(!loadShaderSource(vertex_filename.c_str(), id_vertex))
+	// - vertex shader (optional):
+	if(id_vertex != 0 && !loadShaderSource(vertex_filename.c_str(), id_vertex))
 	{
 		compiled = false;
 		assert(false);
 		return compiled;
 	}
 
-	// - fragment shader:
-	if(!loadShaderSource(fragment_filename.c_str(), id_fragment))
+	// - geometry shader (optional):
+	if(id_geometry != 0 && !loadShaderSource(geometry_filename.c_str(), id_geometry))
+	{
+		compiled = false;
+		assert(false);
+		return compiled;
+	}
+
+	// - fragment shader (optional):
+	if(id_fragment != 0 && !loadShaderSource(fragment_filename.c_str(), id_fragment))
+	{
+		compiled = false;
+		assert(false);
+		return compiled;
+	}
+
+	// - compute shader (optional):
+	if(id_compute != 0 && !loadShaderSource(compute_filename.c_str(), id_compute))
 	{
 		compiled = false;
 		assert(false);
@@ -111,34 +179,78 @@ bool GPUProgram::compileAndAttach()
 	GLint status;
 
 	// - vertex shader:
-	glCompileShader(id_vertex);
-	if(debug_print)
-		printShaderLog(id_vertex, vertex_filename, "vertex");
-	glGetShaderiv(id_vertex, GL_COMPILE_STATUS, &status);
-	compiled = (status == GL_TRUE);
-	if(!compiled)
+	if(id_vertex != 0)
 	{
+		glCompileShader(id_vertex);
 		if(debug_print)
-			logError("compiling vertex shader \"", vertex_filename, "\"");
-		return false;
+			printShaderLog(id_vertex, vertex_filename, "vertex");
+		glGetShaderiv(id_vertex, GL_COMPILE_STATUS, &status);
+		compiled = (status == GL_TRUE);
+		if(!compiled)
+		{
+			if(debug_print)
+				logError("compiling vertex shader \"", vertex_filename, "\"");
+			return false;
+		}
+	}
+
+	// - geometry shader:
+	if(id_geometry != 0)
+	{
+		glCompileShader(id_geometry);
+		if(debug_print)
+			printShaderLog(id_geometry, geometry_filename, "geometry");
+		glGetShaderiv(id_geometry, GL_COMPILE_STATUS, &status);
+		compiled = (status == GL_TRUE);
+		if(!compiled)
+		{
+			if(debug_print)
+				logError("compiling geometry shader \"", geometry_filename, "\"");
+			return false;
+		}
 	}
 
 	// - fragment shader:
-	glCompileShader(id_fragment);
-	if(debug_print)
-		printShaderLog(id_fragment, fragment_filename, "fragment");
-	glGetShaderiv(id_fragment, GL_COMPILE_STATUS, &status);
-	compiled = (status == GL_TRUE);
-	if(!compiled)
+	if(id_fragment != 0)
 	{
+		glCompileShader(id_fragment);
 		if(debug_print)
-			logError("compiling fragment shader \"", fragment_filename, "\"");
-		return false;
+			printShaderLog(id_fragment, fragment_filename, "fragment");
+		glGetShaderiv(id_fragment, GL_COMPILE_STATUS, &status);
+		compiled = (status == GL_TRUE);
+		if(!compiled)
+		{
+			if(debug_print)
+				logError("compiling fragment shader \"", fragment_filename, "\"");
+			return false;
+		}
+	}
+
+	// - compute shader:
+	if(id_compute != 0)
+	{
+		glCompileShader(id_compute);
+		if(debug_print)
+			printShaderLog(id_compute, compute_filename, "compute");
+		glGetShaderiv(id_compute, GL_COMPILE_STATUS, &status);
+		compiled = (status == GL_TRUE);
+		if(!compiled)
+		{
+			if(debug_print)
+				logError("compiling compute shader \"", compute_filename, "\"");
+			return false;
+		}
 	}
 
 	// Attach shaders:
-	glAttachShader(id_program, id_vertex);
-	glAttachShader(id_program, id_fragment);
+	if(id_vertex != 0)
+		glAttachShader(id_program, id_vertex);
+	if(id_geometry != 0)
+		glAttachShader(id_program, id_geometry);
+	if(id_fragment != 0)
+		glAttachShader(id_program, id_fragment);
+	if(id_compute != 0)
+		glAttachShader(id_program, id_compute);
 
 	return compiled;	// if we reach this, compiled == true
 }
@@ -211,6 +323,39 @@ void GPUProgram::bindFragDataLocations(const GPUProgram::Location* locations, ui
 		bindFragDataLocation(locations[i].location, locations[i].name.c_str());
 }
 
+// ---------------------------------------------------------------------
+void GPUProgram::setTransformFeedbackVaryings(GLenum buffer_mode, const char* varying_name, ...)
+{
+	assert(id_program != 0 && !linked);
+
+	// Gather the names (glTransformFeedbackVaryings() takes an array):
+	vector<const char*> names;
+
+	va_list vl;
+	va_start(vl, varying_name);
+
+	const char* name = varying_name;
+	while(name != NULL)
+	{
+		names.push_back(name);
+		name = va_arg(vl, const char*);
+	}
+	va_end(vl);
+
+	if(!names.empty())
+		glTransformFeedbackVaryings(id_program, GLsizei(names.size()), &names[0], buffer_mode);
+}
+
+// ---------------------------------------------------------------------
+void GPUProgram::bindUniformBlock(GLuint binding, const char* block_name)
+{
+	assert(linked);
+
+	GLuint index = glGetUniformBlockIndex(id_program, block_name);
+	if(index != GL_INVALID_INDEX)
+		glUniformBlockBinding(id_program, index, binding);
+}
+
 // ---------------------------------------------------------------------
 void GPUProgram::setUniformNames(const char* uniform_name, ...)
 {
@@ -264,6 +409,8 @@ void GPUProgram::setUniformNames(const char* uniform_name, ...)
 		}
 	}
 #endif
+
+	buildUniformSlots();
 }
 
 void GPUProgram::setUniformNames(const char** uniform_names, uint nb_uniforms)
@@ -299,6 +446,8 @@ void GPUProgram::setUniformNames(const char** uniform_names, uint nb_uniforms)
 		}
 	}
 #endif
+
+	buildUniformSlots();
 }
 
 void GPUProgram::setUniformNames(const string* uniform_names, uint nb_uniforms)
@@ -334,6 +483,8 @@ void GPUProgram::setUniformNames(const string* uniform_names, uint nb_uniforms)
 		}
 	}
 #endif
+
+	buildUniformSlots();
 }
 
 void GPUProgram::setUniformNames(const list<string>& uniform_names)
@@ -378,6 +529,8 @@ void GPUProgram::setUniformNames(const list<string>& uniform_names)
 		}
 	}
 #endif
+
+	buildUniformSlots();
 }
 
 // ---------------------------------------------------------------------
@@ -442,7 +595,7 @@ bool GPUProgram::isValidated() const
 // ---------------------------------------------------------------------
 void GPUProgram::use()
 {
-	glUseProgram(id_program);
+	glutil::useProgram(id_program);
 }
 
 // ---------------------------------------------------------------------
@@ -475,6 +628,37 @@ void GPUProgram::sendUniform(Hash h, const mat4& m, bool transpose)
 	glUniformMatrix4fv(getUniformLocation(h), 1, transpose, &m[0][0]);
 }
 
+// ---------------------------------------------------------------------
+// Handle versions:
+void GPUProgram::sendUniform(UniformHandle h, GLint i)
+{
+	glUniform1i(h.location, i);
+}
+void GPUProgram::sendUniform(UniformHandle h, GLfloat f)
+{
+	glUniform1f(h.location, f);
+}
+void GPUProgram::sendUniform(UniformHandle h, const vec2& v)
+{
+	glUniform2fv(h.location, 1, &v[0]);
+}
+void GPUProgram::sendUniform(UniformHandle h, const vec3& v)
+{
+	glUniform3fv(h.location, 1, &v[0]);
+}
+void GPUProgram::sendUniform(UniformHandle h, const vec4& v)
+{
+	glUniform4fv(h.location, 1, &v[0]);
+}
+void GPUProgram::sendUniform(UniformHandle h, const mat3& m, bool transpose)
+{
+	glUniformMatrix3fv(h.location, 1, transpose, &m[0][0]);
+}
+void GPUProgram::sendUniform(UniformHandle h, const mat4& m, bool transpose)
+{
+	glUniformMatrix4fv(h.location, 1, transpose, &m[0][0]);
+}
+
 // ---------------------------------------------------------------------
 // Runtime versions:
 #ifdef NDEBUG
@@ -488,6 +672,13 @@ void GPUProgram::sendUniform(Hash h, const mat4& m, bool transpose)
 #endif
 
 
+GPUProgram::UniformHandle GPUProgram::getUniformHandle(const char* uniform_name, Hash::Marker marker) const
+{
+	GLint location = getUniformLocation(Hash(uniform_name, Hash::AT_RUNTIME));
+	CHECK_LOCATION(uniform_name, location);
+	return UniformHandle(location);
+}
+
 void GPUProgram::sendUniform(const char* uniform_name, GLint i,                       Hash::Marker marker)
 {
 	GLint location = getUniformLocation(Hash(uniform_name, Hash::AT_RUNTIME));
@@ -564,13 +755,52 @@ bool GPUProgram::loadShaderSource(const char* filename, GLuint id_shader)
 }
 
 // ---------------------------------------------------------------------
-inline GLint GPUProgram::getUniformLocation(Hash h) const
+// Mix the bits of a hash value, to get the first slot to look at in "uniform_slots[]"
+static inline uint getFirstUniformSlot(int hash_val, uint mask)
 {
+	uint h = uint(hash_val);
+	h ^= h >> 16;
+	return h & mask;
+}
+
+// Build "uniform_slots[]" from "uniforms[]" (called by setUniformNames())
+void GPUProgram::buildUniformSlots()
+{
+	delete [] uniform_slots;
+
+	// At least twice as many slots as uniforms, so that there is always an empty slot
+	// ending the linear probing:
+	uint nb_slots = 1;
+	while(nb_slots < 2*nb_uniforms)
+		nb_slots *= 2;
+
+	uniform_slots = new int[nb_slots];
+	uniform_slots_mask = nb_slots - 1;
+
+	for(uint s=0 ; s < nb_slots ; s++)
+		uniform_slots[s] = -1;
+
 	for(uint i=0 ; i < nb_uniforms ; i++)
 	{
-		const Uniform& u = uniforms[i];
+		uint s = getFirstUniformSlot(uniforms[i].hash_val, uniform_slots_mask);
+		while(uniform_slots[s] >= 0)
+			s = (s+1) & uniform_slots_mask;
+		uniform_slots[s] = int(i);
+	}
+}
+
+inline GLint GPUProgram::getUniformLocation(Hash h) const
+{
+	if(uniform_slots == NULL)
+		return UNKNOWN_UNIFORM;
+
+	uint s = getFirstUniformSlot(h.val, uniform_slots_mask);
+	for(int index = uniform_slots[s] ; index >= 0 ; index = uniform_slots[s])
+	{
+		const Uniform& u = uniforms[index];
 		if(u.hash_val == h.val)
 			return u.location;
+		s = (s+1) & uniform_slots_mask;
 	}
 	return UNKNOWN_UNIFORM;
 }
@@ -11,6 +11,13 @@ ok &= p->link();
 assert(ok);
 p->setUniformNames("ambient_color", "texunit", NULL);
 p->validate();
+// Optional geometry shader (before compileAndAttach()), transform feedback (before link()),
+// and no fragment shader when fragment_filename is "" (e.g. with GL_RASTERIZER_DISCARD):
+// p->setGeometryShader("shader.geom");
+// p->setTransformFeedbackVaryings(GL_INTERLEAVED_ATTRIBS, "out_position", "out_color", NULL);
+// Compute program (OpenGL 4.3 or GL_ARB_compute_shader, see glxwHasComputeShader()):
+// GPUProgram* p = new GPUProgram("", "");
+// p->setComputeShader("shader.comp");
 // -----
 p->use();
 p->sendUniform("texunit", 0);
@@ -49,11 +56,23 @@ public:
 		}
 	};
 
+	// Handle of a uniform variable, resolved once with getUniformHandle() and then used
+	// with sendUniform() without any lookup (e.g. for uniform names built at runtime).
+	struct UniformHandle
+	{
+		GLint location;
+
+		UniformHandle() : location(-1) {}
+		explicit UniformHandle(GLint location) : location(location) {}
+	};
+
 private:
 	// OpenGL objects
 	GLuint id_program;
-	GLuint id_vertex;
-	GLuint id_fragment;
+	GLuint id_vertex;	// 0 if there is no vertex shader (compute program)
+	GLuint id_geometry;	// 0 if there is no geometry shader
+	GLuint id_fragment;	// 0 if there is no fragment shader
+	GLuint id_compute;	// 0 if there is no compute shader
 
 	bool debug_print;	// Should we print to the console ?
 	bool compiled;	// Are both shaders compiled ?
@@ -73,12 +92,20 @@ private:
 	Uniform* uniforms;
 	uint nb_uniforms;
 
+	// Open addressing hash table of the indices of the uniforms in "uniforms[]" (-1 for
+	// empty slots), so that getUniformLocation() does not scan the whole array.
+	// Its size is a power of 2, at least twice the number of uniforms.
+	int* uniform_slots;
+	uint uniform_slots_mask;
+
 	// Preprocessor:
 	Preprocessor* preproc;
 
 	// Shaders filenames:
 	std::string vertex_filename;
+	std::string geometry_filename;
 	std::string fragment_filename;
+	std::string compute_filename;
 
 private:
 	GPUProgram() {}
@@ -88,10 +115,20 @@ public:
 
 	GLuint getProgram() const;
 	GLuint getVertexShader() const;
+	GLuint getGeometryShader() const;
 	GLuint getFragmentShader() const;
+	GLuint getComputeShader() const;
 
 	const std::string& getVertexFilename() const;
+	const std::string& getGeometryFilename() const;
 	const std::string& getFragmentFilename() const;
+	const std::string& getComputeFilename() const;
+
+	// Add a geometry shader (before compileAndAttach())
+	void setGeometryShader(const char* geometry_filename);
+
+	// Set the compute shader of a program without vertex and fragment shaders (before compileAndAttach())
+	void setComputeShader(const char* compute_filename);
 
 	Preprocessor* getPreprocessor();
 	const Preprocessor* getPreprocessor() const;
@@ -107,6 +144,14 @@ public:
 	void bindFragDataLocations(GLint location, const char* frag_data_name, ...);
 	void bindFragDataLocations(const Location* locations, uint nb_locations);
 
+	// Outputs captured by transform feedback (before link()).
+	// buffer_mode: GL_INTERLEAVED_ATTRIBS or GL_SEPARATE_ATTRIBS
+	void setTransformFeedbackVaryings(GLenum buffer_mode, const char* varying_name, ...);
+
+	// Bind a uniform block to a binding point (after linking). The block is silently
+	// ignored if it is not used by the program.
+	void bindUniformBlock(GLuint binding, const char* block_name);
+
 	void setUniformNames(const char* uniform_name, ...);
 	void setUniformNames(const char** uniform_names, uint nb_uniforms);
 	void setUniformNames(const std::string* uniform_names, uint nb_uniforms);
@@ -129,6 +174,18 @@ public:
 	void sendUniform(Hash h, const mat3& m, bool transpose=false);
 	void sendUniform(Hash h, const mat4& m, bool transpose=false);
 
+	// Resolve a handle once, for sending uniforms whose name is built at runtime:
+	// h = getUniformHandle(uniform_name, Hash::AT_RUNTIME); [...] sendUniform(h, value);
+	UniformHandle getUniformHandle(const char* uniform_name, Hash::Marker marker) const;
+
+	void sendUniform(UniformHandle h, GLint i);
+	void sendUniform(UniformHandle h, GLfloat f);
+	void sendUniform(UniformHandle h, const vec2& v);
+	void sendUniform(UniformHandle h, const vec3& v);
+	void sendUniform(UniformHandle h, const vec4& v);
+	void sendUniform(UniformHandle h, const mat3& m, bool transpose=false);
+	void sendUniform(UniformHandle h, const mat4& m, bool transpose=false);
+
 	// If needed at runtime: sendUniform(uniform_name, value, Hash::AT_RUNTIME)
 	void sendUniform(const char* uniform_name, GLint i,                       Hash::Marker marker);
 	void sendUniform(const char* uniform_name, GLfloat f,                     Hash::Marker marker);
@@ -143,6 +200,9 @@ private:
 	// Load, preprocess and call glShaderSource()
 	bool loadShaderSource(const char* filename, GLuint id_shader);
 
+	// Build "uniform_slots[]" from "uniforms[]" (called by setUniformNames())
+	void buildUniformSlots();
+
 	// Get a uniform location using the memorized "uniforms[]" array and a hash value
 	inline GLint getUniformLocation(Hash h) const;
 
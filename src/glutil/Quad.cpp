@@ -13,17 +13,29 @@
 namespace glutil
 {
 
-Quad::Quad(uint width, uint height)
+Quad::Quad(uint width, uint height, bool use_pbos)
 : width(width), height(height),
   gpu_transfert_done(false),
-  id_vbo(0), id_vao(0)
+  use_pbos(use_pbos), persistent(false), num_pbo(0),
+  id_vbo(0), id_vao(0),
+  pixels(NULL)
 {
-	// Create an array of pixels
-	this->pixels = new Pixel[width*height];
+	for(uint i=0 ; i < QUAD_NB_PBOS ; i++)
+	{
+		id_pbos[i] = 0;
+		mapped_pbos[i] = NULL;
+		pbo_fences[i] = NULL;
+	}
 
 	// Setup the texture
 	createTexture();
 
+	// Create an array of pixels, or the PBOs the pixels are written to
+	if(use_pbos)
+		createPBOs();
+	else
+		this->pixels = new Pixel[width*height];
+
 	// Setup the GPU program
 	createProgram();
 
@@ -33,15 +45,19 @@ Quad::Quad(uint width, uint height)
 
 Quad::~Quad()
 {
-	delete [] this->pixels;
-	glDeleteTextures(1, &id_texture);
+	if(use_pbos)
+		deletePBOs();
+	else
+		delete [] this->pixels;
 
-	glDeleteProgram(id_program);
+	glutil::deleteTextures(1, &id_texture);
+
+	glutil::deleteProgram(id_program);
 	glDeleteShader(id_vertex);
 	glDeleteShader(id_fragment);
 
 	glDeleteBuffers(1, &id_vbo);
-	glDeleteVertexArrays(1, &id_vao);
+	glutil::deleteVertexArrays(1, &id_vao);
 }
 
 void Quad::setPixels(Pixel* pixels)
@@ -53,24 +69,44 @@ void Quad::setPixels(Pixel* pixels)
 void Quad::display()
 {
 	// Texture:
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_RECTANGLE, id_texture);
+	glutil::activeTexture(GL_TEXTURE0);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_texture);
 
 	if(!gpu_transfert_done)
 	{
-		glTexSubImage2D(GL_TEXTURE_RECTANGLE, 0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		if(use_pbos)
+		{
+			// Start the upload from the current PBO:
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id_pbos[num_pbo]);
+
+			if(!persistent)
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			glTexSubImage2D(GL_TEXTURE_RECTANGLE, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, (const GLvoid*)0);
+
+			if(persistent)
+				pbo_fences[num_pbo] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			// The next frame is written to the next PBO:
+			num_pbo = (num_pbo + 1) % QUAD_NB_PBOS;
+			mapCurrentPBO();
+		}
+		else
+			glTexSubImage2D(GL_TEXTURE_RECTANGLE, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, pixels);
 
 		GL_CHECK();
 		gpu_transfert_done = true;
 	}
 
 	// Setup shader and its uniforms:
-	glUseProgram(id_program);
+	glutil::useProgram(id_program);
 	glUniform1i(uniform_texunit, 0);
 
 	// Draw the VAO:
 	const uint nb_vertices = 6;
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 	glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
 }
 
@@ -86,8 +122,8 @@ void Quad::createTexture()
 	// Setup the texture
 	glGenTextures(1, &id_texture);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_RECTANGLE, id_texture);
+	glutil::activeTexture(GL_TEXTURE0);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_texture);
 
 	// Set the filter
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -99,12 +135,107 @@ void Quad::createTexture()
 	glTexImage2D(
 			GL_TEXTURE_RECTANGLE,
 			0,
-			GL_RGB,
+			GL_RGBA8,
 			width, height,
 			0,
-			GL_RGB,
-			GL_UNSIGNED_BYTE,
-			pixels);
+			GL_BGRA,
+			GL_UNSIGNED_INT_8_8_8_8_REV,
+			NULL);
+}
+
+void Quad::createPBOs()
+{
+	const GLsizeiptr size = width*height*sizeof(Pixel);
+
+	persistent = glxwHasBufferStorage();
+
+	glGenBuffers(QUAD_NB_PBOS, id_pbos);
+
+	for(uint i=0 ; i < QUAD_NB_PBOS ; i++)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id_pbos[i]);
+
+		if(persistent)
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+			mapped_pbos[i] = (Pixel*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+			assert(mapped_pbos[i] != NULL);
+		}
+		else
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	GL_CHECK();
+
+	num_pbo = 0;
+	mapCurrentPBO();
+}
+
+void Quad::deletePBOs()
+{
+	if(persistent)
+	{
+		for(uint i=0 ; i < QUAD_NB_PBOS ; i++)
+		{
+			if(pbo_fences[i] != NULL)
+				glDeleteSync(pbo_fences[i]);
+			pbo_fences[i] = NULL;
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id_pbos[i]);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			mapped_pbos[i] = NULL;
+		}
+	}
+	else
+	{
+		// Only the current PBO is mapped:
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id_pbos[num_pbo]);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glDeleteBuffers(QUAD_NB_PBOS, id_pbos);
+	for(uint i=0 ; i < QUAD_NB_PBOS ; i++)
+		id_pbos[i] = 0;
+
+	pixels = NULL;
+}
+
+void Quad::mapCurrentPBO()
+{
+	if(persistent)
+	{
+		// Wait for the end of the previous upload from this PBO (normally done since the
+		// other PBOs were written in between):
+		GLsync& fence = pbo_fences[num_pbo];
+		if(fence != NULL)
+		{
+			glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fence);
+			fence = NULL;
+		}
+
+		pixels = mapped_pbos[num_pbo];
+	}
+	else
+	{
+		// The previous content is invalidated, so the driver does not have to wait for the end
+		// of its previous upload:
+		const GLsizeiptr size = width*height*sizeof(Pixel);
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id_pbos[num_pbo]);
+		pixels = (Pixel*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+		                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		assert(pixels != NULL);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	GL_CHECK();
 }
 
 void Quad::createProgram()
@@ -156,7 +287,7 @@ void Quad::createVBOAndVAO()
 	glGenVertexArrays(1, &id_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Data:
 	GLfloat max_x = GLfloat(width);
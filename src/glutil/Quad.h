@@ -6,10 +6,20 @@
 #include "../Common.h"
 #include "glxw.h"
 
+// Number of pixel buffer objects of a Quad in PBO mode
+#define QUAD_NB_PBOS 3
+
 namespace glutil
 {
 
-// A fullscreen quad
+// A fullscreen quad, displaying a BGRA8 texture.
+// In PBO mode (use_pbos), the pixels are directly written to a mapped pixel buffer object, and
+// display() starts the asynchronous upload of this PBO to the texture, then maps the next one
+// (QUAD_NB_PBOS PBOs are used in turn), so that the next frame can be written while the previous
+// ones are uploaded, without any copy. When glBufferStorage() is supported, the PBOs are mapped
+// once and for all (persistent mapping), and a fence protects each PBO until its upload is done.
+// NB: in PBO mode, the address returned by getPixels() changes after each upload, and the pixels
+// have to be written again entirely before the next one.
 class Quad
 {
 private:
@@ -18,6 +28,14 @@ private:
 
 	bool gpu_transfert_done;
 
+	// PBO mode:
+	bool use_pbos;
+	bool persistent;	// persistently mapped PBOs
+	GLuint id_pbos[QUAD_NB_PBOS];
+	Pixel* mapped_pbos[QUAD_NB_PBOS];	// persistent mapping
+	GLsync pbo_fences[QUAD_NB_PBOS];	// end of the upload of each PBO (persistent mapping)
+	uint num_pbo;	// PBO pixels points to
+
 	// VBO and VAO:
 	GLuint id_vbo;
 	GLuint id_vao;
@@ -33,11 +51,11 @@ private:
 	// Uniform :
 	GLuint uniform_texunit;
 
-	Pixel* pixels;
+	Pixel* pixels;	// mapping of the current PBO in PBO mode
 
 public:
 	// Should be created AFTER OpenGL is initialized
-	Quad(uint width, uint height);
+	Quad(uint width, uint height, bool use_pbos=false);
 	~Quad();
 
 	uint getWidth() const {return width;}
@@ -53,6 +71,9 @@ public:
 
 private:
 	void createTexture();
+	void createPBOs();
+	void deletePBOs();
+	void mapCurrentPBO();
 	void createProgram();
 	void createVBOAndVAO();
 };
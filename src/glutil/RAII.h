@@ -1,9 +1,12 @@
 // RAII.h - Resource Aquisition Is Initialisation
+// The state is read from and changed through the state cache (see StateCache.h), so that
+// nested scopes which set the same state do not send anything to OpenGL.
 
 #ifndef RAII_H
 #define RAII_H
 
 #include "glxw.h"
+#include "StateCache.h"
 
 namespace glutil
 {
@@ -16,16 +19,16 @@ template <GLenum flag> struct Enable
 
 	Enable()
 	{
-		state = glIsEnabled(flag);
+		state = isEnabled(flag);
 
 		if(!state)
-			glEnable(flag);
+			enable(flag);
 	}
 
 	~Enable()
 	{
 		if(!state)
-			glDisable(flag);
+			disable(flag);
 	}
 };
 
@@ -37,16 +40,16 @@ template <GLenum flag> struct Disable
 
 	Disable()
 	{
-		state = glIsEnabled(flag);
+		state = isEnabled(flag);
 
 		if(state)
-			glDisable(flag);
+			disable(flag);
 	}
 
 	~Disable()
 	{
 		if(state)
-			glEnable(flag);
+			enable(flag);
 	}
 };
 
@@ -54,17 +57,17 @@ template <GLenum flag> struct Disable
 // BindFramebuffer
 struct BindFramebuffer
 {
-	GLint previous_binding;
+	GLuint previous_binding;
 
-	BindFramebuffer(GLint binding)
+	BindFramebuffer(GLuint binding)
 	{
-		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_binding);
-		glBindFramebuffer(GL_FRAMEBUFFER, binding);
+		previous_binding = getFramebufferBinding(GL_FRAMEBUFFER);
+		bindFramebuffer(GL_FRAMEBUFFER, binding);
 	}
 
 	~BindFramebuffer()
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, previous_binding);
+		bindFramebuffer(GL_FRAMEBUFFER, previous_binding);
 	}
 };
 
@@ -91,40 +94,22 @@ struct TexParameter
 // TexParameterRebind - variant of TexParameter which also rebinds the texture
 // before resetting its parameter.
 
-// Specialized template for doing a "static if":
-template <GLenum>
-struct get_integer_param
-{
-};
-
-template <>
-struct get_integer_param<GL_TEXTURE_2D>
-{
-	enum {value = GL_TEXTURE_BINDING_2D};
-};
-
-template <>
-struct get_integer_param<GL_TEXTURE_RECTANGLE>
-{
-	enum {value = GL_TEXTURE_BINDING_RECTANGLE};
-};
-
 template <GLenum target, GLenum param_name, GLint param>
 struct TexParameterRebind
 {
 	GLint previous_param;
-	GLint previous_binding;
+	GLuint previous_binding;
 
 	TexParameterRebind()
 	{
-		glGetIntegerv(get_integer_param<target>::value, &previous_binding);
+		previous_binding = getTextureBinding(target);
 		glGetTexParameteriv(target, param_name, &previous_param);
 		glTexParameteri(target, param_name, param);
 	}
 
 	~TexParameterRebind()
 	{
-		glBindTexture(target, previous_binding);
+		bindTexture(target, previous_binding);
 		glTexParameteri(target, param_name, previous_param);
 	}
 };
@@ -137,13 +122,13 @@ struct SetViewport
 
 	SetViewport(GLint x, GLint y, GLsizei width, GLsizei height)
 	{
-		glGetIntegerv(GL_VIEWPORT, prev_viewport);
-		glViewport(x, y, width, height);
+		getViewport(prev_viewport);
+		viewport(x, y, width, height);
 	}
 
 	~SetViewport()
 	{
-		glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+		viewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
 	}
 };
 
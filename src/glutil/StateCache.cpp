@@ -0,0 +1,349 @@
+// StateCache.cpp
+
+#include "StateCache.h"
+#include "../Boundaries.h"
+#include <cassert>
+
+// Value of the cached bindings when we do not know what is bound
+#define UNKNOWN_BINDING 0xFFFFFFFF
+
+namespace glutil
+{
+
+// ---------------------------------------------------------------------
+// Cached state:
+// - capabilities: -1 if unknown, 0 if disabled, 1 if enabled
+static const GLenum cached_caps[] = {	GL_DEPTH_TEST,
+										GL_CULL_FACE,
+										GL_BLEND,
+										GL_STENCIL_TEST,
+										GL_SCISSOR_TEST,
+										GL_POLYGON_OFFSET_FILL};
+#define NB_CACHED_CAPS (sizeof(cached_caps) / sizeof(GLenum))
+static signed char caps_state[NB_CACHED_CAPS];
+
+// - texture targets:
+static const GLenum cached_texture_targets[] = {	GL_TEXTURE_1D,
+													GL_TEXTURE_2D,
+													GL_TEXTURE_RECTANGLE,
+													GL_TEXTURE_3D,
+													GL_TEXTURE_2D_ARRAY,
+													GL_TEXTURE_CUBE_MAP,
+													GL_TEXTURE_BUFFER};
+#define NB_CACHED_TEXTURE_TARGETS (sizeof(cached_texture_targets) / sizeof(GLenum))
+
+static GLenum active_texunit = UNKNOWN_BINDING;
+static GLuint texture_bindings[NB_MAX_TEXTURE_BINDINGS][NB_CACHED_TEXTURE_TARGETS];
+
+// - objects:
+static GLuint current_program = UNKNOWN_BINDING;
+static GLuint current_vao = UNKNOWN_BINDING;
+static GLuint current_draw_fbo = UNKNOWN_BINDING;
+static GLuint current_read_fbo = UNKNOWN_BINDING;
+
+// - viewport:
+static bool viewport_known = false;
+static GLint current_viewport[4] = {0, 0, 0, 0};
+
+// - counters:
+static StateCacheStats stats = {0, 0};
+
+// ---------------------------------------------------------------------
+// Helper functions: index of a capability / texture target in the cached arrays,
+// -1 if it is not cached.
+static int getCapIndex(GLenum cap)
+{
+	for(uint i=0 ; i < NB_CACHED_CAPS ; i++)
+		if(cached_caps[i] == cap)
+			return int(i);
+	return -1;
+}
+
+static int getTextureTargetIndex(GLenum target)
+{
+	for(uint i=0 ; i < NB_CACHED_TEXTURE_TARGETS ; i++)
+		if(cached_texture_targets[i] == target)
+			return int(i);
+	return -1;
+}
+
+// Count a state change, return true if it has to be issued
+static inline bool mustIssue(bool changed)
+{
+	if(changed)
+		stats.nb_issued++;
+	else
+		stats.nb_skipped++;
+	return changed;
+}
+
+// ---------------------------------------------------------------------
+void invalidateStateCache()
+{
+	for(uint i=0 ; i < NB_CACHED_CAPS ; i++)
+		caps_state[i] = -1;
+
+	active_texunit = UNKNOWN_BINDING;
+	for(uint i=0 ; i < NB_MAX_TEXTURE_BINDINGS ; i++)
+		for(uint j=0 ; j < NB_CACHED_TEXTURE_TARGETS ; j++)
+			texture_bindings[i][j] = UNKNOWN_BINDING;
+
+	current_program = UNKNOWN_BINDING;
+	current_vao = UNKNOWN_BINDING;
+	current_draw_fbo = UNKNOWN_BINDING;
+	current_read_fbo = UNKNOWN_BINDING;
+
+	viewport_known = false;
+}
+
+const StateCacheStats& getStateCacheStats()
+{
+	return stats;
+}
+
+void resetStateCacheStats()
+{
+	stats.nb_issued = 0;
+	stats.nb_skipped = 0;
+}
+
+// ---------------------------------------------------------------------
+// Capabilities
+void enable(GLenum cap)
+{
+	int index = getCapIndex(cap);
+	if(index < 0)
+	{
+		mustIssue(true);
+		glEnable(cap);
+	}
+	else if(mustIssue(caps_state[index] != 1))
+	{
+		glEnable(cap);
+		caps_state[index] = 1;
+	}
+}
+
+void disable(GLenum cap)
+{
+	int index = getCapIndex(cap);
+	if(index < 0)
+	{
+		mustIssue(true);
+		glDisable(cap);
+	}
+	else if(mustIssue(caps_state[index] != 0))
+	{
+		glDisable(cap);
+		caps_state[index] = 0;
+	}
+}
+
+bool isEnabled(GLenum cap)
+{
+	int index = getCapIndex(cap);
+	if(index < 0)
+		return (glIsEnabled(cap) == GL_TRUE);
+
+	if(caps_state[index] < 0)
+		caps_state[index] = (glIsEnabled(cap) == GL_TRUE ? 1 : 0);
+
+	return (caps_state[index] == 1);
+}
+
+// ---------------------------------------------------------------------
+// Program
+void useProgram(GLuint id_program)
+{
+	if(mustIssue(current_program != id_program))
+	{
+		glUseProgram(id_program);
+		current_program = id_program;
+	}
+}
+
+// NB: a program in use is only flagged for deletion by OpenGL, but its name could
+// be reused afterwards, so we forget it.
+void deleteProgram(GLuint id_program)
+{
+	if(current_program == id_program)
+		current_program = UNKNOWN_BINDING;
+	glDeleteProgram(id_program);
+}
+
+// ---------------------------------------------------------------------
+// Textures
+void activeTexture(GLenum texunit)
+{
+	assert(texunit >= GL_TEXTURE0 && texunit < GL_TEXTURE0 + NB_MAX_TEXTURE_BINDINGS);
+
+	if(mustIssue(active_texunit != texunit))
+	{
+		glActiveTexture(texunit);
+		active_texunit = texunit;
+	}
+}
+
+void bindTexture(GLenum target, GLuint id_texture)
+{
+	int index = getTextureTargetIndex(target);
+
+	// Unknown target or active texture unit: we cannot cache anything
+	if(index < 0 || active_texunit == UNKNOWN_BINDING)
+	{
+		mustIssue(true);
+		glBindTexture(target, id_texture);
+		return;
+	}
+
+	GLuint& binding = texture_bindings[active_texunit - GL_TEXTURE0][index];
+	if(mustIssue(binding != id_texture))
+	{
+		glBindTexture(target, id_texture);
+		binding = id_texture;
+	}
+}
+
+GLuint getTextureBinding(GLenum target)
+{
+	int index = getTextureTargetIndex(target);
+	if(index >= 0 && active_texunit != UNKNOWN_BINDING)
+	{
+		GLuint binding = texture_bindings[active_texunit - GL_TEXTURE0][index];
+		if(binding != UNKNOWN_BINDING)
+			return binding;
+	}
+
+	// Not cached: ask OpenGL
+	GLenum binding_name = 0;
+	switch(target)
+	{
+	case GL_TEXTURE_1D:			binding_name = GL_TEXTURE_BINDING_1D;			break;
+	case GL_TEXTURE_2D:			binding_name = GL_TEXTURE_BINDING_2D;			break;
+	case GL_TEXTURE_RECTANGLE:	binding_name = GL_TEXTURE_BINDING_RECTANGLE;	break;
+	case GL_TEXTURE_3D:			binding_name = GL_TEXTURE_BINDING_3D;			break;
+	case GL_TEXTURE_2D_ARRAY:	binding_name = GL_TEXTURE_BINDING_2D_ARRAY;		break;
+	case GL_TEXTURE_CUBE_MAP:	binding_name = GL_TEXTURE_BINDING_CUBE_MAP;		break;
+	case GL_TEXTURE_BUFFER:		binding_name = GL_TEXTURE_BINDING_BUFFER;		break;
+	default:
+		assert(false);
+		return 0;
+	}
+
+	GLint binding = 0;
+	glGetIntegerv(binding_name, &binding);
+	return GLuint(binding);
+}
+
+// OpenGL reverts the bindings of the deleted textures to 0 in all the texture units
+void deleteTextures(GLsizei n, const GLuint* ids)
+{
+	for(GLsizei k=0 ; k < n ; k++)
+		for(uint i=0 ; i < NB_MAX_TEXTURE_BINDINGS ; i++)
+			for(uint j=0 ; j < NB_CACHED_TEXTURE_TARGETS ; j++)
+				if(texture_bindings[i][j] == ids[k])
+					texture_bindings[i][j] = 0;
+
+	glDeleteTextures(n, ids);
+}
+
+// ---------------------------------------------------------------------
+// Vertex array objects
+void bindVertexArray(GLuint id_vao)
+{
+	if(mustIssue(current_vao != id_vao))
+	{
+		glBindVertexArray(id_vao);
+		current_vao = id_vao;
+	}
+}
+
+void deleteVertexArrays(GLsizei n, const GLuint* ids)
+{
+	for(GLsizei k=0 ; k < n ; k++)
+		if(current_vao == ids[k])
+			current_vao = 0;
+
+	glDeleteVertexArrays(n, ids);
+}
+
+// ---------------------------------------------------------------------
+// Framebuffers
+void bindFramebuffer(GLenum target, GLuint id_fbo)
+{
+	bool bind_draw = (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER);
+	bool bind_read = (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER);
+	assert(bind_draw || bind_read);
+
+	bool changed =	(bind_draw && current_draw_fbo != id_fbo) ||
+					(bind_read && current_read_fbo != id_fbo);
+
+	if(mustIssue(changed))
+	{
+		glBindFramebuffer(target, id_fbo);
+		if(bind_draw)
+			current_draw_fbo = id_fbo;
+		if(bind_read)
+			current_read_fbo = id_fbo;
+	}
+}
+
+// NB: GL_FRAMEBUFFER gives the draw framebuffer binding
+GLuint getFramebufferBinding(GLenum target)
+{
+	GLuint& binding = (target == GL_READ_FRAMEBUFFER ? current_read_fbo : current_draw_fbo);
+	if(binding == UNKNOWN_BINDING)
+	{
+		GLint value = 0;
+		glGetIntegerv(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING, &value);
+		binding = GLuint(value);
+	}
+	return binding;
+}
+
+// OpenGL reverts the bindings of the deleted framebuffers to 0
+void deleteFramebuffers(GLsizei n, const GLuint* ids)
+{
+	for(GLsizei k=0 ; k < n ; k++)
+	{
+		if(current_draw_fbo == ids[k])
+			current_draw_fbo = 0;
+		if(current_read_fbo == ids[k])
+			current_read_fbo = 0;
+	}
+
+	glDeleteFramebuffers(n, ids);
+}
+
+// ---------------------------------------------------------------------
+// Viewport
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	bool changed =	!viewport_known ||
+					current_viewport[0] != x || current_viewport[1] != y ||
+					current_viewport[2] != width || current_viewport[3] != height;
+
+	if(mustIssue(changed))
+	{
+		glViewport(x, y, width, height);
+		current_viewport[0] = x;
+		current_viewport[1] = y;
+		current_viewport[2] = width;
+		current_viewport[3] = height;
+		viewport_known = true;
+	}
+}
+
+void getViewport(GLint viewport[4])
+{
+	if(!viewport_known)
+	{
+		glGetIntegerv(GL_VIEWPORT, current_viewport);
+		viewport_known = true;
+	}
+
+	for(uint i=0 ; i < 4 ; i++)
+		viewport[i] = current_viewport[i];
+}
+
+}
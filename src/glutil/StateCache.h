@@ -0,0 +1,62 @@
+// StateCache.h
+// Shadow copy of the OpenGL state, so that binds and enables which would not change
+// anything are not sent to the driver.
+// The cache is only valid if the corresponding state is always changed through these
+// functions (and the corresponding objects deleted through them): do not mix them with
+// direct calls to glBindTexture(), glUseProgram(), etc. If some code has to change the
+// state directly, call invalidateStateCache() afterwards.
+
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include "glxw.h"
+#include "../Common.h"
+
+namespace glutil
+{
+
+// Number of state changes sent to OpenGL or skipped because they would not change anything
+struct StateCacheStats
+{
+	uint nb_issued;
+	uint nb_skipped;
+};
+
+// Forget everything about the current state (the next changes are always issued)
+void invalidateStateCache();
+
+// Counters, reset by the user (e.g. each frame)
+const StateCacheStats& getStateCacheStats();
+void resetStateCacheStats();
+
+// Capabilities (glutil::enable() / glutil::disable())
+void enable(GLenum cap);
+void disable(GLenum cap);
+bool isEnabled(GLenum cap);
+
+// Program
+void useProgram(GLuint id_program);
+void deleteProgram(GLuint id_program);
+
+// Textures: the bindings are tracked for each texture unit and each target
+void activeTexture(GLenum texunit);	// GL_TEXTURE0 + i
+void bindTexture(GLenum target, GLuint id_texture);
+GLuint getTextureBinding(GLenum target);	// in the active texture unit
+void deleteTextures(GLsizei n, const GLuint* ids);
+
+// Vertex array objects
+void bindVertexArray(GLuint id_vao);
+void deleteVertexArrays(GLsizei n, const GLuint* ids);
+
+// Framebuffers (GL_FRAMEBUFFER, GL_DRAW_FRAMEBUFFER or GL_READ_FRAMEBUFFER)
+void bindFramebuffer(GLenum target, GLuint id_fbo);
+GLuint getFramebufferBinding(GLenum target);
+void deleteFramebuffers(GLsizei n, const GLuint* ids);
+
+// Viewport
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void getViewport(GLint viewport[4]);
+
+}
+
+#endif // STATE_CACHE_H
@@ -1,6 +1,7 @@
 // TextureCreation.cpp
 
 #include "TextureCreation.h"
+#include "StateCache.h"
 
 namespace glutil
 {
@@ -10,7 +11,7 @@ GLuint createTextureDepth(uint width, uint height)
 {
 	GLuint id_texture;
 	glGenTextures(1, &id_texture);
-	glBindTexture(GL_TEXTURE_2D, id_texture);
+	glutil::bindTexture(GL_TEXTURE_2D, id_texture);
 
 	// Set the filter
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -37,7 +38,7 @@ GLuint createTextureRectDepth(uint width, uint height)
 {
 	GLuint id_texture;
 	glGenTextures(1, &id_texture);
-	glBindTexture(GL_TEXTURE_RECTANGLE, id_texture);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_texture);
 
 	// Set the filter
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -64,7 +65,7 @@ GLuint createTextureRGBA8(uint width, uint height, const GLubyte* data)
 {
 	GLuint id_texture;
 	glGenTextures(1, &id_texture);
-	glBindTexture(GL_TEXTURE_2D, id_texture);
+	glutil::bindTexture(GL_TEXTURE_2D, id_texture);
 
 	// Set the filter
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -91,7 +92,7 @@ GLuint createTextureRectRGBA8(uint width, uint height, const GLubyte* data)
 {
 	GLuint id_texture;
 	glGenTextures(1, &id_texture);
-	glBindTexture(GL_TEXTURE_RECTANGLE, id_texture);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_texture);
 
 	// Set the filter
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -118,7 +119,7 @@ GLuint createTextureR8(uint width, uint height, const GLubyte* data)
 {
 	GLuint id_texture;
 	glGenTextures(1, &id_texture);
-	glBindTexture(GL_TEXTURE_2D, id_texture);
+	glutil::bindTexture(GL_TEXTURE_2D, id_texture);
 
 	// Set the filter
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -145,7 +146,7 @@ GLuint createTextureRectR8(uint width, uint height, const GLubyte* data)
 {
 	GLuint id_texture;
 	glGenTextures(1, &id_texture);
-	glBindTexture(GL_TEXTURE_RECTANGLE, id_texture);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_texture);
 
 	// Set the filter
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -167,12 +168,39 @@ GLuint createTextureRectR8(uint width, uint height, const GLubyte* data)
 	return id_texture;
 }
 
+// Rect, RG16
+GLuint createTextureRectRG16(uint width, uint height)
+{
+	GLuint id_texture;
+	glGenTextures(1, &id_texture);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_texture);
+
+	// Set the filter
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// Create the texture
+	glTexImage2D(
+			GL_TEXTURE_RECTANGLE,
+			0,
+			GL_RG16,
+			width, height,
+			0,
+			GL_RG,
+			GL_UNSIGNED_SHORT,
+			NULL);
+
+	return id_texture;
+}
+
 // 2D, RGBA16F|RGBA32F
 GLuint createTextureRGBAF(uint width, uint height, bool use_half_float)
 {
 	GLuint id_texture;
 	glGenTextures(1, &id_texture);
-	glBindTexture(GL_TEXTURE_2D, id_texture);
+	glutil::bindTexture(GL_TEXTURE_2D, id_texture);
 
 	// Set the filter
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -199,7 +227,7 @@ GLuint createTextureRectRGBAF(uint width, uint height, bool use_half_float)
 {
 	GLuint id_texture;
 	glGenTextures(1, &id_texture);
-	glBindTexture(GL_TEXTURE_RECTANGLE, id_texture);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_texture);
 
 	// Set the filter
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -221,6 +249,19 @@ GLuint createTextureRectRGBAF(uint width, uint height, bool use_half_float)
 	return id_texture;
 }
 
+// Buffer texture
+GLuint createTextureBuffer(GLenum internal_format, GLuint id_buffer)
+{
+	GLuint id_texture;
+	glGenTextures(1, &id_texture);
+	glutil::bindTexture(GL_TEXTURE_BUFFER, id_texture);
+
+	// Attach the buffer (buffer textures have no filtering and no mipmaps)
+	glTexBuffer(GL_TEXTURE_BUFFER, internal_format, id_buffer);
+
+	return id_texture;
+}
+
 // Renderbuffer, RGBA8
 GLuint createRenderbufferRGBA8(uint width, uint height)
 {
@@ -27,12 +27,18 @@ GLuint createTextureR8(uint width, uint height, const GLubyte* data=NULL);
 // Rect, RED8
 GLuint createTextureRectR8(uint width, uint height, const GLubyte* data=NULL);
 
+// Rect, RG16
+GLuint createTextureRectRG16(uint width, uint height);
+
 // 2D, RGBA16F|RGBA32F
 GLuint createTextureRGBAF(uint width, uint height, bool use_half_float);
 
 // Rect, RGBA16F|RGBA32F
 GLuint createTextureRectRGBAF(uint width, uint height, bool use_half_float);
 
+// Buffer texture, reading the given buffer object with the given format (e.g. GL_RGBA32F)
+GLuint createTextureBuffer(GLenum internal_format, GLuint id_buffer);
+
 // Renderbuffer, RGBA8
 GLuint createRenderbufferRGBA8(uint width, uint height);
 
@@ -57,9 +57,12 @@ static GLuint id_vbo_line = 0;
 // Initialize glutil
 void init()
 {
+	// The state cache starts with the default OpenGL state:
+	invalidateStateCache();
+
 	// Create the VAO used for all display functions of glutil:
 	glGenVertexArrays(1, &id_vao);
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Create the VBO used for displaying quads:
 	glGenBuffers(1, &id_vbo_quad);
@@ -151,7 +154,7 @@ void shutdown()
 	// Free the VAO:
 	if(id_vao != 0)
 	{
-		glDeleteVertexArrays(1, &id_vao);
+		glutil::deleteVertexArrays(1, &id_vao);
 		id_vao = 0;
 	}
 
@@ -371,11 +374,11 @@ void displayTexture2D(GLuint id_texture, unsigned pos_x, unsigned pos_y)
 	Disable<GL_DEPTH_TEST> depth_test_state;
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Texture :
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, id_texture);
+	glutil::activeTexture(GL_TEXTURE0);
+	glutil::bindTexture(GL_TEXTURE_2D, id_texture);
 
 	// Texture parameters:
 	TexParameter<GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE> tex_compare_mode;
@@ -447,14 +450,14 @@ void displayTextureRect(GLuint id_texture, unsigned pos_x, unsigned pos_y,
 	Disable<GL_DEPTH_TEST> depth_test_state;
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	GLfloat fw = GLfloat(tex_width);
 	GLfloat fh = GLfloat(tex_height);
 
 	// Texture:
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_RECTANGLE, id_texture);
+	glutil::activeTexture(GL_TEXTURE0);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_texture);
 
 	// Texture parameters:
 	TexParameter<GL_TEXTURE_RECTANGLE, GL_TEXTURE_COMPARE_MODE, GL_NONE> tex_compare_mode;
@@ -559,7 +562,7 @@ void drawPoint(const vec3& position,
 	Enable<GL_DEPTH_TEST> depth_test_state;
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Point size:
 	glPointSize(point_size);
@@ -602,7 +605,7 @@ void drawLine(const vec3& v1,
 			  GLfloat point_size)
 {
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Point size:
 	glPointSize(point_size);
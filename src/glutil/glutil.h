@@ -5,6 +5,7 @@
 
 #include "glxw.h"
 #include "RAII.h"
+#include "StateCache.h"
 #include "Quad.h"
 #include "GPUProgram.h"
 #include "TextureCreation.h"
@@ -28,8 +29,8 @@
 // Bind a texture to a given texunit, send the corresponding uniform to the
 // program and increment the texunit number.
 #define BIND_TEX(target, id_texture, uniform_name, program, texunit)	\
-	glActiveTexture(GL_TEXTURE0 + texunit);	\
-	glBindTexture(target, id_texture);		\
+	glutil::activeTexture(GL_TEXTURE0 + texunit);	\
+	glutil::bindTexture(target, id_texture);		\
 	program->sendUniform(uniform_name, GLint(texunit));	\
 	texunit++
 
@@ -16,6 +16,36 @@
 		}
 		return true;
 	}
+
+	// Are glMultiDrawArraysIndirect() and the "baseInstance" of the indirect commands supported?
+	inline bool glxwHasMultiDrawIndirect()
+	{
+		return gl3wIsSupported(4, 3) != 0;
+	}
+
+	// Is glBufferStorage() (persistently mapped buffers) supported?
+	inline bool glxwHasBufferStorage()
+	{
+		return gl3wIsSupported(4, 4) != 0;
+	}
+
+	// Are glDrawArraysIndirect() and glDrawElementsIndirect() supported?
+	inline bool glxwHasDrawIndirect()
+	{
+		return gl3wIsSupported(4, 0) != 0;
+	}
+
+	// Are the transform feedback objects and glDrawTransformFeedback() supported?
+	inline bool glxwHasTransformFeedback2()
+	{
+		return gl3wIsSupported(4, 0) != 0;
+	}
+
+	// Are the compute shaders supported, with the image load/store of OpenGL 4.2?
+	inline bool glxwHasComputeShader()
+	{
+		return gl3wIsSupported(4, 3) != 0;
+	}
 #else
 	#ifdef __cplusplus
 	extern "C" {
@@ -44,6 +74,36 @@
 		return true;
 	}
 
+	// Are glMultiDrawArraysIndirect() and the "baseInstance" of the indirect commands supported?
+	inline bool glxwHasMultiDrawIndirect()
+	{
+		return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+	}
+
+	// Is glBufferStorage() (persistently mapped buffers) supported?
+	inline bool glxwHasBufferStorage()
+	{
+		return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+	}
+
+	// Are glDrawArraysIndirect() and glDrawElementsIndirect() supported?
+	inline bool glxwHasDrawIndirect()
+	{
+		return GLEW_VERSION_4_0 || GLEW_ARB_draw_indirect;
+	}
+
+	// Are the transform feedback objects and glDrawTransformFeedback() supported?
+	inline bool glxwHasTransformFeedback2()
+	{
+		return GLEW_VERSION_4_0 || GLEW_ARB_transform_feedback2;
+	}
+
+	// Are the compute shaders supported, with the image load/store of OpenGL 4.2?
+	inline bool glxwHasComputeShader()
+	{
+		return GLEW_VERSION_4_3 || (GLEW_VERSION_4_2 && GLEW_ARB_compute_shader);
+	}
+
 #endif
 
 #endif // GLXW_H
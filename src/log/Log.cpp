@@ -39,6 +39,10 @@ std::map<GLFWthread, Log::ThreadInfo> Log::thread_infos;
 GLFWmutex Log::mutex;
 #endif
 
+#ifdef LOG_ENABLE_PTHREAD_LOCK
+pthread_mutex_t Log::write_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 void Log::open(Output output, const string& filename, bool desync_with_stdio)
 {
 	if(opened)
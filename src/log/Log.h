@@ -13,6 +13,8 @@
 //#define DISABLE_DEBUG_LOGGING	// If defined, disables only logDebugXXX() macros.
 //#define LOG_USE_GLEW
 //#define LOG_ENABLE_GLFW_THREADS
+#define LOG_ENABLE_PTHREAD_LOCK	// Serializes the calls to Log::write() coming from several threads
+								// (e.g. the JobPool's workers)
 
 #endif // USE_COMPILE_FLAGS
 
@@ -31,6 +33,10 @@
 #include <GL/glfw.h>
 #endif
 
+#ifdef LOG_ENABLE_PTHREAD_LOCK
+#include <pthread.h>
+#endif
+
 #ifndef ENABLE_LOGGING
 
 inline void logInfo(...) {}
@@ -166,6 +172,9 @@ private:
 #else
 	static int current_indent;
 #endif
+#ifdef LOG_ENABLE_PTHREAD_LOCK
+	static pthread_mutex_t write_mutex;
+#endif
 
 public:
 	static void open(Output output, const std::string& filename = "", bool desync_with_stdio=true);
@@ -299,6 +308,10 @@ void Log::write(	LogType type, const char* file_path, int line, const char* func
 	if(!opened)
 		open(TERMINAL);
 
+#ifdef LOG_ENABLE_PTHREAD_LOCK
+	pthread_mutex_lock(&Log::write_mutex);
+#endif
+
 #ifdef LOG_ENABLE_GLFW_THREADS
 	glfwLockMutex(Log::mutex);
 
@@ -431,6 +444,10 @@ void Log::write(	LogType type, const char* file_path, int line, const char* func
 #ifdef LOG_ENABLE_GLFW_THREADS
 	glfwUnlockMutex(Log::mutex);
 #endif
+
+#ifdef LOG_ENABLE_PTHREAD_LOCK
+	pthread_mutex_unlock(&Log::write_mutex);
+#endif
 }
 
 #endif // LOG_H
@@ -11,6 +11,7 @@
 #include "../scene/Geometry.h"
 #include "../scene/Camera.h"
 #include "../scene/profiles/GeneralProfile.h"
+#include "utils/UniformBlocks.h"
 #include "../utils/TGALoader.h"
 #include <iostream>
 using namespace std;
@@ -49,7 +50,7 @@ void DebugRenderer::cleanup()
 {
 #ifdef USE_DEBUG_TEXTURE
 	if(id_debug != 0)
-		glDeleteTextures(1, &id_debug);
+		glutil::deleteTextures(1, &id_debug);
 #endif
 }
 
@@ -63,7 +64,7 @@ void DebugRenderer::loadSceneArray(Scene* scene)
 	Object** objects = elements->getObjects();
 	uint nb_objects = elements->getNbObjects();
 
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();	// the forward shading only uses the shadowed lights
 
 	// Load the materials:
 	// - create or complete the list(s) of additional preprocessor symbols:
@@ -78,6 +79,9 @@ void DebugRenderer::loadSceneArray(Scene* scene)
 	// - add _FORWARD_SHADING_:
 	preproc_syms.push_back("_FORWARD_SHADING_");
 
+	// Decode the textures in parallel, so that the loop below only uploads them:
+	elements->decodeTextures(GENERAL_PROFILE);
+
 	// For each mesh object:
 	for(uint i=0 ; i < nb_objects ; i++)
 	{
@@ -152,14 +156,13 @@ void DebugRenderer::renderArray(Scene* scene)
 	// BEGIN DEBUG
 	int width, height;
 	glfwGetFramebufferSize(GLFWWindow::getInstance()->getWindow(), &width, &height);
-	glViewport(0, 0, width, width);
+	glutil::viewport(0, 0, width, width);
 	// END DEBUG
 
 	// Enable depth testing and cullfacing:
 	glutil::Enable<GL_DEPTH_TEST> depth_test_state;
 	glutil::Enable<GL_CULL_FACE>  cull_face_state;
 
-	const Camera* camera = scene->getCamera();
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	vec3 back_color = getBackColor();
 
@@ -175,24 +178,14 @@ void DebugRenderer::renderArray(Scene* scene)
 	Object** objects = elements->getObjects();
 	uint nb_objects = elements->getNbObjects();
 
-	Light** lights = elements->getLights();
 	uint nb_lights = elements->getNbLights();
 
-	// Compute the view and projection matrices:
-	mat4 view_matrix;
-	mat4 proj_matrix;
-
+	// Bind the viewpoint to the camera uniform block (the view and projection matrices and
+	// the lights are in uniform blocks, see UniformBlocks):
 	if(see_from_light)
 	{
 		assert(nb_lights != 0);
-		Light* l = lights[num_light_viewer];
-		view_matrix = l->computeViewMatrix();
-		proj_matrix = l->computeProjectionMatrix();
-	}
-	else
-	{
-		view_matrix = camera->computeViewMatrix();
-		proj_matrix = camera->computeProjectionMatrix();
+		UniformBlocks::bindLightView(num_light_viewer);
 	}
 
 	// For each mesh object:
@@ -211,20 +204,6 @@ void DebugRenderer::renderArray(Scene* scene)
 		if(prev_program != program)
 		{
 			program->use();
-
-			// Bind the uniforms common for all programs:
-			// - lights:
-			for(uint i=0 ; i < nb_lights ; i++)
-			{
-				char uniform_name[50];
-
-				// - position of the light:
-				sprintf(uniform_name, "light_pos_%d", i);
-				const vec3 light_pos = lights[i]->getPosition();
-				program->sendUniform(uniform_name, light_pos, Hash::AT_RUNTIME);
-			}
-
-			// Update prev_program
 			prev_program = program;
 		}
 
@@ -240,17 +219,19 @@ void DebugRenderer::renderArray(Scene* scene)
 		model_matrix[3] = vec4(mesh_obj->getPosition(), 1.0);
 
 		// - send uniform variables:
-		program->sendUniform("view_matrix",       view_matrix);
-		program->sendUniform("model_matrix",      model_matrix);
-		program->sendUniform("projection_matrix", proj_matrix);
+		program->sendUniform("model_matrix", model_matrix);
 
 		// - bind the VAO and draw
-		glBindVertexArray(geo->getVAO(VAO_INDEX_RASTER));
+		glutil::bindVertexArray(geo->getVAO(VAO_INDEX_RASTER));
 		glDrawArrays(GL_TRIANGLES, 0, geo->getNbVertices());
 	}
 
+	// Restore the camera's viewpoint:
+	if(see_from_light)
+		UniformBlocks::bindCameraView();
+
 	// BEGIN DEBUG
-	glViewport(0, 0, width, height);
+	glutil::viewport(0, 0, width, height);
 	// END DEBUG
 }
 
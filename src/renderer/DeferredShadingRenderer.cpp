@@ -6,6 +6,7 @@
 #include "utils/GBuffer.h"
 #include "utils/GBufferRenderer.h"
 #include "utils/ShadowMap.h"
+#include "utils/LightClusters.h"
 #include "../scene/Scene.h"
 #include "../scene/MeshObject.h"
 #include "../scene/Light.h"
@@ -15,6 +16,7 @@
 #include "../scene/Geometry.h"
 #include "../log/Log.h"
 #include "../utils/StdListManip.h"
+#include "../Config.h"
 #include <sstream>
 
 #ifdef USE_DEBUG_TEXTURE
@@ -32,6 +34,7 @@ DeferredShadingRenderer::DeferredShadingRenderer(uint width, uint height,
   raster_renderer(NULL),
   gbuffer(NULL),
   gbuffer_renderer(NULL),
+  light_clusters(NULL),
   use_shadow_mapping(use_shadow_mapping),
   use_visibility_maps(use_visibility_maps),
   brdf_function(brdf_function)
@@ -71,6 +74,9 @@ void DeferredShadingRenderer::setup()
 
 	gbuffer = new GBuffer(getWidth(), getHeight(), use_visibility_maps);
 
+	if(USE_CLUSTERED_LIGHTING)
+		light_clusters = new LightClusters(getWidth(), getHeight());
+
 #ifdef USE_DEBUG_TEXTURE
 	TGALoader tga;
 	if(tga.loadFile(DEBUG_TEXTURE_FILENAME) == TGA_OK)
@@ -86,12 +92,15 @@ void DeferredShadingRenderer::cleanup()
 {
 #ifdef USE_DEBUG_TEXTURE
 	if(id_debug != 0)
-		glDeleteTextures(1, &id_debug);
+		glutil::deleteTextures(1, &id_debug);
 #endif
 
 	delete gbuffer;
 	gbuffer = NULL;
 
+	delete light_clusters;
+	light_clusters = NULL;
+
 	raster_renderer->cleanup();
 }
 
@@ -102,12 +111,14 @@ void DeferredShadingRenderer::loadSceneArray(Scene* scene)
 {
 	// Get some pointers/values
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
-	uint nb_lights = elements->getNbLights();
+	uint nb_shadowed_lights = elements->getNbShadowedLights();
 
 	// ---------------------------------------
 	// Create a list of additional preprocessor symbols for rendering to the GBuffer:
 	Preprocessor::SymbolList preproc_syms;
 	preproc_syms.push_back(PreprocSym("_RENDER_TO_GBUFFER_"));
+	if(GBuffer::isCompact())
+		preproc_syms.push_back(PreprocSym("_COMPACT_GBUFFER_"));
 
 	// Load the scene:
 	raster_renderer->loadSceneArrayExt(scene, preproc_syms);
@@ -116,7 +127,9 @@ void DeferredShadingRenderer::loadSceneArray(Scene* scene)
 	// Setup the list of preprocessor symbols used with the GBufferRenderer
 	// (rendering the full-screen quad):
 	preproc_syms.clear();
-	preproc_syms.push_back(PreprocSym("_NB_LIGHTS_", nb_lights));
+	preproc_syms.push_back(PreprocSym("_NB_LIGHTS_", nb_shadowed_lights));
+	if(light_clusters != NULL)
+		LightClusters::addSymbols(&preproc_syms);
 	if(use_shadow_mapping)
 		preproc_syms.push_back(PreprocSym("_SHADOW_MAPPING_", ""));
 	if(use_visibility_maps)
@@ -145,7 +158,6 @@ void DeferredShadingRenderer::unloadSceneArray(Scene* scene)
 void DeferredShadingRenderer::renderArray(Scene* scene)
 {
 	// Get some pointers/values:
-	Camera* camera = scene->getCamera();
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
 	uint nb_lights = elements->getNbLights();
@@ -155,10 +167,13 @@ void DeferredShadingRenderer::renderArray(Scene* scene)
 	// Render the scene's data to the GBuffer:
 	gbuffer->render(scene, raster_renderer);
 
+	// Bin the lights into the clusters:
+	if(light_clusters != NULL)
+		light_clusters->update(scene);
+
 	// Draw a full screen quad while evaluating the GBuffer:
 	// - bind what is necessary:
 	gbuffer_renderer->bind(gbuffer,
-						   camera,
 						   lights,
 						   nb_lights,
 						   use_shadow_mapping && !use_visibility_maps,	// bind_shadow_maps
@@ -166,20 +181,24 @@ void DeferredShadingRenderer::renderArray(Scene* scene)
 						   &texunit);	// first_valid_texunit
 
 	// - bind our additional stuff:
+	// => Lists of lights of the clusters:
+	if(light_clusters != NULL)
+		light_clusters->bind(program, &texunit);
+
 	// => Visibility maps:
 	if(use_visibility_maps)
 	{
 		assert(use_shadow_mapping);
-		glActiveTexture(GL_TEXTURE0 + texunit);
-		glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexVisibility());
+		glutil::activeTexture(GL_TEXTURE0 + texunit);
+		glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexVisibility());
 		program->sendUniform("visibility_map", GLint(texunit));
 		texunit++;
 	}
 
 	// => Debug texture:
 #ifdef USE_DEBUG_TEXTURE
-	glActiveTexture(GL_TEXTURE0 + texunit);
-	glBindTexture(GL_TEXTURE_2D, id_debug);
+	glutil::activeTexture(GL_TEXTURE0 + texunit);
+	glutil::bindTexture(GL_TEXTURE_2D, id_debug);
 	program->sendUniform("tex_debug", GLint(texunit));
 	texunit++;
 #endif
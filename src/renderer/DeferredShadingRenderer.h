@@ -12,6 +12,7 @@
 
 class GBuffer;
 class GBufferRenderer;
+class LightClusters;
 class Light;
 class Camera;
 class ArrayElementContainer;
@@ -23,6 +24,7 @@ private:
 	RasterRenderer* raster_renderer;
 	GBuffer* gbuffer;
 	GBufferRenderer* gbuffer_renderer;
+	LightClusters* light_clusters;	// NULL if USE_CLUSTERED_LIGHTING is false
 
 	bool use_shadow_mapping;	// NB: current design only allows to set the usage of shadow mapping
 								// at creation/deletion of the renderer.
@@ -100,12 +100,12 @@ void DepthPeelingRenderer::setup()
 void DepthPeelingRenderer::cleanup()
 {
 	// Free the FBO:
-	glDeleteFramebuffers(1, &id_fbo);
+	glutil::deleteFramebuffers(1, &id_fbo);
 	id_fbo = 0;
 
 	// Free the textures:
-	glDeleteTextures(nb_layers, id_depth_layers);
-	glDeleteTextures(nb_layers, id_normal_layers);
+	glutil::deleteTextures(nb_layers, id_depth_layers);
+	glutil::deleteTextures(nb_layers, id_normal_layers);
 
 	for(uint i=0 ; i < nb_layers ; i++)
 		id_depth_layers[i] = id_normal_layers[i] = 0;
@@ -128,6 +128,9 @@ void DepthPeelingRenderer::loadSceneArrayExt(Scene* scene, bool sort_objects)
 	Object** objects = elements->getObjects();
 	uint nb_objects = elements->getNbObjects();
 
+	// Decode the textures in parallel, so that the loop below only uploads them:
+	elements->decodeTextures(DEPTH_PEELING_PROFILE);
+
 	// For each mesh object:
 	for(uint i=0 ; i < nb_objects ; i++)
 	{
@@ -246,8 +249,8 @@ void DepthPeelingRenderer::renderArrayExt(Scene* scene, GLuint id_front_depth)
 		glCullFace(GL_FRONT);	// cull the front faces, as this is the second pass
 
 		// Bind the specified front depth layer for reading:
-		glActiveTexture(GL_TEXTURE0 + DEPTH_PEELING_TEXUNIT_PREV_LAYER);
-		glBindTexture(GL_TEXTURE_RECTANGLE, id_front_depth);
+		glutil::activeTexture(GL_TEXTURE0 + DEPTH_PEELING_TEXUNIT_PREV_LAYER);
+		glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_front_depth);
 
 		// For depth peeling, we keep the fragment if and only if:
 		//             D_ref > D_t (GL_GREATER)
@@ -271,8 +274,8 @@ void DepthPeelingRenderer::renderArrayExt(Scene* scene, GLuint id_front_depth)
 		glCullFace((num_layer % 2 == 0) ? GL_FRONT : GL_BACK);
 
 		// Bind the previous layer's depth buffer for reading:
-		glActiveTexture(GL_TEXTURE0 + DEPTH_PEELING_TEXUNIT_PREV_LAYER);
-		glBindTexture(GL_TEXTURE_RECTANGLE, id_depth_layers[num_layer-1]);
+		glutil::activeTexture(GL_TEXTURE0 + DEPTH_PEELING_TEXUNIT_PREV_LAYER);
+		glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_depth_layers[num_layer-1]);
 
 		// Bind the next layer for writing:
 		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_RECTANGLE, id_normal_layers[num_layer], 0);
@@ -389,7 +392,7 @@ void DepthPeelingRenderer::singlePassArray(Object** objects,
 		program->sendUniform("projection_matrix", proj_matrix);
 
 		// - bind the VAO and draw
-		glBindVertexArray(geo->getVAO(VAO_INDEX_DEPTH_PEELING));
+		glutil::bindVertexArray(geo->getVAO(VAO_INDEX_DEPTH_PEELING));
 		glDrawArrays(GL_TRIANGLES, 0, geo->getNbVertices());
 	}
 }
@@ -1,5 +1,5 @@
 // DepthPeelingRenderer.h
-// This class is DEPRECATED.
+// This class is DEPRECATED: StencilRoutedRenderer computes the same layers from a single geometry pass.
 // TODO: when used normally (not independently), the first normal texture is unused.
 
 #ifndef DEPTH_PEELING_RENDERER_H
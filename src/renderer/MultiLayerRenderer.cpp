@@ -3,6 +3,7 @@
 #include "MultiLayerRenderer.h"
 
 #include "RasterRenderer.h"
+#include "StencilRoutedRenderer.h"
 #include "utils/GBuffer.h"
 #include "utils/GBufferRenderer.h"
 #include "utils/ShadowMap.h"
@@ -14,6 +15,7 @@
 #include "../scene/ArrayElementContainer.h"
 #include "../scene/Material.h"
 #include "../scene/Geometry.h"
+#include "../Config.h"
 #include "../log/Log.h"
 #include "../utils/StdListManip.h"
 #include <sstream>
@@ -42,6 +44,10 @@ MultiLayerRenderer::MultiLayerRenderer(	uint width, uint height,
   raster_renderer(NULL),
   raster_renderer_back_layers(NULL),
 
+  use_stencil_routing(USE_STENCIL_ROUTED_LAYERS),
+  stencil_routed_renderer(NULL),
+  id_layers_depth_targets(NULL),
+
   gbuffer_renderer(NULL),
   gbuffer_renderer_back_layers(NULL),
 
@@ -62,17 +68,25 @@ MultiLayerRenderer::MultiLayerRenderer(	uint width, uint height,
 			VAO_INDEX_RASTER_SHADOW,
 			GENERAL_PROFILE);
 
-	raster_renderer_back_layers = new RasterRenderer(
-			width,
-			height,
-			vec3(0.0),				// back color: ignored
-			false,					// shadow mapping is managed directly by this renderer, not by the
-									// RasterRenderer.
-			false,					// use_visibility_maps: not supported
-			"",						// brdf_function: none (BRDF evaluation is not done here)
-			VAO_INDEX_RASTER,
-			VAO_INDEX_RASTER_SHADOW,
-			GENERAL_PROFILE_DEPTH_PEELING);
+	if(use_stencil_routing)
+	{
+		// One layer for the front GBuffer and one per back GBuffer:
+		stencil_routed_renderer = new StencilRoutedRenderer(width, height, back_color, nb_back_gbuffers+1);
+	}
+	else
+	{
+		raster_renderer_back_layers = new RasterRenderer(
+				width,
+				height,
+				vec3(0.0),				// back color: ignored
+				false,					// shadow mapping is managed directly by this renderer, not by the
+										// RasterRenderer.
+				false,					// use_visibility_maps: not supported
+				"",						// brdf_function: none (BRDF evaluation is not done here)
+				VAO_INDEX_RASTER,
+				VAO_INDEX_RASTER_SHADOW,
+				GENERAL_PROFILE_DEPTH_PEELING);
+	}
 
 	// - second part (rendering to the screen):
 	gbuffer_renderer = new GBufferRenderer(width, height);
@@ -84,6 +98,7 @@ MultiLayerRenderer::~MultiLayerRenderer()
 {
 	delete gbuffer_renderer_back_layers;
 	delete gbuffer_renderer;
+	delete stencil_routed_renderer;
 	delete raster_renderer_back_layers;
 	delete raster_renderer;
 }
@@ -97,7 +112,10 @@ void MultiLayerRenderer::setup()
 
 	// Setup the renderers:
 	raster_renderer->setup();
-	raster_renderer_back_layers->setup();
+	if(use_stencil_routing)
+		stencil_routed_renderer->setup();
+	else
+		raster_renderer_back_layers->setup();
 
 	// Create the front GBuffer:
 	front_gbuffer = new GBuffer(width,
@@ -110,6 +128,16 @@ void MultiLayerRenderer::setup()
 	for(uint i=0 ; i < nb_back_gbuffers ; i++)
 		back_gbuffers[i] = new GBuffer(width, height, false);
 
+	// The layers of the A-buffer are extracted to the depth textures of the back GBuffers:
+	if(use_stencil_routing)
+	{
+		id_layers_depth_targets = new GLuint[nb_back_gbuffers+1];
+		id_layers_depth_targets[0] = 0;	// the front GBuffer is rendered normally
+
+		for(uint i=0 ; i < nb_back_gbuffers ; i++)
+			id_layers_depth_targets[i+1] = back_gbuffers[i]->getTexDepth();
+	}
+
 	// Create the FBO:
 	createFBO();
 }
@@ -119,6 +147,9 @@ void MultiLayerRenderer::cleanup()
 {
 	deleteFBO();
 
+	delete [] id_layers_depth_targets;
+	id_layers_depth_targets = NULL;
+
 	for(uint i=0 ; i < nb_back_gbuffers ; i++)
 		delete back_gbuffers[i];
 
@@ -128,7 +159,10 @@ void MultiLayerRenderer::cleanup()
 	delete front_gbuffer;
 	front_gbuffer = NULL;
 
-	raster_renderer_back_layers->cleanup();
+	if(use_stencil_routing)
+		stencil_routed_renderer->cleanup();
+	else
+		raster_renderer_back_layers->cleanup();
 	raster_renderer->cleanup();
 }
 
@@ -138,7 +172,7 @@ void MultiLayerRenderer::cleanup()
 void MultiLayerRenderer::loadSceneArray(Scene* scene)
 {
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();	// the shaders only use the shadowed lights
 	Preprocessor::SymbolList preproc_syms;
 
 	// ---------------------------------------
@@ -147,12 +181,15 @@ void MultiLayerRenderer::loadSceneArray(Scene* scene)
 	// Common preprocessor symbols:
 	preproc_syms.clear();
 	preproc_syms.push_back(PreprocSym("_RENDER_TO_GBUFFER_"));
+	if(GBuffer::isCompact())
+		preproc_syms.push_back(PreprocSym("_COMPACT_GBUFFER_"));
 
 	// => front layer:
 	raster_renderer->loadSceneArrayExt(scene, preproc_syms);
 
-	// => back layer:
-	raster_renderer_back_layers->loadSceneArrayExt(scene, preproc_syms);
+	// => back layer (with the A-buffer, raster_renderer also renders the back layers):
+	if(!use_stencil_routing)
+		raster_renderer_back_layers->loadSceneArrayExt(scene, preproc_syms);
 
 	// ---------------------------------------
 	// - second part of the rendering (full-screen quads):
@@ -188,7 +225,8 @@ void MultiLayerRenderer::unloadSceneArray(Scene* scene)
 	gbuffer_renderer_back_layers->unload();
 	gbuffer_renderer->unload();
 
-	raster_renderer_back_layers->unloadSceneArray(scene);
+	if(!use_stencil_routing)
+		raster_renderer_back_layers->unloadSceneArray(scene);
 	raster_renderer->unloadSceneArray(scene);
 }
 
@@ -197,7 +235,6 @@ void MultiLayerRenderer::unloadSceneArray(Scene* scene)
 void MultiLayerRenderer::renderArray(Scene* scene)
 {
 	// Get some pointers/values:
-	Camera* camera = scene->getCamera();
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
 	uint nb_lights = elements->getNbLights();
@@ -215,7 +252,24 @@ void MultiLayerRenderer::renderArray(Scene* scene)
     GL_CHECK();
 
 	// --------- First part: render the scene's data to the GBuffers -----------
+	// With the A-buffer: the depth of the back layers is computed from a single geometry pass,
+	// and each back GBuffer only shades the fragments of its layer (GL_EQUAL depth test).
+	if(use_stencil_routing)
+	{
+		// - front GBuffer:
+		glCullFace(GL_BACK);
+		front_gbuffer->render(scene, raster_renderer);
+
+		// - depth of the back GBuffers:
+		stencil_routed_renderer->renderLayers(scene, raster_renderer, id_layers_depth_targets);
+
+		// - back GBuffers:
+		for(uint i=0 ; i < nb_back_gbuffers ; i++)
+			back_gbuffers[i]->render(scene, raster_renderer, NULL, 0, true);
+	}
+	// Otherwise, depth peeling.
 	// NB: we alternate between backface culling and front face culling
+	else
 	{
 		// - front GBuffer:
 		glCullFace(GL_BACK);
@@ -241,6 +295,11 @@ void MultiLayerRenderer::renderArray(Scene* scene)
 			// Render the scene to the current GBuffer:
 			back_gbuffers[i]->render(scene, raster_renderer_back_layers, &prev_depth_layer_tex_binding, 1);
 
+			// The texture parameters stay set: disable the comparison again, as the depth
+			// texture is also read for reconstructing the positions (compact G-buffer layout)
+			glutil::bindTexture(GL_TEXTURE_RECTANGLE, prev_gbuffer->getTexDepth());
+			glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
 			// Update the pointer to the previous GBuffer:
 			prev_gbuffer = back_gbuffers[i];
 		}
@@ -255,7 +314,6 @@ void MultiLayerRenderer::renderArray(Scene* scene)
 		// Draw a full-screen quad while evaluating the front GBuffer:
 		// - bind what is necessary:
 		gbuffer_renderer->bind(front_gbuffer,
-							   camera,
 							   lights,
 							   nb_lights,
 							   use_shadow_mapping,	// bind_shadow_maps
@@ -270,7 +328,7 @@ void MultiLayerRenderer::renderArray(Scene* scene)
 
 		// Draw the back GBuffers:
 		// - setup blending:
-		glEnable(GL_BLEND);
+		glutil::enable(GL_BLEND);
 		//glBlendFunc(GL_ONE_MINUS_DST_ALPHA, GL_DST_ALPHA);
 		glBlendFunc(GL_DST_ALPHA, GL_ONE_MINUS_DST_ALPHA);
 
@@ -280,7 +338,6 @@ void MultiLayerRenderer::renderArray(Scene* scene)
 
 			// - bind what is necessary:
 			gbuffer_renderer_back_layers->bind(gbuffer,
-											   camera,
 											   lights,
 											   nb_lights,
 											   use_shadow_mapping,
@@ -288,22 +345,22 @@ void MultiLayerRenderer::renderArray(Scene* scene)
 											   &texunit);
 
 			// - bind our additional stuff:
-			glActiveTexture(GL_TEXTURE0 + texunit);
-			glBindTexture(GL_TEXTURE_RECTANGLE, id_pixels_done);
+			glutil::activeTexture(GL_TEXTURE0 + texunit);
+			glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_pixels_done);
 			gbuffer_renderer_back_layers->getProgram()->sendUniform("tex_pixels_done", GLint(texunit));
 
 			// - draw the quad:
 			gbuffer_renderer->render();
 		}
 
-		glDisable(GL_BLEND);
+		glutil::disable(GL_BLEND);
 	}
     
     GL_CHECK();
 
 	// ----- Finally: blitting ------
 	// - blit the FBO's color buffer to the screen's color buffer:
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, id_fbo);
+	glutil::bindFramebuffer(GL_READ_FRAMEBUFFER, id_fbo);
     GL_CHECK();
 	glBlitFramebuffer(0, 0, w, h,
 					  0, 0, w, h,
@@ -311,14 +368,14 @@ void MultiLayerRenderer::renderArray(Scene* scene)
     GL_CHECK();
 
 	// - blit the front GBuffer's depth buffer to the screen's depth buffer:
-	/*glBindFramebuffer(GL_READ_FRAMEBUFFER, front_gbuffer->getFBO());
+	/*glutil::bindFramebuffer(GL_READ_FRAMEBUFFER, front_gbuffer->getFBO());
     GL_CHECK();
 	glBlitFramebuffer(0, 0, w, h,
 					  0, 0, w, h,
 					  GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
     GL_CHECK();*/
 
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glutil::bindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
     GL_CHECK();
 }
@@ -437,7 +494,7 @@ void MultiLayerRenderer::createFBO()
 void MultiLayerRenderer::deleteFBO()
 {
 	assert(id_fbo != 0);
-	glDeleteFramebuffers(1, &id_fbo);
+	glutil::deleteFramebuffers(1, &id_fbo);
 	id_fbo = 0;
 
 	assert(id_rb_depth != 0);
@@ -445,10 +502,10 @@ void MultiLayerRenderer::deleteFBO()
 	id_rb_depth = 0;
 
 	assert(id_pixels_done != 0);
-	glDeleteTextures(1, &id_pixels_done);
+	glutil::deleteTextures(1, &id_pixels_done);
 	id_pixels_done = 0;
 
 	assert(id_color != 0);
-	glDeleteTextures(1, &id_color);
+	glutil::deleteTextures(1, &id_color);
 	id_color = 0;
 }
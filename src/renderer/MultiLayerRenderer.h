@@ -16,6 +16,7 @@ class Light;
 class Camera;
 class ArrayElementContainer;
 class RasterRenderer;
+class StencilRoutedRenderer;
 
 class MultiLayerRenderer : public Renderer
 {
@@ -49,6 +50,12 @@ private:
 	RasterRenderer* raster_renderer_back_layers;	// Associated with GENERAL_PROFILE_DEPTH_PEELING:
 													// used to render the next layers.
 
+	// - or with USE_STENCIL_ROUTED_LAYERS, the depth of all the layers comes from an A-buffer,
+	//   and the back GBuffers are rendered by raster_renderer with the GL_EQUAL depth test:
+	bool use_stencil_routing;
+	StencilRoutedRenderer* stencil_routed_renderer;
+	GLuint* id_layers_depth_targets;	// depth textures of the GBuffers (0 for the front one)
+
 	// - second part (rendering to the screen):
 	GBufferRenderer* gbuffer_renderer;	// Used for rendering the front GBuffer.
 										// _MARK_PIXELS_DONE_ is defined.
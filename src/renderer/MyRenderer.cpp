@@ -123,7 +123,7 @@ void MyRenderer::loadSceneArray(Scene* scene)
 	// Get some pointers/values:
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();	// the lights without shadow map get no photons
 
 	// Load the scene for the multi-layer renderer:
 	multi_layer_renderer->loadSceneArray(scene);
@@ -150,7 +150,7 @@ void MyRenderer::unloadSceneArray(Scene* scene)
 	// Get some pointers/values:
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();
 
 	// Remove the GBuffers and the bounce maps of the lights:
 	for(uint i=0 ; i < nb_lights ; i++)
@@ -174,7 +174,7 @@ void MyRenderer::renderArray(Scene* scene)
 	Camera* camera = scene->getCamera();
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();
 	GBuffer** back_gbuffers = multi_layer_renderer->getBackGBuffers();
 	uint nb_back_gbuffers = multi_layer_renderer->getNbBackGBuffers();
 
@@ -252,7 +252,7 @@ void MyRenderer::debugDraw2D(Scene* scene)
 	// Get some pointers/values:
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();
 
 	// Intersection map:
 	{
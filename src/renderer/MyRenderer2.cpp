@@ -10,8 +10,11 @@
 #include "utils/GBuffer.h"
 #include "utils/GLRaytracer.h"
 //#include "utils/PhotonsAdvancer.h"
-//#include "utils/PhotonVolumesRenderer.h"
+#include "utils/PhotonVolumesRenderer.h"
+#include "utils/PhotonBounces.h"
+#include "utils/HistoPyramid.h"
 #include "utils/MinMaxMipmaps.h"
+#include "utils/TextureReducer.h"
 #include "../scene/Camera.h"
 #include "../scene/Scene.h"
 #include "../scene/Light.h"
@@ -19,8 +22,9 @@
 #include "../log/Log.h"
 using namespace std;
 
-#define DEBUG_DONT_DRAW_PHOTON_VOLUMES
-#define NB_ITERATIONS_INDIRECT 1
+//#define DEBUG_DONT_DRAW_PHOTON_VOLUMES
+//#define DEBUG_PRINT_INDIRECT_STATS	// print statistics of the indirect illumination
+#define NB_BOUNCES_INDIRECT 3	// number of bounces of the photons (the first one is the photons map)
 
 // ---------------------------------------------------------------------
 MyRenderer2::MyRenderer2(uint width, uint height,
@@ -33,8 +37,11 @@ MyRenderer2::MyRenderer2(uint width, uint height,
   raster_renderer_no_shadows(NULL),
   direct_renderer(NULL),
   //photons_advancer(NULL),
-  //photon_volumes_renderer(NULL),	// TODO
+  photon_volumes_renderer(NULL),
+  photon_bounces(NULL),
+  photon_hits(NULL),
   min_max_mipmaps(NULL),
+  indirect_stats(NULL),
   use_shadow_mapping(use_shadow_mapping),
   use_visibility_maps(use_visibility_maps),
   brdf_function(brdf_function)
@@ -61,25 +68,39 @@ MyRenderer2::MyRenderer2(uint width, uint height,
 	//photons_advancer = new PhotonsAdvancer(width, height, 1);
 
 	// Photon volumes renderer:
-	// TODO
-/*	photon_volumes_renderer = new PhotonVolumesRenderer(width,
+	photon_volumes_renderer = new PhotonVolumesRenderer(width,
 														height,
-														gl_raytracer->getTargetWidth(),
-														gl_raytracer->getTargetHeight(),
 														kernel_filename,
 														brdf_function);
-*/
+	// Photon bounces
+	photon_bounces = new PhotonBounces();
+
+	// Hits of the photons maps
+	photon_hits = new HistoPyramid();
+
 	// Min-max mipmaps
 	min_max_mipmaps = new MinMaxMipmaps(width, height);
+
+	// Statistics of the indirect illumination
+	indirect_stats = new TextureReducer();
 }
 
 MyRenderer2::~MyRenderer2()
 {
+	// Statistics of the indirect illumination
+	delete indirect_stats;
+
 	// Min-max mipmaps
 	delete min_max_mipmaps;
 	
+	// Hits of the photons maps
+	delete photon_hits;
+
+	// Photon bounces
+	delete photon_bounces;
+
 	// Photon volume renderer:
-	//delete photon_volumes_renderer;	// TODO
+	delete photon_volumes_renderer;
 	
 	// Photons advancer:
 	//delete photons_advancer;
@@ -106,20 +127,38 @@ void MyRenderer2::setup()
 	//gl_raytracer->setup();
 
 	// Setup the photon volumes renderer:
-	//photon_volumes_renderer->setup();	// TODO
+	photon_volumes_renderer->setup();
 	
+	// Photon bounces
+	photon_bounces->setup();
+
+	// Hits of the photons maps
+	photon_hits->setup();
+
 	// Min-max mipmaps
 	min_max_mipmaps->setup();
+
+	// Statistics of the indirect illumination
+	indirect_stats->setup();
 }
 
 // Called when we switch to another renderer or close the program
 void MyRenderer2::cleanup()
 {
+	// Statistics of the indirect illumination
+	indirect_stats->cleanup();
+
 	// Min-max mipmaps
 	min_max_mipmaps->cleanup();
 	
+	// Hits of the photons maps
+	photon_hits->cleanup();
+
+	// Photon bounces
+	photon_bounces->cleanup();
+
 	// Photon volume renderer:
-	//photon_volumes_renderer->cleanup();	// TODO
+	photon_volumes_renderer->cleanup();
 
 	// Photons advancer:
 	//photons_advancer->cleanup();
@@ -139,7 +178,7 @@ void MyRenderer2::loadSceneArray(Scene* scene)
 	// Get some pointers/values:
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();	// the lights without shadow map get no photons
 
 	// Load the scene for the direct lighting renderer:
 	direct_renderer->loadSceneArray(scene);
@@ -168,7 +207,7 @@ void MyRenderer2::unloadSceneArray(Scene* scene)
 	// Get some pointers/values:
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();
 
 	// Remove the user data from the lights
 	for(uint i=0 ; i < nb_lights ; i++)
@@ -193,7 +232,7 @@ void MyRenderer2::renderArray(Scene* scene)
 	Camera* camera = scene->getCamera();
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();
 	
 	// BEGIN DEBUG
 	//lights[0]->setPosition(vec3(-0.26, 0.0, 0.62));
@@ -203,7 +242,8 @@ void MyRenderer2::renderArray(Scene* scene)
 	direct_renderer->renderArray(scene);
 	
 	// Depth min-max mipmapping
-	min_max_mipmaps->run(direct_renderer->getGBuffer()->getTexPositions());
+	min_max_mipmaps->run(direct_renderer->getGBuffer()->getTexDepth(),
+	                     direct_renderer->getGBuffer()->getInvProjMatrix());
 
 	// Compute the eye's projection and view matrix:
 	mat4 eye_view = camera->computeViewMatrix();
@@ -211,11 +251,17 @@ void MyRenderer2::renderArray(Scene* scene)
 
 	GL_CHECK();
 	
+#ifndef DEBUG_DONT_DRAW_PHOTON_VOLUMES
+	photon_volumes_renderer->clearAccumulation();
+	photon_bounces->beginFrame();
+#endif
+
 	// For each light:
 	// - render to its GBuffer
 	// - compute its bounce map
 	// - advance the photons
-	// - render the photon volumes (indirect illumination):
+	// - splat the photon volumes (indirect illumination)
+	// - propagate the photons over the next bounces, and splat them:
 	for(uint i=0 ; i < nb_lights ; i++)
 	{
 		Light* l = lights[i];
@@ -232,10 +278,17 @@ void MyRenderer2::renderArray(Scene* scene)
 
 		photons_map->run(bounce_map,
 		                 light_gbuffer,
-		                 direct_renderer->getGBuffer(),
+		                 min_max_mipmaps,
 		                 eye_proj,
-		                 eye_view,
-		                 NB_ITERATIONS_INDIRECT);
+		                 eye_view);
+		GL_CHECK();
+
+		// Pack the photons which hit something (alpha of the second output of the photons map):
+		{
+			uint size = photons_map->getSize();
+			photon_hits->build(photons_map->getTexOutput1(), size, size, vec4(0.0f, 0.0f, 0.0f, 1.0f), 0.5f);
+			photon_hits->compact();
+		}
 		GL_CHECK();
 
 		// TODO
@@ -245,17 +298,77 @@ void MyRenderer2::renderArray(Scene* scene)
 //			GBuffer* gbuffer = direct_renderer->getGBuffer();
 //			gl_raytracer->run(l, &gbuffer, eye_proj, eye_view, camera->getZNear(), camera->getZFar());
 
-		// TODO
-/*
 #ifndef DEBUG_DONT_DRAW_PHOTON_VOLUMES
-		photon_volumes_renderer->run(eye_view,
-									 eye_proj,
-									 gl_raytracer,
-									 direct_renderer->getGBuffer(),
-									 bounce_map->getSize());
+		photon_volumes_renderer->splatPhotonsMap(eye_proj,
+												 photons_map,
+												 bounce_map,
+												 photon_hits,
+												 direct_renderer->getGBuffer());
+		GL_CHECK();
+
+		// Next bounces (Russian roulette: only the surviving photons are processed):
+		if(NB_BOUNCES_INDIRECT > 1)
+		{
+			photon_bounces->scatterPhotonsMap(photons_map,
+											  bounce_map,
+											  photon_hits,
+											  direct_renderer->getGBuffer(),
+											  eye_proj,
+											  1);
+
+			// NB: the number of photons is not known on the CPU (see PhotonBounces.h),
+			// so that all the bounces are run
+			for(uint num_bounce=2 ; num_bounce <= NB_BOUNCES_INDIRECT ; num_bounce++)
+			{
+				photon_bounces->trace(min_max_mipmaps, eye_proj);
+
+				photon_volumes_renderer->splatPhotonBuffer(eye_proj,
+														   photon_bounces->getTexHits(),
+														   photon_bounces->getNbHits(),
+														   photon_bounces->getHitsStamp(),
+														   direct_renderer->getGBuffer());
+
+				if(num_bounce < NB_BOUNCES_INDIRECT)
+					photon_bounces->scatterHits(direct_renderer->getGBuffer(), eye_proj, num_bounce);
+			}
+			GL_CHECK();
+		}
 #endif
-*/
 	}
+
+	// Add the indirect illumination of all the lights to the direct illumination:
+#ifndef DEBUG_DONT_DRAW_PHOTON_VOLUMES
+	#ifdef DEBUG_PRINT_INDIRECT_STATS
+		printIndirectStats();
+	#endif
+
+	photon_volumes_renderer->upsampleAccumulation(min_max_mipmaps);
+	GL_CHECK();
+#endif
+}
+
+void MyRenderer2::printIndirectStats()
+{
+	// Print the statistics of a previous frame when they are available (no stall):
+	vec4 results[2];
+	if(indirect_stats->isReadbackPending() && indirect_stats->finishReadback(results))
+	{
+		logInfo("indirect illumination: average (", results[0].r, ", ", results[0].g, ", ", results[0].b, ")");
+		logInfo("indirect illumination: max (",     results[1].r, ", ", results[1].g, ", ", results[1].b, ")");
+	}
+
+	// Reduce the accumulation buffer of this frame:
+	if(!indirect_stats->isReadbackPending())
+	{
+		static const ReduceOp ops[] = {REDUCE_AVERAGE, REDUCE_MAX};
+
+		indirect_stats->reduce(photon_volumes_renderer->getAccumulationTex(),
+							   photon_volumes_renderer->getAccumulationWidth(),
+							   photon_volumes_renderer->getAccumulationHeight(),
+							   ops, 2);
+		indirect_stats->startReadback();
+	}
+	GL_CHECK();
 }
 
 // ---------------------------------------------------------------------
@@ -277,7 +390,7 @@ void MyRenderer2::debugDraw2D(Scene* scene)
 	// Get some pointers/values:
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();
 
 	// Lights GBuffers:
 	for(uint i=0 ; i < nb_lights ; i++)
@@ -312,22 +425,12 @@ void MyRenderer2::debugDraw2D(Scene* scene)
 		glutil::displayTextureRect(photons_map->getTexOutput1(), x, y, size, size); NEXT_POS();
 	}
 	
-	// Min-max textures:
-	{
-		uint w = getWidth() >> 1;
-		uint h = getHeight() >> 1;
-		uint x_start = x;
-		for(uint i=0 ; i < min_max_mipmaps->getNbLayers() ; i++)
-		{
-			glutil::displayTextureRect(min_max_mipmaps->getMinMaxTex(i), x, y, w, h); //NEXT_POS();
-			x = x_start + (i%2);
-			if(i%2 == 0)
-				y++;
-			
-			w >>= 1;
-			h >>= 1;
-		}
-	}
+	// Min-max pyramid:
+	glutil::displayTexture2D(min_max_mipmaps->getMinMaxTex(), x, y); NEXT_POS();
+
+	// Accumulation buffer of the photon volumes:
+	glutil::displayTextureRect(photon_volumes_renderer->getAccumulationTex(), x, y,
+							   glm::max(getWidth() / 2, 1U), glm::max(getHeight() / 2, 1U));
 
 #undef NEXT_POS
 }
@@ -342,7 +445,7 @@ void MyRenderer2::debugDraw3D(Scene* scene)
 	// Get some pointers/values:
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();
 	const mat4& proj_matrix = scene->getCamera()->computeProjectionMatrix();
 	const mat4& view_matrix = scene->getCamera()->computeViewMatrix();
 
@@ -13,7 +13,10 @@ class ArrayElementContainer;
 class RasterRenderer;
 class DeferredShadingRenderer;
 //class PhotonsAdvancer;
-//class PhotonVolumesRenderer;
+class PhotonVolumesRenderer;
+class PhotonBounces;
+class HistoPyramid;
+class TextureReducer;
 class MinMaxMipmaps;
 
 class MyRenderer2 : public Renderer
@@ -22,8 +25,11 @@ private:
 	RasterRenderer*				raster_renderer_no_shadows;	// used for rendering the light GBuffers
 	DeferredShadingRenderer*	direct_renderer;	// direct lighting
 	//PhotonsAdvancer*			photons_advancer;
-	//PhotonVolumesRenderer*		photon_volumes_renderer;	// TODO
+	PhotonVolumesRenderer*		photon_volumes_renderer;	// indirect lighting
+	PhotonBounces*				photon_bounces;	// bounces of the photons after the photons maps
+	HistoPyramid*				photon_hits;	// compaction of the hits of the photons maps
 	MinMaxMipmaps*				min_max_mipmaps;
+	TextureReducer*				indirect_stats;	// statistics of the indirect illumination (debug)
 
 	bool		use_shadow_mapping;	// NB: current design only allows to set the usage of shadow mapping
 									// at creation/deletion of the renderer.
@@ -61,6 +67,10 @@ public:
 
 	// Implementation of KeyEventReceiver:
 	virtual void onKeyEvent(int key, int action);
+
+private:
+	// Print the average and maximum indirect illumination, read back asynchronously
+	void printIndirectStats();
 };
 
 #endif // MY_RENDERER2_H
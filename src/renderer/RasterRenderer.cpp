@@ -5,6 +5,7 @@
 #include "../glutil/glutil.h"
 #include "../scene/ArrayElementContainer.h"
 #include "../scene/Camera.h"
+#include "../scene/Frustum.h"
 #include "../scene/GPUProgramManager.h"
 #include "../scene/Light.h"
 #include "../scene/Material.h"
@@ -12,13 +13,15 @@
 #include "../scene/Geometry.h"
 #include "../scene/Scene.h"
 #include "../scene/profiles/GeneralProfile.h"
+#include "../Config.h"
 #include "../log/Log.h"
 #include "../utils/StdListManip.h"
+#include "utils/RenderQueue.h"
 #include "utils/ShadowMap.h"
 #include "utils/TexunitManager.h"
 #include "utils/TextureBinding.h"
+#include "utils/UniformBlocks.h"
 #include <cassert>
-#include <sstream>
 #include <cstring>
 
 #ifdef USE_DEBUG_TEXTURE
@@ -26,6 +29,8 @@
 #endif
 using namespace std;
 
+bool RasterRenderer::depth_prepass_enabled = USE_DEPTH_PREPASS;
+
 RasterRenderer::RasterRenderer(uint width, uint height,
 							   const vec3& back_color,
 							   bool use_shadow_mapping,
@@ -43,7 +48,16 @@ RasterRenderer::RasterRenderer(uint width, uint height,
   brdf_function(brdf_function),
   vao_index(vao_index),
   vao_index_shadow(vao_index_shadow),
-  profile_index(profile_index)
+  profile_index(profile_index),
+  id_instances_vbo(0),
+  instance_matrices(NULL),
+  nb_instance_matrices(0),
+  draw_batches(NULL),
+  draw_commands(NULL),
+  use_multi_draw_indirect(false),
+  id_indirect_buffer(0),
+  supports_depth_prepass(profile_index != GENERAL_PROFILE_DEPTH_PEELING),
+  depth_prepass_program()
 {
 }
 
@@ -69,7 +83,7 @@ void RasterRenderer::cleanup()
 {
 #ifdef USE_DEBUG_TEXTURE
 	if(id_debug != 0)
-		glDeleteTextures(1, &id_debug);
+		glutil::deleteTextures(1, &id_debug);
 #endif
 }
 
@@ -93,7 +107,7 @@ void RasterRenderer::loadSceneArrayExt(Scene* scene, const Preprocessor::SymbolL
 	Object** objects = elements->getObjects();
 	uint nb_objects = elements->getNbObjects();
 
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();	// the shaders only use the shadowed lights
 
 	// Load the materials:
 	// - create and complete the list(s) of additional preprocessor symbols:
@@ -120,6 +134,35 @@ void RasterRenderer::loadSceneArrayExt(Scene* scene, const Preprocessor::SymbolL
 	preproc_syms.push_back(PreprocSym("_DEBUG_TEXTURE_", ""));
 #endif
 
+	// - add _INSTANCING_, as the model matrices are per-instance attributes:
+	preproc_syms.push_back(PreprocSym("_INSTANCING_", ""));
+
+	// Create the per-instance VBO, with one model matrix per object:
+	nb_instance_matrices = nb_objects;
+	instance_matrices = new mat4[nb_instance_matrices];
+	draw_batches = new DrawBatch[nb_instance_matrices];
+	draw_commands = new DrawCommand[nb_instance_matrices];
+	render_queue.reserve(nb_objects);
+
+	glGenBuffers(1, &id_instances_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, id_instances_vbo);
+	glBufferData(GL_ARRAY_BUFFER, nb_instance_matrices * sizeof(mat4), NULL, GL_STREAM_DRAW);
+
+	// With multi-draw indirect, the commands are also streamed to a buffer:
+	use_multi_draw_indirect = (USE_MULTI_DRAW_INDIRECT && glxwHasMultiDrawIndirect());
+	if(use_multi_draw_indirect)
+	{
+		logInfo("using multi-draw indirect");
+
+		glGenBuffers(1, &id_indirect_buffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, id_indirect_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, nb_instance_matrices * sizeof(DrawCommand), NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	// Decode the textures in parallel, so that the loop below only uploads them:
+	elements->decodeTextures(profile_index);
+
 	// For each mesh object:
 	for(uint i=0 ; i < nb_objects ; i++)
 	{
@@ -149,9 +192,46 @@ void RasterRenderer::loadSceneArrayExt(Scene* scene, const Preprocessor::SymbolL
 		if(profile->hasTextureMapping() || profile->hasNormalMapping())
 			texcoords_attrib = GENERAL_PROFILE_ATTRIB_TEXCOORDS;
 
+		// With multi-draw indirect, the geometry is packed with the others (see below)
+		if(use_multi_draw_indirect)
+		{
+			mesh_pool.addGeometry(geo, vertex_attrib, normal_attrib, texcoords_attrib);
+			continue;
+		}
+
 		geo->buildVAO(vao_index, vertex_attrib, normal_attrib, texcoords_attrib);
+
+		// Add the per-instance model matrix to the VAO (which is still bound):
+		addInstancesAttrib();
+	}
+
+	// Pack the geometries and add the per-instance model matrix to the shared VAOs:
+	if(use_multi_draw_indirect)
+	{
+		mesh_pool.build(vao_index);
+
+		uint nb_pool_vaos = mesh_pool.getNbVAOs();
+		GLuint* pool_vaos = new GLuint[nb_pool_vaos];
+		mesh_pool.getVAOs(pool_vaos);
+
+		for(uint i=0 ; i < nb_pool_vaos ; i++)
+		{
+			if(pool_vaos[i] == 0)
+				continue;
+
+			glutil::bindVertexArray(pool_vaos[i]);
+			addInstancesAttrib();
+		}
+
+		delete [] pool_vaos;
 	}
 
+	glutil::bindVertexArray(0);
+
+	// Load the program of the depth pre-pass, which uses the same VAOs:
+	if(supports_depth_prepass)
+		setupDepthPrepassProgram();
+
 	// Build the VBOs, VAOs, etc used for shadow mapping
 	if(use_shadow_mapping)
 		ShadowMap::loadSceneArray(elements, vao_index_shadow);
@@ -188,10 +268,33 @@ void RasterRenderer::unloadSceneArray(Scene* scene)
 		profile->unloadTextures();
 		profile->unloadProgram();
 
-		// Delete the VAO:
+		// Delete the VAO (or forget it, if it is shared):
 		geo->deleteVAO(vao_index);
 	}
 
+	// Delete the packed geometries:
+	mesh_pool.clear();
+
+	// Release the program of the depth pre-pass:
+	depth_prepass_program = NULL;
+
+	// Delete the per-instance VBO and the indirect commands buffer:
+	if(id_instances_vbo != 0)
+		glDeleteBuffers(1, &id_instances_vbo);
+	id_instances_vbo = 0;
+
+	if(id_indirect_buffer != 0)
+		glDeleteBuffers(1, &id_indirect_buffer);
+	id_indirect_buffer = 0;
+
+	delete [] instance_matrices;
+	delete [] draw_batches;
+	delete [] draw_commands;
+	instance_matrices = NULL;
+	draw_batches = NULL;
+	draw_commands = NULL;
+	nb_instance_matrices = 0;
+
 	// In case we used shadow mapping, also delete the special VBOs and VAOs we used for it, and other stuff
 	if(use_shadow_mapping)
 		ShadowMap::unloadSceneArray(elements, vao_index_shadow);
@@ -208,10 +311,9 @@ void RasterRenderer::renderArrayExt(Scene* scene,
 									const vec3& back_color,
 									const Light* light_viewpoint,
 									TextureBinding* added_tex_bindings,
-									uint nb_added_tex_bindings)
+									uint nb_added_tex_bindings,
+									bool use_depth_layer)
 {
-	stringstream ss;
-
 	// Enable depth testing and cullfacing:
 	glutil::Enable<GL_DEPTH_TEST> depth_test_state;
 	glutil::Enable<GL_CULL_FACE>  cull_face_state;
@@ -219,9 +321,15 @@ void RasterRenderer::renderArrayExt(Scene* scene,
 	const Camera* camera = scene->getCamera();
 	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
 
-	// Clear the screen
+	// Clear the screen (but not the depth layer, whose fragments are all shaded, front and back faces)
 	glClearColor(back_color.r, back_color.g, back_color.b, 0.0);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if(use_depth_layer)
+	{
+		glClear(GL_COLOR_BUFFER_BIT);
+		glutil::disable(GL_CULL_FACE);
+	}
+	else
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	glutil::GPUProgram* prev_program = NULL;	// Used for tracking if the currently
 												// bound program changes
@@ -233,7 +341,6 @@ void RasterRenderer::renderArrayExt(Scene* scene,
 	// ------------------ Render the scene -----------------
 	// Get some pointers and values
 	Object** objects = elements->getObjects();
-	uint nb_objects = elements->getNbObjects();
 
 	Light** lights = elements->getLights();
 	uint nb_lights = elements->getNbLights();
@@ -246,6 +353,14 @@ void RasterRenderer::renderArrayExt(Scene* scene,
 	{
 		view_matrix = light_viewpoint->computeViewMatrix();
 		proj_matrix = light_viewpoint->computeProjectionMatrix();
+
+		// Bind the light's viewpoint to the camera uniform block:
+		uint light_index = 0;
+		while(light_index < nb_lights && lights[light_index] != light_viewpoint)
+			light_index++;
+		assert(light_index < nb_lights);
+
+		UniformBlocks::bindLightView(light_index);
 	}
 	else
 	{
@@ -261,44 +376,64 @@ void RasterRenderer::renderArrayExt(Scene* scene,
 
 	glutil::SetViewport viewport(0, 0, viewport_width, viewport_height);
 
-	// For each mesh object:
-	for(uint i=0 ; i < nb_objects ; i++)
+	// Cull the objects and build the batches of draw commands:
+	uint nb_batches = buildBatches(elements, view_matrix, proj_matrix);
+	uint nb_opaque_objects = elements->getNbOpaqueObjects();
+
+	// ----------------- Depth pre-pass --------------------
+	// Render the depth of the opaque objects, without writing the colors. The opaque objects
+	// are then shaded with the GL_EQUAL depth test and without writing the depth, so that only
+	// the visible fragments are shaded. The transparent objects are not in the pre-pass.
+	// With a depth layer, the depth buffer is already filled, with the depth of all the objects.
+	bool depth_prepass = (!use_depth_layer && depth_prepass_enabled && depth_prepass_program.ptr() != NULL);
+
+	uint nb_opaque_batches = 0;
+	while(nb_opaque_batches < nb_batches && draw_batches[nb_opaque_batches].first_object < nb_opaque_objects)
+		nb_opaque_batches++;
+
+	if(depth_prepass && nb_opaque_batches != 0)
 	{
-		Object* obj = objects[i];
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
-		if(obj->getType() != Object::MESH)
-			continue;
+		depth_prepass_program->use();
+		prev_program = depth_prepass_program.ptr();
+
+		for(uint b=0 ; b < nb_opaque_batches ; b++)
+			drawBatch(draw_batches[b], objects);
+
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
+
+	if(depth_prepass || use_depth_layer)
+	{
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+
+	// For each batch:
+	for(uint b=0 ; b < nb_batches ; b++)
+	{
+		const DrawBatch& batch = draw_batches[b];
+
+		// The transparent objects are rendered with the default depth test:
+		if(depth_prepass && b == nb_opaque_batches)
+		{
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+		}
+
+		Object* obj = objects[batch.first_object];
 
 		GeneralProfile* profile = (GeneralProfile*)(obj->getMaterial()->getProfile(profile_index));
 		glutil::GPUProgram* program = profile->getProgram();
 
 		// If the current program changed, we start using
 		// the new program
+		// NB: the uniforms common for all programs (camera and lights) are in
+		// uniform blocks (see UniformBlocks)
 		if(prev_program != program)
 		{
 			program->use();
-
-			// Bind the uniforms common for all programs:
-			// - lights (when not rendering to a GBuffer):
-			if(program->getPreprocessor()->hasOriginalSymbol("_FORWARD_SHADING_"))
-			{
-				for(uint i=0 ; i < nb_lights ; i++)
-				{
-					Light* l = lights[i];
-
-					// - position of the light:
-					ss.str("");
-					ss << "light_pos_" << i << flush;
-					program->sendUniform(ss.str().c_str(), l->getPosition(), Hash::AT_RUNTIME);
-
-					// - color of the light:
-					ss.str("");
-					ss << "light_color_" << i << flush;
-					program->sendUniform(ss.str().c_str(), l->getColor(), Hash::AT_RUNTIME);
-				}
-			}
-
-			// Update prev_program
 			prev_program = program;
 		}
 
@@ -312,60 +447,292 @@ void RasterRenderer::renderArrayExt(Scene* scene,
 		// Bind the debug texture to a free texture unit:
 #ifdef USE_DEBUG_TEXTURE
 		uint debug_texunit = texunit_manager.getFreeTexunit();
-		glActiveTexture(GL_TEXTURE0 + debug_texunit);
-		glBindTexture(GL_TEXTURE_2D, id_debug);
+		glutil::activeTexture(GL_TEXTURE0 + debug_texunit);
+		glutil::bindTexture(GL_TEXTURE_2D, id_debug);
 		program->sendUniform("tex_debug", GLint(debug_texunit));
 #endif
 
 		// Bind the shadow map textures and set the uniforms for indicating the texture units
 		if(use_shadow_mapping)
-			bindShadowMaps(lights, nb_lights, program, &texunit_manager);
+			bindShadowMaps(profile, &texunit_manager);
 
 		// Bind the additional textures:
 		if(nb_added_tex_bindings != 0)
 			TextureBinding::bind(added_tex_bindings, nb_added_tex_bindings, program, &texunit_manager);
 
 		// ----------------------------------
-		MeshObject* mesh_obj = (MeshObject*)obj;
-		Geometry* geo = mesh_obj->getGeometry();
+		// - bind the VAO (the same for all the geometries of the batch) and draw the commands:
+		drawBatch(batch, objects);
+	}
+
+	// Restore the default depth test and face culling:
+	if(depth_prepass || use_depth_layer)
+	{
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
+
+	if(use_depth_layer)
+		glutil::enable(GL_CULL_FACE);
+
+	if(use_multi_draw_indirect)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glutil::bindVertexArray(0);
+
+	// Restore the camera's viewpoint:
+	if(light_viewpoint != NULL)
+		UniformBlocks::bindCameraView();
+}
+
+// Draw the visible objects from the viewpoint of the camera with the given program, without
+// any material (see RasterRenderer.h)
+void RasterRenderer::renderGeometryArray(Scene* scene, glutil::GPUProgram* program)
+{
+	const Camera* camera = scene->getCamera();
+	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
+	Object** objects = elements->getObjects();
+
+	uint nb_batches = buildBatches(elements, camera->computeViewMatrix(), camera->computeProjectionMatrix());
+
+	program->use();
+
+	for(uint b=0 ; b < nb_batches ; b++)
+		drawBatch(draw_batches[b], objects);
+
+	if(use_multi_draw_indirect)
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glutil::bindVertexArray(0);
+}
+
+// ---------------------------------------------------------------------
+// Cull the objects outside of the view frustum, sort the visible ones with the render queue
+// and build their batches. The model matrices (and the commands, with multi-draw indirect)
+// are streamed to the GPU. Returns the number of batches.
+uint RasterRenderer::buildBatches(ArrayElementContainer* elements, const mat4& view_matrix, const mat4& proj_matrix)
+{
+	Object** objects = elements->getObjects();
+	uint nb_objects = elements->getNbObjects();
+
+	// Cull the objects outside of the view frustum:
+	const uchar* visible_objects = elements->cullObjects(Frustum(proj_matrix * view_matrix));
+
+	// Queue the visible mesh objects, sorted by state and depth (see RenderQueue):
+	uint nb_opaque_objects = elements->getNbOpaqueObjects();
+
+	vec3 view_dir_row(view_matrix[0][2], view_matrix[1][2], view_matrix[2][2]);	// 3rd row of the view matrix
+	float view_dir_offset = view_matrix[3][2];
+
+	render_queue.clear();
+
+	for(uint i=0 ; i < nb_objects ; i++)
+	{
+		if(!visible_objects[i] || objects[i]->getType() != Object::MESH)
+			continue;
+
+		const MeshObject* mesh_obj = (const MeshObject*)(objects[i]);
+		const Material* mat = mesh_obj->getMaterial();
+		const GPUProfile* profile = (const GPUProfile*)(mat->getProfile(profile_index));
+
+		// Depth of the center of the bounding sphere, along the view direction:
+		BoundingSphere sphere = elements->getWorldBoundingSphere(i);
+		float depth = -(glm::dot(view_dir_row, sphere.center) + view_dir_offset);
+
+		uint64 key = RenderQueue::makeKey(0,
+										  i >= nb_opaque_objects,
+										  profile->getProgram()->getProgram(),
+										  uint(mat->getFilenameHash()) ^ mat->getFlags(),
+										  mesh_obj->getGeometry()->getVAO(vao_index),
+										  depth);
+		render_queue.push(key, i);
+	}
+
+	render_queue.sort();
+
+	// Build the batches with consecutive draws of the queue sharing the same state, and
+	// stream their model matrices to the per-instance VBO:
+	assert(nb_objects <= nb_instance_matrices);
+
+	const SortItem* items = render_queue.getItems();
+	uint nb_items = render_queue.getNbItems();
+
+	uint nb_batches = 0;
+	uint nb_commands = 0;
+	const Geometry* prev_geo = NULL;
+
+	for(uint i=0 ; i < nb_items ; i++)
+	{
+		uint index = items[i].value;
+		const Geometry* geo = ((const MeshObject*)(objects[index]))->getGeometry();
+
+		// New batch when the state changes (the ids in the keys are truncated, so that
+		// we also check the VAO and the material):
+		bool new_batch = true;
+		if(nb_batches != 0 && RenderQueue::getStateBits(items[i].key) == RenderQueue::getStateBits(items[i-1].key))
+		{
+			const Object* batch_obj = objects[draw_batches[nb_batches-1].first_object];
+			new_batch = (	((const MeshObject*)batch_obj)->getGeometry()->getVAO(vao_index) != geo->getVAO(vao_index) ||
+							!canShareMaterial(batch_obj, objects[index], profile_index));
+		}
 
-		// - compute the model matrix:
-		mat4 model_matrix = mat4(mesh_obj->getOrientation());
-		model_matrix[3] = vec4(mesh_obj->getPosition(), 1.0);
+		if(new_batch)
+		{
+			DrawBatch& batch = draw_batches[nb_batches++];
+			batch.first_object = index;
+			batch.first_command = nb_commands;
+			batch.nb_commands = 0;
+		}
 
-		// - send uniform variables:
-		program->sendUniform("view_matrix",       view_matrix);
-		program->sendUniform("model_matrix",      model_matrix);
-		program->sendUniform("projection_matrix", proj_matrix);
+		// New command when the geometry changes:
+		if(new_batch || geo != prev_geo)
+		{
+			DrawCommand& command = draw_commands[nb_commands++];
+			command.count = geo->getNbVertices();
+			command.instance_count = 0;
+			command.first = geo->getFirstVertex(vao_index);
+			command.base_instance = i;	// one matrix per item
+			draw_batches[nb_batches-1].nb_commands++;
+			prev_geo = geo;
+		}
 
-		// - bind the VAO and draw
-		glBindVertexArray(geo->getVAO(vao_index));
-		glDrawArrays(GL_TRIANGLES, 0, geo->getNbVertices());
+		mat4& model_matrix = instance_matrices[i];
+		model_matrix = mat4(objects[index]->getOrientation());
+		model_matrix[3] = vec4(objects[index]->getPosition(), 1.0);
+		draw_commands[nb_commands-1].instance_count++;
 	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, id_instances_vbo);
+	glBufferData(GL_ARRAY_BUFFER, nb_instance_matrices * sizeof(mat4), NULL, GL_STREAM_DRAW);	// orphan the previous frame's data
+	glBufferSubData(GL_ARRAY_BUFFER, 0, nb_items * sizeof(mat4), instance_matrices);
+
+	if(use_multi_draw_indirect)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, id_indirect_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, nb_instance_matrices * sizeof(DrawCommand), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, nb_commands * sizeof(DrawCommand), draw_commands);
+	}
+
+
+	return nb_batches;
 }
 
 // ---------------------------------------------------------------------
-void RasterRenderer::debugDraw2D(Scene* scene)
+// Can two mesh objects be drawn in the same batch? They must have a material loaded from
+// the same file, so that the uniforms bound by the profile are the same.
+bool RasterRenderer::canShareMaterial(const Object* obj_a, const Object* obj_b, uint profile_index)
 {
-	if(scene->getElements()->getType() != ElementContainer::ARRAY)
-		return;
+	const Material* mat_a = obj_a->getMaterial();
+	const Material* mat_b = obj_b->getMaterial();
 
-	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
+	if(mat_a->getFilename() == "")
+		return false;
 
-	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	return	mat_a->getFlags() == mat_b->getFlags() &&
+			mat_a->getFilenameHash() == mat_b->getFilenameHash() &&
+			mat_a->getFilename() == mat_b->getFilename() &&
+			((const GPUProfile*)(mat_a->getProfile(profile_index)))->getProgram() ==
+			((const GPUProfile*)(mat_b->getProfile(profile_index)))->getProgram();
+}
 
-	// Draw the shadow maps:
-	if(use_shadow_mapping)
+// Set the per-instance model matrix attribute of the currently bound VAO, reading the
+// matrices from the given index in the instances VBO
+void RasterRenderer::setInstancesAttrib(uint first_matrix) const
+{
+	glBindBuffer(GL_ARRAY_BUFFER, id_instances_vbo);
+
+	for(uint c=0 ; c < 4 ; c++)
 	{
-		for(uint i=0 ; i < nb_lights ; i++)
+		size_t offset = first_matrix * sizeof(mat4) + c * sizeof(vec4);
+		glVertexAttribPointer(GENERAL_PROFILE_ATTRIB_INSTANCE_MODEL_MATRIX + c, 4, GL_FLOAT, GL_FALSE,
+							  sizeof(mat4), (const GLvoid*)offset);
+	}
+}
+
+// Add the per-instance model matrix attribute to the currently bound VAO
+void RasterRenderer::addInstancesAttrib() const
+{
+	for(uint c=0 ; c < 4 ; c++)
+	{
+		glEnableVertexAttribArray(GENERAL_PROFILE_ATTRIB_INSTANCE_MODEL_MATRIX + c);
+		glVertexAttribDivisor(GENERAL_PROFILE_ATTRIB_INSTANCE_MODEL_MATRIX + c, 1);
+	}
+	setInstancesAttrib(0);
+}
+
+// Bind the VAO of a batch and submit its draw commands
+void RasterRenderer::drawBatch(const DrawBatch& batch, Object** objects) const
+{
+	// The VAO is the same for all the geometries of the batch:
+	const MeshObject* mesh_obj = (const MeshObject*)(objects[batch.first_object]);
+	glutil::bindVertexArray(mesh_obj->getGeometry()->getVAO(vao_index));
+
+	if(use_multi_draw_indirect)
+	{
+		// The base instances of the commands give the model matrices:
+		setInstancesAttrib(0);
+		glMultiDrawArraysIndirect(GL_TRIANGLES,
+								  (const GLvoid*)(batch.first_command * sizeof(DrawCommand)),
+								  batch.nb_commands,
+								  0);
+	}
+	else
+	{
+		for(uint c=batch.first_command ; c < batch.first_command + batch.nb_commands ; c++)
 		{
-			ShadowMap* shadow_map = (ShadowMap*)(lights[i]->getUserData(LIGHT_DATA_SHADOW_MAP));
-			glutil::displayTexture2D(shadow_map->getTexDepth(), i, 0);
+			const DrawCommand& command = draw_commands[c];
+			setInstancesAttrib(command.base_instance);
+			glDrawArraysInstanced(GL_TRIANGLES, command.first, command.count, command.instance_count);
 		}
 	}
 }
 
+// Load the program of the depth pre-pass
+void RasterRenderer::setupDepthPrepassProgram()
+{
+	bool ok = true;
+	bool is_new = false;
+	depth_prepass_program = getProgramManager().getProgram(
+								GPUProgramID("media/shaders/depth_prepass.vert",
+											 "media/shaders/depth_prepass.frag"),
+								&is_new);
+
+	// If it is a new program, we should set the attrib location(s), link it and bind
+	// the camera uniform block:
+	if(is_new)
+	{
+		// - attrib location(s):
+		depth_prepass_program->bindAttribLocation(DEPTH_PREPASS_ATTRIB_POSITION, "vertex_position");
+		depth_prepass_program->bindAttribLocation(DEPTH_PREPASS_ATTRIB_INSTANCE_MODEL_MATRIX, "instance_model_matrix");
+
+		// - link the program:
+		ok &= depth_prepass_program->link();
+		assert(ok);
+
+		// - bind the uniform block (camera):
+		depth_prepass_program->bindUniformBlock(UNIFORM_BLOCK_BINDING_CAMERA, "CameraBlock");
+
+		// - validate the program:
+#ifndef NDEBUG
+		depth_prepass_program->validate();
+#endif
+	}
+}
+
+// ---------------------------------------------------------------------
+void RasterRenderer::debugDraw2D(Scene* scene)
+{
+	if(scene->getElements()->getType() != ElementContainer::ARRAY)
+		return;
+
+	ArrayElementContainer* elements = (ArrayElementContainer*)(scene->getElements());
+	uint nb_lights = elements->getNbLights();
+
+	// Draw the shadow atlas:
+	if(use_shadow_mapping && nb_lights != 0)
+		glutil::displayTexture2D(ShadowMap::getAtlasTexture(), 0, 0);
+}
+
 // ---------------------------------------------------------------------
 void RasterRenderer::debugDraw3D(Scene* scene)
 {
@@ -393,63 +760,24 @@ void RasterRenderer::debugDraw3D(Scene* scene)
 
 // ---------------------------------------------------------------------
 // This function:
-// - binds the shadow map textures
-// - sets the uniforms for indicating the texture units
-// - updates texunits_usage[] (read/write)
+// - binds the shadow atlas texture
+// - sets the uniform for indicating the texture unit
+// - uses and updates the texunit manager
 // It is called from the rendering function.
-void RasterRenderer::bindShadowMaps(Light** lights,
-									uint nb_lights,
-									glutil::GPUProgram* program,
+void RasterRenderer::bindShadowMaps(GeneralProfile* profile,
 									TexunitManager* texunit_manager) const
 {
-	stringstream ss;
-
-	// Get the necessary number of free texunits for binding the shadow maps:
-	uint texunits[NB_MAX_TEXTURE_BINDINGS];
-	texunit_manager->getFreeTexunits(texunits, nb_lights);
-
-	// Bias matrix, used for shadow mapping. Lets us switch from the range [-1, 1] to [0, 1]
-	// (0.5*x + 0.5)
-	mat4 bias_matrix = mat4(vec4(0.5, 0.0, 0.0, 0.0),
-							vec4(0.0, 0.5, 0.0, 0.0),
-							vec4(0.0, 0.0, 0.5, 0.0),
-							vec4(0.5, 0.5, 0.5, 1.0));
-
-	// Bind the shadow map textures to the corresponding texture units
-	// and send the corresponding uniforms to the current program:
-	for(uint i=0 ; i < nb_lights ; i++)
-	{
-		Light* l = lights[i];
-		ShadowMap* shadow_map = (ShadowMap*)(l->getUserData(LIGHT_DATA_SHADOW_MAP));
-
-		// Bind the texture to the texture unit
-		glActiveTexture(GL_TEXTURE0 + texunits[i]);
-		glBindTexture(GL_TEXTURE_2D, shadow_map->getTexDepth());
-
-		// Set the parameters for shadow comparison and disable any possible mip-mapping:
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,       GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,       GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,   GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,   GL_NEAREST);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-
-		// Send the texture unit as an uniform
-		ss.str("");
-		ss << "shadow_map_" << i << flush;
-		program->sendUniform(ss.str().c_str(), GLint(texunits[i]), Hash::AT_RUNTIME);
-
-		// Compute the "shadow matrix", which lets us do:
-		// world space      => light view space		[light view matrix]
-		// light view space => light clip space		[light proj matrix]
-		// light clip space => shadow map space		[bias matrix]
-		// Hence : shadow_matrix = bias_matrix * light_proj_matrix * light_view_matrix
-		mat4 shadow_matrix = bias_matrix * l->computeProjectionMatrix() * l->computeViewMatrix();
-
-		// Send the shadow matrix as a uniform to the program:
-		ss.str("");
-		ss << "shadow_matrix_" << i << flush;
-		program->sendUniform(ss.str().c_str(), shadow_matrix, false, Hash::AT_RUNTIME);
-	}
+	glutil::GPUProgram* program = profile->getProgram();
+
+	// Bind the atlas, which contains the shadow maps of all the lights, and send the
+	// texture unit to the current program.
+	// NB: the shadow matrices and the regions of the shadow maps in the atlas are in the
+	// lights uniform block (see UniformBlocks::update()), and the shadow comparison
+	// is set up when creating the atlas.
+	uint texunit = texunit_manager->getFreeTexunit();
+
+	glutil::activeTexture(GL_TEXTURE0 + texunit);
+	glutil::bindTexture(GL_TEXTURE_2D, ShadowMap::getAtlasTexture());
+
+	program->sendUniform("shadow_atlas", GLint(texunit));
 }
@@ -8,6 +8,9 @@
 #include "../CommonIndices.h"
 #include "../Debug.h"
 #include "../scene/Material.h"
+#include "../scene/GPUProgramManager.h"
+#include "utils/MeshPool.h"
+#include "utils/RenderQueue.h"
 #include <list>
 #include <string>
 
@@ -15,6 +18,7 @@ class Light;
 class Camera;
 class ArrayElementContainer;
 class Scene;
+class Object;
 class GeneralProfile;
 class TexunitManager;
 struct TextureBinding;
@@ -38,6 +42,49 @@ private:
 
 	uint profile_index;
 
+	// Instanced drawing: the visible objects are sorted each frame by the render queue, and
+	// consecutive draws sharing the same program and material are put in the same batch.
+	// Each batch is a list of draw commands, one per run of objects sharing the same geometry,
+	// drawn as instances. The model matrices of the visible objects are streamed each frame
+	// to a per-instance vertex buffer, and the commands give the index of their first matrix.
+	// Objects outside of the view frustum are culled before building the batches.
+	// With multi-draw indirect, the static geometries are packed into a few vertex buffers
+	// (see MeshPool), so that each batch is submitted with a single glMultiDrawArraysIndirect().
+	// Otherwise, the commands of a batch are submitted one by one with glDrawArraysInstanced().
+	struct DrawCommand	// same layout as the commands of glMultiDrawArraysIndirect()
+	{
+		GLuint count;
+		GLuint instance_count;
+		GLuint first;
+		GLuint base_instance;	// index of the first matrix in the instances VBO
+	};
+
+	struct DrawBatch
+	{
+		uint first_object;	// index of the first object of the batch (gives the material)
+		uint first_command;
+		uint nb_commands;
+	};
+
+	GLuint id_instances_vbo;
+	mat4* instance_matrices;
+	uint nb_instance_matrices;	// capacity (number of objects)
+	DrawBatch* draw_batches;
+	DrawCommand* draw_commands;
+
+	bool use_multi_draw_indirect;
+	MeshPool mesh_pool;
+	GLuint id_indirect_buffer;
+
+	RenderQueue render_queue;
+
+	// Depth pre-pass: the depth of the opaque objects is rendered first with a minimal
+	// program, so that the main pass only shades the visible fragments (with GL_EQUAL).
+	// It is not done for the depth peeling profile, whose programs discard fragments.
+	bool supports_depth_prepass;
+	GPUProgramRef depth_prepass_program;
+	static bool depth_prepass_enabled;	// shared by all the raster renderers
+
 public:
 	RasterRenderer(uint width, uint height,
 				   const vec3& back_color,
@@ -62,12 +109,22 @@ public:
 
 	// Render one frame
 	// If light_viewpoint != NULL, render from the viewpoint of the given light.
+	// If use_depth_layer, the depth buffer is not cleared: it already contains a depth layer
+	// (see StencilRoutedRenderer), and only the fragments of this layer are shaded, with the
+	// GL_EQUAL depth test and without face culling.
 	virtual void renderArray(Scene* scene);
 	void renderArrayExt(Scene* scene,
 						const vec3& back_color,
 						const Light* light_viewpoint=NULL,
 						TextureBinding* added_tex_bindings=NULL,
-						uint nb_added_tex_bindings=0);
+						uint nb_added_tex_bindings=0,
+						bool use_depth_layer=false);
+
+	// Draw the visible objects from the viewpoint of the camera with the given program, which
+	// replaces the programs of the materials: it reads the camera uniform block and the
+	// per-instance model matrix (like media/shaders/depth_prepass.vert). Nothing is cleared and
+	// the depth test, face culling and viewport are the caller's.
+	void renderGeometryArray(Scene* scene, glutil::GPUProgram* program);
 
 	// Debug drawing
 	virtual void debugDraw2D(Scene* scene);
@@ -76,15 +133,37 @@ public:
 	// Get the renderer's name
 	virtual const char* getName() const {return "RasterRenderer";}
 
+	// Enable or disable the depth pre-pass at runtime, for all the raster renderers
+	static void setDepthPrepassEnabled(bool enabled) {depth_prepass_enabled = enabled;}
+	static bool isDepthPrepassEnabled() {return depth_prepass_enabled;}
+
 private:
+	// Cull the objects outside of the view frustum and build the batches of the visible ones,
+	// streaming their model matrices (and commands) to the GPU. Returns the number of batches.
+	uint buildBatches(ArrayElementContainer* elements, const mat4& view_matrix, const mat4& proj_matrix);
+
+	// Can two mesh objects be drawn in the same batch, i.e. do they need the same program and material?
+	static bool canShareMaterial(const Object* obj_a, const Object* obj_b, uint profile_index);
+
+	// Set the per-instance model matrix attribute of the currently bound VAO, reading the
+	// matrices from the given index in the instances VBO
+	void setInstancesAttrib(uint first_matrix) const;
+
+	// Add the per-instance model matrix attribute to the currently bound VAO
+	void addInstancesAttrib() const;
+
+	// Bind the VAO of a batch and submit its draw commands
+	void drawBatch(const DrawBatch& batch, Object** objects) const;
+
+	// Load the program of the depth pre-pass
+	void setupDepthPrepassProgram();
+
 	// This function:
-	// - binds the shadow map textures
-	// - sets the uniforms for indicating the texture units
+	// - binds the shadow atlas texture
+	// - sets the uniform for indicating the texture unit
 	// - uses and updates the texunit manager
 	// It is called from the rendering function.
-	void bindShadowMaps(Light** lights,
-						uint nb_lights,
-						glutil::GPUProgram* program,
+	void bindShadowMaps(GeneralProfile* profile,
 						TexunitManager* texunit_manager) const;
 };
 
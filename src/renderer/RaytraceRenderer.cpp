@@ -2,6 +2,7 @@
 
 #include "RaytraceRenderer.h"
 #include "../CommonIndices.h"
+#include "../Config.h"
 #include "../glutil/glutil.h"
 #include "../log/Log.h"
 #include "../scene/ArrayElementContainer.h"
@@ -40,7 +41,7 @@ RaytraceRenderer::~RaytraceRenderer()
 void RaytraceRenderer::setup()
 {
 	// Setup a fullscreen quad :
-	fs_quad = new glutil::Quad(getWidth(), getHeight());
+	fs_quad = new glutil::Quad(getWidth(), getHeight(), USE_PBO_STREAMING);
 
 	tri_container.nb_triangles = 0;
 	lights = NULL;
@@ -203,6 +204,7 @@ void RaytraceRenderer::renderArraySinglethread(Pixel* pixels, const Camera* came
 			p.r = (uchar)(glm::clamp(final_color.r, 0.0f, 255.0f));
 			p.g = (uchar)(glm::clamp(final_color.g, 0.0f, 255.0f));
 			p.b = (uchar)(glm::clamp(final_color.b, 0.0f, 255.0f));
+			p.a = 255;
 		}
 	}
 }
@@ -334,6 +336,7 @@ void RaytraceRenderer::renderArrayThread(Pixel* pixels, const Camera* camera,
 			p.r = (uchar)(glm::clamp(final_color.r, 0.0f, 255.0f));
 			p.g = (uchar)(glm::clamp(final_color.g, 0.0f, 255.0f));
 			p.b = (uchar)(glm::clamp(final_color.b, 0.0f, 255.0f));
+			p.a = 255;
 		}
 	}
 	// Thread 1 : decrement
@@ -365,6 +368,7 @@ void RaytraceRenderer::renderArrayThread(Pixel* pixels, const Camera* camera,
 			p.r = (uchar)(glm::clamp(final_color.r, 0.0f, 255.0f));
 			p.g = (uchar)(glm::clamp(final_color.g, 0.0f, 255.0f));
 			p.b = (uchar)(glm::clamp(final_color.b, 0.0f, 255.0f));
+			p.a = 255;
 		}
 	}
 }
@@ -4,6 +4,7 @@
 #include "../log/Log.h"
 #include "../scene/Scene.h"
 #include "../scene/ElementContainer.h"
+#include "utils/UniformBlocks.h"
 
 Renderer::Renderer(uint width, uint height, const vec3& back_color)
 : width(width), height(height), back_color(back_color)
@@ -112,6 +113,9 @@ void Renderer::render(Scene* scene)
 	assert(scene->getCamera() != NULL);
 	assert(scene->getElements() != NULL);
 
+	// Upload the camera and lights data shared by the programs:
+	UniformBlocks::update(scene);
+
 	// Call render[Array|Octree|...]()
 	switch(scene->getElements()->getType())
 	{
@@ -2,103 +2,485 @@
 
 #include "StencilRoutedRenderer.h"
 
-#define ATTRIB_POSITION 0
-#define FRAG_DATA_COLOR 0
+#include "RasterRenderer.h"
+#include "../CommonIndices.h"
+#include "../ShaderLocations.h"
+#include "../glutil/glutil.h"
+#include "../scene/Scene.h"
+#include "../log/Log.h"
+#include <sstream>
+using namespace std;
 
-StencilRoutedRenderer::StencilRoutedRenderer(uint width, uint height)
-: Renderer(width, height, vec3(0.0, 0.0, 0.0)),
+// Opacity of the surfaces when compositing the fragments
+#define LAYER_OPACITY 0.5f
+
+// Stencil value of the next free sample (see writeFragments())
+#define ROUTING_STENCIL_REF 2
+
+// ---------------------------------------------------------------------
+StencilRoutedRenderer::StencilRoutedRenderer(uint width, uint height, const vec3& back_color, uint nb_layers)
+: Renderer(width, height, back_color),
+  nb_samples(0),
+  id_fragments_tex(0),
+  id_stencil_tex(0),
+  id_abuffer_fbo(0),
+  id_depth_layers(NULL),
+  id_normal_layers(NULL),
+  nb_layers(nb_layers),
+  id_layers_fbo(0),
+  init_routing_program(NULL),
   write_fragments_program(NULL),
-  sort_fragments_program(NULL)
+  extract_layer_program(NULL),
+  sort_fragments_program(NULL),
+  id_quad_vao(0),
+  id_quad_vbo(0),
+  raster_renderer(NULL)
 {
+	id_depth_layers  = new GLuint[nb_layers];
+	id_normal_layers = new GLuint[nb_layers];
+
+	for(uint i=0 ; i < nb_layers ; i++)
+		id_depth_layers[i] = id_normal_layers[i] = 0;
+
+	// Only its VAOs, instances and batches are used (see writeFragments()):
+	raster_renderer = new RasterRenderer(
+			width,
+			height,
+			vec3(0.0),				// back color: ignored
+			false,					// use_shadow_mapping
+			false,					// use_visibility_maps
+			"",						// brdf_function: none
+			VAO_INDEX_RASTER,
+			VAO_INDEX_RASTER_SHADOW,
+			GENERAL_PROFILE);
 }
 
 StencilRoutedRenderer::~StencilRoutedRenderer()
 {
+	delete raster_renderer;
+
+	delete [] id_depth_layers;
+	delete [] id_normal_layers;
 }
 
+// ---------------------------------------------------------------------
 // Called when we switch to this renderer
 void StencilRoutedRenderer::setup()
 {
-	createPrograms();
+	createAbuffer();
+	createLayers();
+	createPrograms();	// after createAbuffer(): depends on the number of samples
+	createQuadVBOAndVAO();
+
+	raster_renderer->setup();
 }
 
 // Called when we switch to another renderer or close the program
 void StencilRoutedRenderer::cleanup()
 {
+	raster_renderer->cleanup();
+
+	// Programs
+	delete init_routing_program;
+	init_routing_program = NULL;
+
 	delete write_fragments_program;
 	write_fragments_program = NULL;
 
+	delete extract_layer_program;
+	extract_layer_program = NULL;
+
 	delete sort_fragments_program;
 	sort_fragments_program = NULL;
+
+	// A-buffer
+	glutil::deleteFramebuffers(1, &id_abuffer_fbo);
+	id_abuffer_fbo = 0;
+
+	glutil::deleteTextures(1, &id_fragments_tex);
+	glutil::deleteTextures(1, &id_stencil_tex);
+	id_fragments_tex = 0;
+	id_stencil_tex = 0;
+	nb_samples = 0;
+
+	// Layers
+	glutil::deleteFramebuffers(1, &id_layers_fbo);
+	id_layers_fbo = 0;
+
+	glutil::deleteTextures(nb_layers, id_depth_layers);
+	glutil::deleteTextures(nb_layers, id_normal_layers);
+
+	for(uint i=0 ; i < nb_layers ; i++)
+		id_depth_layers[i] = id_normal_layers[i] = 0;
+
+	// Quad
+	glDeleteBuffers(1, &id_quad_vbo);
+	id_quad_vbo = 0;
+
+	glutil::deleteVertexArrays(1, &id_quad_vao);
+	id_quad_vao = 0;
 }
 
+// ---------------------------------------------------------------------
 // Called when we change the scene
+// NB: the programs of the materials are loaded by the raster renderer, but only its VAOs are used.
 void StencilRoutedRenderer::loadSceneArray(Scene* scene)
 {
+	raster_renderer->loadSceneArray(scene);
 }
 
 void StencilRoutedRenderer::unloadSceneArray(Scene* scene)
 {
+	raster_renderer->unloadSceneArray(scene);
 }
 
+// ---------------------------------------------------------------------
 // Render a frame
 void StencilRoutedRenderer::renderArray(Scene* scene)
 {
-	glClearColor(0.0, 0.0, 0.0, 0.0);
+	renderLayers(scene, raster_renderer, NULL);
+
+	composite();
+	GL_CHECK();
+}
+
+void StencilRoutedRenderer::renderLayers(Scene* scene, RasterRenderer* geometry_renderer, const GLuint* id_depth_targets)
+{
+	// Single geometry pass:
+	writeFragments(scene, geometry_renderer);
+	GL_CHECK();
+
+	// Full-screen passes:
+	extractLayers(id_depth_targets);
+	GL_CHECK();
+}
+
+void StencilRoutedRenderer::writeFragments(Scene* scene, RasterRenderer* geometry_renderer)
+{
+	glutil::BindFramebuffer fbo_binding(id_abuffer_fbo);
+
+	// Empty samples: depth (w) greater than 1
+	glClearColor(0.0, 0.0, 0.0, 2.0);
 	glClear(GL_COLOR_BUFFER_BIT);
+
+	glutil::Disable<GL_DEPTH_TEST> depth_test_state;
+	glutil::Disable<GL_CULL_FACE>  cull_face_state;
+	glutil::Enable<GL_STENCIL_TEST> stencil_test_state;
+
+	// ---------- Routing: the sample i gets the stencil value i+2 ----------
+	{
+		glutil::Enable<GL_SAMPLE_MASK> sample_mask_state;
+
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+		init_routing_program->use();
+		glutil::bindVertexArray(id_quad_vao);
+
+		for(uint i=0 ; i < nb_samples ; i++)
+		{
+			glSampleMaski(0, 1U << i);
+			glStencilFunc(GL_ALWAYS, ROUTING_STENCIL_REF + i, 0xFF);
+
+			const uint nb_vertices = 6;
+			glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
+		}
+
+		glSampleMaski(0, ~0U);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
+
+	// ---------- Geometry: each fragment goes to the sample whose stencil value is 2 ----------
+	// Without multisampling, a fragment covers all the samples of its pixel, and the stencil
+	// test selects one of them. The stencil values of all the samples are then decremented,
+	// so that the next fragment goes to the next sample.
+	{
+		glutil::Disable<GL_MULTISAMPLE> multisample_state;
+
+		glStencilFunc(GL_EQUAL, ROUTING_STENCIL_REF, 0xFF);
+		glStencilOp(GL_DECR, GL_DECR, GL_DECR);
+
+		// Visible objects, with the camera uniform block and the per-instance model matrices:
+		geometry_renderer->renderGeometryArray(scene, write_fragments_program);
+
+		glStencilFunc(GL_ALWAYS, 0, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	}
 }
 
+void StencilRoutedRenderer::extractLayers(const GLuint* id_depth_targets)
+{
+	uint texunit = 0;
+
+	glutil::BindFramebuffer fbo_binding(id_layers_fbo);
+
+	// The depth test has to be enabled for writing gl_FragDepth:
+	glutil::Enable<GL_DEPTH_TEST> depth_test_state;
+	glDepthFunc(GL_ALWAYS);
+
+	glutil::GPUProgram* program = extract_layer_program;
+	program->use();
+
+	BIND_TEX(GL_TEXTURE_2D_MULTISAMPLE, id_fragments_tex, "tex_fragments", program, texunit);
+
+	glutil::bindVertexArray(id_quad_vao);
+
+	for(uint i=0 ; i < nb_layers ; i++)
+	{
+		GLuint id_depth = id_depth_layers[i];
+		if(id_depth_targets != NULL && id_depth_targets[i] != 0)
+			id_depth = id_depth_targets[i];
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_RECTANGLE, id_normal_layers[i], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_TEXTURE_RECTANGLE, id_depth,            0);
+
+		program->sendUniform("num_layer", GLint(i));
+
+		const uint nb_vertices = 6;
+		glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
+	}
+
+	glDepthFunc(GL_LESS);
+}
+
+void StencilRoutedRenderer::composite()
+{
+	uint texunit = 0;
+
+	glutil::Disable<GL_DEPTH_TEST> depth_test_state;
+
+	glutil::GPUProgram* program = sort_fragments_program;
+	program->use();
+
+	BIND_TEX(GL_TEXTURE_2D_MULTISAMPLE, id_fragments_tex, "tex_fragments", program, texunit);
+	program->sendUniform("back_color",    getBackColor());
+	program->sendUniform("layer_opacity", LAYER_OPACITY);
+
+	const uint nb_vertices = 6;
+	glutil::bindVertexArray(id_quad_vao);
+	glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
+}
+
+// ---------------------------------------------------------------------
 // Debug drawing for the renderers
 void StencilRoutedRenderer::debugDraw2D(Scene* scene)
 {
+	uint w = getWidth();
+	uint h = getHeight();
+
+	for(uint i=0 ; i < nb_layers ; i++)
+	{
+		uint x = (i*2 + 0) % DEBUG_RECT_FACTOR;
+		uint y = (i*2 + 0) / DEBUG_RECT_FACTOR;
+		glutil::displayTextureRect(id_depth_layers[i], x, y, w, h);
+
+		x = (i*2 + 1) % DEBUG_RECT_FACTOR;
+		y = (i*2 + 1) / DEBUG_RECT_FACTOR;
+		glutil::displayTextureRect(id_normal_layers[i], x, y, w, h);
+	}
 }
 
 void StencilRoutedRenderer::debugDraw3D(Scene* scene)
 {
 }
 
+// ---------------------------------------------------------------------
+void StencilRoutedRenderer::createAbuffer()
+{
+	uint width  = getWidth();
+	uint height = getHeight();
+
+	// Number of samples: at least one per layer, if supported
+	GLint max_color_samples = 0;
+	GLint max_depth_samples = 0;
+	glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &max_color_samples);
+	glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &max_depth_samples);
+
+	uint max_samples = uint(glm::min(max_color_samples, max_depth_samples));
+	nb_samples = glm::min(nb_layers, max_samples);
+
+	if(nb_samples < nb_layers)
+		logWarn("only ", nb_samples, " fragments per pixel are supported for ", nb_layers, " layers");
+
+	// - fragments (the implementation may allocate more samples than asked):
+	glGenTextures(1, &id_fragments_tex);
+	glutil::bindTexture(GL_TEXTURE_2D_MULTISAMPLE, id_fragments_tex);
+	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, nb_samples, GL_RGBA32F, width, height, GL_TRUE);
+
+	GLint actual_nb_samples = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D_MULTISAMPLE, 0, GL_TEXTURE_SAMPLES, &actual_nb_samples);
+	nb_samples = uint(actual_nb_samples);
+
+	// - routing:
+	glGenTextures(1, &id_stencil_tex);
+	glutil::bindTexture(GL_TEXTURE_2D_MULTISAMPLE, id_stencil_tex);
+	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, nb_samples, GL_DEPTH24_STENCIL8, width, height, GL_TRUE);
+
+	GL_CHECK();
+
+	// - FBO:
+	glGenFramebuffers(1, &id_abuffer_fbo);
+	glutil::BindFramebuffer fbo_binding(id_abuffer_fbo);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + STENCIL_ROUTED_FRAG_DATA_FRAGMENT,
+						   GL_TEXTURE_2D_MULTISAMPLE, id_fragments_tex, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+						   GL_TEXTURE_2D_MULTISAMPLE, id_stencil_tex, 0);
+
+	static const GLenum draw_buffers[] = {
+		GL_COLOR_ATTACHMENT0 + STENCIL_ROUTED_FRAG_DATA_FRAGMENT
+	};
+	glDrawBuffers(sizeof(draw_buffers) / sizeof(GLenum), draw_buffers);
+
+	GLenum fbo_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	if(fbo_status == GL_FRAMEBUFFER_COMPLETE)
+		logSuccess("FBO creation");
+	else
+		logError("FBO not complete");
+}
+
+void StencilRoutedRenderer::createLayers()
+{
+	uint width  = getWidth();
+	uint height = getHeight();
+
+	// Same textures as the depth peeling:
+	for(uint i=0 ; i < nb_layers ; i++)
+	{
+		id_depth_layers[i]  = glutil::createTextureRectDepth(width, height);
+		id_normal_layers[i] = glutil::createTextureRectRGBA8(width, height);
+	}
+	GL_CHECK();
+
+	// The layers are attached by extractLayers():
+	glGenFramebuffers(1, &id_layers_fbo);
+	glutil::BindFramebuffer fbo_binding(id_layers_fbo);
+
+	static const GLenum draw_buffers[] = {
+		GL_COLOR_ATTACHMENT0 + STENCIL_ROUTED_FRAG_DATA_NORMAL
+	};
+	glDrawBuffers(sizeof(draw_buffers) / sizeof(GLenum), draw_buffers);
+}
+
 void StencilRoutedRenderer::createPrograms()
 {
 	glutil::GPUProgram* p = NULL;
 	bool ok = false;
 
+	// --------  init_routing_program ---------
+	p = new glutil::GPUProgram("media/shaders/stencil_routing/sort_fragments.vert",
+							   "media/shaders/stencil_routing/init_routing.frag");
+
+	ok = p->compileAndAttach();
+	assert(ok);
+
+	p->bindAttribLocation(STENCIL_ROUTED_ATTRIB_POSITION, "vertex_position");
+	ok &= p->link();
+	assert(ok);
+
+	p->validate();
+
+	init_routing_program = p;
+
 	// --------  write_fragments_program ---------
 	p = new glutil::GPUProgram("media/shaders/stencil_routing/write_fragments.vert",
 							   "media/shaders/stencil_routing/write_fragments.frag");
 
-	// Here: preprocessor symbols
-
 	ok = p->compileAndAttach();
 	assert(ok);
 
-	p->bindAttribLocation(ATTRIB_POSITION, "vertex_position");
-	p->bindFragDataLocation(FRAG_DATA_COLOR, "frag_color");
+	p->bindAttribLocation(STENCIL_ROUTED_ATTRIB_POSITION,              "vertex_position");
+	p->bindAttribLocation(STENCIL_ROUTED_ATTRIB_INSTANCE_MODEL_MATRIX, "instance_model_matrix");
+	p->bindFragDataLocation(STENCIL_ROUTED_FRAG_DATA_FRAGMENT, "frag_fragment");
 	ok &= p->link();
 	assert(ok);
 
-	// Here: set uniforms' names
+	p->bindUniformBlock(UNIFORM_BLOCK_BINDING_CAMERA, "CameraBlock");
 
 	p->validate();
 
 	write_fragments_program = p;
 
-	// --------  sort_fragments_program ---------
-	p = new glutil::GPUProgram("media/shaders/stencil_routing/sort_fragments.vert",
-							   "media/shaders/stencil_routing/sort_fragments.frag");
+	// --------  extract_layer_program and sort_fragments_program ---------
+	extract_layer_program  = createSortProgram(true);
+	sort_fragments_program = createSortProgram(false);
+}
+
+glutil::GPUProgram* StencilRoutedRenderer::createSortProgram(bool extract_layer)
+{
+	stringstream ss;
+	bool ok = false;
+
+	glutil::GPUProgram* p = new glutil::GPUProgram("media/shaders/stencil_routing/sort_fragments.vert",
+												   "media/shaders/stencil_routing/sort_fragments.frag");
+
+	// Preprocessor symbols:
+	Preprocessor::SymbolList symbols;
 
-	// Here: preprocessor symbols
+	ss.str(""); ss << nb_samples << flush;
+	symbols.push_back(PreprocSym("_NB_SAMPLES_", ss.str()));
+
+	if(extract_layer)
+		symbols.push_back(PreprocSym("_EXTRACT_LAYER_"));
+
+	p->getPreprocessor()->setSymbols(symbols);
 
 	ok = p->compileAndAttach();
 	assert(ok);
 
-	p->bindAttribLocation(ATTRIB_POSITION, "vertex_position");
-	p->bindFragDataLocation(FRAG_DATA_COLOR, "frag_color");
+	p->bindAttribLocation(STENCIL_ROUTED_ATTRIB_POSITION, "vertex_position");
+
+	if(extract_layer)
+		p->bindFragDataLocation(STENCIL_ROUTED_FRAG_DATA_NORMAL, "frag_normal");
+	else
+		p->bindFragDataLocation(STENCIL_ROUTED_FRAG_DATA_COLOR, "frag_color");
+
 	ok &= p->link();
 	assert(ok);
 
-	// Here: set uniforms' names
+	p->setUniformNames("tex_fragments", "num_layer", "back_color", "layer_opacity", NULL);
 
 	p->validate();
 
-	sort_fragments_program = p;
+	return p;
+}
+
+// ---------------------------------------------------------------------
+void StencilRoutedRenderer::createQuadVBOAndVAO()
+{
+	// Create the VAO:
+	glGenVertexArrays(1, &id_quad_vao);
+
+	// Bind the VAO:
+	glutil::bindVertexArray(id_quad_vao);
+
+	// Vertex and coordinates:
+	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
+								-1.0f, -1.0f,	// triangle 1
+								+1.0f, -1.0f,
+								+1.0f, +1.0f,
+
+								-1.0f, -1.0f,	// triangle 2
+								+1.0f, +1.0f,
+								-1.0f, +1.0f
+							};
+
+	const GLsizeiptr buffer_size = sizeof(buffer_data);
+
+	// Create the buffer and put the data into it:
+	glGenBuffers(1, &id_quad_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, id_quad_vbo);
+
+	glBufferData(GL_ARRAY_BUFFER, buffer_size, (const GLvoid*)buffer_data, GL_STATIC_DRAW);
+
+	// - enable attributes:
+	glEnableVertexAttribArray(STENCIL_ROUTED_ATTRIB_POSITION);
+
+	// - vertices pointer:
+	glVertexAttribPointer(STENCIL_ROUTED_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
+
+	glutil::bindVertexArray(0);
+
+	GL_CHECK();
 }
@@ -1,19 +1,61 @@
 // StencilRoutedRenderer.h
+// Stencil-routed A-buffer (k-buffer): all the fragments of a pixel are captured in a single
+// geometry pass, in the samples of a multisample FBO, instead of re-rendering the scene once per
+// layer like the depth peeling (see DepthPeelingRenderer):
+// - writeFragments(): the stencil value of the sample i of each pixel is initialized to i+2, then
+//   the scene is rendered without multisampling (the fragments cover all the samples) and without
+//   depth test, with the stencil test GL_EQUAL 2 and GL_DECR for all the samples: each fragment
+//   is stored in the next free sample. The fragments beyond the number of samples are lost.
+//   The geometry is drawn by a RasterRenderer (see RasterRenderer::renderGeometryArray()), with
+//   its frustum culling, instancing and camera uniform block.
+// - extractLayers(): full-screen passes sort the fragments of each pixel by depth and write the
+//   nb_layers nearest ones to depth and normal layers (the same layers as the depth peeling).
+// - composite(): full-screen pass sorting the fragments and blending them from front to back.
+// MultiLayerRenderer uses renderLayers() instead of the depth peeling for the depth of its back
+// G-buffers (see USE_STENCIL_ROUTED_LAYERS in Config.h).
+// The stencil routing only needs the OpenGL 3.3 baseline and a fixed amount of memory. Per-pixel
+// linked lists (image load/store and atomic counters, OpenGL 4.2) would keep all the fragments,
+// and could be gated at runtime like glxwHasMultiDrawIndirect(), but they need a pool sized
+// for the worst depth complexity: they are not implemented.
 
 #ifndef STENCIL_ROUTED_RENDERER_H
 #define STENCIL_ROUTED_RENDERER_H
 
 #include "Renderer.h"
+#include "../Common.h"
 #include "../glutil/GPUProgram.h"
 
+class RasterRenderer;
+
 class StencilRoutedRenderer : public Renderer
 {
 private:
+	// A-buffer:
+	uint nb_samples;	// maximum number of fragments per pixel
+	GLuint id_fragments_tex;	// RGBA32F multisample: normal (xyz), depth (w)
+	GLuint id_stencil_tex;		// DEPTH24_STENCIL8 multisample: routing
+	GLuint id_abuffer_fbo;
+
+	// Layers extracted from the A-buffer:
+	GLuint* id_depth_layers;	// DEPTH_COMPONENT
+	GLuint* id_normal_layers;	// RGBA8
+	uint nb_layers;
+	GLuint id_layers_fbo;
+
+	glutil::GPUProgram* init_routing_program;
 	glutil::GPUProgram* write_fragments_program;
-	glutil::GPUProgram* sort_fragments_program;
+	glutil::GPUProgram* extract_layer_program;
+	glutil::GPUProgram* sort_fragments_program;	// compositing
+
+	// Full-screen quad:
+	GLuint id_quad_vao;
+	GLuint id_quad_vbo;
+
+	// Used for drawing the scene when this renderer is used on its own:
+	RasterRenderer* raster_renderer;
 
 public:
-	StencilRoutedRenderer(uint width, uint height);
+	StencilRoutedRenderer(uint width, uint height, const vec3& back_color, uint nb_layers);
 	virtual ~StencilRoutedRenderer();
 
 	// Called when we switch to this renderer
@@ -36,8 +78,27 @@ public:
 	// Get the renderer's name
 	virtual const char* getName() const {return "StencilRoutedRenderer";}
 
+	// Layers of the last frame, from front to back
+	uint getNbLayers() const {return nb_layers;}
+	const GLuint* getDepthLayers() const {return id_depth_layers;}
+	const GLuint* getNormalLayers() const {return id_normal_layers;}
+
+	// Render the scene to the A-buffer with the given raster renderer (whose scene is loaded)
+	// and extract the layers. If id_depth_targets != NULL, it gives for each layer the depth
+	// texture written instead of the own depth layer (0: the own depth layer is kept).
+	// The depth targets must have the same size and format as the depth layers.
+	void renderLayers(Scene* scene, RasterRenderer* geometry_renderer, const GLuint* id_depth_targets=NULL);
+
 private:
+	void writeFragments(Scene* scene, RasterRenderer* geometry_renderer);
+	void extractLayers(const GLuint* id_depth_targets);
+	void composite();
+
+	void createAbuffer();
+	void createLayers();
 	void createPrograms();
+	glutil::GPUProgram* createSortProgram(bool extract_layer);
+	void createQuadVBOAndVAO();
 };
 
 #endif // STENCIL_ROUTED_RENDERER_H
@@ -49,17 +49,17 @@ BounceMap::BounceMap(uint size)
 BounceMap::~BounceMap()
 {
 	// Delete the VBO/VAO:
-	glDeleteVertexArrays(1, &id_vao);
+	glutil::deleteVertexArrays(1, &id_vao);
 	glDeleteBuffers(1, &id_vbo);
 
 	// Decrement the reference counting of the GPU program:
 	program = NULL;
 
 	// Delete the FBO and the textures:
-	glDeleteFramebuffers(1, &id_fbo);
+	glutil::deleteFramebuffers(1, &id_fbo);
 
-	glDeleteTextures(1, &id_output0);
-	glDeleteTextures(1, &id_output1);
+	glutil::deleteTextures(1, &id_output0);
+	glutil::deleteTextures(1, &id_output1);
 
 	// Occlusion query:
 //	glDeleteQueries(1, &id_query);
@@ -91,29 +91,30 @@ void BounceMap::renderFromGBuffer(const GBuffer* gbuffer, int num_iteration)
 	program->sendUniform("tex_diffuse",   BOUNCE_MAP_TEXUNIT_DIFFUSE);
 	program->sendUniform("tex_specular",  BOUNCE_MAP_TEXUNIT_SPECULAR);
 
+	program->sendUniform("inv_proj_matrix", gbuffer->getInvProjMatrix());
 	program->sendUniform("light_color",  l->getColor());
 	program->sendUniform("light_pos_ws", l->getPosition());
 	program->sendUniform("seed_offset",  float(num_iteration));
 
 	// Bind the textures:
-	glActiveTexture(GL_TEXTURE0 + BOUNCE_MAP_TEXUNIT_POSITIONS);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexPositions());
+	glutil::activeTexture(GL_TEXTURE0 + BOUNCE_MAP_TEXUNIT_POSITIONS);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexPositions());
 
-	glActiveTexture(GL_TEXTURE0 + BOUNCE_MAP_TEXUNIT_NORMALS);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexNormals());
+	glutil::activeTexture(GL_TEXTURE0 + BOUNCE_MAP_TEXUNIT_NORMALS);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexNormals());
 
-	glActiveTexture(GL_TEXTURE0 + BOUNCE_MAP_TEXUNIT_DIFFUSE);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexDiffuse());
+	glutil::activeTexture(GL_TEXTURE0 + BOUNCE_MAP_TEXUNIT_DIFFUSE);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexDiffuse());
 
-	glActiveTexture(GL_TEXTURE0 + BOUNCE_MAP_TEXUNIT_SPECULAR);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexSpecular());
+	glutil::activeTexture(GL_TEXTURE0 + BOUNCE_MAP_TEXUNIT_SPECULAR);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexSpecular());
 
 	// Start the occlusion query:
 //	glBeginQuery(GL_SAMPLES_PASSED, id_query);
 
 	// Draw the VAO:
 	const uint nb_vertices = 6;
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 	glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
 
 	// Stop the occlusion query:
@@ -169,9 +170,11 @@ void BounceMap::createProgram()
 	bool ok = true;
 	bool is_new = false;
 
-	program = getProgramManager().getProgram(
-			GPUProgramID("media/shaders/bounce_map.vert", "media/shaders/bounce_map.frag"),
-			&is_new);
+	GPUProgramID program_id("media/shaders/bounce_map.vert", "media/shaders/bounce_map.frag");
+	if(GBuffer::isCompact())
+		program_id.preproc_sym.push_back(PreprocSym("_COMPACT_GBUFFER_"));
+
+	program = getProgramManager().getProgram(program_id, &is_new);
 
 	// If it is a new program, we should set the attrib location(s),
 	// the frag data location(s), link it and set the uniform names/get their locations.
@@ -191,6 +194,7 @@ void BounceMap::createProgram()
 
 		// - set the uniforms.
 		program->setUniformNames("tex_positions",
+								 "inv_proj_matrix",
 								 "tex_normals",
 								 "tex_diffuse",
 								 "tex_specular",
@@ -213,7 +217,7 @@ void BounceMap::createVBOAndVAO()
 	glGenVertexArrays(1, &id_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Vertex coordinates:
 	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
@@ -0,0 +1,721 @@
+// CPURaytracer.cpp
+
+#include "CPURaytracer.h"
+#include "../../utils/JobPool.h"
+#include <cassert>
+#include <cmath>
+using namespace std;
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define CPU_RAYTRACER_USE_SSE
+	#include <xmmintrin.h>
+#endif
+
+// ---------------------------------------------------------------------
+// Same values as library/screen_ray_marching.shader:
+#define CPU_RAYTRACER_MAX_DISTANCE 5.0f
+#define CPU_RAYTRACER_MIN_DISTANCE 0.1f
+#define CPU_RAYTRACER_THICKNESS    0.1f
+
+#define CPU_RAYTRACER_MAX_ITERATIONS_LINEAR       2048
+#define CPU_RAYTRACER_MAX_ITERATIONS_HIERARCHICAL 128
+
+// Number of rows of the bounce map traced by one job:
+#define CPU_RAYTRACER_ROWS_PER_JOB 8
+
+// ---------------------------------------------------------------------
+class CPURaytracer::TraceJob : public Job
+{
+private:
+	CPURaytracer* raytracer;
+	const float* bounce_map_0;
+	const float* bounce_map_1;
+	const float* light_positions;
+	uint first_row;
+	uint end_row;
+	mat4 light_to_eye_matrix;
+	mat4 eye_proj_matrix;
+	Traversal traversal;
+
+public:
+	// Statistics of the rows traced by this job:
+	uint nb_rays;
+	uint nb_hits;
+	uint64 nb_iterations;
+
+public:
+	TraceJob(CPURaytracer* raytracer,
+	         const float* bounce_map_0, const float* bounce_map_1, const float* light_positions,
+	         uint first_row, uint end_row,
+	         const mat4& light_to_eye_matrix, const mat4& eye_proj_matrix,
+	         Traversal traversal)
+	: raytracer(raytracer),
+	  bounce_map_0(bounce_map_0), bounce_map_1(bounce_map_1), light_positions(light_positions),
+	  first_row(first_row), end_row(end_row),
+	  light_to_eye_matrix(light_to_eye_matrix), eye_proj_matrix(eye_proj_matrix),
+	  traversal(traversal),
+	  nb_rays(0), nb_hits(0), nb_iterations(0)
+	{
+	}
+
+	virtual void run()
+	{
+		uint size = raytracer->bounce_map_size;
+
+		// Gather the rays to trace:
+		vector<PhotonRay> rays;
+		rays.reserve((end_row - first_row) * size);
+
+		for(uint y = first_row ; y < end_row ; y++)
+			for(uint x=0 ; x < size ; x++)
+			{
+				bool is_ray = false;
+				PhotonRay ray;
+				if(raytracer->setupPhoton(bounce_map_0, bounce_map_1, light_positions, x, y,
+				                          light_to_eye_matrix, eye_proj_matrix, &is_ray, &ray))
+					rays.push_back(ray);
+
+				nb_rays += (is_ray ? 1 : 0);
+			}
+
+		if(rays.empty())
+			return;
+
+		// Trace them and write the outputs:
+		vector<float> t_hits(rays.size());
+		vector<uint> nb_ray_iterations(rays.size());
+		raytracer->traceRays(&rays[0], rays.size(), traversal, &t_hits[0], &nb_ray_iterations[0]);
+
+		for(uint i=0 ; i < rays.size() ; i++)
+		{
+			bool is_hit = raytracer->finishPhoton(rays[i], t_hits[i], nb_ray_iterations[i]);
+			nb_hits += (is_hit ? 1 : 0);
+			nb_iterations += nb_ray_iterations[i];
+		}
+	}
+};
+
+#ifdef CPU_RAYTRACER_USE_SSE
+// ---------------------------------------------------------------------
+// Traces a stream of rays with SSE, 4 at a time (one ray per lane). When the ray of a lane is
+// finished, the lane takes the next ray of the stream, so that the lanes stay busy although
+// the rays need different numbers of iterations. The computations are vectorized, while the
+// min-max values, which depend on the cell of each lane, are fetched lane by lane. The
+// operations are the same as the ones of the scalar traversal, in the same order.
+class CPURaytracer::PacketTracer
+{
+private:
+	const CPURaytracer* raytracer;
+	Traversal traversal;
+
+	// Stream of rays:
+	const PhotonRay* rays;
+	uint nb_rays;
+	uint next_ray;
+	float* t_hits;
+	uint* nb_iterations;
+
+	// Lanes: index of the ray in the stream, and mask of the lanes with a ray
+	uint lane_rays[4];
+	int active;
+
+	// Rays of the lanes (see ScreenRay), and current position:
+	__m128 start_x, start_y;
+	__m128 delta_x, delta_y;
+	__m128 inv_dist_start, inv_dist_delta;
+	__m128 t_max;
+	__m128 step;	// LINEAR: increment of t for one pixel, HIERARCHICAL: 1/100th of a pixel
+	__m128 t;
+	uint levels[4];
+
+public:
+	PacketTracer(const CPURaytracer* raytracer, Traversal traversal,
+	             const PhotonRay* rays, uint nb_rays, float* t_hits, uint* nb_iterations);
+
+	void run();
+
+private:
+	static float& lane(__m128& v, uint i) {return ((float*)(&v))[i];}
+	static __m128 abs4(__m128 x) {return _mm_max_ps(x, _mm_sub_ps(_mm_setzero_ps(), x));}
+	static __m128 select4(__m128 mask, __m128 a, __m128 b) {return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));}
+
+	// Give the next ray of the stream to the lane i, or deactivate it
+	void loadRay(uint i);
+
+	// Write the result of the ray of the lane i, and give it the next ray
+	void finishRay(uint i, float t_hit)
+	{
+		t_hits[lane_rays[i]] = t_hit;
+		loadRay(i);
+	}
+
+	// Is the ray of the lane i finished without intersection?
+	bool isRayOver(uint i, uint max_iterations)
+	{
+		return !(lane(t, i) < lane(t_max, i)) || nb_iterations[lane_rays[i]] >= max_iterations;
+	}
+
+	__m128 getDistance(__m128 t) const
+	{
+		return _mm_div_ps(_mm_set1_ps(1.0f), _mm_add_ps(inv_dist_start, _mm_mul_ps(t, inv_dist_delta)));
+	}
+
+	// Same as CPURaytracer::findIntersection(), for the cell (cell_x[i], cell_y[i]) of the level
+	// levels[i] in the lane i. Returns the mask of the lanes with a potential intersection.
+	int findIntersection(__m128 t0, __m128 t1, const uint* cell_levels, const uint* cell_x, const uint* cell_y, __m128* t_hit) const;
+
+	void traceLinear();
+	void traceHierarchical();
+};
+
+CPURaytracer::PacketTracer::PacketTracer(const CPURaytracer* raytracer, Traversal traversal,
+                                         const PhotonRay* rays, uint nb_rays, float* t_hits, uint* nb_iterations)
+: raytracer(raytracer),
+  traversal(traversal),
+  rays(rays),
+  nb_rays(nb_rays),
+  next_ray(0),
+  t_hits(t_hits),
+  nb_iterations(nb_iterations),
+  active(0)
+{
+	// The lanes without ray keep valid values, which are ignored:
+	start_x = start_y = _mm_setzero_ps();
+	delta_x = delta_y = _mm_setzero_ps();
+	inv_dist_start = inv_dist_delta = _mm_set1_ps(1.0f);
+	t_max = step = t = _mm_setzero_ps();
+
+	for(uint i=0 ; i < 4 ; i++)
+	{
+		lane_rays[i] = 0;
+		levels[i] = 0;
+		loadRay(i);
+	}
+}
+
+void CPURaytracer::PacketTracer::run()
+{
+	if(traversal == HIERARCHICAL)
+		traceHierarchical();
+	else
+		traceLinear();
+}
+
+void CPURaytracer::PacketTracer::loadRay(uint i)
+{
+	if(next_ray == nb_rays)
+	{
+		active &= ~(1 << i);
+		levels[i] = 0;
+		return;
+	}
+
+	const PhotonRay& ray = rays[next_ray];
+	lane_rays[i] = next_ray;
+	next_ray++;
+	active |= (1 << i);
+
+	lane(start_x, i) = ray.r.start.x;
+	lane(start_y, i) = ray.r.start.y;
+	lane(delta_x, i) = ray.r.delta.x;
+	lane(delta_y, i) = ray.r.delta.y;
+	lane(inv_dist_start, i) = ray.r.inv_dist_start;
+	lane(inv_dist_delta, i) = ray.r.inv_dist_delta;
+	lane(t_max, i) = ray.t_max;
+	lane(t, i) = ray.t_min;
+
+	// Same as traceLinear() and traceHierarchical():
+	if(traversal == HIERARCHICAL)
+		lane(step, i) = 0.01f / glm::max(glm::length(ray.r.delta), 1e-6f);
+	else
+		lane(step, i) = 1.0f / glm::max(glm::max(fabsf(ray.r.delta.x), fabsf(ray.r.delta.y)), 1e-6f);
+
+	levels[i] = 0;
+	nb_iterations[lane_rays[i]] = 0;
+	t_hits[lane_rays[i]] = -1.0f;
+}
+
+int CPURaytracer::PacketTracer::findIntersection(__m128 t0, __m128 t1, const uint* cell_levels, const uint* cell_x, const uint* cell_y, __m128* t_hit) const
+{
+	__m128 d0 = getDistance(t0);
+	__m128 d1 = getDistance(t1);
+	__m128 ray_min = _mm_min_ps(d0, d1);
+	__m128 ray_max = _mm_max_ps(d0, d1);
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 thickness = _mm_set1_ps(CPU_RAYTRACER_THICKNESS);
+	__m128 non_zero_inv_dist_delta = _mm_cmpge_ps(abs4(inv_dist_delta), _mm_set1_ps(1e-9f));
+
+	__m128 found = _mm_setzero_ps();
+	*t_hit = t1;
+
+	const vector<MinMaxPyramid>& layers = raytracer->layers;
+	for(uint i=0 ; i < layers.size() ; i++)
+	{
+		const vec2& min_max_0 = layers[i].getMinMax(cell_levels[0], cell_x[0], cell_y[0]);
+		const vec2& min_max_1 = layers[i].getMinMax(cell_levels[1], cell_x[1], cell_y[1]);
+		const vec2& min_max_2 = layers[i].getMinMax(cell_levels[2], cell_x[2], cell_y[2]);
+		const vec2& min_max_3 = layers[i].getMinMax(cell_levels[3], cell_x[3], cell_y[3]);
+
+		__m128 layer_min = _mm_setr_ps(min_max_0.x, min_max_1.x, min_max_2.x, min_max_3.x);
+		__m128 layer_max = _mm_setr_ps(min_max_0.y, min_max_1.y, min_max_2.y, min_max_3.y);
+
+		// !(ray_max < layer_min || ray_min > layer_max + thickness)
+		__m128 overlap = _mm_and_ps(_mm_cmpge_ps(ray_max, layer_min),
+		                            _mm_cmple_ps(ray_min, _mm_add_ps(layer_max, thickness)));
+
+		// Where the ray crosses the closest distance of the layer:
+		__m128 t_cross = _mm_div_ps(_mm_sub_ps(_mm_div_ps(one, layer_min), inv_dist_start), inv_dist_delta);
+		t_cross = _mm_min_ps(_mm_max_ps(t_cross, t0), t1);
+		t_cross = select4(non_zero_inv_dist_delta, t_cross, t0);
+
+		*t_hit = select4(overlap, _mm_min_ps(*t_hit, t_cross), *t_hit);
+		found = _mm_or_ps(found, overlap);
+	}
+
+	return _mm_movemask_ps(found);
+}
+
+void CPURaytracer::PacketTracer::traceLinear()
+{
+	int screen_width  = int(raytracer->screen_width);
+	int screen_height = int(raytracer->screen_height);
+
+	while(active != 0)
+	{
+		__m128 t_next = _mm_min_ps(_mm_add_ps(t, step), t_max);
+
+		float pos_x[4], pos_y[4];
+		_mm_storeu_ps(pos_x, _mm_add_ps(start_x, _mm_mul_ps(t, delta_x)));
+		_mm_storeu_ps(pos_y, _mm_add_ps(start_y, _mm_mul_ps(t, delta_y)));
+
+		uint x[4], y[4];
+		for(uint i=0 ; i < 4 ; i++)
+		{
+			x[i] = uint(glm::clamp(int(pos_x[i]), 0, screen_width-1));
+			y[i] = uint(glm::clamp(int(pos_y[i]), 0, screen_height-1));
+		}
+
+		__m128 t_hit;
+		int hit = findIntersection(t, t_next, levels, x, y, &t_hit) & active;
+		int iteration_lanes = active;
+
+		t = _mm_add_ps(t, step);
+
+		for(uint i=0 ; i < 4 ; i++)
+		{
+			if(((iteration_lanes >> i) & 1) == 0)
+				continue;
+
+			nb_iterations[lane_rays[i]]++;
+
+			if((hit >> i) & 1)
+				finishRay(i, lane(t_hit, i));
+			else if(isRayOver(i, CPU_RAYTRACER_MAX_ITERATIONS_LINEAR))
+				finishRay(i, -1.0f);
+		}
+	}
+}
+
+void CPURaytracer::PacketTracer::traceHierarchical()
+{
+	const MinMaxPyramid& pyramid = raytracer->layers[0];	// all the layers have the same levels
+	uint nb_levels = pyramid.getNbLevels();
+	float screen_width  = float(raytracer->screen_width);
+	float screen_height = float(raytracer->screen_height);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 min_delta = _mm_set1_ps(1e-6f);
+
+	while(active != 0)
+	{
+		float pos_x[4], pos_y[4];
+		_mm_storeu_ps(pos_x, _mm_add_ps(start_x, _mm_mul_ps(t, delta_x)));
+		_mm_storeu_ps(pos_y, _mm_add_ps(start_y, _mm_mul_ps(t, delta_y)));
+
+		// Cell of the current level of each lane, and its bounds in pixels of the level 0:
+		uint cell_x[4], cell_y[4];
+		__m128 cell_min_x, cell_min_y, cell_max_x, cell_max_y;
+		for(uint i=0 ; i < 4 ; i++)
+		{
+			uint level = levels[i];
+			uint level_width  = pyramid.getWidth(level);
+			uint level_height = pyramid.getHeight(level);
+
+			cell_x[i] = glm::min(uint(glm::max(int(pos_x[i]), 0)) >> level, level_width-1);
+			cell_y[i] = glm::min(uint(glm::max(int(pos_y[i]), 0)) >> level, level_height-1);
+
+			lane(cell_min_x, i) = float(cell_x[i] << level);
+			lane(cell_min_y, i) = float(cell_y[i] << level);
+			lane(cell_max_x, i) = (cell_x[i] == level_width-1  ? screen_width  : float((cell_x[i]+1) << level));
+			lane(cell_max_y, i) = (cell_y[i] == level_height-1 ? screen_height : float((cell_y[i]+1) << level));
+		}
+
+		// Where the rays leave the cells:
+		__m128 exit_x = _mm_div_ps(_mm_sub_ps(select4(_mm_cmpgt_ps(delta_x, zero), cell_max_x, cell_min_x), start_x), delta_x);
+		__m128 exit_y = _mm_div_ps(_mm_sub_ps(select4(_mm_cmpgt_ps(delta_y, zero), cell_max_y, cell_min_y), start_y), delta_y);
+
+		__m128 t_exit = t_max;
+		t_exit = select4(_mm_cmpge_ps(abs4(delta_x), min_delta), _mm_min_ps(t_exit, exit_x), t_exit);
+		t_exit = select4(_mm_cmpge_ps(abs4(delta_y), min_delta), _mm_min_ps(t_exit, exit_y), t_exit);
+
+		__m128 t_hit;
+		int hit = findIntersection(t, t_exit, levels, cell_x, cell_y, &t_hit) & active;
+		int iteration_lanes = active;
+
+		__m128 t_next = _mm_add_ps(t_exit, step);
+
+		for(uint i=0 ; i < 4 ; i++)
+		{
+			if(((iteration_lanes >> i) & 1) == 0)
+				continue;
+
+			nb_iterations[lane_rays[i]]++;
+
+			if((hit >> i) & 1)
+			{
+				// Potential intersection: this is a hit at the level 0, otherwise descend
+				if(levels[i] == 0)
+				{
+					finishRay(i, lane(t_hit, i));
+					continue;
+				}
+				levels[i]--;
+			}
+			else
+			{
+				// Empty space: skip the cell and ascend
+				lane(t, i) = lane(t_next, i);
+				levels[i] = glm::min(levels[i]+1, nb_levels-1);
+			}
+
+			if(isRayOver(i, CPU_RAYTRACER_MAX_ITERATIONS_HIERARCHICAL))
+				finishRay(i, -1.0f);
+		}
+	}
+}
+#endif // CPU_RAYTRACER_USE_SSE
+
+// ---------------------------------------------------------------------
+CPURaytracer::CPURaytracer(uint screen_width, uint screen_height)
+: screen_width(screen_width),
+  screen_height(screen_height),
+  layers(),
+  bounce_map_size(0),
+  output0(),
+  output1(),
+  nb_rays(0),
+  nb_hits(0),
+  nb_iterations(0)
+{
+}
+
+CPURaytracer::~CPURaytracer()
+{
+}
+
+// ---------------------------------------------------------------------
+void CPURaytracer::setDepthLayers(const float* const* depth_layers, uint nb_layers, const mat4& eye_inv_proj)
+{
+	layers.resize(nb_layers);
+	for(uint i=0 ; i < nb_layers ; i++)
+		layers[i].buildFromDepth(depth_layers[i], screen_width, screen_height, eye_inv_proj);
+}
+
+void CPURaytracer::run(const float* bounce_map_0,
+                       const float* bounce_map_1,
+                       const float* light_positions,
+                       uint bounce_map_size,
+                       const mat4& light_to_eye_matrix,
+                       const mat4& eye_proj_matrix,
+                       Traversal traversal)
+{
+	assert(!layers.empty());
+
+	this->bounce_map_size = bounce_map_size;
+	output0.resize(bounce_map_size*bounce_map_size);
+	output1.resize(bounce_map_size*bounce_map_size);
+
+	// Trace the bands of rows in parallel:
+	vector<TraceJob*> jobs;
+	for(uint y=0 ; y < bounce_map_size ; y += CPU_RAYTRACER_ROWS_PER_JOB)
+	{
+		uint end_row = glm::min(y + CPU_RAYTRACER_ROWS_PER_JOB, bounce_map_size);
+		TraceJob* job = new TraceJob(this, bounce_map_0, bounce_map_1, light_positions, y, end_row,
+		                             light_to_eye_matrix, eye_proj_matrix, traversal);
+		jobs.push_back(job);
+		getJobPool().push(job);
+	}
+
+	getJobPool().wait();
+
+	// Gather the statistics:
+	nb_rays = 0;
+	nb_hits = 0;
+	nb_iterations = 0;
+
+	for(uint i=0 ; i < jobs.size() ; i++)
+	{
+		nb_rays += jobs[i]->nb_rays;
+		nb_hits += jobs[i]->nb_hits;
+		nb_iterations += jobs[i]->nb_iterations;
+		delete jobs[i];
+	}
+}
+
+// ---------------------------------------------------------------------
+bool CPURaytracer::setupPhoton(const float* bounce_map_0,
+                               const float* bounce_map_1,
+                               const float* light_positions,
+                               uint x, uint y,
+                               const mat4& light_to_eye_matrix,
+                               const mat4& eye_proj_matrix,
+                               bool* is_ray, PhotonRay* ray)
+{
+	uint index = y*bounce_map_size + x;
+	vec4& out0 = output0[index];
+	vec4& out1 = output1[index];
+
+	*is_ray = false;
+
+	// Read the photon power. If the power is 0, "discard" this ray.
+	vec3 power_i(bounce_map_0[4*index+0], bounce_map_0[4*index+1], bounce_map_0[4*index+2]);
+	if(glm::dot(power_i, power_i) < 0.01f)
+	{
+		out0 = vec4(0.0f);
+		out1 = vec4(0.0f);
+		return false;
+	}
+
+	*is_ray = true;
+
+	// Position and direction in eye space:
+	vec3 light_space_dir(bounce_map_1[4*index+0], bounce_map_1[4*index+1], bounce_map_1[4*index+2]);
+	vec3 light_space_pos(light_positions[4*index+0], light_positions[4*index+1], light_positions[4*index+2]);
+
+	vec3 eye_space_pos = vec3(light_to_eye_matrix * vec4(light_space_pos, 1.0f));
+	vec3 eye_space_dir = mat3(light_to_eye_matrix) * light_space_dir;
+
+	vec3 first_vertex_pos  = eye_space_pos + CPU_RAYTRACER_MIN_DISTANCE * eye_space_dir;
+	vec3 second_vertex_pos = eye_space_pos + CPU_RAYTRACER_MAX_DISTANCE * eye_space_dir;
+
+	vec4 first_vertex_proj_pos  = eye_proj_matrix * vec4(first_vertex_pos,  1.0f);
+	vec4 second_vertex_proj_pos = eye_proj_matrix * vec4(second_vertex_pos, 1.0f);
+
+	// Default: no intersection
+	out0 = vec4(eye_space_pos, 0.0f);
+	out1 = vec4(second_vertex_pos, 0.0f);
+
+	// Clip the ray against the near plane (z >= -w):
+	float d_first  = first_vertex_proj_pos.z  + first_vertex_proj_pos.w;
+	float d_second = second_vertex_proj_pos.z + second_vertex_proj_pos.w;
+
+	if(d_first < 0.0f && d_second < 0.0f)
+		return false;
+
+	if(d_first < 0.0f)
+	{
+		float s = d_first / (d_first - d_second);
+		first_vertex_pos      = glm::mix(first_vertex_pos,      second_vertex_pos,      s);
+		first_vertex_proj_pos = glm::mix(first_vertex_proj_pos, second_vertex_proj_pos, s);
+	}
+	else if(d_second < 0.0f)
+	{
+		float s = d_first / (d_first - d_second);
+		second_vertex_pos      = glm::mix(first_vertex_pos,      second_vertex_pos,      s);
+		second_vertex_proj_pos = glm::mix(first_vertex_proj_pos, second_vertex_proj_pos, s);
+	}
+
+	// Screen-space ray:
+	vec2 screen_size = vec2(float(screen_width), float(screen_height));
+
+	vec2 first_vertex_win  = (0.5f*vec2(first_vertex_proj_pos)  / first_vertex_proj_pos.w  + vec2(0.5f)) * screen_size;
+	vec2 second_vertex_win = (0.5f*vec2(second_vertex_proj_pos) / second_vertex_proj_pos.w + vec2(0.5f)) * screen_size;
+
+	ScreenRay r;
+	r.start = first_vertex_win;
+	r.delta = second_vertex_win - first_vertex_win;
+	r.inv_dist_start = 1.0f / first_vertex_proj_pos.w;
+	r.inv_dist_delta = 1.0f / second_vertex_proj_pos.w - r.inv_dist_start;
+
+	// Part of the ray to trace:
+	ray->t_min = 0.0f;
+	ray->t_max = 1.0f;
+	if(!clipRayToScreen(r, &ray->t_min, &ray->t_max))
+		return false;
+
+	ray->index = index;
+	ray->first_vertex_pos  = first_vertex_pos;
+	ray->second_vertex_pos = second_vertex_pos;
+	ray->first_vertex_w  = first_vertex_proj_pos.w;
+	ray->second_vertex_w = second_vertex_proj_pos.w;
+	ray->r = r;
+	return true;
+}
+
+void CPURaytracer::traceRays(const PhotonRay* rays, uint nb_rays, Traversal traversal, float* t_hits, uint* nb_iterations) const
+{
+#ifdef CPU_RAYTRACER_USE_SSE
+	PacketTracer tracer(this, traversal, rays, nb_rays, t_hits, nb_iterations);
+	tracer.run();
+#else
+	for(uint i=0 ; i < nb_rays ; i++)
+	{
+		if(traversal == HIERARCHICAL)
+			t_hits[i] = traceHierarchical(rays[i].r, rays[i].t_min, rays[i].t_max, &nb_iterations[i]);
+		else
+			t_hits[i] = traceLinear(rays[i].r, rays[i].t_min, rays[i].t_max, &nb_iterations[i]);
+	}
+#endif
+}
+
+bool CPURaytracer::finishPhoton(const PhotonRay& ray, float t_hit, uint nb_iterations)
+{
+	vec4& out0 = output0[ray.index];
+	vec4& out1 = output1[ray.index];
+
+	out0.w = float(nb_iterations);
+
+	// Eye-space position of the intersection (perspective-correct interpolation):
+	if(t_hit < 0.0f)
+		return false;
+
+	vec3 hit_pos = glm::mix(ray.first_vertex_pos  / ray.first_vertex_w,
+	                        ray.second_vertex_pos / ray.second_vertex_w,
+	                        t_hit) / (ray.r.inv_dist_start + t_hit*ray.r.inv_dist_delta);
+	out1 = vec4(hit_pos, 1.0f);
+	return true;
+}
+
+// ---------------------------------------------------------------------
+bool CPURaytracer::clipRayToScreen(const ScreenRay& r, float* t_min, float* t_max) const
+{
+	vec2 screen_size = vec2(float(screen_width), float(screen_height));
+
+	for(uint i=0 ; i < 2 ; i++)
+	{
+		if(fabsf(r.delta[i]) < 1e-6f)
+		{
+			if(r.start[i] < 0.0f || r.start[i] > screen_size[i])
+				return false;
+		}
+		else
+		{
+			float t0 = (0.0f - r.start[i]) / r.delta[i];
+			float t1 = (screen_size[i] - r.start[i]) / r.delta[i];
+			*t_min = glm::max(*t_min, glm::min(t0, t1));
+			*t_max = glm::min(*t_max, glm::max(t0, t1));
+		}
+	}
+	return *t_min < *t_max;
+}
+
+bool CPURaytracer::findIntersection(const ScreenRay& r, float t0, float t1, uint level, uint x, uint y, float* t_hit) const
+{
+	float d0 = r.getDistance(t0);
+	float d1 = r.getDistance(t1);
+	float ray_min = glm::min(d0, d1);
+	float ray_max = glm::max(d0, d1);
+
+	bool found = false;
+	*t_hit = t1;
+
+	for(uint i=0 ; i < layers.size() ; i++)
+	{
+		const vec2& min_max = layers[i].getMinMax(level, x, y);
+		if(ray_max < min_max.x || ray_min > min_max.y + CPU_RAYTRACER_THICKNESS)
+			continue;
+
+		// Where the ray crosses the closest distance of the layer:
+		float t = t0;
+		if(fabsf(r.inv_dist_delta) >= 1e-9f)
+			t = glm::clamp((1.0f/min_max.x - r.inv_dist_start) / r.inv_dist_delta, t0, t1);
+
+		*t_hit = glm::min(*t_hit, t);
+		found = true;
+	}
+
+	return found;
+}
+
+// ---------------------------------------------------------------------
+float CPURaytracer::traceLinear(const ScreenRay& r, float t_min, float t_max, uint* nb_iterations) const
+{
+	// ray_inc: by how much we need to increment t to do one step
+	// => the greater of dx and dy is equal to 1 pixel
+	float ray_inc = 1.0f / glm::max(glm::max(fabsf(r.delta.x), fabsf(r.delta.y)), 1e-6f);
+
+	*nb_iterations = 0;
+	for(float t = t_min ; t < t_max && *nb_iterations < CPU_RAYTRACER_MAX_ITERATIONS_LINEAR ; t += ray_inc)
+	{
+		(*nb_iterations)++;
+
+		float t_next = glm::min(t + ray_inc, t_max);
+		vec2 pos = r.start + t*r.delta;
+		uint x = uint(glm::clamp(int(pos.x), 0, int(screen_width)-1));
+		uint y = uint(glm::clamp(int(pos.y), 0, int(screen_height)-1));
+
+		float t_hit = 0.0f;
+		if(findIntersection(r, t, t_next, 0, x, y, &t_hit))
+			return t_hit;
+	}
+
+	return -1.0f;
+}
+
+float CPURaytracer::traceHierarchical(const ScreenRay& r, float t_min, float t_max, uint* nb_iterations) const
+{
+	const MinMaxPyramid& pyramid = layers[0];	// all the layers have the same levels
+	uint nb_levels = pyramid.getNbLevels();
+	float t_eps = 0.01f / glm::max(glm::length(r.delta), 1e-6f);	// 1/100th of a pixel
+
+	uint level = 0;
+	float t = t_min;
+
+	*nb_iterations = 0;
+	while(t < t_max && *nb_iterations < CPU_RAYTRACER_MAX_ITERATIONS_HIERARCHICAL)
+	{
+		(*nb_iterations)++;
+
+		// Cell of the current level containing the current position:
+		uint level_width  = pyramid.getWidth(level);
+		uint level_height = pyramid.getHeight(level);
+
+		vec2 pos = r.start + t*r.delta;
+		uint cell_x = glm::min(uint(glm::max(int(pos.x), 0)) >> level, level_width-1);
+		uint cell_y = glm::min(uint(glm::max(int(pos.y), 0)) >> level, level_height-1);
+
+		// Bounds of the cell, in pixels of the level 0 (the last cells also cover the extra
+		// columns/rows of the finer levels):
+		vec2 cell_min(float(cell_x << level), float(cell_y << level));
+		vec2 cell_max(float((cell_x+1) << level), float((cell_y+1) << level));
+		if(cell_x == level_width-1)
+			cell_max.x = float(screen_width);
+		if(cell_y == level_height-1)
+			cell_max.y = float(screen_height);
+
+		// Where the ray leaves the cell:
+		float t_exit = t_max;
+		if(fabsf(r.delta.x) >= 1e-6f)
+			t_exit = glm::min(t_exit, ((r.delta.x > 0.0f ? cell_max.x : cell_min.x) - r.start.x) / r.delta.x);
+		if(fabsf(r.delta.y) >= 1e-6f)
+			t_exit = glm::min(t_exit, ((r.delta.y > 0.0f ? cell_max.y : cell_min.y) - r.start.y) / r.delta.y);
+
+		float t_hit = 0.0f;
+		if(findIntersection(r, t, t_exit, level, cell_x, cell_y, &t_hit))
+		{
+			// Potential intersection: this is a hit at the level 0, otherwise descend
+			if(level == 0)
+				return t_hit;
+			level--;
+		}
+		else
+		{
+			// Empty space: skip the cell and ascend
+			t = t_exit + t_eps;
+			level = glm::min(level+1, nb_levels-1);
+		}
+	}
+
+	return -1.0f;
+}
@@ -0,0 +1,137 @@
+// CPURaytracer.h
+// CPU reference of the screen-space tracing of the photons done by PhotonsMap (see ray_marching.frag),
+// for validating the GPU version and comparing the traversal algorithms on machines without a GPU.
+// - the inputs are float arrays, row after row, like the textures read back with glGetTexImage():
+//   the 2 RGBA textures of the bounce map, the positions of the light's G-buffer (RGBA, light
+//   space) and the depth layers of the screen (depth buffer values in [0, 1], e.g. from depth peeling)
+// - a min-max pyramid (see MinMaxPyramid) is built for each depth layer, and a ray hits a layer
+//   where it passes behind it by less than the thickness of the surfaces. With only one layer,
+//   the results are the same as the ones of ray_marching.frag.
+// - the outputs have the layout of the outputs of PhotonsMap
+// - the bounce map is divided into bands of rows which are traced in parallel by the JobPool
+// - with SSE, the rays of a band are traced 4 at a time (see PacketTracer), with the same results
+//   as the scalar traversal
+
+#ifndef CPU_RAYTRACER_H
+#define CPU_RAYTRACER_H
+
+#include "../../Common.h"
+#include "MinMaxMipmaps.h"
+#include <vector>
+
+class CPURaytracer
+{
+public:
+	enum Traversal
+	{
+		LINEAR,			// linear DDA over the pixels of the depth layers
+		HIERARCHICAL,	// hierarchical traversal of the min-max pyramids
+	};
+
+	class TraceJob;
+	class PacketTracer;
+
+private:
+	uint screen_width;
+	uint screen_height;
+
+	std::vector<MinMaxPyramid> layers;
+
+	// Outputs of the last call to run():
+	uint bounce_map_size;
+	std::vector<vec4> output0;	// eye-space position of the photon (xyz), number of iterations (w)
+	std::vector<vec4> output1;	// eye-space position of the intersection (xyz) and 1 (w), or the end of the ray and 0
+
+	// Statistics of the last call to run():
+	uint nb_rays;		// number of photons with a non-null power
+	uint nb_hits;
+	uint64 nb_iterations;
+
+public:
+	CPURaytracer(uint screen_width, uint screen_height);
+	virtual ~CPURaytracer();
+
+	// depth_layers: nb_layers arrays of screen_width*screen_height depth values, rendered with the
+	// projection whose inverse is eye_inv_proj
+	void setDepthLayers(const float* const* depth_layers, uint nb_layers, const mat4& eye_inv_proj);
+
+	// bounce_map_0, bounce_map_1, light_positions: RGBA textures of bounce_map_size² texels
+	void run(const float* bounce_map_0,
+	         const float* bounce_map_1,
+	         const float* light_positions,
+	         uint bounce_map_size,
+	         const mat4& light_to_eye_matrix,
+	         const mat4& eye_proj_matrix,
+	         Traversal traversal);
+
+	// Getters:
+	uint getScreenWidth()  const {return screen_width;}
+	uint getScreenHeight() const {return screen_height;}
+	uint getNbLayers()     const {return layers.size();}
+
+	uint getBounceMapSize() const {return bounce_map_size;}
+	const vec4* getOutput0() const {return (output0.empty() ? NULL : &output0[0]);}
+	const vec4* getOutput1() const {return (output1.empty() ? NULL : &output1[0]);}
+
+	uint getNbRays() const          {return nb_rays;}
+	uint getNbHits() const          {return nb_hits;}
+	uint64 getNbIterations() const  {return nb_iterations;}
+
+private:
+	// Ray in screen space (see ScreenRay in library/screen_ray_marching.shader)
+	struct ScreenRay
+	{
+		vec2 start;
+		vec2 delta;
+		float inv_dist_start;
+		float inv_dist_delta;
+
+		float getDistance(float t) const {return 1.0f / (inv_dist_start + t*inv_dist_delta);}
+	};
+
+	// Ray of a photon, in eye space and in screen space
+	struct PhotonRay
+	{
+		uint index;		// texel of the bounce map
+		vec3 first_vertex_pos;
+		vec3 second_vertex_pos;
+		float first_vertex_w;
+		float second_vertex_w;
+
+		ScreenRay r;
+		float t_min;
+		float t_max;
+	};
+
+	bool clipRayToScreen(const ScreenRay& r, float* t_min, float* t_max) const;
+
+	// Can the part of the ray between t0 and t1 intersect the surfaces of the cell (x, y) of the
+	// given level, in one of the layers? If so, *t_hit is where it crosses the closest one.
+	bool findIntersection(const ScreenRay& r, float t0, float t1, uint level, uint x, uint y, float* t_hit) const;
+
+	// Trace a ray between t_min and t_max: returns the t of the first intersection, or -1.0f
+	float traceLinear(const ScreenRay& r, float t_min, float t_max, uint* nb_iterations) const;
+	float traceHierarchical(const ScreenRay& r, float t_min, float t_max, uint* nb_iterations) const;
+
+	// Read the photon of the texel (x, y) of the bounce map and write the outputs of a ray without
+	// intersection. Returns true if the ray has to be traced, in *ray.
+	bool setupPhoton(const float* bounce_map_0,
+	                 const float* bounce_map_1,
+	                 const float* light_positions,
+	                 uint x, uint y,
+	                 const mat4& light_to_eye_matrix,
+	                 const mat4& eye_proj_matrix,
+	                 bool* is_ray, PhotonRay* ray);
+
+	// Trace the rays: t_hits[i] receives the t of the first intersection of rays[i], or -1.0f.
+	// Uses SSE when available.
+	void traceRays(const PhotonRay* rays, uint nb_rays, Traversal traversal, float* t_hits, uint* nb_iterations) const;
+
+	// Write the outputs of a traced ray. Returns true if it hits a surface.
+	bool finishPhoton(const PhotonRay& ray, float t_hit, uint nb_iterations);
+
+	friend class TraceJob;
+	friend class PacketTracer;
+};
+
+#endif // CPU_RAYTRACER_H
@@ -3,12 +3,14 @@
 #include "GBuffer.h"
 
 #include "../RasterRenderer.h"
+#include "../../scene/Scene.h"
 #include "../../scene/Camera.h"
 #include "../../scene/Light.h"
 #include "../../scene/ArrayElementContainer.h"
 #include "../../scene/MeshObject.h"
 #include "../../scene/Geometry.h"
 #include "../../scene/Material.h"
+#include "../../Config.h"
 #include "../../log/Log.h"
 #include "../../glutil/glutil.h"
 #include <cassert>
@@ -24,7 +26,8 @@ GBuffer::GBuffer(uint width, uint height, bool use_visibility_maps)
   id_diffuse(0),
   id_specular(0),
   id_depth(0),
-  id_visibility(0)
+  id_visibility(0),
+  inv_proj_matrix(1.0)
 {
 	// Check the texture's size
 #ifndef NDEBUG
@@ -36,10 +39,19 @@ GBuffer::GBuffer(uint width, uint height, bool use_visibility_maps)
 #endif
 
 	// Setup the textures:
-	id_position = glutil::createTextureRectRGBAF(width, height, true);
-	id_normal   = glutil::createTextureRectRGBAF(width, height, true);
-	id_diffuse  = glutil::createTextureRectRGBAF(width, height, true);
-	id_specular = glutil::createTextureRectRGBAF(width, height, true);
+	if(isCompact())
+	{
+		id_normal   = glutil::createTextureRectRG16(width, height);
+		id_diffuse  = glutil::createTextureRectRGBA8(width, height);
+		id_specular = glutil::createTextureRectRGBA8(width, height);
+	}
+	else
+	{
+		id_position = glutil::createTextureRectRGBAF(width, height, true);
+		id_normal   = glutil::createTextureRectRGBAF(width, height, true);
+		id_diffuse  = glutil::createTextureRectRGBAF(width, height, true);
+		id_specular = glutil::createTextureRectRGBAF(width, height, true);
+	}
 	id_depth = glutil::createTextureRectDepth(width, height);
 
 	if(use_visibility_maps)
@@ -52,7 +64,8 @@ GBuffer::GBuffer(uint width, uint height, bool use_visibility_maps)
 	glutil::BindFramebuffer fbo_binding(id_fbo);
 
 	// - attach the textures:
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_RECTANGLE, id_position, 0);
+	if(id_position != 0)
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_RECTANGLE, id_position, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_RECTANGLE, id_normal,   0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_RECTANGLE, id_diffuse,  0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_RECTANGLE, id_specular, 0);
@@ -63,28 +76,20 @@ GBuffer::GBuffer(uint width, uint height, bool use_visibility_maps)
 
 	GL_CHECK();
 
-	// - specify the draw buffers :
-	if(use_visibility_maps)
-	{
-		static const GLenum draw_buffers[] = {
-			GL_COLOR_ATTACHMENT0,
-			GL_COLOR_ATTACHMENT1,
-			GL_COLOR_ATTACHMENT2,
-			GL_COLOR_ATTACHMENT3,
-			GL_COLOR_ATTACHMENT4,
-		};
-		glDrawBuffers(sizeof(draw_buffers) / sizeof(GLenum), draw_buffers);
-	}
-	else
-	{
-		static const GLenum draw_buffers[] = {
-			GL_COLOR_ATTACHMENT0,
-			GL_COLOR_ATTACHMENT1,
-			GL_COLOR_ATTACHMENT2,
-			GL_COLOR_ATTACHMENT3,
-		};
-		glDrawBuffers(sizeof(draw_buffers) / sizeof(GLenum), draw_buffers);
-	}
+	// - specify the draw buffers (the fragment data locations are the same in both layouts,
+	// there is just nothing at the location of the positions in the compact layout):
+	GLenum draw_buffers[] = {
+		GL_COLOR_ATTACHMENT0,
+		GL_COLOR_ATTACHMENT1,
+		GL_COLOR_ATTACHMENT2,
+		GL_COLOR_ATTACHMENT3,
+		GL_COLOR_ATTACHMENT4,
+	};
+
+	if(id_position == 0)
+		draw_buffers[0] = GL_NONE;
+
+	glDrawBuffers(use_visibility_maps ? 5 : 4, draw_buffers);
 
 	// Check the FBO:
 	GLenum fbo_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -98,23 +103,31 @@ GBuffer::GBuffer(uint width, uint height, bool use_visibility_maps)
 // ---------------------------------------------------------------------
 GBuffer::~GBuffer()
 {
-	glDeleteFramebuffers(1, &id_fbo);
+	glutil::deleteFramebuffers(1, &id_fbo);
 
-	glDeleteTextures(1, &id_position);
-	glDeleteTextures(1, &id_normal);
-	glDeleteTextures(1, &id_specular);
-	glDeleteTextures(1, &id_diffuse);
-	glDeleteTextures(1, &id_depth);
+	if(id_position != 0)
+		glutil::deleteTextures(1, &id_position);
+	glutil::deleteTextures(1, &id_normal);
+	glutil::deleteTextures(1, &id_specular);
+	glutil::deleteTextures(1, &id_diffuse);
+	glutil::deleteTextures(1, &id_depth);
 
 	if(use_visibility_maps)
-		glDeleteTextures(1, &id_visibility);
+		glutil::deleteTextures(1, &id_visibility);
+}
+
+// ---------------------------------------------------------------------
+bool GBuffer::isCompact()
+{
+	return USE_COMPACT_GBUFFER;
 }
 
 // ---------------------------------------------------------------------
 void GBuffer::render(Scene* scene,
 					 RasterRenderer* raster_renderer,
 					 TextureBinding* added_tex_bindings,
-					 uint nb_added_tex_bindings)
+					 uint nb_added_tex_bindings,
+					 bool use_depth_layer)
 {
 	// Bind the FBO:
 	glutil::BindFramebuffer fbo_binding(id_fbo);
@@ -122,7 +135,9 @@ void GBuffer::render(Scene* scene,
 	// Enable the depth test:
 	glutil::Enable<GL_DEPTH_TEST> depth_test_state;
 
-	raster_renderer->renderArrayExt(scene, vec3(0.0), NULL, added_tex_bindings, nb_added_tex_bindings);
+	raster_renderer->renderArrayExt(scene, vec3(0.0), NULL, added_tex_bindings, nb_added_tex_bindings, use_depth_layer);
+
+	inv_proj_matrix = glm::inverse(scene->getCamera()->computeProjectionMatrix());
 }
 
 void GBuffer::renderFromLight(const Light* light,
@@ -138,4 +153,6 @@ void GBuffer::renderFromLight(const Light* light,
 	glutil::Enable<GL_DEPTH_TEST> depth_test_state;
 
 	raster_renderer->renderArrayExt(scene, vec3(0.0), light, added_tex_bindings, nb_added_tex_bindings);
+
+	inv_proj_matrix = glm::inverse(light->computeProjectionMatrix());
 }
@@ -1,4 +1,11 @@
 // GBuffer.h
+// G-buffer, in one of 2 layouts (see USE_COMPACT_GBUFFER in Config.h):
+// - default: positions, normals, diffuse and specular in RGBA16F textures
+// - compact: no positions texture (the positions are reconstructed from the depth and the
+//   inverse of the projection matrix), octahedral-encoded normals in RG16, diffuse and
+//   specular in RGBA8 (16 bytes per pixel with the depth, instead of 36)
+// The programs writing or reading the G-buffers must be compiled with the _COMPACT_GBUFFER_
+// symbol in the compact layout, and read them with media/shaders/library/gbuffer.shader.
 
 #ifndef GBUFFER_H
 #define GBUFFER_H
@@ -21,25 +28,33 @@ private:
 
 	GLuint id_fbo;
 
-	GLuint id_position;		// RGBA16F: x   y   z   free
-	GLuint id_normal;		// RGBA16F: nx  ny  nz  free
-	GLuint id_diffuse;		// RGBA16F: dr  dg  db  alpha
-	GLuint id_specular;		// RGBA16F: sr  sg  sb  exponent
+	GLuint id_position;		// RGBA16F: x   y   z   free		(compact: none)
+	GLuint id_normal;		// RGBA16F: nx  ny  nz  free		(compact: RG16, encoded normal)
+	GLuint id_diffuse;		// RGBA16F: dr  dg  db  alpha		(compact: RGBA8)
+	GLuint id_specular;		// RGBA16F: sr  sg  sb  exponent	(compact: RGBA8, encoded exponent)
 	GLuint id_depth;		// DEPTH_COMPONENT
 
 	GLuint id_visibility;	// RGBA8: visibility for the light i is indicated in the ith component.
 							// Only used when shadow mapping is enabled.
 
+	mat4 inv_proj_matrix;	// inverse of the projection matrix of the last rendering
+
 public:
 	GBuffer(uint width, uint height, bool use_visibility_maps);
 	virtual ~GBuffer();
 
 	virtual Type getType() const {return GBUFFER;}
 
+	// Do the G-buffers use the compact layout?
+	static bool isCompact();
+
+	// use_depth_layer: the depth texture already contains the depth of the fragments to render
+	// (see RasterRenderer::renderArrayExt())
 	void render(Scene* scene,
 				RasterRenderer* raster_renderer,
 				TextureBinding* added_tex_bindings=NULL,
-				uint nb_added_tex_bindings=0);
+				uint nb_added_tex_bindings=0,
+				bool use_depth_layer=false);
 	void renderFromLight(const Light* light,
 						 Scene* scene,
 						 RasterRenderer* raster_renderer,
@@ -50,12 +65,17 @@ public:
 	inline uint getHeight() const {return height;}
 
 	inline GLuint getFBO()           const {return id_fbo;}
-	inline GLuint getTexPositions()  const {return id_position;}
+	// NB: in the compact layout, the positions are read from the depth texture
+	inline GLuint getTexPositions()  const {return (id_position != 0 ? id_position : id_depth);}
 	inline GLuint getTexNormals()    const {return id_normal;}
 	inline GLuint getTexDiffuse()    const {return id_diffuse;}
 	inline GLuint getTexSpecular()   const {return id_specular;}
 	inline GLuint getTexDepth()      const {return id_depth;}
 	inline GLuint getTexVisibility() const {return id_visibility;}
+
+	// Inverse of the projection matrix used for rendering the G-buffer, used for reconstructing
+	// the positions in the compact layout
+	inline const mat4& getInvProjMatrix() const {return inv_proj_matrix;}
 };
 
 #endif // GBUFFER_H
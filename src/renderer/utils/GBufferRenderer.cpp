@@ -4,14 +4,13 @@
 #include "../../CommonIndices.h"
 #include "../../Boundaries.h"
 #include "../../utils/StdListManip.h"
-#include "../../scene/Camera.h"
 #include "../../scene/Light.h"
 #include "../../glutil/RAII.h"
 #include "GBufferRenderer.h"
 #include "GBuffer.h"
 #include "ShadowMap.h"
+#include "UniformBlocks.h"
 #include <string>
-#include <sstream>
 using namespace std;
 
 // Locations for the render_from_gbuffer program:
@@ -57,21 +56,19 @@ void GBufferRenderer::unload()
 	id_vbo = 0;
 
 	assert(id_vao != 0);
-	glDeleteVertexArrays(1, &id_vao);
+	glutil::deleteVertexArrays(1, &id_vao);
 	id_vao = 0;
 }
 
 // ---------------------------------------------------------------------
 // Binds stuff, and lets the user know which one is the first texunit he can use.
 void GBufferRenderer::bind(GBuffer* gbuffer,
-						   Camera* camera,
 						   Light** lights,
 						   uint nb_lights,
 						   bool bind_shadow_maps,
 						   const vec3& back_color,
 						   uint* first_valid_texunit)
 {
-	stringstream ss;
 	uint texunit = 0;
 
 	// Start using the program:
@@ -83,99 +80,40 @@ void GBufferRenderer::bind(GBuffer* gbuffer,
 	// Bind the textures of the GBuffer to the texunits and send
 	// the corresponding uniforms:
 	// - positions:
-	glActiveTexture(GL_TEXTURE0 + texunit);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexPositions());
+	glutil::activeTexture(GL_TEXTURE0 + texunit);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexPositions());
 	program->sendUniform("tex_positions", GLint(texunit));
+	program->sendUniform("gbuffer_inv_proj", gbuffer->getInvProjMatrix());
 	texunit++;
 
 	// - normals:
-	glActiveTexture(GL_TEXTURE0 + texunit);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexNormals());
+	glutil::activeTexture(GL_TEXTURE0 + texunit);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexNormals());
 	program->sendUniform("tex_normals",   GLint(texunit));
 	texunit++;
 
 	// - diffuse:
-	glActiveTexture(GL_TEXTURE0 + texunit);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexDiffuse());
+	glutil::activeTexture(GL_TEXTURE0 + texunit);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexDiffuse());
 	program->sendUniform("tex_diffuse",   GLint(texunit));
 	texunit++;
 
 	// - specular:
-	glActiveTexture(GL_TEXTURE0 + texunit);
-	glBindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexSpecular());
+	glutil::activeTexture(GL_TEXTURE0 + texunit);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffer->getTexSpecular());
 	program->sendUniform("tex_specular",  GLint(texunit));
 	texunit++;
 
-	// Bias matrix, used for shadow mapping. Lets us switch from the range [-1, 1] to [0, 1]
-	// (0.5*x + 0.5)
-	mat4 bias_matrix = mat4(vec4(0.5, 0.0, 0.0, 0.0),
-							vec4(0.0, 0.5, 0.0, 0.0),
-							vec4(0.0, 0.0, 0.5, 0.0),
-							vec4(0.5, 0.5, 0.5, 1.0));
-
-	// Compute the view matrix:
-	mat4 view_matrix = camera->computeViewMatrix();
-
-	// Inverse the view matrix (for shadows):
-	mat4 inv_view_matrix = glm::inverse(view_matrix);
-
-
-	// For each light:
-	for(uint i=0 ; i < nb_lights ; i++)
+	// Bind the shadow atlas, which contains the shadow maps of all the lights
+	// NB: the positions, colors, shadow matrices and shadow atlas regions of the lights are in
+	// the lights uniform block, and the view matrix in the camera uniform block
+	// (see UniformBlocks::update()). The shadow comparison is set up when creating the atlas.
+	if(bind_shadow_maps && nb_lights != 0)
 	{
-		Light* l = lights[i];
-
-		// Compute the light position in eye space and send it as a uniform:
-		vec3 eye_space_light_pos = vec3(view_matrix * vec4(l->getPosition(), 1.0f));
-
-		ss.str("");
-		ss << "eye_space_light_pos_" << i << flush;
-		program->sendUniform(ss.str().c_str(), eye_space_light_pos, Hash::AT_RUNTIME);
-
-		ss.str("");
-		ss << "light_color_" << i << flush;
-		program->sendUniform(ss.str().c_str(), l->getColor(), Hash::AT_RUNTIME);
-
-		// Shadow mapping without visibility maps (computed on-the-fly):
-		if(bind_shadow_maps)
-		{
-			ShadowMap* shadow_map = (ShadowMap*)(l->getUserData(LIGHT_DATA_SHADOW_MAP));
-
-			// Shadow mapping without visibility maps (computed during the rendering of
-			// the full-screen quad):
-
-			// Compute the shadow matrix:
-			// inverse of view:   eye space -> world space
-			// light view:        world space -> light space
-			// light proj:        light space -> light screen space
-			// bias matrix:       switches from [-1, 1] to [0, 1]
-			mat4 shadow_matrix = bias_matrix * l->computeProjectionMatrix() * l->computeViewMatrix() * inv_view_matrix ;
-
-			// Send the shadow matrix as a uniform:
-			ss.str("");
-			ss << "shadow_matrix_" << i << flush;
-			program->sendUniform(ss.str().c_str(), shadow_matrix, false, Hash::AT_RUNTIME);
-
-			// Bind the shadow map to the corresponding texture unit:
-			glActiveTexture(GL_TEXTURE0 + texunit);
-			glBindTexture(GL_TEXTURE_2D, shadow_map->getTexDepth());
-
-			// Set the parameters for shadow comparison and disable any possible mip-mapping:
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,       GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,       GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,   GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,   GL_NEAREST);
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-
-			// Send the texunit as an uniform:
-			ss.str("");
-			ss << "shadow_map_" << i << flush;
-			program->sendUniform(ss.str().c_str(), GLint(texunit), Hash::AT_RUNTIME);
-
-			texunit++;
-		}
+		glutil::activeTexture(GL_TEXTURE0 + texunit);
+		glutil::bindTexture(GL_TEXTURE_2D, ShadowMap::getAtlasTexture());
+		program->sendUniform("shadow_atlas", GLint(texunit));
+		texunit++;
 	}
 
 	// If asked, return the number of the first valid texunit the user can use:
@@ -191,7 +129,7 @@ void GBufferRenderer::render()
 
 	// Bind the VAO and draw
 	const uint nb_vertices = 6;
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 	glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
 }
 
@@ -201,6 +139,8 @@ void GBufferRenderer::createProgram(const Preprocessor::SymbolList& additional_p
 	program = new glutil::GPUProgram("media/shaders/render_from_gbuffer.vert",
 									 "media/shaders/render_from_gbuffer.frag");
 	program->getPreprocessor()->setSymbols(additional_preproc_syms);
+	if(GBuffer::isCompact())
+		program->getPreprocessor()->addSymbol(PreprocSym("_COMPACT_GBUFFER_"));
 
 	bool ok = program->compileAndAttach();
 	assert(ok);
@@ -216,9 +156,13 @@ void GBufferRenderer::createProgram(const Preprocessor::SymbolList& additional_p
 	ok &= program->link();
 	assert(ok);
 
+	// Bind the uniform blocks (camera and lights):
+	UniformBlocks::setupProgram(program);
+
 	// Set the uniform names:
 	list<string> uniform_names_list;
 	uniform_names_list.push_back("tex_positions");
+	uniform_names_list.push_back("gbuffer_inv_proj");
 	uniform_names_list.push_back("tex_normals");
 	uniform_names_list.push_back("tex_diffuse");
 	uniform_names_list.push_back("tex_specular");
@@ -227,25 +171,12 @@ void GBufferRenderer::createProgram(const Preprocessor::SymbolList& additional_p
 	uniform_names_list.push_back("tex_debug");
 	uniform_names_list.push_back("tex_pixels_done");
 
-	stringstream ss;
-	for(uint i=0 ; i < NB_MAX_LIGHTS ; i++)
-	{
-		ss.str("");
-		ss << "eye_space_light_pos_" << i << flush;
-		uniform_names_list.push_back(ss.str());
-
-		ss.str("");
-		ss << "shadow_matrix_" << i << flush;
-		uniform_names_list.push_back(ss.str());
+	uniform_names_list.push_back("shadow_atlas");
 
-		ss.str("");
-		ss << "shadow_map_" << i << flush;
-		uniform_names_list.push_back(ss.str());
-
-		ss.str("");
-		ss << "light_color_" << i << flush;
-		uniform_names_list.push_back(ss.str());
-	}
+	uniform_names_list.push_back("cluster_lights");
+	uniform_names_list.push_back("cluster_headers");
+	uniform_names_list.push_back("cluster_indices");
+	uniform_names_list.push_back("cluster_params");
 
 	const string* uniform_names = listToArray(uniform_names_list);
 	program->setUniformNames(uniform_names, uniform_names_list.size());
@@ -264,7 +195,7 @@ void GBufferRenderer::createVBOAndVAO()
 	glGenVertexArrays(1, &id_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Vertex and texture coordinates:
 	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
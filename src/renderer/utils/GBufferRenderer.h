@@ -7,7 +7,6 @@
 #include "../../glutil/GPUProgram.h"
 
 class GBuffer;
-class Camera;
 class Light;
 
 class GBufferRenderer
@@ -31,7 +30,6 @@ public:
 
 	// Binds stuff, and lets the user know which one is the first texunit he can use.
 	void bind(GBuffer* gbuffer,
-			  Camera* camera,
 			  Light** lights,
 			  uint nb_lights,
 			  bool bind_shadow_maps,
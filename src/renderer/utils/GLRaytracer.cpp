@@ -91,30 +91,30 @@ void GLRaytracer::cleanup()
 	raytrace_bm_program = NULL;
 
 	// VBO and VAO:
-	glDeleteVertexArrays(1, &id_vao);
+	glutil::deleteVertexArrays(1, &id_vao);
 	id_vao = 0;
 
 	glDeleteBuffers(1, &id_vbo);
 	id_vbo = 0;
 
 	// FBO:
-	glDeleteFramebuffers(1, &id_fbo);
+	glutil::deleteFramebuffers(1, &id_fbo);
 	id_fbo = 0;
 
-	glDeleteTextures(1, &id_position);
+	glutil::deleteTextures(1, &id_position);
 	id_position = 0;
 
-	glDeleteTextures(1, &id_power);
+	glutil::deleteTextures(1, &id_power);
 	id_power = 0;
 
-	glDeleteTextures(1, &id_coming_dir);
+	glutil::deleteTextures(1, &id_coming_dir);
 	id_coming_dir = 0;
 
 	// Delete the debug texture:
 #ifdef USE_DEBUG_TEXTURE
 	if(id_debug != 0)
 	{
-		glDeleteTextures(1, &id_debug);
+		glutil::deleteTextures(1, &id_debug);
 		id_debug = 0;
 	}
 #endif
@@ -165,6 +165,7 @@ void GLRaytracer::run(Light* light,
 
 		// - light GBuffer (positions)
 		BIND_TEX(GL_TEXTURE_RECTANGLE, light_gbuffer->getTexPositions(), "tex_light_positions", raytrace_bm_program, texunit);
+		raytrace_bm_program->sendUniform("light_inv_proj", light_gbuffer->getInvProjMatrix());
 
 		// - eye-view depth layers:
 		for(uint i=0 ; i < nb_gbuffers ; i++)
@@ -172,8 +173,8 @@ void GLRaytracer::run(Light* light,
 			ss.str("");
 			ss << "tex_depth_" << i << flush;
 
-			glActiveTexture(GL_TEXTURE0 + texunit);
-			glBindTexture(GL_TEXTURE_RECTANGLE, gbuffers[i]->getTexDepth());
+			glutil::activeTexture(GL_TEXTURE0 + texunit);
+			glutil::bindTexture(GL_TEXTURE_RECTANGLE, gbuffers[i]->getTexDepth());
 			glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_COMPARE_MODE, GL_NONE);
 			raytrace_bm_program->sendUniform(ss.str().c_str(), GLint(texunit), Hash::AT_RUNTIME);
 			texunit++;
@@ -196,7 +197,7 @@ void GLRaytracer::run(Light* light,
 		raytrace_bm_program->sendUniform("eye_proj_matrix", eye_proj, false);
 
 		// Bind the VAO and draw the lines:
-		glBindVertexArray(id_vao);
+		glutil::bindVertexArray(id_vao);
 
 		const uint nb_vertices = 2;
 
@@ -289,7 +290,7 @@ void GLRaytracer::createVBOAndVAO()
 	glGenVertexArrays(1, &id_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Vertex coordinates:
 	GLfloat buffer_data[] = {
@@ -341,6 +342,9 @@ void GLRaytracer::createRaytraceBMProgram()
 
 	symbols.push_back(PreprocSym("_NB_DEPTH_LAYERS_", nb_gbuffers));
 
+	if(GBuffer::isCompact())
+		symbols.push_back(PreprocSym("_COMPACT_GBUFFER_"));
+
 #ifdef DEBUG_USE_EYE_SPACE_LINES
 	symbols.push_back(PreprocSym("_DEBUG_USE_EYE_SPACE_LINES_"));
 #endif
@@ -382,6 +386,7 @@ void GLRaytracer::createRaytraceBMProgram()
 	uniform_names.push_back("bounce_map_1");
 	uniform_names.push_back("bounce_map_size");
 	uniform_names.push_back("tex_light_positions");
+	uniform_names.push_back("light_inv_proj");
 	uniform_names.push_back("light_to_eye_matrix");
 	uniform_names.push_back("eye_proj_matrix");
 	uniform_names.push_back("tex_debug");
@@ -0,0 +1,484 @@
+// HistoPyramid.cpp
+
+#include "HistoPyramid.h"
+#include "../../ShaderLocations.h"
+#include "../../log/Log.h"
+#include "../../glutil/glutil.h"
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+using namespace std;
+
+// ---------------------------------------------------------------------
+// Content of the indirect buffer. build() copies the count of valid texels to the fields marked
+// with (*), the other ones are constant (except DrawElements::count, see drawElementsInstanced()).
+struct DrawCommands
+{
+	struct DrawArrays	// command of glDrawArraysIndirect()
+	{
+		GLuint count;			// (*)
+		GLuint instance_count;
+		GLuint first;
+		GLuint base_instance;
+	} arrays;
+
+	struct DrawElements	// command of glDrawElementsIndirect()
+	{
+		GLuint count;
+		GLuint instance_count;	// (*)
+		GLuint first_index;
+		GLint  base_vertex;
+		GLuint base_instance;
+	} elements;
+};
+
+#define ARRAYS_OFFSET   0
+#define ELEMENTS_OFFSET (sizeof(DrawCommands::DrawArrays))
+
+// ---------------------------------------------------------------------
+HistoPyramid::HistoPyramid()
+: base_size(0),
+  nb_levels(0),
+  id_pyramid_tex(0),
+  id_fbo(0),
+  base_program(NULL),
+  next_program(NULL),
+  compact_program(NULL),
+  id_vao(0),
+  id_vbo(0),
+  id_empty_vao(0),
+  use_draw_indirect(false),
+  id_indirect_buffer(0),
+  indirect_nb_indices(0),
+  capacity(0),
+  id_indices_buffer(0),
+  id_tex_indices(0),
+  mask_width(0),
+  mask_height(0),
+  count(0)
+{
+}
+
+HistoPyramid::~HistoPyramid()
+{
+}
+
+// ---------------------------------------------------------------------
+void HistoPyramid::setup()
+{
+	createFBO();
+	createPrograms();
+	createVBOAndVAO();
+
+	// Indices buffer (allocated by reserveIndices()):
+	glGenBuffers(1, &id_indices_buffer);
+	id_tex_indices = glutil::createTextureBuffer(GL_R32UI, id_indices_buffer);
+
+	// Indirect draws: the count never goes back to the CPU
+	use_draw_indirect = glxwHasDrawIndirect();
+	if(use_draw_indirect)
+	{
+		logInfo("histopyramid: using indirect draws");
+
+		DrawCommands commands;
+		memset(&commands, 0, sizeof(commands));
+		commands.arrays.instance_count = 1;
+
+		glGenBuffers(1, &id_indirect_buffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, id_indirect_buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(commands), &commands, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		indirect_nb_indices = 0;
+	}
+
+	GL_CHECK();
+}
+
+void HistoPyramid::cleanup()
+{
+	// Indirect buffer
+	if(id_indirect_buffer != 0)
+		glDeleteBuffers(1, &id_indirect_buffer);
+	id_indirect_buffer = 0;
+	use_draw_indirect = false;
+
+	// Indices
+	glutil::deleteTextures(1, &id_tex_indices);
+	id_tex_indices = 0;
+
+	glDeleteBuffers(1, &id_indices_buffer);
+	id_indices_buffer = 0;
+	capacity = 0;
+
+	// Programs
+	delete base_program;
+	base_program = NULL;
+
+	delete next_program;
+	next_program = NULL;
+
+	delete compact_program;
+	compact_program = NULL;
+
+	// FBO and texture
+	assert(id_fbo != 0);
+	glutil::deleteFramebuffers(1, &id_fbo);
+	id_fbo = 0;
+
+	deleteTexture();
+
+	// VBO/VAOs
+	glDeleteBuffers(1, &id_vbo);
+	id_vbo = 0;
+
+	glutil::deleteVertexArrays(1, &id_vao);
+	glutil::deleteVertexArrays(1, &id_empty_vao);
+	id_vao = 0;
+	id_empty_vao = 0;
+
+	mask_width = 0;
+	mask_height = 0;
+	count = 0;
+}
+
+// ---------------------------------------------------------------------
+void HistoPyramid::build(GLuint id_mask_tex, uint width, uint height, const vec4& weights, float threshold)
+{
+	// (Re)create the texture if the mask does not fit in the base level:
+	uint size = 1;
+	while(size < width || size < height)
+		size <<= 1;
+
+	if(size > base_size)
+	{
+		deleteTexture();
+		createTexture(size);
+	}
+
+	mask_width = width;
+	mask_height = height;
+
+	// Disable the depth test:
+	glutil::Disable<GL_DEPTH_TEST> depth_test_state;
+
+	glutil::BindFramebuffer fbo_binding(id_fbo);
+	glutil::bindVertexArray(id_vao);
+	glutil::activeTexture(GL_TEXTURE0);
+
+	uint w = base_size;
+
+	for(uint i=0 ; i < nb_levels ; i++)
+	{
+		// Render to the level i:
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, id_pyramid_tex, i);
+		glutil::SetViewport viewport(0, 0, w, w);
+
+		if(i == 0)
+		{
+			base_program->use();
+
+			glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_mask_tex);
+			base_program->sendUniform("tex_mask", 0);
+			base_program->sendUniform("mask_weights", weights);
+			base_program->sendUniform("mask_threshold", threshold);
+		}
+		else
+		{
+			next_program->use();
+
+			// Only the previous level can be sampled:
+			glutil::bindTexture(GL_TEXTURE_2D, id_pyramid_tex);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, i-1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,  i-1);
+			next_program->sendUniform("tex_prev_level", 0);
+		}
+
+		// Draw
+		const uint nb_vertices = 6;
+		glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
+
+		w = glm::max(w >> 1, 1U);
+	}
+
+	// Make all the levels accessible again:
+	glutil::bindTexture(GL_TEXTURE_2D, id_pyramid_tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,  nb_levels-1);
+
+	if(use_draw_indirect)
+	{
+		// Copy the number of valid texels from the top level to the indirect commands.
+		// With a PBO bound, glGetTexImage() does not wait for the pyramid.
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, id_indirect_buffer);
+		glGetTexImage(GL_TEXTURE_2D, nb_levels-1, GL_RED_INTEGER, GL_UNSIGNED_INT,
+					  (GLvoid*)(ARRAYS_OFFSET + offsetof(DrawCommands::DrawArrays, count)));
+		glGetTexImage(GL_TEXTURE_2D, nb_levels-1, GL_RED_INTEGER, GL_UNSIGNED_INT,
+					  (GLvoid*)(ELEMENTS_OFFSET + offsetof(DrawCommands::DrawElements, instance_count)));
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	else
+	{
+		// Read back the number of valid texels from the top level:
+		GLuint top = 0;
+		glGetTexImage(GL_TEXTURE_2D, nb_levels-1, GL_RED_INTEGER, GL_UNSIGNED_INT, &top);
+		count = top;
+	}
+
+	GL_CHECK();
+}
+
+void HistoPyramid::compact()
+{
+	// (the count may not be known: room for all the texels)
+	reserveIndices(getMaxCount());
+
+	uint texunit = 0;
+
+	compact_program->use();
+	compact_program->sendUniform("mask_width", GLint(mask_width));
+	bindPyramid(compact_program, &texunit);
+
+	// Nothing is rasterized: the indices only go to the transform feedback buffer
+	glutil::Enable<GL_RASTERIZER_DISCARD> rasterizer_discard_state;
+
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, id_indices_buffer);
+	glBeginTransformFeedback(GL_POINTS);
+
+	glutil::bindVertexArray(id_empty_vao);
+	drawArrays(GL_POINTS);
+
+	glEndTransformFeedback();
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+	GL_CHECK();
+}
+
+void HistoPyramid::drawArrays(GLenum mode) const
+{
+	if(use_draw_indirect)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, id_indirect_buffer);
+		glDrawArraysIndirect(mode, (const GLvoid*)(ARRAYS_OFFSET));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else if(count != 0)
+		glDrawArrays(mode, 0, count);
+}
+
+void HistoPyramid::drawElementsInstanced(GLenum mode, GLsizei nb_indices, GLenum type)
+{
+	if(use_draw_indirect)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, id_indirect_buffer);
+
+		// The number of indices is given by the caller:
+		if(GLuint(nb_indices) != indirect_nb_indices)
+		{
+			indirect_nb_indices = GLuint(nb_indices);
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER,
+							ELEMENTS_OFFSET + offsetof(DrawCommands::DrawElements, count),
+							sizeof(GLuint), &indirect_nb_indices);
+		}
+
+		glDrawElementsIndirect(mode, type, (const GLvoid*)(ELEMENTS_OFFSET));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else if(count != 0)
+		glDrawElementsInstanced(mode, nb_indices, type, 0, count);
+}
+
+void HistoPyramid::bindPyramid(glutil::GPUProgram* program, uint* texunit) const
+{
+	uint& t = *texunit;
+
+	BIND_TEX(GL_TEXTURE_2D, id_pyramid_tex, "tex_histopyramid", program, t);
+	program->sendUniform("hp_nb_levels", GLint(nb_levels));
+}
+
+// ---------------------------------------------------------------------
+void HistoPyramid::createTexture(uint size)
+{
+	base_size = size;
+
+	nb_levels = 1;
+	while((size >> (nb_levels-1)) > 1)
+		nb_levels++;
+
+	glGenTextures(1, &id_pyramid_tex);
+	glutil::bindTexture(GL_TEXTURE_2D, id_pyramid_tex);
+
+	// Integer texture: no filtering
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,  nb_levels-1);
+
+	// Create the levels
+	uint w = size;
+	for(uint i=0 ; i < nb_levels ; i++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, i, GL_R32UI, w, w, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		w = glm::max(w >> 1, 1U);
+	}
+
+	GL_CHECK();
+}
+
+void HistoPyramid::deleteTexture()
+{
+	if(id_pyramid_tex != 0)
+		glutil::deleteTextures(1, &id_pyramid_tex);
+
+	id_pyramid_tex = 0;
+	base_size = 0;
+	nb_levels = 0;
+}
+
+void HistoPyramid::reserveIndices(uint nb_indices)
+{
+	if(nb_indices <= capacity)
+		return;
+
+	capacity = nb_indices;
+
+	// (the buffer texture keeps referencing the same buffer)
+	glBindBuffer(GL_TEXTURE_BUFFER, id_indices_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, capacity*sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// ---------------------------------------------------------------------
+void HistoPyramid::createFBO()
+{
+	// The levels are attached by build():
+	glGenFramebuffers(1, &id_fbo);
+
+	glutil::BindFramebuffer fbo_binding(id_fbo);
+
+	static const GLenum draw_buffers[] = {
+		GL_COLOR_ATTACHMENT0,
+	};
+	glDrawBuffers(sizeof(draw_buffers) / sizeof(GLenum), draw_buffers);
+}
+
+void HistoPyramid::createPrograms()
+{
+	bool ok = false;
+
+	// Base level program
+	{
+		base_program = new glutil::GPUProgram(	"media/shaders/histopyramid.vert",
+												"media/shaders/histopyramid.frag");
+
+		base_program->getPreprocessor()->setSymbols("_BASE_LEVEL_", NULL);
+
+		// Compile, attach, set the locations, link
+		ok = base_program->compileAndAttach();
+		assert(ok);
+
+		base_program->bindAttribLocations(HISTO_PYRAMID_ATTRIB_POSITION, "vertex_position",
+		                                  0, NULL);
+
+		base_program->bindFragDataLocations(HISTO_PYRAMID_FRAG_DATA_OUTPUT, "frag_output",
+		                                    0, NULL);
+
+		ok &= base_program->link();
+		assert(ok);
+
+		// Set the uniform names
+		base_program->setUniformNames("tex_mask", "mask_weights", "mask_threshold", NULL);
+
+		// Validate
+		base_program->validate();
+	}
+
+	// Next levels program
+	{
+		next_program = new glutil::GPUProgram(	"media/shaders/histopyramid.vert",
+												"media/shaders/histopyramid.frag");
+
+		// Compile, attach, set the locations, link
+		ok = next_program->compileAndAttach();
+		assert(ok);
+
+		next_program->bindAttribLocations(HISTO_PYRAMID_ATTRIB_POSITION, "vertex_position",
+		                                  0, NULL);
+
+		next_program->bindFragDataLocations(HISTO_PYRAMID_FRAG_DATA_OUTPUT, "frag_output",
+		                                    0, NULL);
+
+		ok &= next_program->link();
+		assert(ok);
+
+		// Set the uniform names
+		next_program->setUniformNames("tex_prev_level", NULL);
+
+		// Validate
+		next_program->validate();
+	}
+
+	// Compaction program (no fragment shader)
+	{
+		compact_program = new glutil::GPUProgram("media/shaders/histopyramid.vert", "");
+
+		compact_program->getPreprocessor()->setSymbols("_COMPACT_", NULL);
+
+		// Compile, attach, set the outputs, link
+		ok = compact_program->compileAndAttach();
+		assert(ok);
+
+		compact_program->setTransformFeedbackVaryings(GL_INTERLEAVED_ATTRIBS, "out_index", NULL);
+
+		ok &= compact_program->link();
+		assert(ok);
+
+		// Set the uniform names
+		compact_program->setUniformNames("tex_histopyramid", "hp_nb_levels", "mask_width", NULL);
+
+		// Validate
+		compact_program->validate();
+	}
+}
+
+// ---------------------------------------------------------------------
+void HistoPyramid::createVBOAndVAO()
+{
+	// Create the VAO:
+	glGenVertexArrays(1, &id_vao);
+
+	// Bind the VAO:
+	glutil::bindVertexArray(id_vao);
+
+	// Vertex and coordinates:
+	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
+								-1.0f, -1.0f,	// triangle 1
+								+1.0f, -1.0f,
+								+1.0f, +1.0f,
+
+								-1.0f, -1.0f,	// triangle 2
+								+1.0f, +1.0f,
+								-1.0f, +1.0f
+							};
+
+	const GLsizeiptr buffer_size = sizeof(buffer_data);
+
+	// Create the buffer and put the data into it:
+	glGenBuffers(1, &id_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, id_vbo);
+
+	glBufferData(GL_ARRAY_BUFFER, buffer_size, (const GLvoid*)buffer_data, GL_STATIC_DRAW);
+
+	// - enable attributes:
+	glEnableVertexAttribArray(HISTO_PYRAMID_ATTRIB_POSITION);
+
+	// - vertices pointer:
+	glVertexAttribPointer(HISTO_PYRAMID_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
+
+	// VAO without attributes, for compact():
+	glGenVertexArrays(1, &id_empty_vao);
+
+	glutil::bindVertexArray(0);
+}
@@ -0,0 +1,100 @@
+// HistoPyramid.h
+// Stream compaction of the valid texels of a mask, with a histopyramid:
+// - build(): the base level of an R32UI texture contains 1 for the valid texels of the mask and 0
+//   otherwise, and each next level the sum of 2x2 texels of the previous one, so that the top
+//   level (1x1) contains the number of valid texels. The base level is square, with a power of 2
+//   size, and the texture is (re)created when a bigger mask is given.
+// - compact(): a vertex per valid texel traverses the pyramid from the top (see
+//   library/histopyramid.shader) and writes the index of its texel (y*width + x) with transform
+//   feedback, so that the indices of the valid texels are packed in a buffer.
+// The passes which used to run over all the texels of the mask can then run over the valid texels
+// only, with drawArrays() or drawElementsInstanced(), reading their texel from getTexIndices().
+// When indirect draws are supported (OpenGL 4.0 or GL_ARB_draw_indirect), build() copies the count
+// from the top level into the commands of an indirect buffer, through a PBO, so that the CPU never
+// waits for it. Otherwise, build() reads it back to the CPU (getCount()), which stalls the pipeline.
+
+#ifndef HISTO_PYRAMID_H
+#define HISTO_PYRAMID_H
+
+#include "../../Common.h"
+#include "../../glutil/GPUProgram.h"
+
+class HistoPyramid
+{
+private:
+	uint base_size;	// size of the base level (power of 2)
+	uint nb_levels;
+	GLuint id_pyramid_tex;	// R32UI, with nb_levels mip levels
+	GLuint id_fbo;
+
+	glutil::GPUProgram* base_program;		// base level, from the mask
+	glutil::GPUProgram* next_program;		// next levels
+	glutil::GPUProgram* compact_program;
+
+	GLuint id_vao;
+	GLuint id_vbo;
+	GLuint id_empty_vao;
+
+	// Indirect draws (see DrawCommands in HistoPyramid.cpp):
+	bool use_draw_indirect;
+	GLuint id_indirect_buffer;
+	GLuint indirect_nb_indices;	// "count" of the command of drawElementsInstanced()
+
+	// Packed indices:
+	uint capacity;
+	GLuint id_indices_buffer;
+	GLuint id_tex_indices;	// R32UI buffer texture of id_indices_buffer
+
+	// Last call to build():
+	uint mask_width;
+	uint mask_height;
+	uint count;	// only without indirect draws
+
+public:
+	HistoPyramid();
+	virtual ~HistoPyramid();
+
+	void setup();
+	void cleanup();
+
+	// id_mask_tex: rectangle texture of width*height texels. A texel is valid if
+	// dot(texel, weights) > threshold.
+	void build(GLuint id_mask_tex, uint width, uint height, const vec4& weights, float threshold);
+
+	// Write the indices of the valid texels found by build()
+	void compact();
+
+	// Draw one vertex per valid texel (gl_VertexID is the rank of the texel in getTexIndices()),
+	// from the first vertex
+	void drawArrays(GLenum mode) const;
+
+	// Draw one instance per valid texel (gl_InstanceID is the rank of the texel in getTexIndices()),
+	// with the element array buffer of the bound VAO, from its first index
+	void drawElementsInstanced(GLenum mode, GLsizei nb_indices, GLenum type);
+
+	// Is the number of valid texels only on the GPU?
+	bool isCountOnGPU() const {return use_draw_indirect;}
+
+	// Getters:
+	uint getCount() const        {return count;}	// only if !isCountOnGPU()
+	uint getMaxCount() const     {return mask_width * mask_height;}
+	uint getNbLevels() const     {return nb_levels;}
+	GLuint getPyramidTex() const {return id_pyramid_tex;}
+
+	GLuint getIndicesBuffer() const {return id_indices_buffer;}
+	GLuint getTexIndices() const    {return id_tex_indices;}
+
+	// Bind the pyramid for library/histopyramid.shader
+	void bindPyramid(glutil::GPUProgram* program, uint* texunit) const;
+
+private:
+	void createTexture(uint size);
+	void deleteTexture();
+	void reserveIndices(uint nb_indices);
+
+	void createFBO();
+	void createPrograms();
+	void createVBOAndVAO();
+};
+
+#endif // HISTO_PYRAMID_H
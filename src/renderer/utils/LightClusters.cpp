@@ -0,0 +1,280 @@
+// LightClusters.cpp
+
+#include "LightClusters.h"
+#include "../../Config.h"
+#include "../../scene/Scene.h"
+#include "../../scene/Camera.h"
+#include "../../scene/Light.h"
+#include "../../scene/ArrayElementContainer.h"
+#include "../../glutil/glutil.h"
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// ---------------------------------------------------------------------
+LightClusters::LightClusters(uint width, uint height)
+: width(width),
+  height(height),
+  nb_tiles_x((width  + LIGHT_CLUSTERS_TILE_SIZE - 1) / LIGHT_CLUSTERS_TILE_SIZE),
+  nb_tiles_y((height + LIGHT_CLUSTERS_TILE_SIZE - 1) / LIGHT_CLUSTERS_TILE_SIZE),
+  nb_clusters(0),
+  z_near(1.0f),
+  z_far(2.0f),
+  slice_scale(1.0f),
+  id_lights_buffer(0),
+  id_headers_buffer(0),
+  id_indices_buffer(0),
+  id_tex_lights(0),
+  id_tex_headers(0),
+  id_tex_indices(0),
+  nb_lights(0),
+  headers_data(NULL)
+{
+	nb_clusters = nb_tiles_x * nb_tiles_y * LIGHT_CLUSTERS_NB_SLICES;
+	headers_data = new uint[2*nb_clusters];
+
+	// Create the buffers. The indices buffer is resized when needed by update().
+	GLuint ids[3];
+	glGenBuffers(3, ids);
+	id_lights_buffer  = ids[0];
+	id_headers_buffer = ids[1];
+	id_indices_buffer = ids[2];
+
+	glBindBuffer(GL_TEXTURE_BUFFER, id_lights_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(lights_data), NULL, GL_STREAM_DRAW);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, id_headers_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 2*nb_clusters*sizeof(uint), NULL, GL_STREAM_DRAW);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, id_indices_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLushort), NULL, GL_STREAM_DRAW);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// Create the buffer textures:
+	id_tex_lights  = glutil::createTextureBuffer(GL_RGBA32F, id_lights_buffer);
+	id_tex_headers = glutil::createTextureBuffer(GL_RG32UI,  id_headers_buffer);
+	id_tex_indices = glutil::createTextureBuffer(GL_R16UI,   id_indices_buffer);
+
+	GL_CHECK();
+}
+
+LightClusters::~LightClusters()
+{
+	glutil::deleteTextures(1, &id_tex_lights);
+	glutil::deleteTextures(1, &id_tex_headers);
+	glutil::deleteTextures(1, &id_tex_indices);
+
+	glDeleteBuffers(1, &id_lights_buffer);
+	glDeleteBuffers(1, &id_headers_buffer);
+	glDeleteBuffers(1, &id_indices_buffer);
+
+	delete [] headers_data;
+}
+
+// ---------------------------------------------------------------------
+void LightClusters::update(const Scene* scene)
+{
+	assert(scene->getElements()->getType() == ElementContainer::ARRAY);
+
+	const ArrayElementContainer* elements = (const ArrayElementContainer*)(scene->getElements());
+	Light** lights = elements->getLights();
+	nb_lights = elements->getNbLights();
+
+	// The shadowed lights are not binned: render_from_gbuffer.frag shades them one by one
+	uint first_light = elements->getNbShadowedLights();
+
+	// Get the view frustum of the camera:
+	const Camera* camera = scene->getCamera();
+	mat4 view_matrix = camera->computeViewMatrix();
+	mat4 proj_matrix = camera->computeProjectionMatrix();
+
+	z_near = camera->getZNear();
+	z_far  = camera->getZFar();
+	slice_scale = float(LIGHT_CLUSTERS_NB_SLICES) / logf(z_far / z_near);
+
+	// First pass: compute the clusters covered by each light, and count the lights of each cluster
+	memset(headers_data, 0, 2*nb_clusters*sizeof(uint));
+
+	mat3 view_rotation = mat3(view_matrix);
+
+	for(uint i=first_light ; i < nb_lights ; i++)
+	{
+		const Light* l = lights[i];
+		vec3 position = vec3(view_matrix * vec4(l->getPosition(), 1.0f));
+		float range = l->getRange();
+
+		// Frustum of the light (see Light::computeProjectionMatrix()), in eye space:
+		float angle = l->getAngle();
+		float tan_half_angle = (angle == 0.0f ? 0.0f : tanf(0.5f * float(angle * M_PI / 180.0)));
+		const mat3& orientation = l->getOrientation();
+
+		vec4* data = &lights_data[LIGHT_CLUSTERS_TEXELS_PER_LIGHT*i];
+		data[0] = vec4(position, range);
+		data[1] = vec4(l->getColor(), tan_half_angle);
+		data[2] = vec4(view_rotation * orientation[0], 0.0f);
+		data[3] = vec4(view_rotation * orientation[1], 0.0f);
+
+		light_visible[i] = computeLightBounds(position, range, proj_matrix, &light_bounds[i]);
+		if(!light_visible[i])
+			continue;
+
+		const LightBounds& b = light_bounds[i];
+		for(uint s = b.first_slice ; s <= b.last_slice ; s++)
+			for(uint y = b.first_tile_y ; y <= b.last_tile_y ; y++)
+				for(uint x = b.first_tile_x ; x <= b.last_tile_x ; x++)
+					headers_data[2*((s*nb_tiles_y + y)*nb_tiles_x + x) + 1]++;
+	}
+
+	// Compute the offsets of the lists of lights of the clusters:
+	uint nb_indices = 0;
+	for(uint c=0 ; c < nb_clusters ; c++)
+	{
+		headers_data[2*c+0] = nb_indices;
+		nb_indices += headers_data[2*c+1];
+		headers_data[2*c+1] = 0;
+	}
+
+	// Second pass: fill the lists (the lights are thus sorted in each list)
+	indices_data.resize(nb_indices);
+
+	for(uint i=first_light ; i < nb_lights ; i++)
+	{
+		if(!light_visible[i])
+			continue;
+
+		const LightBounds& b = light_bounds[i];
+		for(uint s = b.first_slice ; s <= b.last_slice ; s++)
+			for(uint y = b.first_tile_y ; y <= b.last_tile_y ; y++)
+				for(uint x = b.first_tile_x ; x <= b.last_tile_x ; x++)
+				{
+					uint* header = &headers_data[2*((s*nb_tiles_y + y)*nb_tiles_x + x)];
+					indices_data[header[0] + header[1]] = GLushort(i);
+					header[1]++;
+				}
+	}
+
+	// Upload everything:
+	if(nb_lights > first_light)
+	{
+		const uint offset = LIGHT_CLUSTERS_TEXELS_PER_LIGHT*first_light;
+		glBindBuffer(GL_TEXTURE_BUFFER, id_lights_buffer);
+		glBufferSubData(GL_TEXTURE_BUFFER, offset*sizeof(vec4),
+						LIGHT_CLUSTERS_TEXELS_PER_LIGHT*(nb_lights-first_light)*sizeof(vec4),
+						&lights_data[offset]);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, id_headers_buffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, 2*nb_clusters*sizeof(uint), headers_data);
+
+	// (the size of the buffer texture follows the size of the buffer)
+	if(nb_indices != 0)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, id_indices_buffer);
+		glBufferData(GL_TEXTURE_BUFFER, nb_indices*sizeof(GLushort), &indices_data[0], GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// ---------------------------------------------------------------------
+void LightClusters::bind(glutil::GPUProgram* program, uint* texunit) const
+{
+	glutil::activeTexture(GL_TEXTURE0 + *texunit);
+	glutil::bindTexture(GL_TEXTURE_BUFFER, id_tex_lights);
+	program->sendUniform("cluster_lights", GLint(*texunit));
+	(*texunit)++;
+
+	glutil::activeTexture(GL_TEXTURE0 + *texunit);
+	glutil::bindTexture(GL_TEXTURE_BUFFER, id_tex_headers);
+	program->sendUniform("cluster_headers", GLint(*texunit));
+	(*texunit)++;
+
+	glutil::activeTexture(GL_TEXTURE0 + *texunit);
+	glutil::bindTexture(GL_TEXTURE_BUFFER, id_tex_indices);
+	program->sendUniform("cluster_indices", GLint(*texunit));
+	(*texunit)++;
+
+	program->sendUniform("cluster_params", vec4(float(nb_tiles_x), float(nb_tiles_y), z_near, slice_scale));
+}
+
+void LightClusters::addSymbols(Preprocessor::SymbolList* preproc_syms)
+{
+	preproc_syms->push_back(PreprocSym("_CLUSTERED_LIGHTING_"));
+	preproc_syms->push_back(PreprocSym("_CLUSTER_TILE_SIZE_", LIGHT_CLUSTERS_TILE_SIZE));
+	preproc_syms->push_back(PreprocSym("_CLUSTER_NB_SLICES_", LIGHT_CLUSTERS_NB_SLICES));
+	if(USE_CLUSTERED_LIGHT_FALLOFF)
+		preproc_syms->push_back(PreprocSym("_CLUSTER_LIGHT_FALLOFF_"));
+}
+
+// ---------------------------------------------------------------------
+bool LightClusters::computeLightBounds(const vec3& position, float range, const mat4& proj_matrix,
+									   LightBounds* bounds) const
+{
+	// Distances of the sphere from the eye, along the view direction (-z):
+	float dist_min = -position.z - range;
+	float dist_max = -position.z + range;
+
+	if(dist_max < z_near || dist_min > z_far)
+		return false;
+
+	bounds->first_slice = computeSlice(dist_min);
+	bounds->last_slice  = computeSlice(dist_max);
+
+	// Normalized device coordinates of the sphere: if it crosses the near plane, it may cover
+	// the whole screen. Otherwise, we project the corners of its bounding box, which are all in
+	// front of the eye.
+	vec2 ndc_min(-1.0f);
+	vec2 ndc_max( 1.0f);
+
+	if(dist_min > z_near)
+	{
+		ndc_min = vec2( FLT_MAX);
+		ndc_max = vec2(-FLT_MAX);
+
+		for(uint i=0 ; i < 8 ; i++)
+		{
+			vec3 corner = position + vec3((i & 1) ? range : -range,
+										  (i & 2) ? range : -range,
+										  (i & 4) ? range : -range);
+			vec4 clip = proj_matrix * vec4(corner, 1.0f);
+			vec2 ndc = vec2(clip) / clip.w;
+
+			ndc_min = glm::min(ndc_min, ndc);
+			ndc_max = glm::max(ndc_max, ndc);
+		}
+
+		if(ndc_min.x > 1.0f || ndc_min.y > 1.0f || ndc_max.x < -1.0f || ndc_max.y < -1.0f)
+			return false;
+
+		ndc_min = glm::max(ndc_min, vec2(-1.0f));
+		ndc_max = glm::min(ndc_max, vec2( 1.0f));
+	}
+
+	// Tiles covered by the rectangle, in window coordinates:
+	vec2 win_min = 0.5f * (ndc_min + vec2(1.0f)) * vec2(float(width), float(height));
+	vec2 win_max = 0.5f * (ndc_max + vec2(1.0f)) * vec2(float(width), float(height));
+
+	bounds->first_tile_x = glm::min(uint(win_min.x) / LIGHT_CLUSTERS_TILE_SIZE, nb_tiles_x-1);
+	bounds->last_tile_x  = glm::min(uint(win_max.x) / LIGHT_CLUSTERS_TILE_SIZE, nb_tiles_x-1);
+	bounds->first_tile_y = glm::min(uint(win_min.y) / LIGHT_CLUSTERS_TILE_SIZE, nb_tiles_y-1);
+	bounds->last_tile_y  = glm::min(uint(win_max.y) / LIGHT_CLUSTERS_TILE_SIZE, nb_tiles_y-1);
+
+	return true;
+}
+
+// Same computation as getClusterLights() in light_clusters.shader
+uint LightClusters::computeSlice(float dist) const
+{
+	if(dist <= z_near)
+		return 0;
+
+	uint slice = uint(logf(dist / z_near) * slice_scale);
+	return glm::min(slice, uint(LIGHT_CLUSTERS_NB_SLICES-1));
+}
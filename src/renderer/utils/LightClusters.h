@@ -0,0 +1,105 @@
+// LightClusters.h
+// Clustered light culling for the deferred shading of the lights which are not shadowed (the lights
+// after the first NB_MAX_SHADOWED_LIGHTS ones, which keep being shaded one by one, with their shadow
+// maps). The view frustum is divided into clusters:
+// tiles of LIGHT_CLUSTERS_TILE_SIZE x LIGHT_CLUSTERS_TILE_SIZE pixels, each one divided into
+// LIGHT_CLUSTERS_NB_SLICES depth slices (distributed exponentially between the near and far
+// planes). Each cluster gets the list of the lights whose sphere of influence (position and
+// Light::getRange()) intersects it, so that the shading cost of a pixel only depends on the
+// number of lights close to it.
+// The lights are binned on the CPU once per frame, and the shaders read the result from 3 buffer
+// textures (see media/shaders/library/light_clusters.shader):
+// - "cluster_lights": LIGHT_CLUSTERS_TEXELS_PER_LIGHT RGBA32F texels per light: eye-space position and
+//   range, color and tangent of the half-angle (0 for omnidirectional lights), eye-space X and Y axes
+// - "cluster_headers": 1 RG32UI texel per cluster: offset and number of its lights in "cluster_indices"
+// - "cluster_indices": R16UI indices of the lights, cluster after cluster
+// The clusters are numbered by slice, then row of tiles, then column of tiles.
+// The range of a light is only a culling bound: a light lights what is inside its frustum (like the
+// shadowed lights) with no attenuation, unless USE_CLUSTERED_LIGHT_FALLOFF is set in Config.h.
+
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include "../../Common.h"
+#include "../../Boundaries.h"
+#include "../../glutil/GPUProgram.h"
+#include <vector>
+
+#define LIGHT_CLUSTERS_TILE_SIZE 32
+#define LIGHT_CLUSTERS_NB_SLICES 16
+#define LIGHT_CLUSTERS_TEXELS_PER_LIGHT 4
+
+class Scene;
+
+class LightClusters
+{
+private:
+	uint width;
+	uint height;
+
+	uint nb_tiles_x;
+	uint nb_tiles_y;
+	uint nb_clusters;
+
+	// Depth slices: the slice of a point at the distance d from the eye (along the view
+	// direction) is log(d / z_near) * slice_scale
+	float z_near;
+	float z_far;
+	float slice_scale;
+
+	// Buffers and the buffer textures reading them:
+	GLuint id_lights_buffer;
+	GLuint id_headers_buffer;
+	GLuint id_indices_buffer;
+
+	GLuint id_tex_lights;
+	GLuint id_tex_headers;
+	GLuint id_tex_indices;
+
+	// Data uploaded to the buffers by update():
+	uint nb_lights;
+	vec4 lights_data[LIGHT_CLUSTERS_TEXELS_PER_LIGHT*NB_MAX_LIGHTS];
+	uint* headers_data;	// offset and number of lights of each cluster
+	std::vector<GLushort> indices_data;
+
+	// Clusters covered by a light, computed by update():
+	struct LightBounds
+	{
+		uint first_tile_x, last_tile_x;
+		uint first_tile_y, last_tile_y;
+		uint first_slice,  last_slice;
+	};
+	LightBounds light_bounds[NB_MAX_LIGHTS];
+	bool light_visible[NB_MAX_LIGHTS];
+
+public:
+	// Creates the buffers (needs an OpenGL context)
+	LightClusters(uint width, uint height);
+	virtual ~LightClusters();
+
+	// Bin the unshadowed lights of the scene into the clusters of the camera's view frustum, and
+	// upload the result
+	void update(const Scene* scene);
+
+	// Bind the buffer textures to the texunits starting at *texunit (which is updated)
+	// and send the uniforms of light_clusters.shader
+	void bind(glutil::GPUProgram* program, uint* texunit) const;
+
+	// Add the preprocessor symbols needed by light_clusters.shader
+	static void addSymbols(Preprocessor::SymbolList* preproc_syms);
+
+	// Getters:
+	uint getNbClusters() const {return nb_clusters;}
+	uint getNbIndices() const  {return indices_data.size();}
+
+private:
+	// Compute the clusters covered by the sphere of influence of a light, given in eye space.
+	// Returns false if the sphere is outside the view frustum.
+	bool computeLightBounds(const vec3& position, float range, const mat4& proj_matrix,
+							LightBounds* bounds) const;
+
+	// Depth slice of a point at the given distance from the eye, along the view direction
+	uint computeSlice(float dist) const;
+};
+
+#endif // LIGHT_CLUSTERS_H
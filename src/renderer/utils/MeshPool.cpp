@@ -0,0 +1,156 @@
+// MeshPool.cpp
+
+#include "MeshPool.h"
+#include "../../glutil/glutil.h"
+#include "../../scene/Geometry.h"
+#include <cassert>
+#include <cstring>
+using namespace std;
+
+bool MeshPool::Format::operator<(const Format& f) const
+{
+	if(vertex_size != f.vertex_size)		return vertex_size < f.vertex_size;
+	if(vertex_attrib != f.vertex_attrib)	return vertex_attrib < f.vertex_attrib;
+	if(normal_attrib != f.normal_attrib)	return normal_attrib < f.normal_attrib;
+	return texcoords_attrib < f.texcoords_attrib;
+}
+
+// ---------------------------------------------------------------------
+MeshPool::MeshPool()
+{
+}
+
+MeshPool::~MeshPool()
+{
+	clear();
+}
+
+void MeshPool::addGeometry(Geometry* geo,
+						   GLuint vertex_attrib,
+						   GLuint normal_attrib,
+						   GLuint texcoords_attrib)
+{
+	// Only add each geometry once:
+	if(added_geometries.find(geo) != added_geometries.end())
+		return;
+	added_geometries[geo] = true;
+
+	Format format;
+	format.vertex_size = geo->getVertexSize();
+	format.vertex_attrib = vertex_attrib;
+	format.normal_attrib = normal_attrib;
+	format.texcoords_attrib = texcoords_attrib;
+
+	BucketMap::iterator it = buckets.find(format);
+	if(it == buckets.end())
+	{
+		Bucket bucket;
+		bucket.nb_vertices = 0;
+		bucket.id_vbo = 0;
+		bucket.id_vao = 0;
+		it = buckets.insert(make_pair(format, bucket)).first;
+	}
+
+	it->second.geometries.push_back(geo);
+}
+
+void MeshPool::build(uint vao_index)
+{
+	for(BucketMap::iterator it = buckets.begin() ; it != buckets.end() ; it++)
+	{
+		const Format& format = it->first;
+		Bucket& bucket = it->second;
+
+		assert(bucket.id_vbo == 0);
+
+		// Skip the geometries which already have a VAO in this slot:
+		uint nb_geometries = 0;
+		bucket.nb_vertices = 0;
+		for(uint i=0 ; i < bucket.geometries.size() ; i++)
+		{
+			Geometry* geo = bucket.geometries[i];
+			if(geo->getVAO(vao_index) != 0)
+				continue;
+
+			bucket.geometries[nb_geometries++] = geo;
+			bucket.nb_vertices += geo->getNbVertices();
+		}
+		bucket.geometries.resize(nb_geometries);
+
+		if(nb_geometries == 0)
+			continue;
+
+		// Create the VBO and copy the geometries one after the other:
+		glGenBuffers(1, &bucket.id_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, bucket.id_vbo);
+		glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(bucket.nb_vertices) * format.vertex_size, NULL, GL_STATIC_DRAW);
+
+		// Create the VAO:
+		glGenVertexArrays(1, &bucket.id_vao);
+		glutil::bindVertexArray(bucket.id_vao);
+
+		glEnableVertexAttribArray(format.vertex_attrib);
+		glVertexAttribPointer(format.vertex_attrib, 3, GL_FLOAT, GL_FALSE, format.vertex_size, (const GLvoid*)0);
+
+		// - the normals and texcoords are in the buffer only if the geometry has them,
+		// but the offsets are the same as in Geometry::buildVAO():
+		if(format.normal_attrib != 0)
+		{
+			glEnableVertexAttribArray(format.normal_attrib);
+			glVertexAttribPointer(format.normal_attrib, 3, GL_FLOAT, GL_FALSE, format.vertex_size,
+								  (const GLvoid*)(sizeof(GLfloat)*3));
+		}
+
+		if(format.texcoords_attrib != 0)
+		{
+			glEnableVertexAttribArray(format.texcoords_attrib);
+			glVertexAttribPointer(format.texcoords_attrib, 2, GL_FLOAT, GL_FALSE, format.vertex_size,
+								  (const GLvoid*)(sizeof(GLfloat)*6));
+		}
+
+		uint first_vertex = 0;
+		for(uint i=0 ; i < nb_geometries ; i++)
+		{
+			Geometry* geo = bucket.geometries[i];
+
+			GLfloat* interleaved_data = geo->buildInterleavedData();
+			glBufferSubData(GL_ARRAY_BUFFER,
+							GLintptr(first_vertex) * format.vertex_size,
+							GLsizeiptr(geo->getNbVertices()) * format.vertex_size,
+							(const GLvoid*)interleaved_data);
+			delete [] interleaved_data;
+
+			geo->setSharedVAO(vao_index, bucket.id_vao, first_vertex);
+			first_vertex += geo->getNbVertices();
+		}
+		bucket.geometries.clear();
+
+		GL_CHECK();
+	}
+
+	added_geometries.clear();
+}
+
+void MeshPool::clear()
+{
+	for(BucketMap::iterator it = buckets.begin() ; it != buckets.end() ; it++)
+	{
+		Bucket& bucket = it->second;
+
+		if(bucket.id_vao != 0)
+			glutil::deleteVertexArrays(1, &bucket.id_vao);
+
+		if(bucket.id_vbo != 0)
+			glDeleteBuffers(1, &bucket.id_vbo);
+	}
+
+	buckets.clear();
+	added_geometries.clear();
+}
+
+void MeshPool::getVAOs(GLuint* id_vaos) const
+{
+	uint i = 0;
+	for(BucketMap::const_iterator it = buckets.begin() ; it != buckets.end() ; it++)
+		id_vaos[i++] = it->second.id_vao;
+}
@@ -0,0 +1,70 @@
+// MeshPool.h
+// Packs the vertices of the static geometries of a scene into a few large vertex buffers,
+// one per vertex format (which attributes are present and enabled), so that draws of
+// different geometries can be submitted together with glMultiDrawArraysIndirect().
+// Usage:
+//   pool.addGeometry(geo, vertex_attrib, normal_attrib, texcoords_attrib);	// for each geometry
+//   pool.build(vao_index);	// upload the buffers and set the shared VAOs of the geometries
+//   [...] draw with geo->getVAO(vao_index) and geo->getFirstVertex(vao_index)
+//   pool.clear();	// once the geometries forgot their VAO (Geometry::deleteVAO())
+// As for Geometry::buildVAO(), a geometry which already has a VAO in the given slot is not
+// added to the pool, and it keeps its VAO.
+
+#ifndef MESH_POOL_H
+#define MESH_POOL_H
+
+#include "../../Common.h"
+#include "../../glutil/glxw.h"
+#include <map>
+#include <vector>
+
+class Geometry;
+
+class MeshPool
+{
+private:
+	struct Format
+	{
+		uint vertex_size;	// in bytes, gives which attributes are present in the geometry
+		GLuint vertex_attrib;
+		GLuint normal_attrib;
+		GLuint texcoords_attrib;
+
+		bool operator<(const Format& f) const;
+	};
+
+	struct Bucket
+	{
+		std::vector<Geometry*> geometries;
+		uint nb_vertices;
+		GLuint id_vbo;
+		GLuint id_vao;
+	};
+
+	typedef std::map<Format, Bucket> BucketMap;
+	BucketMap buckets;
+
+	std::map<const Geometry*, bool> added_geometries;
+
+public:
+	MeshPool();
+	virtual ~MeshPool();
+
+	void addGeometry(Geometry* geo,
+					 GLuint vertex_attrib,
+					 GLuint normal_attrib,
+					 GLuint texcoords_attrib);
+
+	// Upload the vertex buffers, create the VAOs and give them to the geometries
+	void build(uint vao_index);
+
+	// Delete the buffers and the VAOs
+	void clear();
+
+	// Access to the VAOs, e.g. for adding per-instance attributes
+	// (0 for the formats whose geometries all kept their own VAO):
+	uint getNbVAOs() const {return uint(buckets.size());}
+	void getVAOs(GLuint* id_vaos) const;
+};
+
+#endif // MESH_POOL_H
@@ -1,24 +1,41 @@
 // MinMaxMipmaps.cpp
 
-#include "MinMaxMipmaps.h"
-
 #include "MinMaxMipmaps.h"
 #include "../../glutil/glutil.h"
 #include "../../ShaderLocations.h"
-#include <sstream>
+#include <cassert>
 using namespace std;
 
+// Number of levels computed by a dispatch of the compute shader (see min_max_mipmaps.comp)
+#define MIN_MAX_MIPMAPS_TILE_NB_LEVELS 5
+
+// ---------------------------------------------------------------------
+uint computeMinMaxNbLevels(uint width, uint height)
+{
+	uint nb_levels = 1;
+	uint size = glm::max(width, height);
+	while(size > 1)
+	{
+		size >>= 1;
+		nb_levels++;
+	}
+	return nb_levels;
+}
+
 // ---------------------------------------------------------------------
 MinMaxMipmaps::MinMaxMipmaps(uint target_width, uint target_height)
 : target_width(target_width),
   target_height(target_height),
   program_first(NULL),
   program_next(NULL),
+  use_compute_shader(false),
+  compute_program_first(NULL),
+  compute_program_next(NULL),
   id_vao(0),
   id_vbo(0),
-  nb_layers(0),
-  id_fbo(NULL),
-  id_min_max_tex(NULL)
+  nb_levels(0),
+  id_fbo(0),
+  id_min_max_tex(0)
 {
 }
 
@@ -29,7 +46,13 @@ MinMaxMipmaps::~MinMaxMipmaps()
 // ---------------------------------------------------------------------
 void MinMaxMipmaps::setup()
 {
-	createFBOs();
+	// NB: the compute shader does not write the level 0 of a 1x1 pyramid
+	use_compute_shader = (glxwHasComputeShader() && computeMinMaxNbLevels(target_width, target_height) > 1);
+	if(use_compute_shader)
+		logInfo("min-max mipmaps: using compute shaders");
+
+	createTexture();
+	createFBO();
 	createPrograms();
 	createVBOAndVAO();
 }
@@ -44,20 +67,22 @@ void MinMaxMipmaps::cleanup()
 	assert(program_next != NULL);
 	delete program_next;
 	program_next = NULL;
+
+	delete compute_program_first;
+	compute_program_first = NULL;
+
+	delete compute_program_next;
+	compute_program_next = NULL;
 	
-	// FBOs and textures
-	assert(nb_layers > 0);
-	assert(id_fbo != NULL);
-	assert(id_min_max_tex != NULL);
-	
-	glDeleteFramebuffers(nb_layers, id_fbo);
-	glDeleteTextures(nb_layers, id_min_max_tex);
-	nb_layers = 0;
-	delete [] id_fbo;
-	id_fbo = NULL;
-	
-	delete [] id_min_max_tex;
-	id_min_max_tex = NULL;
+	// FBO and texture
+	assert(id_fbo != 0);
+	glutil::deleteFramebuffers(1, &id_fbo);
+	id_fbo = 0;
+
+	assert(id_min_max_tex != 0);
+	glutil::deleteTextures(1, &id_min_max_tex);
+	id_min_max_tex = 0;
+	nb_levels = 0;
 	
 	// VBO/VAO
 	assert(id_vbo != 0);
@@ -65,126 +90,182 @@ void MinMaxMipmaps::cleanup()
 	id_vbo = 0;
 
 	assert(id_vao != 0);
-	glDeleteVertexArrays(1, &id_vao);
+	glutil::deleteVertexArrays(1, &id_vao);
 	id_vao = 0;
 }
 
 // ---------------------------------------------------------------------
-void MinMaxMipmaps::run(GLuint id_tex_position)
+void MinMaxMipmaps::run(GLuint id_tex_depth, const mat4& inv_proj_matrix)
 {
-	uint w = target_width >> 1;
-	uint h = target_height >> 1;
-	
+	if(use_compute_shader)
+	{
+		runCompute(id_tex_depth, inv_proj_matrix);
+		return;
+	}
+
 	// Disable the depth test:
 	glutil::Disable<GL_DEPTH_TEST> depth_test_state;
+
+	glutil::BindFramebuffer fbo_binding(id_fbo);
+	glutil::bindVertexArray(id_vao);
+	glutil::activeTexture(GL_TEXTURE0);
+
+	uint w = target_width;
+	uint h = target_height;
 	
-	for(uint i=0 ; i < nb_layers ; i++)
+	for(uint i=0 ; i < nb_levels ; i++)
 	{
-		glutil::BindFramebuffer fbo_binding(id_fbo[i]);
-		
+		// Render to the level i:
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, id_min_max_tex, i);
 		glutil::SetViewport viewport(0, 0, w, h);
 		
 		if(i == 0)
 		{
-			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-			glClear(GL_COLOR_BUFFER_BIT);
-			
 			program_first->use();
 			
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_RECTANGLE, id_tex_position);
-			program_first->sendUniform("tex_position", 0);
-			
-			program_next->sendUniform("source_size", vec2(w, h));
+			glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_tex_depth);
+			glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+			program_first->sendUniform("tex_depth", 0);
+			program_first->sendUniform("inv_proj_matrix", inv_proj_matrix);
 		}
 		else
 		{
 			program_next->use();
 			
-			const GLuint id_tex_prev_layer = id_min_max_tex[i-1];
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_RECTANGLE, id_tex_prev_layer);
-			program_next->sendUniform("tex_prev_layer", 0);
-			
-			program_next->sendUniform("source_size", vec2(w, h));
+			// Only the previous level can be sampled:
+			glutil::bindTexture(GL_TEXTURE_2D, id_min_max_tex);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, i-1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,  i-1);
+			program_next->sendUniform("tex_prev_level", 0);
 		}
 	
-		// Bind the VAO and draw
+		// Draw
 		const uint nb_vertices = 6;
-		glBindVertexArray(id_vao);
 		glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
 		
-		w >>= 1;
-		h >>= 1;
+		w = glm::max(w >> 1, 1U);
+		h = glm::max(h >> 1, 1U);
 	}
+
+	// Make all the levels accessible again:
+	glutil::bindTexture(GL_TEXTURE_2D, id_min_max_tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,  nb_levels-1);
 }
 
-// ---------------------------------------------------------------------
-void MinMaxMipmaps::createFBOs()
+void MinMaxMipmaps::runCompute(GLuint id_tex_depth, const mat4& inv_proj_matrix)
 {
-	// Compute nb_layers
-	uint w = target_width >> 1;
-	uint h = target_height >> 1;
-	nb_layers = 0;
-	while(w >= 16)	// up to 16x9 - TODO: common denominator
+	glutil::activeTexture(GL_TEXTURE0);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_tex_depth);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+	uint w = target_width;
+	uint h = target_height;
+	uint src_level = 0;
+
+	while(src_level < nb_levels-1)
 	{
-		nb_layers++;
-		w >>= 1;
-		h >>= 1;
+		uint nb_dst_levels = glm::min(uint(MIN_MAX_MIPMAPS_TILE_NB_LEVELS), nb_levels-1 - src_level);
+
+		glutil::GPUProgram* program = (src_level == 0 ? compute_program_first : compute_program_next);
+		program->use();
+		program->sendUniform("nb_dst_levels", GLint(nb_dst_levels));
+		if(src_level == 0)
+			program->sendUniform("inv_proj_matrix", inv_proj_matrix);
+
+		// Image units: 0 for the source level, 1+i for the destination levels
+		glBindImageTexture(0, id_min_max_tex, src_level, GL_FALSE, 0,
+						   (src_level == 0 ? GL_WRITE_ONLY : GL_READ_ONLY), GL_RG32F);
+		for(uint i=0 ; i < nb_dst_levels ; i++)
+			glBindImageTexture(1+i, id_min_max_tex, src_level+1+i, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+
+		// One work group per tile of 2^MIN_MAX_MIPMAPS_TILE_NB_LEVELS texels of the source level:
+		glDispatchCompute(glm::max(w >> MIN_MAX_MIPMAPS_TILE_NB_LEVELS, 1U),
+						  glm::max(h >> MIN_MAX_MIPMAPS_TILE_NB_LEVELS, 1U),
+						  1);
+
+		// The next dispatch reads the last level:
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		for(uint i=0 ; i < nb_dst_levels ; i++)
+		{
+			w = glm::max(w >> 1, 1U);
+			h = glm::max(h >> 1, 1U);
+		}
+		src_level += nb_dst_levels;
 	}
-	
-	id_fbo = new GLuint[nb_layers];
-	id_min_max_tex = new GLuint[nb_layers];
-	
-	glGenFramebuffers(nb_layers, id_fbo);
-	
-	// Create all layers
-	w = target_width >> 1;
-	h = target_height >> 1;
-	for(uint i=0 ; i < nb_layers ; i++)
+
+	// The pyramid is then sampled:
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	GL_CHECK();
+}
+
+// ---------------------------------------------------------------------
+void MinMaxMipmaps::createTexture()
+{
+	nb_levels = computeMinMaxNbLevels(target_width, target_height);
+
+	glGenTextures(1, &id_min_max_tex);
+	glutil::bindTexture(GL_TEXTURE_2D, id_min_max_tex);
+
+	// Set the filter
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,  nb_levels-1);
+
+	// Create the levels
+	uint w = target_width;
+	uint h = target_height;
+	for(uint i=0 ; i < nb_levels ; i++)
 	{
-		// Setup the textures:
-		id_min_max_tex[i] = glutil::createTextureRectRGBAF(w, h, true);
-	
-		GL_CHECK();
-	
-		// Setup a FBO:
-		glutil::BindFramebuffer fbo_binding(id_fbo[i]);
-	
-		// - attach the texture:
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_RECTANGLE, id_min_max_tex[i], 0);
-	
-		GL_CHECK();
-	
-		// - specify the draw buffers :
-		static const GLenum draw_buffers[] = {
-			GL_COLOR_ATTACHMENT0,
-		};
-		glDrawBuffers(sizeof(draw_buffers) / sizeof(GLenum), draw_buffers);
-	
-		// Check the FBO:
-		GLenum fbo_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-	
-		if(fbo_status == GL_FRAMEBUFFER_COMPLETE)
-			logSuccess("FBO creation");
-		else
-			logError("FBO not complete");
-		
-		w >>= 1;
-		h >>= 1;
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RG32F, w, h, 0, GL_RG, GL_FLOAT, NULL);
+
+		w = glm::max(w >> 1, 1U);
+		h = glm::max(h >> 1, 1U);
 	}
+
+	GL_CHECK();
+}
+
+void MinMaxMipmaps::createFBO()
+{
+	glGenFramebuffers(1, &id_fbo);
+
+	glutil::BindFramebuffer fbo_binding(id_fbo);
+
+	// - attach the first level (run() attaches the others):
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, id_min_max_tex, 0);
+
+	// - specify the draw buffers :
+	static const GLenum draw_buffers[] = {
+		GL_COLOR_ATTACHMENT0,
+	};
+	glDrawBuffers(sizeof(draw_buffers) / sizeof(GLenum), draw_buffers);
+
+	// Check the FBO:
+	GLenum fbo_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	if(fbo_status == GL_FRAMEBUFFER_COMPLETE)
+		logSuccess("FBO creation");
+	else
+		logError("FBO not complete");
 }
 
 // ---------------------------------------------------------------------
 void MinMaxMipmaps::createPrograms()
 {
-	stringstream ss;
 	bool ok = false;
 
-	// First layer program
+	// First level program
 	{
-		program_first = new glutil::GPUProgram(	"media/shaders/min_max_mipmaps_first.vert",
-												"media/shaders/min_max_mipmaps_first.frag");
+		program_first = new glutil::GPUProgram(	"media/shaders/min_max_mipmaps.vert",
+												"media/shaders/min_max_mipmaps.frag");
+
+		program_first->getPreprocessor()->setSymbols("_FIRST_LEVEL_", NULL);
 	
 		// Compile, attach, set the locations, link
 		ok = program_first->compileAndAttach();
@@ -193,33 +274,23 @@ void MinMaxMipmaps::createPrograms()
 		program_first->bindAttribLocations(MIN_MAX_MIPMAPS_ATTRIB_POSITION, "vertex_position",
 		                                   0, NULL);
 	
-		program_first->bindFragDataLocations(	MIN_MAX_MIPMAPS_FRAG_DATA_OUTPUT, "frag_output",
+		program_first->bindFragDataLocations(MIN_MAX_MIPMAPS_FRAG_DATA_OUTPUT, "frag_output",
 		                                     0, NULL);
 	
 		ok &= program_first->link();
 		assert(ok);
 	
 		// Set the uniform names
-		list<string> uniform_names;
-		uniform_names.push_back("tex_position");
-		uniform_names.push_back("source_size");
-	
-		program_first->setUniformNames(uniform_names);
+		program_first->setUniformNames("tex_depth", "inv_proj_matrix", NULL);
 	
 		// Validate
 		program_first->validate();
 	}
 	
-	// Next layers program
+	// Next levels program
 	{
-		program_next = new glutil::GPUProgram(	"media/shaders/min_max_mipmaps_next.vert",
-												"media/shaders/min_max_mipmaps_next.frag");
-	
-		// Prepare the list of symbols:
-		Preprocessor::SymbolList symbols;
-	
-		// Set the symbols:
-		program_next->getPreprocessor()->setSymbols(symbols);
+		program_next = new glutil::GPUProgram(	"media/shaders/min_max_mipmaps.vert",
+												"media/shaders/min_max_mipmaps.frag");
 	
 		// Compile, attach, set the locations, link
 		ok = program_next->compileAndAttach();
@@ -235,15 +306,45 @@ void MinMaxMipmaps::createPrograms()
 		assert(ok);
 	
 		// Set the uniform names
-		list<string> uniform_names;
-		uniform_names.push_back("tex_prev_layer");
-		uniform_names.push_back("source_size");
-	
-		program_next->setUniformNames(uniform_names);
+		program_next->setUniformNames("tex_prev_level", NULL);
 	
 		// Validate
 		program_next->validate();
 	}
+
+	// Compute programs
+	if(use_compute_shader)
+	{
+		compute_program_first = createComputeProgram(true);
+		compute_program_next  = createComputeProgram(false);
+	}
+}
+
+glutil::GPUProgram* MinMaxMipmaps::createComputeProgram(bool first_level)
+{
+	glutil::GPUProgram* p = new glutil::GPUProgram("", "");
+	p->setComputeShader("media/shaders/min_max_mipmaps.comp");
+
+	if(first_level)
+		p->getPreprocessor()->setSymbols("_FIRST_LEVEL_", NULL);
+
+	// Compile, attach, link
+	bool ok = p->compileAndAttach();
+	assert(ok);
+
+	ok &= p->link();
+	assert(ok);
+
+	// Set the uniform names
+	if(first_level)
+		p->setUniformNames("nb_dst_levels", "inv_proj_matrix", NULL);
+	else
+		p->setUniformNames("nb_dst_levels", NULL);
+
+	// Validate
+	p->validate();
+
+	return p;
 }
 
 // ---------------------------------------------------------------------
@@ -253,7 +354,7 @@ void MinMaxMipmaps::createVBOAndVAO()
 	glGenVertexArrays(1, &id_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Vertex and coordinates:
 	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
@@ -284,3 +385,79 @@ void MinMaxMipmaps::createVBOAndVAO()
 	glVertexAttribPointer(MIN_MAX_MIPMAPS_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)offset);
 	offset += sizeof(GLfloat)*nb_vertices*2;
 }
+
+// ---------------------------------------------------------------------
+// MinMaxPyramid: same computations as min_max_mipmaps.frag
+void MinMaxPyramid::build(const float* distances, uint width, uint height)
+{
+	uint nb_levels = computeMinMaxNbLevels(width, height);
+
+	widths.resize(nb_levels);
+	heights.resize(nb_levels);
+	levels.resize(nb_levels);
+
+	// First level:
+	widths[0] = width;
+	heights[0] = height;
+	levels[0].resize(width*height);
+
+	for(uint i=0 ; i < width*height ; i++)
+		levels[0][i] = vec2(distances[i]);
+
+	// Next levels:
+	for(uint l=1 ; l < nb_levels ; l++)
+	{
+		uint prev_w = widths[l-1];
+		uint prev_h = heights[l-1];
+		const vector<vec2>& prev = levels[l-1];
+
+		uint w = glm::max(prev_w >> 1, 1U);
+		uint h = glm::max(prev_h >> 1, 1U);
+
+		widths[l] = w;
+		heights[l] = h;
+		levels[l].resize(w*h);
+
+		for(uint y=0 ; y < h ; y++)
+			for(uint x=0 ; x < w ; x++)
+			{
+				// Texels of the previous level covered by (x, y), including the extra column/row
+				// of the previous level for the last texels:
+				uint x_begin = 2*x;
+				uint y_begin = 2*y;
+				uint x_end = (x == w-1 ? prev_w : glm::min(x_begin+2, prev_w));
+				uint y_end = (y == h-1 ? prev_h : glm::min(y_begin+2, prev_h));
+
+				vec2 min_max = prev[y_begin*prev_w + x_begin];
+				for(uint j=y_begin ; j < y_end ; j++)
+					for(uint i=x_begin ; i < x_end ; i++)
+					{
+						const vec2& v = prev[j*prev_w + i];
+						min_max.x = glm::min(min_max.x, v.x);
+						min_max.y = glm::max(min_max.y, v.y);
+					}
+
+				levels[l][y*w + x] = min_max;
+			}
+	}
+}
+
+void MinMaxPyramid::buildFromDepth(const float* depths, uint width, uint height, const mat4& inv_proj_matrix)
+{
+	vector<float> distances(width*height);
+
+	for(uint y=0 ; y < height ; y++)
+		for(uint x=0 ; x < width ; x++)
+		{
+			// Normalized device coordinates of the center of the pixel:
+			vec4 ndc(2.0f * (float(x) + 0.5f) / float(width)  - 1.0f,
+					 2.0f * (float(y) + 0.5f) / float(height) - 1.0f,
+					 2.0f * depths[y*width + x] - 1.0f,
+					 1.0f);
+
+			vec4 pos = inv_proj_matrix * ndc;
+			distances[y*width + x] = -pos.z / pos.w;
+		}
+
+	build(&distances[0], width, height);
+}
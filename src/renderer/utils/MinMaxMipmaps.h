@@ -1,26 +1,47 @@
 // MinMaxMipmaps.h
-  
+// Hierarchical min-max depth pyramid: the mip levels of one RG32F texture contain the minimum (r)
+// and the maximum (g) distance from the eye (-z in eye space) of the pixels they cover.
+// Level 0 has the size of the target and is computed from the depth buffer of a G-buffer. Each
+// next level is half the size of the previous one (rounded down, like OpenGL's mipmaps), and when
+// the previous level has an odd size, the last texels also cover its extra column/row.
+// The levels are rendered one after the other with the same FBO, each one reading the previous
+// level (the base and max levels of the texture restrict the sampling to it).
+// With compute shaders (see glxwHasComputeShader()), the levels are instead computed 5 by 5 in
+// shared memory (see media/shaders/min_max_mipmaps.comp): one dispatch for up to 6 levels,
+// i.e. 2 dispatches instead of 11 passes for 1280x720. A single dispatch would need all the
+// levels bound as images at once, which is more than the 8 image units guaranteed by OpenGL.
+// MinMaxPyramid computes the same pyramid on the CPU (e.g. for testing the screen-space ray marching).
+
 #ifndef MIN_MAX_MIPMAPS_H
 #define MIN_MAX_MIPMAPS_H
 
 #include "../../Common.h"
 #include "../../glutil/GPUProgram.h"
+#include <vector>
+
+// Number of levels of a min-max pyramid (down to 1x1)
+uint computeMinMaxNbLevels(uint width, uint height);
 
+// ---------------------------------------------------------------------
 class MinMaxMipmaps
 {
 private:
 	uint target_width;
 	uint target_height;
 
-	glutil::GPUProgram* program_first;	// first layer
-	glutil::GPUProgram* program_next;	// next layers
+	glutil::GPUProgram* program_first;	// first level, from the depth buffer
+	glutil::GPUProgram* program_next;	// next levels
+
+	bool use_compute_shader;
+	glutil::GPUProgram* compute_program_first;	// first levels, from the depth buffer
+	glutil::GPUProgram* compute_program_next;	// next levels
 
 	GLuint id_vao;
 	GLuint id_vbo;
-	
-	uint nb_layers;
-	GLuint* id_fbo;
-	GLuint* id_min_max_tex;	// TODO: use mipmaps
+
+	uint nb_levels;
+	GLuint id_fbo;
+	GLuint id_min_max_tex;	// RG32F, with nb_levels mip levels
 
 public:
 	MinMaxMipmaps(uint target_width, uint target_height);
@@ -29,15 +50,44 @@ public:
 	void setup();
 	void cleanup();
 
-	void run(GLuint id_tex_position);
-	
-	uint getNbLayers() const {return nb_layers;}
-	GLuint getMinMaxTex(int i) const {return id_min_max_tex[i];}
-	
+	// id_tex_depth: depth texture (rectangle) of a G-buffer, rendered with the given
+	// projection matrix (see GBuffer::getTexDepth() and GBuffer::getInvProjMatrix())
+	void run(GLuint id_tex_depth, const mat4& inv_proj_matrix);
+
+	uint getNbLevels() const {return nb_levels;}
+	GLuint getMinMaxTex() const {return id_min_max_tex;}
+
 private:
-	void createFBOs();
+	void runCompute(GLuint id_tex_depth, const mat4& inv_proj_matrix);
+
+	void createTexture();
+	void createFBO();
 	void createPrograms();
+	glutil::GPUProgram* createComputeProgram(bool first_level);
 	void createVBOAndVAO();
 };
 
+// ---------------------------------------------------------------------
+// CPU version of the pyramid
+class MinMaxPyramid
+{
+private:
+	std::vector<uint> widths;
+	std::vector<uint> heights;
+	std::vector< std::vector<vec2> > levels;	// min/max of each texel, row after row
+
+public:
+	// Build the pyramid from the distances from the eye of the pixels, row after row
+	void build(const float* distances, uint width, uint height);
+
+	// Build the pyramid from a depth buffer (values in [0, 1]), rendered with the given projection
+	void buildFromDepth(const float* depths, uint width, uint height, const mat4& inv_proj_matrix);
+
+	uint getNbLevels() const         {return levels.size();}
+	uint getWidth(uint level) const  {return widths[level];}
+	uint getHeight(uint level) const {return heights[level];}
+
+	const vec2& getMinMax(uint level, uint x, uint y) const {return levels[level][y*widths[level] + x];}
+};
+
 #endif // MIN_MAX_MIPMAPS_H
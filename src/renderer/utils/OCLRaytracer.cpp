@@ -87,7 +87,7 @@ void OCLRaytracer::cleanup()
 {
 	// Delete the intersection map:
 	clReleaseMemObject(intersection_map_mem);
-	glDeleteTextures(1, &id_intersection_map);
+	glutil::deleteTextures(1, &id_intersection_map);
 
 	// Release the OpenCL program and kernels:
 	clReleaseKernel(raytrace_kernel);
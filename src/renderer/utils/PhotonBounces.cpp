@@ -0,0 +1,417 @@
+// PhotonBounces.cpp
+
+#include "PhotonBounces.h"
+
+#include "GBuffer.h"
+#include "BounceMap.h"
+#include "PhotonsMap.h"
+#include "HistoPyramid.h"
+#include "MinMaxMipmaps.h"
+#include "../../ShaderLocations.h"
+#include "../../Config.h"
+#include "../../log/Log.h"
+#include "../../glutil/glutil.h"
+#include <cassert>
+using namespace std;
+
+// ---------------------------------------------------------------------
+#define PHOTON_SIZE (3*sizeof(vec4))	// see photon_bounces.vert
+
+#define SEED_OFFSET_FACTOR 17.0f	// changes the random numbers of each bounce
+
+// ---------------------------------------------------------------------
+PhotonBounces::PhotonBounces()
+: capacity(0),
+  id_scattered_buffer(0),
+  id_hits_buffer(0),
+  id_tex_hits(0),
+  id_scattered_vao(0),
+  id_hits_vao(0),
+  id_empty_vao(0),
+  use_feedback_draws(false),
+  id_scattered_feedback(0),
+  id_hits_feedback(0),
+  num_queries(0),
+  nb_passes(0),
+  nb_prev_passes(0),
+  nb_scattered(0),
+  nb_hits(0),
+  scattered_stamp(0.0f),
+  hits_stamp(0.0f),
+  next_stamp(1),
+  scatter_first_program(NULL),
+  scatter_program(NULL),
+  trace_program(NULL)
+{
+}
+
+PhotonBounces::~PhotonBounces()
+{
+}
+
+// ---------------------------------------------------------------------
+void PhotonBounces::setup()
+{
+	use_feedback_draws = glxwHasTransformFeedback2();
+	if(use_feedback_draws)
+		logInfo("photon bounces: using glDrawTransformFeedback()");
+
+	createBuffersAndVAOs();
+	createPrograms();
+
+	num_queries = 0;
+	nb_passes = 0;
+	nb_prev_passes = 0;
+}
+
+void PhotonBounces::cleanup()
+{
+	// Queries
+	for(uint i=0 ; i < 2 ; i++)
+	{
+		if(!id_queries[i].empty())
+			glDeleteQueries(id_queries[i].size(), &id_queries[i][0]);
+		id_queries[i].clear();
+	}
+
+	// Transform feedback objects
+	if(use_feedback_draws)
+	{
+		glDeleteTransformFeedbacks(1, &id_scattered_feedback);
+		glDeleteTransformFeedbacks(1, &id_hits_feedback);
+	}
+	id_scattered_feedback = 0;
+	id_hits_feedback = 0;
+
+	// Programs
+	delete scatter_first_program;
+	scatter_first_program = NULL;
+
+	delete scatter_program;
+	scatter_program = NULL;
+
+	delete trace_program;
+	trace_program = NULL;
+
+	// VAOs
+	glutil::deleteVertexArrays(1, &id_scattered_vao);
+	glutil::deleteVertexArrays(1, &id_hits_vao);
+	glutil::deleteVertexArrays(1, &id_empty_vao);
+	id_scattered_vao = 0;
+	id_hits_vao = 0;
+	id_empty_vao = 0;
+
+	// Buffers
+	glutil::deleteTextures(1, &id_tex_hits);
+	id_tex_hits = 0;
+
+	glDeleteBuffers(1, &id_scattered_buffer);
+	glDeleteBuffers(1, &id_hits_buffer);
+	id_scattered_buffer = 0;
+	id_hits_buffer = 0;
+
+	capacity = 0;
+	nb_scattered = 0;
+	nb_hits = 0;
+}
+
+// ---------------------------------------------------------------------
+void PhotonBounces::beginFrame()
+{
+	// The queries of the previous frame are now read by the passes of this one:
+	num_queries = 1 - num_queries;
+	nb_prev_passes = nb_passes;
+	nb_passes = 0;
+}
+
+void PhotonBounces::scatterPhotonsMap(const PhotonsMap* photons_map,
+									  const BounceMap* bounce_map,
+									  const HistoPyramid* hits,
+									  const GBuffer* front_gbuffer,
+									  const mat4& eye_proj,
+									  uint num_bounce)
+{
+	uint size = photons_map->getSize();
+	uint texunit = 0;
+
+	reserve(hits->getMaxCount());
+
+	scatter_first_program->use();
+
+	scatter_first_program->sendUniform("eye_proj_matrix", eye_proj);
+	scatter_first_program->sendUniform("seed_offset", SEED_OFFSET_FACTOR * float(num_bounce));
+	scatter_first_program->sendUniform("photons_map_size", GLint(size));
+
+	BIND_TEX(GL_TEXTURE_RECTANGLE, photons_map->getTexOutput0(),     "tex_photons_map_0",    scatter_first_program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, photons_map->getTexOutput1(),     "tex_photons_map_1",    scatter_first_program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, bounce_map->getTexOutput0(),      "tex_bounce_map_0",     scatter_first_program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, bounce_map->getTexOutput1(),      "tex_bounce_map_1",     scatter_first_program, texunit);
+	BIND_TEX(GL_TEXTURE_BUFFER,    hits->getTexIndices(),            "tex_photon_indices",   scatter_first_program, texunit);
+
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexNormals(),   "tex_gbuffer_normal",   scatter_first_program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexDiffuse(),   "tex_gbuffer_diffuse",  scatter_first_program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexSpecular(),  "tex_gbuffer_specular", scatter_first_program, texunit);
+
+	// One vertex per hit of the photons map:
+	nb_scattered = runPass(scatter_first_program,
+						   id_empty_vao, 0, 0, hits, 0.0f,
+						   id_scattered_buffer, id_scattered_feedback, &scattered_stamp);
+	nb_hits = 0;
+}
+
+void PhotonBounces::trace(const MinMaxMipmaps* min_max_mipmaps, const mat4& eye_proj)
+{
+	uint texunit = 0;
+
+	trace_program->use();
+
+	trace_program->sendUniform("eye_proj_matrix", eye_proj);
+	trace_program->sendUniform("min_max_nb_levels", GLint(min_max_mipmaps->getNbLevels()));
+
+	BIND_TEX(GL_TEXTURE_2D, min_max_mipmaps->getMinMaxTex(), "tex_min_max", trace_program, texunit);
+
+	nb_hits = runPass(trace_program,
+					  id_scattered_vao, nb_scattered, id_scattered_feedback, NULL, scattered_stamp,
+					  id_hits_buffer, id_hits_feedback, &hits_stamp);
+}
+
+void PhotonBounces::scatterHits(const GBuffer* front_gbuffer, const mat4& eye_proj, uint num_bounce)
+{
+	uint texunit = 0;
+
+	scatter_program->use();
+
+	scatter_program->sendUniform("eye_proj_matrix", eye_proj);
+	scatter_program->sendUniform("seed_offset", SEED_OFFSET_FACTOR * float(num_bounce));
+
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexNormals(),   "tex_gbuffer_normal",   scatter_program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexDiffuse(),   "tex_gbuffer_diffuse",  scatter_program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexSpecular(),  "tex_gbuffer_specular", scatter_program, texunit);
+
+	nb_scattered = runPass(scatter_program,
+						   id_hits_vao, nb_hits, id_hits_feedback, NULL, hits_stamp,
+						   id_scattered_buffer, id_scattered_feedback, &scattered_stamp);
+}
+
+// ---------------------------------------------------------------------
+void PhotonBounces::reserve(uint nb_photons)
+{
+	if(nb_photons <= capacity)
+		return;
+
+	capacity = nb_photons;
+
+	// (the VAOs and the buffer texture keep referencing the same buffers)
+	glBindBuffer(GL_ARRAY_BUFFER, id_scattered_buffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity*PHOTON_SIZE, NULL, GL_DYNAMIC_COPY);
+
+	glBindBuffer(GL_ARRAY_BUFFER, id_hits_buffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity*PHOTON_SIZE, NULL, GL_DYNAMIC_COPY);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GL_CHECK();
+}
+
+uint PhotonBounces::runPass(glutil::GPUProgram* program,
+							GLuint id_vao,
+							uint nb_input,
+							GLuint id_input_feedback,
+							const HistoPyramid* input_hits,
+							float input_stamp,
+							GLuint id_output_buffer,
+							GLuint id_output_feedback,
+							float* output_stamp)
+{
+	// Maximum number of input photons:
+	if(input_hits != NULL)
+		nb_input = (input_hits->isCountOnGPU() ? input_hits->getMaxCount() : input_hits->getCount());
+	nb_input = glm::min(nb_input, capacity);
+
+	// NB: the pass is run (and its query issued) even without input, so that the passes keep the
+	// same queries from one frame to the next, and that the output gets a new stamp.
+
+	// Stamps of the input and of the output photons (exact in a float):
+	*output_stamp = float(next_stamp);
+	next_stamp = (next_stamp % 0xFFFFFF) + 1;
+
+	program->sendUniform("input_stamp",  input_stamp);
+	program->sendUniform("output_stamp", *output_stamp);
+
+	// Query of this pass, and number of photons written by the same pass of the previous frame:
+	uint num_pass = nb_passes++;
+
+	std::vector<GLuint>& queries = id_queries[num_queries];
+	if(num_pass >= queries.size())
+	{
+		GLuint id_query = 0;
+		glGenQueries(1, &id_query);
+		queries.push_back(id_query);
+	}
+
+	uint nb_output = nb_input;	// there are never more output photons than input ones
+	const std::vector<GLuint>& prev_queries = id_queries[1 - num_queries];
+	if(num_pass < nb_prev_passes)
+	{
+		// (the result is usually available: it was issued one frame ago)
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(prev_queries[num_pass], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(available)
+		{
+			GLuint prev_nb_output = 0;
+			glGetQueryObjectuiv(prev_queries[num_pass], GL_QUERY_RESULT, &prev_nb_output);
+			nb_output = glm::min(nb_output, uint(prev_nb_output));
+		}
+	}
+
+	// Nothing is rasterized: the photons only go to the transform feedback buffer
+	glutil::Enable<GL_RASTERIZER_DISCARD> rasterizer_discard_state;
+
+	if(use_feedback_draws)
+		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, id_output_feedback);
+	else
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, id_output_buffer);
+
+	glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, queries[num_pass]);
+	glBeginTransformFeedback(GL_POINTS);
+
+	glutil::bindVertexArray(id_vao);
+	if(input_hits != NULL)
+		input_hits->drawArrays(GL_POINTS);
+	else if(use_feedback_draws)
+		glDrawTransformFeedback(GL_POINTS, id_input_feedback);
+	else
+		glDrawArrays(GL_POINTS, 0, nb_input);
+
+	glEndTransformFeedback();
+	glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
+	if(use_feedback_draws)
+		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+	else
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+	GL_CHECK();
+
+	return nb_output;
+}
+
+// ---------------------------------------------------------------------
+void PhotonBounces::createBuffersAndVAOs()
+{
+	// Buffers (allocated by reserve()):
+	glGenBuffers(1, &id_scattered_buffer);
+	glGenBuffers(1, &id_hits_buffer);
+
+	// VAOs reading the photons of the buffers:
+	GLuint id_buffers[] = {id_scattered_buffer, id_hits_buffer};
+	GLuint* id_vaos[] = {&id_scattered_vao, &id_hits_vao};
+
+	for(uint i=0 ; i < 2 ; i++)
+	{
+		glGenVertexArrays(1, id_vaos[i]);
+		glutil::bindVertexArray(*id_vaos[i]);
+
+		glBindBuffer(GL_ARRAY_BUFFER, id_buffers[i]);
+
+		// - enable attributes:
+		glEnableVertexAttribArray(PHOTON_BOUNCES_ATTRIB_POSITION);
+		glEnableVertexAttribArray(PHOTON_BOUNCES_ATTRIB_POWER);
+		glEnableVertexAttribArray(PHOTON_BOUNCES_ATTRIB_DIRECTION);
+
+		// - interleaved attributes:
+		ptrdiff_t offset = 0;
+		glVertexAttribPointer(PHOTON_BOUNCES_ATTRIB_POSITION,  4, GL_FLOAT, GL_FALSE, PHOTON_SIZE, (const GLvoid*)offset);
+		offset += sizeof(vec4);
+		glVertexAttribPointer(PHOTON_BOUNCES_ATTRIB_POWER,     4, GL_FLOAT, GL_FALSE, PHOTON_SIZE, (const GLvoid*)offset);
+		offset += sizeof(vec4);
+		glVertexAttribPointer(PHOTON_BOUNCES_ATTRIB_DIRECTION, 4, GL_FLOAT, GL_FALSE, PHOTON_SIZE, (const GLvoid*)offset);
+	}
+
+	// VAO without attributes (the vertices read the photons map):
+	glGenVertexArrays(1, &id_empty_vao);
+
+	glutil::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// Buffer texture of the hits, for splatting them:
+	id_tex_hits = glutil::createTextureBuffer(GL_RGBA32F, id_hits_buffer);
+
+	// Transform feedback objects writing to the buffers:
+	if(use_feedback_draws)
+	{
+		GLuint* id_feedbacks[] = {&id_scattered_feedback, &id_hits_feedback};
+
+		for(uint i=0 ; i < 2 ; i++)
+		{
+			glGenTransformFeedbacks(1, id_feedbacks[i]);
+			glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, *id_feedbacks[i]);
+			glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, id_buffers[i]);
+		}
+
+		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+	}
+
+	GL_CHECK();
+}
+
+void PhotonBounces::createPrograms()
+{
+	scatter_first_program = createProgram("_SCATTER_", "_FROM_PHOTONS_MAP_");
+	scatter_program       = createProgram("_SCATTER_", NULL);
+	trace_program         = createProgram("_TRACE_",   NULL);
+}
+
+glutil::GPUProgram* PhotonBounces::createProgram(const char* symbol_1, const char* symbol_2)
+{
+	// No fragment shader: nothing is rasterized
+	glutil::GPUProgram* program = new glutil::GPUProgram("media/shaders/photon_bounces.vert", "");
+	program->setGeometryShader("media/shaders/photon_bounces.geom");
+
+	program->getPreprocessor()->setSymbols(symbol_1, symbol_2, NULL);
+	if(GBuffer::isCompact())
+		program->getPreprocessor()->addSymbol(PreprocSym("_COMPACT_GBUFFER_"));
+	if(USE_HIZ_RAY_MARCHING)
+		program->getPreprocessor()->addSymbol(PreprocSym("_HIZ_RAY_MARCHING_"));
+
+	// Compile, attach, set the locations, link
+	bool ok = program->compileAndAttach();
+	assert(ok);
+
+	program->bindAttribLocations(PHOTON_BOUNCES_ATTRIB_POSITION,  "photon_position",
+								 PHOTON_BOUNCES_ATTRIB_POWER,     "photon_power",
+								 PHOTON_BOUNCES_ATTRIB_DIRECTION, "photon_direction",
+								 0, NULL);
+
+	program->setTransformFeedbackVaryings(GL_INTERLEAVED_ATTRIBS,
+										  "out_position",
+										  "out_power",
+										  "out_direction",
+										  NULL);
+
+	ok &= program->link();
+	assert(ok);
+
+	// Set the uniform names
+	program->setUniformNames("eye_proj_matrix",
+							 "tex_gbuffer_normal",
+							 "tex_gbuffer_diffuse",
+							 "tex_gbuffer_specular",
+							 "seed_offset",
+							 "tex_photons_map_0",
+							 "tex_photons_map_1",
+							 "tex_bounce_map_0",
+							 "tex_bounce_map_1",
+							 "photons_map_size",
+							 "tex_photon_indices",
+							 "tex_min_max",
+							 "min_max_nb_levels",
+							 "input_stamp",
+							 "output_stamp",
+							 NULL);
+
+	// Validate
+	program->validate();
+
+	return program;
+}
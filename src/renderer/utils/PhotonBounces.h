@@ -0,0 +1,130 @@
+// PhotonBounces.h
+// Propagation of the photons of a PhotonsMap over the next bounces, in eye space, against the
+// screen G-buffer:
+// - scatterPhotonsMap(): the photons of the photons map which hit a surface are scattered
+//   according to the material of the G-buffer at the hit, with Russian roulette sampling
+// - trace(): the scattered photons are traced in screen space against the min-max pyramid (same
+//   tracing as the photons map), the hits can then be splatted (see getTexHits())
+// - scatterHits(): the hits are scattered again, and so on
+// Each pass is a vertex shader whose outputs are written with transform feedback, and a geometry
+// shader only emits the photons which are still alive (see photon_bounces.vert/.geom). The
+// photon buffers are thus compacted, and each pass only processes the photons which survived the
+// previous one instead of the full size*size grid of the photons map.
+// The number of photons written by a pass is never waited for:
+// - with transform feedback objects (OpenGL 4.0 or GL_ARB_transform_feedback2), the next pass
+//   draws the photons of the previous one with glDrawTransformFeedback();
+// - otherwise, the number of photons written by each pass is read from a query one frame later,
+//   and used as the number of photons of the same pass of the next frame (bounded by its input).
+// The splatting of the hits (instanced volumes) also uses these counts of the previous frame.
+// Each pass writes a stamp in the photons (power.w), and the photons read by the next pass or by
+// the splatting must have the stamp of the buffer (see getHitsStamp()): photons left over in the
+// buffers by other passes are thus ignored when a count is too high. When it is too low, some
+// photons are only missed for a frame.
+
+#ifndef PHOTON_BOUNCES_H
+#define PHOTON_BOUNCES_H
+
+#include "../../Common.h"
+#include "../../glutil/GPUProgram.h"
+#include <vector>
+
+class GBuffer;
+class BounceMap;
+class PhotonsMap;
+class HistoPyramid;
+class MinMaxMipmaps;
+
+class PhotonBounces
+{
+private:
+	uint capacity;	// maximum number of photons of each buffer
+
+	// Photon buffers (3 vec4 per photon, see photon_bounces.vert):
+	GLuint id_scattered_buffer;	// photons leaving a surface
+	GLuint id_hits_buffer;		// photons arriving on a surface
+	GLuint id_tex_hits;			// RGBA32F buffer texture of id_hits_buffer
+
+	GLuint id_scattered_vao;	// id_scattered_buffer as vertex attributes
+	GLuint id_hits_vao;			// id_hits_buffer as vertex attributes
+	GLuint id_empty_vao;		// no attribute (photons read from the photons map)
+
+	// Transform feedback objects writing to the buffers (if use_feedback_draws):
+	bool use_feedback_draws;
+	GLuint id_scattered_feedback;
+	GLuint id_hits_feedback;
+
+	// GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN queries of the passes of the current and the
+	// previous frames (one per pass, in the order of the passes):
+	std::vector<GLuint> id_queries[2];
+	uint num_queries;	// index in id_queries of the current frame
+	uint nb_passes;		// passes of the current frame
+	uint nb_prev_passes;
+
+	// Number of photons of the buffers (counts of the previous frame, see above) and their stamps:
+	uint nb_scattered;
+	uint nb_hits;
+	float scattered_stamp;
+	float hits_stamp;
+	uint next_stamp;
+
+	glutil::GPUProgram* scatter_first_program;	// from the photons map
+	glutil::GPUProgram* scatter_program;		// from the hits
+	glutil::GPUProgram* trace_program;
+
+public:
+	PhotonBounces();
+	virtual ~PhotonBounces();
+
+	void setup();
+	void cleanup();
+
+	// To be called at the beginning of each frame
+	void beginFrame();
+
+	// The photons map has been traced from the bounce map, and front_gbuffer is the screen G-buffer.
+	// hits: compaction of the photons of the photons map which hit something, only these are scattered.
+	// num_bounce is used for changing the random numbers between the bounces.
+	void scatterPhotonsMap(const PhotonsMap* photons_map,
+						   const BounceMap* bounce_map,
+						   const HistoPyramid* hits,
+						   const GBuffer* front_gbuffer,
+						   const mat4& eye_proj,
+						   uint num_bounce);
+
+	// min_max_mipmaps: min-max pyramid of the depth of the screen G-buffer
+	void trace(const MinMaxMipmaps* min_max_mipmaps, const mat4& eye_proj);
+
+	void scatterHits(const GBuffer* front_gbuffer, const mat4& eye_proj, uint num_bounce);
+
+	// Getters (counts of the previous frame, see above):
+	uint getNbScattered() const {return nb_scattered;}
+	uint getNbHits() const      {return nb_hits;}
+
+	// Hits of the last call to trace(): 3 texels per photon (see photon_bounces.vert).
+	// Only the photons with the stamp getHitsStamp() are valid.
+	GLuint getTexHits() const  {return id_tex_hits;}
+	float getHitsStamp() const {return hits_stamp;}
+
+private:
+	void reserve(uint nb_photons);
+
+	// Run a pass of the program over the photons of id_input_buffer (nb_input photons, or the
+	// photons written by id_input_feedback), or over the valid texels of input_hits.
+	// The input stamp is *input_stamp, and *output_stamp is set to the stamp of the output.
+	// Returns the number of photons written to id_output_buffer (estimated, see above).
+	uint runPass(glutil::GPUProgram* program,
+				 GLuint id_vao,
+				 uint nb_input,
+				 GLuint id_input_feedback,
+				 const HistoPyramid* input_hits,
+				 float input_stamp,
+				 GLuint id_output_buffer,
+				 GLuint id_output_feedback,
+				 float* output_stamp);
+
+	void createBuffersAndVAOs();
+	void createPrograms();
+	glutil::GPUProgram* createProgram(const char* symbol_1, const char* symbol_2);
+};
+
+#endif // PHOTON_BOUNCES_H
@@ -4,6 +4,11 @@
 #include "GLRaytracer.h"
 #include "GLRaytracerConfig.h"
 #include "GBuffer.h"
+#include "BounceMap.h"
+#include "PhotonsMap.h"
+#include "HistoPyramid.h"
+#include "MinMaxMipmaps.h"
+#include "../../log/Log.h"
 #include "../../utils/TGALoader.h"
 #include <cassert>
 #include <cmath>
@@ -22,17 +27,53 @@ PhotonVolumesRenderer::PhotonVolumesRenderer(uint layers_width,
 											 uint intersection_map_height,
 											 const string& kernel_filename,
 											 const string& brdf_function)
-: id_vao(0),
+: source(FROM_INTERSECTION_MAP),
+  id_vao(0),
   id_vbo(0),
   id_index_buffer(0),
   id_kernel(0),
   kernel_filename(kernel_filename),
   brdf_function(brdf_function),
   program(NULL),
+  buffer_program(NULL),
   layers_width(layers_width),
   layers_height(layers_height),
   intersection_map_width(intersection_map_width),
-  intersection_map_height(intersection_map_height)
+  intersection_map_height(intersection_map_height),
+  accumulation_width(0),
+  accumulation_height(0),
+  id_accumulation_fbo(0),
+  id_accumulation_tex(0),
+  upsample_program(NULL),
+  id_quad_vao(0),
+  id_quad_vbo(0)
+{
+}
+
+PhotonVolumesRenderer::PhotonVolumesRenderer(uint layers_width,
+											 uint layers_height,
+											 const string& kernel_filename,
+											 const string& brdf_function)
+: source(FROM_PHOTONS_MAP),
+  id_vao(0),
+  id_vbo(0),
+  id_index_buffer(0),
+  id_kernel(0),
+  kernel_filename(kernel_filename),
+  brdf_function(brdf_function),
+  program(NULL),
+  buffer_program(NULL),
+  layers_width(layers_width),
+  layers_height(layers_height),
+  intersection_map_width(0),
+  intersection_map_height(0),
+  accumulation_width(glm::max(layers_width / 2, 1U)),
+  accumulation_height(glm::max(layers_height / 2, 1U)),
+  id_accumulation_fbo(0),
+  id_accumulation_tex(0),
+  upsample_program(NULL),
+  id_quad_vao(0),
+  id_quad_vbo(0)
 {
 }
 
@@ -44,17 +85,55 @@ void PhotonVolumesRenderer::setup()
 {
 	loadKernelTexture();
 	createVBOAndVAO();
-	createProgram();
+
+	if(source == FROM_PHOTONS_MAP)
+	{
+		program = createProgram("_FROM_PHOTONS_MAP_");
+		buffer_program = createProgram("_FROM_PHOTON_BUFFER_");
+
+		createAccumulationFBO();
+		createUpsampleProgram();
+		createQuadVBOAndVAO();
+	}
+	else
+		program = createProgram("_FROM_INTERSECTION_MAP_");
 }
 
 void PhotonVolumesRenderer::cleanup()
 {
+	if(source == FROM_PHOTONS_MAP)
+	{
+		assert(buffer_program != NULL);
+		delete buffer_program;
+		buffer_program = NULL;
+
+		assert(upsample_program != NULL);
+		delete upsample_program;
+		upsample_program = NULL;
+
+		assert(id_accumulation_fbo != 0);
+		glutil::deleteFramebuffers(1, &id_accumulation_fbo);
+		id_accumulation_fbo = 0;
+
+		assert(id_accumulation_tex != 0);
+		glutil::deleteTextures(1, &id_accumulation_tex);
+		id_accumulation_tex = 0;
+
+		assert(id_quad_vbo != 0);
+		glDeleteBuffers(1, &id_quad_vbo);
+		id_quad_vbo = 0;
+
+		assert(id_quad_vao != 0);
+		glutil::deleteVertexArrays(1, &id_quad_vao);
+		id_quad_vao = 0;
+	}
+
 	assert(program != NULL);
 	delete program;
 	program = NULL;
 
 	assert(id_kernel != 0);
-	glDeleteTextures(1, &id_kernel);
+	glutil::deleteTextures(1, &id_kernel);
 	id_kernel = 0;
 
 	assert(id_index_buffer != 0);
@@ -66,7 +145,7 @@ void PhotonVolumesRenderer::cleanup()
 	id_vbo = 0;
 
 	assert(id_vao != 0);
-	glDeleteVertexArrays(1, &id_vao);
+	glutil::deleteVertexArrays(1, &id_vao);
 	id_vao = 0;
 }
 
@@ -105,6 +184,7 @@ void PhotonVolumesRenderer::run(const mat4& eye_view,
 	BIND_TEX(GL_TEXTURE_RECTANGLE, gl_raytracer->getComingDirTex(),  "tex_coming_dir", program, texunit);
 
 	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexPositions(), "tex_gbuffer_position",  program, texunit);
+	program->sendUniform("gbuffer_inv_proj", front_gbuffer->getInvProjMatrix());
 	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexNormals(),   "tex_gbuffer_normal",    program, texunit);
 	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexDiffuse(),   "tex_gbuffer_diffuse",   program, texunit);
 	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexSpecular(),  "tex_gbuffer_specular",  program, texunit);
@@ -114,13 +194,141 @@ void PhotonVolumesRenderer::run(const mat4& eye_view,
     program->validate();
 
 	// Bind the VAO and draw
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 	glDrawElementsInstanced(GL_TRIANGLES, NB_FACES*3, GL_UNSIGNED_INT, 0, bounce_map_size*bounce_map_size);
 
 	// Restore writing to the Z-buffer:
 	glDepthMask(GL_TRUE);
 }
 
+// ---------------------------------------------------------------------
+void PhotonVolumesRenderer::clearAccumulation()
+{
+	assert(source == FROM_PHOTONS_MAP);
+
+	glutil::BindFramebuffer fbo_binding(id_accumulation_fbo);
+
+	glClearColor(0.0, 0.0, 0.0, 0.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void PhotonVolumesRenderer::splatPhotonsMap(const mat4& eye_proj,
+											const PhotonsMap* photons_map,
+											const BounceMap* bounce_map,
+											HistoPyramid* hits,
+											const GBuffer* front_gbuffer)
+{
+	assert(source == FROM_PHOTONS_MAP);
+
+	if(!hits->isCountOnGPU() && hits->getCount() == 0)
+		return;
+
+	uint texunit = 0;
+	uint size = photons_map->getSize();
+
+	glutil::BindFramebuffer fbo_binding(id_accumulation_fbo);
+	glutil::SetViewport viewport(0, 0, accumulation_width, accumulation_height);
+
+	// There is no depth buffer: the volumes only light the surfaces of the G-buffer which are
+	// inside them (see photon_volumes.frag). We draw their back faces, so that each pixel is lit
+	// once by each volume, even when the eye is inside it.
+	glutil::Disable<GL_DEPTH_TEST> depth_test_state;
+	glutil::Enable<GL_CULL_FACE>   cull_face_state;
+	glutil::Enable<GL_BLEND>       blend_state;
+
+	glCullFace(GL_FRONT);
+
+	// Additive blending:
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	// Start using the program:
+	program->use();
+
+	// Send the uniforms:
+	program->sendUniform("eye_proj_matrix", eye_proj);
+	program->sendUniform("photons_map_size", GLint(size));
+
+	// Bind the textures to the corresponding texunits and send the corresponding uniforms:
+	BIND_TEX(GL_TEXTURE_RECTANGLE, photons_map->getTexOutput0(),     "tex_photons_map_0",     program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, photons_map->getTexOutput1(),     "tex_photons_map_1",     program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, bounce_map->getTexOutput0(),      "tex_bounce_map_0",      program, texunit);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, bounce_map->getTexOutput1(),      "tex_bounce_map_1",      program, texunit);
+	BIND_TEX(GL_TEXTURE_BUFFER,    hits->getTexIndices(),            "tex_photon_indices",    program, texunit);
+
+	bindGBufferAndKernel(program, front_gbuffer, &texunit);
+
+	// Bind the VAO and draw all the volumes at once, one per hit:
+	glutil::bindVertexArray(id_vao);
+	hits->drawElementsInstanced(GL_TRIANGLES, NB_FACES*3, GL_UNSIGNED_INT);
+
+	glCullFace(GL_BACK);
+}
+
+void PhotonVolumesRenderer::splatPhotonBuffer(const mat4& eye_proj,
+											  GLuint id_tex_photons,
+											  uint nb_photons,
+											  float photons_stamp,
+											  const GBuffer* front_gbuffer)
+{
+	assert(source == FROM_PHOTONS_MAP);
+
+	if(nb_photons == 0)
+		return;
+
+	uint texunit = 0;
+
+	glutil::BindFramebuffer fbo_binding(id_accumulation_fbo);
+	glutil::SetViewport viewport(0, 0, accumulation_width, accumulation_height);
+
+	// Same states as splatPhotonsMap():
+	glutil::Disable<GL_DEPTH_TEST> depth_test_state;
+	glutil::Enable<GL_CULL_FACE>   cull_face_state;
+	glutil::Enable<GL_BLEND>       blend_state;
+
+	glCullFace(GL_FRONT);
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	buffer_program->use();
+
+	buffer_program->sendUniform("eye_proj_matrix", eye_proj);
+	buffer_program->sendUniform("photons_stamp", photons_stamp);
+
+	BIND_TEX(GL_TEXTURE_BUFFER, id_tex_photons, "tex_photons", buffer_program, texunit);
+
+	bindGBufferAndKernel(buffer_program, front_gbuffer, &texunit);
+
+	// The buffer only contains live photons: one volume per photon
+	// (nb_photons may be too high, the volumes of the photons without the stamp are clipped)
+	glutil::bindVertexArray(id_vao);
+	glDrawElementsInstanced(GL_TRIANGLES, NB_FACES*3, GL_UNSIGNED_INT, 0, nb_photons);
+
+	glCullFace(GL_BACK);
+}
+
+void PhotonVolumesRenderer::upsampleAccumulation(const MinMaxMipmaps* min_max_mipmaps)
+{
+	assert(source == FROM_PHOTONS_MAP);
+
+	uint texunit = 0;
+
+	glutil::SetViewport viewport(0, 0, layers_width, layers_height);
+
+	// Add the indirect lighting to the current framebuffer:
+	glutil::Disable<GL_DEPTH_TEST> depth_test_state;
+	glutil::Enable<GL_BLEND>       blend_state;
+
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	upsample_program->use();
+
+	BIND_TEX(GL_TEXTURE_RECTANGLE, id_accumulation_tex,              "tex_accumulation", upsample_program, texunit);
+	BIND_TEX(GL_TEXTURE_2D,        min_max_mipmaps->getMinMaxTex(),  "tex_min_max",      upsample_program, texunit);
+
+	const uint nb_vertices = 6;
+	glutil::bindVertexArray(id_quad_vao);
+	glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
+}
+
 void PhotonVolumesRenderer::createVBOAndVAO()
 {
 	// Reference about the icosahedron: http://en.wikipedia.org/wiki/Icosahedron
@@ -198,7 +406,7 @@ void PhotonVolumesRenderer::createVBOAndVAO()
 	glGenVertexArrays(1, &id_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Create the buffer for vertices and put the data into it:
 	glGenBuffers(1, &id_vbo);
@@ -219,11 +427,27 @@ void PhotonVolumesRenderer::createVBOAndVAO()
 	glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
 }
 
-void PhotonVolumesRenderer::createProgram()
+void PhotonVolumesRenderer::bindGBufferAndKernel(glutil::GPUProgram* p, const GBuffer* front_gbuffer, uint* texunit)
+{
+	uint& t = *texunit;
+
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexPositions(), "tex_gbuffer_position",  p, t);
+	p->sendUniform("gbuffer_inv_proj", front_gbuffer->getInvProjMatrix());
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexNormals(),   "tex_gbuffer_normal",    p, t);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexDiffuse(),   "tex_gbuffer_diffuse",   p, t);
+	BIND_TEX(GL_TEXTURE_RECTANGLE, front_gbuffer->getTexSpecular(),  "tex_gbuffer_specular",  p, t);
+
+	BIND_TEX(GL_TEXTURE_1D,        id_kernel,                        "tex_kernel",   p, t);
+}
+
+glutil::GPUProgram* PhotonVolumesRenderer::createProgram(const char* source_symbol)
 {
-	stringstream ss;
-	program = new glutil::GPUProgram("media/shaders/photon_volumes.vert",
-									 "media/shaders/photon_volumes.frag");
+	glutil::GPUProgram* program = new glutil::GPUProgram("media/shaders/photon_volumes.vert",
+														 "media/shaders/photon_volumes.frag");
+
+	program->getPreprocessor()->addSymbol(PreprocSym(source_symbol));
+	if(source == FROM_PHOTONS_MAP)
+		program->getPreprocessor()->addSymbol(PreprocSym("_HALF_RESOLUTION_"));
 
 #ifdef DEBUG_USE_DEBUG_FBO_ATTACHMENT
 	program->getPreprocessor()->addSymbol("_DEBUG_USE_DEBUG_FBO_ATTACHMENT_");
@@ -236,6 +460,9 @@ void PhotonVolumesRenderer::createProgram()
 
 	program->getPreprocessor()->addSymbol(PreprocSym("_BRDF_FUNCTION_", brdf_function));
 
+	if(GBuffer::isCompact())
+		program->getPreprocessor()->addSymbol(PreprocSym("_COMPACT_GBUFFER_"));
+
 	bool ok = program->compileAndAttach();
 	assert(ok);
 
@@ -254,13 +481,24 @@ void PhotonVolumesRenderer::createProgram()
 							 "tex_power",
 							 "tex_coming_dir",
 							 "tex_gbuffer_position",
+							 "gbuffer_inv_proj",
 							 "tex_gbuffer_normal",
 							 "tex_gbuffer_diffuse",
 							 "tex_gbuffer_specular",
 							 "tex_kernel",
+							 "tex_photons_map_0",
+							 "tex_photons_map_1",
+							 "tex_bounce_map_0",
+							 "tex_bounce_map_1",
+							 "photons_map_size",
+							 "tex_photon_indices",
+							 "tex_photons",
+							 "photons_stamp",
 							 NULL);
 
 	program->validate();
+
+	return program;
 }
 
 void PhotonVolumesRenderer::loadKernelTexture()
@@ -273,7 +511,7 @@ void PhotonVolumesRenderer::loadKernelTexture()
 
 	// Create the 1D texture:
 	glGenTextures(1, &id_kernel);
-	glBindTexture(GL_TEXTURE_1D, id_kernel);
+	glutil::bindTexture(GL_TEXTURE_1D, id_kernel);
 
 	// We set the filter in case there is a driver requires it, but we don't use filtering anyway.
 	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -292,3 +530,78 @@ void PhotonVolumesRenderer::loadKernelTexture()
 			GL_UNSIGNED_BYTE,
 			(const GLvoid*)(tga.getData()));
 }
+
+// ---------------------------------------------------------------------
+void PhotonVolumesRenderer::createAccumulationFBO()
+{
+	id_accumulation_tex = glutil::createTextureRectRGBAF(accumulation_width, accumulation_height, true);
+
+	GL_CHECK();
+
+	// Setup a FBO:
+	glGenFramebuffers(1, &id_accumulation_fbo);
+	glutil::BindFramebuffer fbo_binding(id_accumulation_fbo);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_RECTANGLE, id_accumulation_tex, 0);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+
+	// Check the FBO:
+	GLenum fbo_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	if(fbo_status == GL_FRAMEBUFFER_COMPLETE)
+		logSuccess("FBO creation");
+	else
+		logError("FBO not complete");
+}
+
+void PhotonVolumesRenderer::createUpsampleProgram()
+{
+	upsample_program = new glutil::GPUProgram("media/shaders/photon_splat_upsample.vert",
+											  "media/shaders/photon_splat_upsample.frag");
+
+	bool ok = upsample_program->compileAndAttach();
+	assert(ok);
+
+	upsample_program->bindAttribLocations(ATTRIB_POSITION, "vertex_position",
+										  0,               NULL);
+	upsample_program->bindFragDataLocation(FRAG_DATA_COLOR, "frag_color");
+
+	ok &= upsample_program->link();
+	assert(ok);
+
+	upsample_program->setUniformNames("tex_accumulation", "tex_min_max", NULL);
+
+	upsample_program->validate();
+}
+
+void PhotonVolumesRenderer::createQuadVBOAndVAO()
+{
+	// Create the VAO:
+	glGenVertexArrays(1, &id_quad_vao);
+
+	// Bind the VAO:
+	glutil::bindVertexArray(id_quad_vao);
+
+	// Vertex coordinates:
+	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
+								-1.0f, -1.0f,	// triangle 1
+								+1.0f, -1.0f,
+								+1.0f, +1.0f,
+
+								-1.0f, -1.0f,	// triangle 2
+								+1.0f, +1.0f,
+								-1.0f, +1.0f,
+							};
+
+	// Create the buffer and put the data into it:
+	glGenBuffers(1, &id_quad_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, id_quad_vbo);
+
+	glBufferData(GL_ARRAY_BUFFER, sizeof(buffer_data), (const GLvoid*)buffer_data, GL_STATIC_DRAW);
+
+	// - enable attributes:
+	glEnableVertexAttribArray(ATTRIB_POSITION);
+
+	// - vertices pointer:
+	glVertexAttribPointer(ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, (const GLvoid*)0);
+}
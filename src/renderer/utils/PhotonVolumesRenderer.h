@@ -1,4 +1,12 @@
 // PhotonVolumesRenderer.h
+// Renders the photons as volumes (oblate spheroids) lighting the surfaces of a G-buffer.
+// The photons come either:
+// - from the intersection map of a GLRaytracer: the volumes are added to the current framebuffer by run()
+// - from PhotonsMap objects: the volumes are splatted into a half-resolution accumulation buffer
+//   (clearAccumulation(), then splatPhotonsMap() for each light), which is then added to the current
+//   framebuffer with a bilateral upsampling (upsampleAccumulation())
+// - from the hits of the next bounces (see PhotonBounces): with splatPhotonBuffer(), into the same
+//   accumulation buffer
 
 #ifndef PHOTON_VOLUMES_RENDERER_H
 #define PHOTON_VOLUMES_RENDERER_H
@@ -8,10 +16,23 @@
 
 class GLRaytracer;
 class GBuffer;
+class BounceMap;
+class PhotonsMap;
+class HistoPyramid;
+class MinMaxMipmaps;
 
 class PhotonVolumesRenderer
 {
+public:
+	enum Source
+	{
+		FROM_INTERSECTION_MAP,
+		FROM_PHOTONS_MAP,
+	};
+
 private:
+	Source source;
+
 	GLuint id_vao;
 	GLuint id_vbo;
 	GLuint id_index_buffer;
@@ -22,6 +43,7 @@ private:
 	std::string brdf_function;
 
 	glutil::GPUProgram* program;
+	glutil::GPUProgram* buffer_program;	// photons from PhotonBounces (FROM_PHOTONS_MAP only)
 
 	uint layers_width;
 	uint layers_height;
@@ -29,13 +51,31 @@ private:
 	uint intersection_map_width;
 	uint intersection_map_height;
 
+	// Half-resolution accumulation buffer (FROM_PHOTONS_MAP only):
+	uint accumulation_width;
+	uint accumulation_height;
+	GLuint id_accumulation_fbo;
+	GLuint id_accumulation_tex;	// RGBA16F
+
+	glutil::GPUProgram* upsample_program;
+	GLuint id_quad_vao;
+	GLuint id_quad_vbo;
+
 public:
+	// Photons from the intersection map of a GLRaytracer:
 	PhotonVolumesRenderer(uint layers_width,
 						  uint layers_height,
 						  uint intersection_map_width,
 						  uint intersection_map_height,
 						  const std::string& kernel_filename,
 						  const std::string& brdf_function);
+
+	// Photons from PhotonsMap objects, lighting a G-buffer of layers_width*layers_height pixels:
+	PhotonVolumesRenderer(uint layers_width,
+						  uint layers_height,
+						  const std::string& kernel_filename,
+						  const std::string& brdf_function);
+
 	virtual ~PhotonVolumesRenderer();
 
 	void setup();
@@ -47,10 +87,42 @@ public:
 			 const GBuffer* front_gbuffer,
 			 uint bounce_map_size);
 
+	void clearAccumulation();
+
+	// hits: compaction of the photons of the photons map which hit something, only these are splatted
+	void splatPhotonsMap(const mat4& eye_proj,
+						 const PhotonsMap* photons_map,
+						 const BounceMap* bounce_map,
+						 HistoPyramid* hits,
+						 const GBuffer* front_gbuffer);
+
+	// id_tex_photons: buffer texture of at most nb_photons photons (see PhotonBounces::getTexHits()),
+	// only the ones with the stamp photons_stamp are splatted
+	void splatPhotonBuffer(const mat4& eye_proj,
+						   GLuint id_tex_photons,
+						   uint nb_photons,
+						   float photons_stamp,
+						   const GBuffer* front_gbuffer);
+
+	// min_max_mipmaps: min-max pyramid of the depth of front_gbuffer
+	void upsampleAccumulation(const MinMaxMipmaps* min_max_mipmaps);
+
+	// Getters:
+	Source getSource() const {return source;}
+	GLuint getAccumulationTex() const {return id_accumulation_tex;}
+	uint getAccumulationWidth() const {return accumulation_width;}
+	uint getAccumulationHeight() const {return accumulation_height;}
+
 private:
 	void loadKernelTexture();
 	void createVBOAndVAO();
-	void createProgram();
+	glutil::GPUProgram* createProgram(const char* source_symbol);
+
+	void bindGBufferAndKernel(glutil::GPUProgram* p, const GBuffer* front_gbuffer, uint* texunit);
+
+	void createAccumulationFBO();
+	void createUpsampleProgram();
+	void createQuadVBOAndVAO();
 };
 
 #endif // PHOTON_VOLUMES_RENDERER_H
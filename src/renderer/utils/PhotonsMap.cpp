@@ -4,8 +4,10 @@
 
 #include "GBuffer.h"
 #include "BounceMap.h"
+#include "MinMaxMipmaps.h"
 #include "../RasterRenderer.h"
 #include "../../ShaderLocations.h"
+#include "../../Config.h"
 #include "../../scene/Scene.h"
 #include "../../scene/Camera.h"
 #include "../../scene/Light.h"
@@ -26,7 +28,7 @@ using namespace std;
 #define PHOTONS_MAP_TEXUNIT_BOUNCE_MAP_0    0
 #define PHOTONS_MAP_TEXUNIT_BOUNCE_MAP_1    1
 #define PHOTONS_MAP_TEXUNIT_LIGHT_POSITIONS 2
-#define PHOTONS_MAP_TEXUNIT_SCREEN_POSITIONS    3
+#define PHOTONS_MAP_TEXUNIT_MIN_MAX         3
 
 #define DEBUG_PHOTONS_MAP_TEXUNIT_PHOTONS_MAP_0    0
 #define DEBUG_PHOTONS_MAP_TEXUNIT_PHOTONS_MAP_1    1
@@ -56,20 +58,20 @@ PhotonsMap::PhotonsMap(uint size)
 PhotonsMap::~PhotonsMap()
 {
 	// Delete the VBO/VAO:
-	glDeleteVertexArrays(1, &id_vao);
+	glutil::deleteVertexArrays(1, &id_vao);
 	glDeleteBuffers(1, &id_vbo);
 
 	// Decrement the reference counting of the GPU program:
 	program = NULL;
 
 	// Delete the FBO and the textures:
-	glDeleteFramebuffers(1, &id_fbo);
+	glutil::deleteFramebuffers(1, &id_fbo);
 
-	glDeleteTextures(1, &id_output0);
-	glDeleteTextures(1, &id_output1);
+	glutil::deleteTextures(1, &id_output0);
+	glutil::deleteTextures(1, &id_output1);
 	
 	// Debug
-	glDeleteVertexArrays(1, &id_debug_vao);
+	glutil::deleteVertexArrays(1, &id_debug_vao);
 	glDeleteBuffers(1, &id_debug_vbo);
 	debug_program = NULL;
 }
@@ -77,14 +79,10 @@ PhotonsMap::~PhotonsMap()
 // ---------------------------------------------------------------------
 void PhotonsMap::run(const BounceMap* bounce_map,
                      const GBuffer* light_gbuffer,
-                     const GBuffer* screen_gbuffer,
+                     const MinMaxMipmaps* min_max_mipmaps,
                      const mat4& eye_proj,
-                     const mat4& eye_view,
-                     uint nb_iterations)
+                     const mat4& eye_view)
 {
-	// TODO
-	(void)nb_iterations;	// unused for now
-	
 	// Bind the FBO:
 	glutil::BindFramebuffer fbo_binding(id_fbo);
 	
@@ -99,20 +97,23 @@ void PhotonsMap::run(const BounceMap* bounce_map,
 	program->sendUniform("tex_bounce_map_0",     PHOTONS_MAP_TEXUNIT_BOUNCE_MAP_0);
 	program->sendUniform("tex_bounce_map_1",     PHOTONS_MAP_TEXUNIT_BOUNCE_MAP_1);
 	program->sendUniform("tex_light_positions",  PHOTONS_MAP_TEXUNIT_LIGHT_POSITIONS);
-	program->sendUniform("tex_screen_positions", PHOTONS_MAP_TEXUNIT_SCREEN_POSITIONS);
+	program->sendUniform("tex_min_max",          PHOTONS_MAP_TEXUNIT_MIN_MAX);
+	program->sendUniform("min_max_nb_levels",    GLint(min_max_mipmaps->getNbLevels()));
+
+	program->sendUniform("light_inv_proj", light_gbuffer->getInvProjMatrix());
 	
 	// Bind the textures:
-	glActiveTexture(GL_TEXTURE0 + PHOTONS_MAP_TEXUNIT_BOUNCE_MAP_0);
-	glBindTexture(GL_TEXTURE_RECTANGLE, bounce_map->getTexOutput0());
+	glutil::activeTexture(GL_TEXTURE0 + PHOTONS_MAP_TEXUNIT_BOUNCE_MAP_0);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, bounce_map->getTexOutput0());
 	
-	glActiveTexture(GL_TEXTURE0 + PHOTONS_MAP_TEXUNIT_BOUNCE_MAP_1);
-	glBindTexture(GL_TEXTURE_RECTANGLE, bounce_map->getTexOutput1());
+	glutil::activeTexture(GL_TEXTURE0 + PHOTONS_MAP_TEXUNIT_BOUNCE_MAP_1);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, bounce_map->getTexOutput1());
 	
-	glActiveTexture(GL_TEXTURE0 + PHOTONS_MAP_TEXUNIT_LIGHT_POSITIONS);
-	glBindTexture(GL_TEXTURE_RECTANGLE, light_gbuffer->getTexPositions());
+	glutil::activeTexture(GL_TEXTURE0 + PHOTONS_MAP_TEXUNIT_LIGHT_POSITIONS);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, light_gbuffer->getTexPositions());
 	
-	glActiveTexture(GL_TEXTURE0 + PHOTONS_MAP_TEXUNIT_SCREEN_POSITIONS);
-	glBindTexture(GL_TEXTURE_RECTANGLE, screen_gbuffer->getTexPositions());
+	glutil::activeTexture(GL_TEXTURE0 + PHOTONS_MAP_TEXUNIT_MIN_MAX);
+	glutil::bindTexture(GL_TEXTURE_2D, min_max_mipmaps->getMinMaxTex());
 	
 	// Compute and send the matrix used for going from light space to eye space:
 	mat4 light_view = getLight()->computeViewMatrix();
@@ -125,7 +126,7 @@ void PhotonsMap::run(const BounceMap* bounce_map,
 	
 	// Draw the VAO:
 	const uint nb_vertices = 6;
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 	glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
 }
 
@@ -152,15 +153,15 @@ void PhotonsMap::debugDraw3D(const mat4& eye_proj_matrix)
 	debug_program->sendUniform("eye_proj_matrix", eye_proj_matrix);
 	
 	// Bind the textures:
-	glActiveTexture(GL_TEXTURE0 + DEBUG_PHOTONS_MAP_TEXUNIT_PHOTONS_MAP_0);
-	glBindTexture(GL_TEXTURE_RECTANGLE, id_output0);
+	glutil::activeTexture(GL_TEXTURE0 + DEBUG_PHOTONS_MAP_TEXUNIT_PHOTONS_MAP_0);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_output0);
 	
-	glActiveTexture(GL_TEXTURE0 + DEBUG_PHOTONS_MAP_TEXUNIT_PHOTONS_MAP_1);
-	glBindTexture(GL_TEXTURE_RECTANGLE, id_output1);
+	glutil::activeTexture(GL_TEXTURE0 + DEBUG_PHOTONS_MAP_TEXUNIT_PHOTONS_MAP_1);
+	glutil::bindTexture(GL_TEXTURE_RECTANGLE, id_output1);
 	
 	// Draw the VAO:
 	const uint nb_vertices = 2;
-	glBindVertexArray(id_debug_vao);
+	glutil::bindVertexArray(id_debug_vao);
 	glDrawArraysInstanced(GL_LINES, 0, nb_vertices, bounce_map_size*bounce_map_size);
 }
 
@@ -212,9 +213,13 @@ void PhotonsMap::createProgram()
 	bool ok = true;
 	bool is_new = false;
 
-	program = getProgramManager().getProgram(
-			GPUProgramID("media/shaders/ray_marching.vert", "media/shaders/ray_marching.frag"),
-			&is_new);
+	GPUProgramID program_id("media/shaders/ray_marching.vert", "media/shaders/ray_marching.frag");
+	if(GBuffer::isCompact())
+		program_id.preproc_sym.push_back(PreprocSym("_COMPACT_GBUFFER_"));
+	if(USE_HIZ_RAY_MARCHING)
+		program_id.preproc_sym.push_back(PreprocSym("_HIZ_RAY_MARCHING_"));
+
+	program = getProgramManager().getProgram(program_id, &is_new);
 
 	// If it is a new program, we should set the attrib location(s),
 	// the frag data location(s), link it and set the uniform names/get their locations.
@@ -236,7 +241,9 @@ void PhotonsMap::createProgram()
 		program->setUniformNames("tex_bounce_map_0",
 								 "tex_bounce_map_1",
 		                         "tex_light_positions",
-		                         "tex_screen_positions",
+		                         "tex_min_max",
+		                         "min_max_nb_levels",
+		                         "light_inv_proj",
 		                         "light_to_eye_matrix",
 		                         "eye_proj_matrix",
 								 NULL);
@@ -255,7 +262,7 @@ void PhotonsMap::createVBOAndVAO()
 	glGenVertexArrays(1, &id_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Vertex coordinates:
 	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
@@ -333,7 +340,7 @@ void PhotonsMap::createDebugVBOAndVAO()
 	glGenVertexArrays(1, &id_debug_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_debug_vao);
+	glutil::bindVertexArray(id_debug_vao);
 
 	// Vertex coordinates:
 	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
@@ -363,7 +370,7 @@ void PhotonsMap::createDebugVBOAndVAO()
 	glGenVertexArrays(1, &id_debug_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_debug_vao);
+	glutil::bindVertexArray(id_debug_vao);
 
 	// Vertex coordinates:
 	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
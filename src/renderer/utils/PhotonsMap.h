@@ -10,6 +10,7 @@
 
 class GBuffer;
 class BounceMap;
+class MinMaxMipmaps;
 
 class PhotonsMap : public LightData
 {
@@ -23,8 +24,8 @@ private:
 
 	GLuint id_fbo;	// FBO
 
-	GLuint id_output0;		// RGBA16F: see ray_marching.frag
-	GLuint id_output1;		// RGBA16F: see ray_marching.frag
+	GLuint id_output0;		// RGBA16F: see ray_marching.frag (w: number of iterations of the ray marching)
+	GLuint id_output1;		// RGBA16F: see ray_marching.frag (w: 1 if the photon hit a surface)
 	
 	// Debug
 	GLuint id_debug_vao;
@@ -37,12 +38,13 @@ public:
 
 	virtual Type getType() const {return PHOTONS_MAP;}
 
+	// The photons are traced in screen space against the min-max pyramid of the screen G-buffer.
+	// This is the first bounce: the next ones are done by PhotonBounces.
 	void run(const BounceMap* bounce_map,
 	         const GBuffer* light_gbuffer,
-	         const GBuffer* screen_gbuffer,
+	         const MinMaxMipmaps* min_max_mipmaps,
 	         const mat4& eye_proj,
-             const mat4& eye_view,
-	         uint nb_iterations=1);
+	         const mat4& eye_view);
 	
 	void debugDraw3D(const mat4& eye_proj_matrix);
 
@@ -0,0 +1,105 @@
+// RenderQueue.cpp
+
+#include "RenderQueue.h"
+#include <cassert>
+#include <cstring>
+
+#define MASK(nb_bits) ((uint64(1) << (nb_bits)) - 1)
+
+RenderQueue::RenderQueue()
+: items(NULL),
+  tmp_items(NULL),
+  nb_items(0),
+  capacity(0)
+{
+	ASSERT_STATIC(PASS_BITS + 1 + PROGRAM_BITS + MATERIAL_BITS + VAO_BITS + DEPTH_BITS <= 64);
+}
+
+RenderQueue::~RenderQueue()
+{
+	delete [] items;
+	delete [] tmp_items;
+}
+
+void RenderQueue::reserve(uint capacity)
+{
+	if(capacity <= this->capacity)
+		return;
+
+	delete [] items;
+	delete [] tmp_items;
+
+	this->capacity = capacity;
+	items = new SortItem[capacity];
+	tmp_items = new SortItem[capacity];
+	nb_items = 0;
+}
+
+void RenderQueue::push(uint64 key, uint value)
+{
+	assert(nb_items < capacity);
+
+	items[nb_items].key = key;
+	items[nb_items].value = value;
+	nb_items++;
+}
+
+void RenderQueue::sort()
+{
+	radixSort(items, tmp_items, nb_items);
+}
+
+// ---------------------------------------------------------------------
+uint64 RenderQueue::makeKey(uint pass,
+							bool transparent,
+							uint program_id,
+							uint material_id,
+							uint vao_id,
+							float depth)
+{
+	assert(pass < NB_PASSES);
+
+	uint64 state =	((uint64(program_id)  & MASK(PROGRAM_BITS))  << (MATERIAL_BITS + VAO_BITS)) |
+					((uint64(material_id) & MASK(MATERIAL_BITS)) << VAO_BITS) |
+					 (uint64(vao_id)      & MASK(VAO_BITS));
+
+	uint64 key = (uint64(pass) << (64 - PASS_BITS));
+
+	if(transparent)
+	{
+		// Back to front:
+		uint64 inv_depth = MASK(DEPTH_BITS) - quantizeDepth(depth);
+
+		key |= (uint64(1) << (63 - PASS_BITS));
+		key |= (inv_depth << (PROGRAM_BITS + MATERIAL_BITS + VAO_BITS));
+		key |= state;
+	}
+	else
+	{
+		// Front to back, inside a group of draws with the same state:
+		key |= (state << DEPTH_BITS);
+		key |= quantizeDepth(depth);
+	}
+
+	return key;
+}
+
+uint64 RenderQueue::getStateBits(uint64 key)
+{
+	if(isTransparent(key))
+		return key & ~(MASK(DEPTH_BITS) << (PROGRAM_BITS + MATERIAL_BITS + VAO_BITS));
+	else
+		return key & ~MASK(DEPTH_BITS);
+}
+
+// The bits of a positive float are in the same order as the float itself: we keep
+// the exponent and the most significant bits of the mantissa.
+uint RenderQueue::quantizeDepth(float depth)
+{
+	if(!(depth > 0.0f))
+		return 0;
+
+	uint bits;
+	memcpy(&bits, &depth, sizeof(uint));
+	return bits >> (31 - DEPTH_BITS);
+}
@@ -0,0 +1,81 @@
+// RenderQueue.h
+// Queue of draw calls, sorted by a 64-bit key encoding the state they need, so that
+// the submission loop changes as few states as possible.
+// Layout of the keys, from the most significant bit:
+// - opaque draws:      | pass (2) | 0 | program (10) | material (14) | VAO (14) | depth (23)      |
+// - transparent draws: | pass (2) | 1 | inverted depth (23) | program (10) | material (14) | VAO (14) |
+// So that the opaque draws are grouped by state and drawn front to back inside a group
+// (for early-Z), and the transparent draws are drawn after them, back to front.
+// The ids are truncated to their number of bits: two different states may have the same
+// id, so that the user has to check that consecutive draws really share the same state
+// before merging them (the ids are only a hint for the sorting).
+// Usage:
+//   queue.clear();
+//   for each draw: queue.push(RenderQueue::makeKey(...), object_index);
+//   queue.sort();
+//   for each item of queue.getItems(): [...]
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "../../Common.h"
+#include "../../utils/RadixSort.h"
+
+class RenderQueue
+{
+public:
+	enum
+	{
+		PASS_BITS     = 2,
+		PROGRAM_BITS  = 10,
+		MATERIAL_BITS = 14,
+		VAO_BITS      = 14,
+		DEPTH_BITS    = 23
+	};
+
+	static const uint NB_PASSES = (1 << PASS_BITS);
+
+private:
+	SortItem* items;
+	SortItem* tmp_items;	// used by the radix sort
+	uint nb_items;
+	uint capacity;
+
+public:
+	RenderQueue();
+	virtual ~RenderQueue();
+
+	// Allocate the queue for at most "capacity" draws (e.g. the number of objects of the scene)
+	void reserve(uint capacity);
+	uint getCapacity() const {return capacity;}
+
+	void clear() {nb_items = 0;}
+
+	// "value" is given back with the key after sorting (e.g. the index of the object)
+	void push(uint64 key, uint value);
+
+	void sort();
+
+	const SortItem* getItems() const {return items;}
+	uint getNbItems() const {return nb_items;}
+
+	// "depth" is the distance along the view direction (negative values are clamped to 0)
+	static uint64 makeKey(uint pass,
+						  bool transparent,
+						  uint program_id,
+						  uint material_id,
+						  uint vao_id,
+						  float depth);
+
+	// Key without the depth: draws needing the same state have the same state bits
+	static uint64 getStateBits(uint64 key);
+
+	static uint getPass(uint64 key)       {return uint(key >> (64 - PASS_BITS));}
+	static bool isTransparent(uint64 key) {return ((key >> (63 - PASS_BITS)) & 1) != 0;}
+
+private:
+	// Depth quantized to DEPTH_BITS bits, keeping the order of the depths
+	static uint quantizeDepth(float depth);
+};
+
+#endif // RENDER_QUEUE_H
@@ -2,51 +2,137 @@
 
 #include "ShadowMap.h"
 
+#include "../../Boundaries.h"
 #include "../../CommonIndices.h"
 #include "../../ShaderLocations.h"
 #include "../../scene/Light.h"
 #include "../../scene/ArrayElementContainer.h"
 #include "../../scene/MeshObject.h"
 #include "../../scene/Geometry.h"
+#include "../../scene/Frustum.h"
 #include "../../scene/Scene.h"
 #include "../../log/Log.h"
 #include "../../glutil/glutil.h"
 #include <cassert>
 using namespace std;
 
+GLuint ShadowMap::id_atlas_fbo = 0;
+GLuint ShadowMap::id_atlas_depth = 0;
+uint ShadowMap::atlas_width = 0;
+uint ShadowMap::atlas_height = 0;
+uint ShadowMap::atlas_ref_count = 0;
+
+// ---------------------------------------------------------------------
+ShadowMap::ShadowMap(uint x, uint y, uint size)
+: x(x),
+  y(y),
+  size(size),
+  program(NULL),
+  rendered(false),
+  rendered_view_proj(1.0),
+  rendered_moves_stamp(0)
+{
+	// Setup the GPUProgram:
+	setupGPUProgram();
+}
+
+// ---------------------------------------------------------------------
+ShadowMap::~ShadowMap()
+{
+	program = NULL;
+}
+
+vec4 ShadowMap::getAtlasRect() const
+{
+	assert(atlas_width != 0 && atlas_height != 0);
+
+	return vec4(float(x)    / float(atlas_width),
+				float(y)    / float(atlas_height),
+				float(size) / float(atlas_width),
+				float(size) / float(atlas_height));
+}
+
 // ---------------------------------------------------------------------
-ShadowMap::ShadowMap(uint size)
-: size(size),
-  id_fbo(0),
-  id_rb_color(0),
-  id_depth(0),
-  program(NULL)
+// Allocate the regions of the shadow maps in the atlas: the shadow maps are sorted by
+// decreasing size and put on shelves, from the bottom to the top of the atlas.
+void ShadowMap::buildAtlas(Light** lights, uint nb_lights)
 {
-	// Check the texture's size
+	deleteAtlas();
+
+	if(nb_lights == 0)
+		return;
+
 	GLint max_texture_size = 0;
 	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
 
-	assert(size <= uint(max_texture_size));
+	// Sort the lights by decreasing shadow map size (there are only a few lights):
+	uint order[NB_MAX_SHADOWED_LIGHTS];
+	uint total_area = 0;
+	uint max_size = 0;
+
+	for(uint i=0 ; i < nb_lights ; i++)
+	{
+		uint size = lights[i]->getShadowMapSize();
+		total_area += size*size;
+		max_size = glm::max(max_size, size);
+
+		uint j = i;
+		for( ; j > 0 && lights[order[j-1]]->getShadowMapSize() < size ; j--)
+			order[j] = order[j-1];
+		order[j] = i;
+	}
 
-	// Setup the color renderbuffer:
-	id_rb_color = glutil::createRenderbufferRGBA8(size, size);
+	// Width of the atlas: power of 2 big enough for a square atlas
+	atlas_width = 1;
+	while(atlas_width < max_size || atlas_width*atlas_width < total_area)
+		atlas_width *= 2;
+	atlas_width = glm::min(atlas_width, uint(max_texture_size));
 
-	// Setup the depth texture:
-	id_depth = glutil::createTextureDepth(size, size);
-	GL_CHECK();
+	// Put the shadow maps on shelves:
+	uint shelf_x = 0;
+	uint shelf_y = 0;
+	uint shelf_height = 0;
+
+	for(uint i=0 ; i < nb_lights ; i++)
+	{
+		Light* l = lights[order[i]];
+		uint size = l->getShadowMapSize();
+
+		if(shelf_x + size > atlas_width)
+		{
+			shelf_x = 0;
+			shelf_y += shelf_height;
+			shelf_height = 0;
+		}
+
+		l->setUserData(LIGHT_DATA_SHADOW_MAP, new ShadowMap(shelf_x, shelf_y, size));
+
+		shelf_x += size;
+		shelf_height = glm::max(shelf_height, size);
+	}
+
+	atlas_height = shelf_y + shelf_height;
+
+	if(atlas_height > uint(max_texture_size))
+		logError("the shadow atlas is too big: ", atlas_width, "x", atlas_height);
+	assert(atlas_height <= uint(max_texture_size));
 
-	// Setup a FBO:
-	glGenFramebuffers(1, &id_fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, id_fbo);
+	logInfo("shadow atlas: ", atlas_width, "x", atlas_height, " for ", nb_lights, " light(s)");
 
-	// Attach the renderbuffer and the texture:
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, id_rb_color);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_TEXTURE_2D,   id_depth,    0);
+	// Setup the depth texture, with shadow comparison:
+	id_atlas_depth = glutil::createTextureDepth(atlas_width, atlas_height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
 	GL_CHECK();
 
-	// We need to attach something to GL_COLOR_ATTACHMENT0 for the FBO to be complete,
-	// but we never need to write to it, hence the glDrawBuffer(GL_NONE):
+	// Setup a depth-only FBO:
+	glGenFramebuffers(1, &id_atlas_fbo);
+	glutil::bindFramebuffer(GL_FRAMEBUFFER, id_atlas_fbo);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, id_atlas_depth, 0);
 	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	GL_CHECK();
 
 	// Check the FBO:
 	GLenum fbo_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -57,21 +143,20 @@ ShadowMap::ShadowMap(uint size)
 		logError("FBO not complete");
 
 	// Back to normal framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// Setup the GPUProgram:
-	setupGPUProgram();
+	glutil::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-// ---------------------------------------------------------------------
-ShadowMap::~ShadowMap()
+void ShadowMap::deleteAtlas()
 {
-	glDeleteFramebuffers(1, &id_fbo);
-
-	glDeleteRenderbuffers(1, &id_rb_color);
-	glDeleteTextures(1, &id_depth);
-
-	program = NULL;
+	if(id_atlas_fbo != 0)
+		glutil::deleteFramebuffers(1, &id_atlas_fbo);
+	if(id_atlas_depth != 0)
+		glutil::deleteTextures(1, &id_atlas_depth);
+
+	id_atlas_fbo = 0;
+	id_atlas_depth = 0;
+	atlas_width = 0;
+	atlas_height = 0;
 }
 
 // ---------------------------------------------------------------------
@@ -106,7 +191,6 @@ void ShadowMap::loadSceneArray(ArrayElementContainer* elements, uint index_vao)
 	uint nb_objects = elements->getNbObjects();
 
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
 
 	// Build the VBOs and VAOs:
 	// For each mesh object:
@@ -123,12 +207,9 @@ void ShadowMap::loadSceneArray(ArrayElementContainer* elements, uint index_vao)
 		mesh_obj->getGeometry()->buildVAO(index_vao, SHADOW_MAP_ATTRIB_POSITION, 0, 0);
 	}
 
-	// Add shadow maps to each light:
-	for(uint i=0 ; i < nb_lights ; i++)
-	{
-		Light* l = lights[i];
-		l->setUserData(LIGHT_DATA_SHADOW_MAP, new ShadowMap(l->getShadowMapSize()));
-	}
+	// Add shadow maps to each shadowed light, in a new atlas:
+	buildAtlas(lights, elements->getNbShadowedLights());
+	atlas_ref_count++;
 }
 
 void ShadowMap::unloadSceneArray(ArrayElementContainer* elements, uint index_vao)
@@ -160,6 +241,12 @@ void ShadowMap::unloadSceneArray(ArrayElementContainer* elements, uint index_vao
 		Light* l = lights[i];
 		l->setUserData(LIGHT_DATA_SHADOW_MAP, NULL);
 	}
+
+	// Delete the atlas when it is not used anymore:
+	assert(atlas_ref_count != 0);
+	atlas_ref_count--;
+	if(atlas_ref_count == 0)
+		deleteAtlas();
 }
 
 // ---------------------------------------------------------------------
@@ -177,9 +264,12 @@ void ShadowMap::renderShadowMaps(Scene* scene, uint vao_index)
 // Array version:
 void ShadowMap::renderShadowMapsArray(ArrayElementContainer* elements, uint vao_index)
 {
-	// For each light, render the shadow map:
+	// For each shadowed light, check if the shadow map is stale:
 	Light** lights = elements->getLights();
-	uint nb_lights = elements->getNbLights();
+	uint nb_lights = elements->getNbShadowedLights();
+
+	ShadowMap* stale_shadow_maps[NB_MAX_SHADOWED_LIGHTS];
+	uint nb_stale_shadow_maps = 0;
 
 	for(uint i=0 ; i < nb_lights ; i++)
 	{
@@ -189,10 +279,54 @@ void ShadowMap::renderShadowMapsArray(ArrayElementContainer* elements, uint vao_
 		assert(l->getUserData(LIGHT_DATA_SHADOW_MAP)->getType() == LightData::SHADOW_MAP);
 
 		ShadowMap* shadow_map = (ShadowMap*)(l->getUserData(LIGHT_DATA_SHADOW_MAP));
-		shadow_map->renderFromLightArray(l, elements, vao_index);
+		if(shadow_map->isStale(l, elements))
+			stale_shadow_maps[nb_stale_shadow_maps++] = shadow_map;
+	}
+
+	if(nb_stale_shadow_maps == 0)
+		return;
+
+	// Render them in a single pass over the atlas:
+	AtlasRendering atlas_rendering;
+
+	for(uint i=0 ; i < nb_stale_shadow_maps ; i++)
+	{
+		ShadowMap* shadow_map = stale_shadow_maps[i];
+		shadow_map->drawFromLightArray(shadow_map->getLight(), elements, vao_index);
 	}
 }
 
+// ---------------------------------------------------------------------
+// Does the shadow map need to be rendered again?
+bool ShadowMap::isStale(const Light* light, const ArrayElementContainer* elements)
+{
+	if(!rendered)
+		return true;
+
+	// The light moved or its projection changed:
+	mat4 view_proj = light->computeProjectionMatrix() * light->computeViewMatrix();
+	if(view_proj != rendered_view_proj)
+		return true;
+
+	// No object moved:
+	uint moves_stamp = elements->getMovesStamp();
+	if(moves_stamp == rendered_moves_stamp)
+		return false;
+
+	// Objects moved several times since the last rendering: we do not know where.
+	if(elements->getPrevMovesStamp() != rendered_moves_stamp)
+		return true;
+
+	// Objects moved once: the shadow map is stale only if they were or are in the frustum of the light
+	const AABB& moves_bounds = elements->getLastMovesBounds();
+	if(!moves_bounds.isEmpty() &&
+	   Frustum(view_proj).isSphereVisible(moves_bounds.getCenter(), glm::length(moves_bounds.getExtents())))
+		return true;
+
+	rendered_moves_stamp = moves_stamp;
+	return false;
+}
+
 // ---------------------------------------------------------------------
 // Render a scene from the point of view of a light
 void ShadowMap::renderFromLight(const Light* light, Scene* scene, uint index_vao)
@@ -207,16 +341,17 @@ void ShadowMap::renderFromLight(const Light* light, Scene* scene, uint index_vao
 
 void ShadowMap::renderFromLightArray(const Light* light, ArrayElementContainer* elements, uint index_vao)
 {
-	// Bind the FBO:
-	glutil::BindFramebuffer fbo_binding(id_fbo);
-
-	// Set the viewport:
-	glutil::SetViewport viewport(0, 0, size, size);
+	AtlasRendering atlas_rendering;
+	drawFromLightArray(light, elements, index_vao);
+}
 
-	// Enable depth testing and cullfacing:
-	glutil::Enable<GL_DEPTH_TEST> depth_test_state;
-	glutil::Enable<GL_CULL_FACE>  cull_face_state;
-	//glutil::Disable<GL_CULL_FACE>  cull_face_state;	// DEBUG!!
+// ---------------------------------------------------------------------
+// Binds the atlas and sets the states shared by all the shadow maps, until the end of the scope
+ShadowMap::AtlasRendering::AtlasRendering()
+: fbo_binding(id_atlas_fbo),
+  viewport(0, 0, atlas_width, atlas_height)
+{
+	assert(id_atlas_fbo != 0);
 
 	// Cull the front faces instead of the back faces.
 	// This way, during shadow comparison, front faces are not flickering and
@@ -225,11 +360,23 @@ void ShadowMap::renderFromLightArray(const Light* light, ArrayElementContainer*
 
 	// Polygon offset is rarely needed because of the cullfacing below, but it can solve
 	// some z-fighting issues:
-	glutil::Enable<GL_POLYGON_OFFSET_FILL> offset_fill_state;
 	glPolygonOffset(1, 1);
 
-	// Clear the depth buffer:
+	// Each shadow map only clears its own region (see the scissor test):
 	glClearDepth(1.0);
+}
+
+ShadowMap::AtlasRendering::~AtlasRendering()
+{
+	// Reset usual cullfacing
+	glCullFace(GL_BACK);
+}
+
+void ShadowMap::drawFromLightArray(const Light* light, ArrayElementContainer* elements, uint index_vao)
+{
+	// Set the viewport and clear the region of the shadow map:
+	glutil::viewport(x, y, size, size);
+	glScissor(x, y, size, size);
 	glClear(GL_DEPTH_BUFFER_BIT);
 
 	// Get some pointers and values
@@ -240,15 +387,18 @@ void ShadowMap::renderFromLightArray(const Light* light, ArrayElementContainer*
 	mat4 view_matrix = light->computeViewMatrix();
 	mat4 proj_matrix = light->computeProjectionMatrix();
 
+	// Cull the objects outside of the light's frustum:
+	const uchar* visible_objects = elements->cullObjects(Frustum(proj_matrix * view_matrix));
+
 	// Start using the program:
 	program->use();
 
-	// For each mesh object:
+	// For each visible mesh object:
 	for(uint i=0 ; i < nb_objects ; i++)
 	{
 		Object* obj = objects[i];
 
-		if(obj->getType() != Object::MESH)
+		if(obj->getType() != Object::MESH || !visible_objects[i])
 			continue;
 
 		MeshObject* mesh_obj = (MeshObject*)obj;
@@ -266,18 +416,16 @@ void ShadowMap::renderFromLightArray(const Light* light, ArrayElementContainer*
 		program->sendUniform("projection_matrix", proj_matrix);
 
 		// - bind the VAO and draw
-		glBindVertexArray(mesh_obj->getGeometry()->getVAO(index_vao));
+		glutil::bindVertexArray(mesh_obj->getGeometry()->getVAO(index_vao));
 		glDrawArrays(GL_TRIANGLES, 0, geo->getNbVertices());
 	}
 
-	// Reactivate writing to the color buffer(s)
-	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-
-	// Reset usual cullfacing
-	glCullFace(GL_BACK);
+	// Record what the shadow map corresponds to:
+	rendered = true;
+	rendered_view_proj = proj_matrix * view_matrix;
+	rendered_moves_stamp = elements->getMovesStamp();
 }
 
-
 // ---------------------------------------------------------------------
 void ShadowMap::setupGPUProgram()
 {
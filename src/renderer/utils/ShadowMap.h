@@ -1,5 +1,13 @@
 // ShadowMap.h
-// A shadow map is a square depth texture.
+// A shadow map is a square region of the shadow atlas, which is a depth texture shared by
+// the shadow maps of all the shadowed lights (without any color attachment). The size of the region
+// is given by Light::getShadowMapSize(), and the regions are allocated when loading the scene.
+// The shaders read the shadow maps from the atlas (uniform "shadow_atlas"), using the
+// rectangle of each light given in the lights uniform block (see UniformBlocks).
+// The shadow maps are cached: renderShadowMapsArray() only re-renders the shadow maps which
+// are stale, i.e. when the view or projection of the light changed, or when objects moved
+// inside the frustum of the light since the last rendering (see isStale()). All the stale
+// shadow maps are rendered in a single pass over the atlas.
 
 #ifndef SHADOW_MAP_H
 #define SHADOW_MAP_H
@@ -8,6 +16,7 @@
 #include "../../scene/GPUProgramManager.h"
 #include "../../scene/LightData.h"
 #include "../../glutil/glxw.h"
+#include "../../glutil/RAII.h"
 
 class Light;
 class Scene;
@@ -16,17 +25,28 @@ class ArrayElementContainer;
 class ShadowMap : public LightData
 {
 private:
+	// Region of the shadow map in the atlas, in texels:
+	uint x;
+	uint y;
 	uint size;
 
-	GLuint id_fbo;
+	GPUProgramRef program;
 
-	GLuint id_rb_color;		// RGBA8: Color renderbuffer (necessary for completeness of the FBO)
-	GLuint id_depth;		// DEPTH_COMPONENT
+	// Caching:
+	bool rendered;				// false until the first rendering, or after invalidate()
+	mat4 rendered_view_proj;	// projection * view matrix of the light at the last rendering
+	uint rendered_moves_stamp;	// ArrayElementContainer::getMovesStamp() at the last rendering
 
-	GPUProgramRef program;
+	// Atlas shared by all the shadow maps. It is created by the first call to loadSceneArray(),
+	// and deleted by the last call to unloadSceneArray().
+	static GLuint id_atlas_fbo;
+	static GLuint id_atlas_depth;	// DEPTH_COMPONENT24, with shadow comparison enabled
+	static uint atlas_width;
+	static uint atlas_height;
+	static uint atlas_ref_count;
 
 public:
-	ShadowMap(uint size);
+	ShadowMap(uint x, uint y, uint size);
 	virtual ~ShadowMap();
 
 	// Implementation of the LightData interface:
@@ -34,7 +54,7 @@ public:
 
 	// We need to call these functions when loading / unloading a scene.
 	// They create/delete VAOs necessary for rendering the shadow map from
-	// the light and assign/remove shadow maps to all lights.
+	// the light and assign/remove shadow maps to the shadowed lights (see NB_MAX_SHADOWED_LIGHTS).
 	static void loadScene(Scene* scene, uint index_vao);
 	static void unloadScene(Scene* scene, uint index_vao);
 
@@ -52,11 +72,47 @@ public:
 	void renderFromLight(const Light* light, Scene* scene, uint index_vao);
 	void renderFromLightArray(const Light* light, ArrayElementContainer* elements, uint index_vao);
 
+	// Does the shadow map need to be rendered again? If objects moved outside of the frustum
+	// of the light, the shadow map is still valid and it records that it took these moves into account.
+	bool isStale(const Light* light, const ArrayElementContainer* elements);
+
+	// Force the next call to renderShadowMapsArray() to render the shadow map
+	void invalidate() {rendered = false;}
+
 	inline uint getSize() const  {return size;}
-	inline GLuint getTexDepth()     const {return id_depth;}
+
+	// Region of the shadow map in the atlas, in texture coordinates: offset (x, y) and scale (z, w)
+	vec4 getAtlasRect() const;
+
+	// The atlas:
+	static GLuint getAtlasTexture() {return id_atlas_depth;}
+	static uint getAtlasWidth()     {return atlas_width;}
+	static uint getAtlasHeight()    {return atlas_height;}
 
 private:
 	void setupGPUProgram();
+
+	// Binds the atlas and sets the states shared by all the shadow maps, until the end of the scope
+	struct AtlasRendering
+	{
+		glutil::BindFramebuffer fbo_binding;
+		glutil::SetViewport viewport;
+		glutil::Enable<GL_DEPTH_TEST> depth_test_state;
+		glutil::Enable<GL_CULL_FACE> cull_face_state;
+		glutil::Enable<GL_POLYGON_OFFSET_FILL> offset_fill_state;
+		glutil::Enable<GL_SCISSOR_TEST> scissor_test_state;
+
+		AtlasRendering();
+		~AtlasRendering();
+	};
+
+	// Render to the region of the shadow map (the atlas FBO and the states are already set)
+	void drawFromLightArray(const Light* light, ArrayElementContainer* elements, uint index_vao);
+
+	// Allocate the regions of the shadow maps of the given lights in an atlas, and
+	// (re)create the atlas with the needed size
+	static void buildAtlas(Light** lights, uint nb_lights);
+	static void deleteAtlas();
 };
 
 #endif // SHADOW_MAP_H
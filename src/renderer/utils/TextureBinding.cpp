@@ -2,6 +2,7 @@
 
 #include "TextureBinding.h"
 #include "TexunitManager.h"
+#include "../../glutil/StateCache.h"
 
 // This static function:
 // - binds textures and sets their parameters
@@ -21,8 +22,8 @@ void TextureBinding::bind(	TextureBinding* tex_bindings,
 		const TextureBinding& tex_binding = tex_bindings[i];
 
 		// - bind the texture to the texunit:
-		glActiveTexture(GL_TEXTURE0 + texunit);
-		glBindTexture(tex_binding.target, tex_binding.id_texture);
+		glutil::activeTexture(GL_TEXTURE0 + texunit);
+		glutil::bindTexture(tex_binding.target, tex_binding.id_texture);
 
 		// - set the parameters:
 		if( ! tex_binding.parameters.empty())
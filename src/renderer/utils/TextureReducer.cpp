@@ -3,8 +3,12 @@
 #include "TextureReducer.h"
 #include "GLRaytracer.h"
 #include "GLRaytracerConfig.h"
+#include "../../ShaderLocations.h"
 #include "../../glutil/RAII.h"
+#include "../../glutil/glutil.h"
 #include <sstream>
+#include <cstring>
+#include <cassert>
 using namespace std;
 
 // ---------------------------------------------------------------------
@@ -21,8 +25,21 @@ TextureReducer::TextureReducer(uint target_width, uint target_height)
   target_height(target_height),
   program(NULL),
   id_vao(0),
-  id_vbo(0)
+  id_vbo(0),
+  reduce_program(NULL),
+  buffers_width(0),
+  buffers_height(0),
+  num_result(0),
+  nb_result_ops(0),
+  id_readback_pbo(0),
+  readback_fence(NULL)
 {
+	for(uint i=0 ; i < 2 ; i++)
+	{
+		for(uint j=0 ; j < MAX_REDUCE_OPS ; j++)
+			id_buffer_tex[i][j] = 0;
+		id_buffer_fbo[i] = 0;
+	}
 }
 
 TextureReducer::~TextureReducer()
@@ -33,7 +50,16 @@ TextureReducer::~TextureReducer()
 void TextureReducer::setup()
 {
 	createProgram();
+	createReduceProgram();
 	createVBOAndVAO();
+
+	// PBO for the asynchronous readback:
+	glGenBuffers(1, &id_readback_pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, id_readback_pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, MAX_REDUCE_OPS*sizeof(vec4), NULL, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	GL_CHECK();
 }
 
 void TextureReducer::cleanup()
@@ -47,8 +73,179 @@ void TextureReducer::cleanup()
 	id_vbo = 0;
 
 	assert(id_vao != 0);
-	glDeleteVertexArrays(1, &id_vao);
+	glutil::deleteVertexArrays(1, &id_vao);
 	id_vao = 0;
+
+	// Generic reduction:
+	assert(reduce_program != NULL);
+	delete reduce_program;
+	reduce_program = NULL;
+
+	deleteBuffers();
+
+	if(readback_fence != NULL)
+		glDeleteSync(readback_fence);
+	readback_fence = NULL;
+
+	glDeleteBuffers(1, &id_readback_pbo);
+	id_readback_pbo = 0;
+
+	nb_result_ops = 0;
+}
+
+// ---------------------------------------------------------------------
+void TextureReducer::reduce(GLuint id_tex, uint width, uint height, const ReduceOp* ops, uint nb_ops)
+{
+	assert(nb_ops >= 1 && nb_ops <= MAX_REDUCE_OPS);
+	assert(width != 0 && height != 0);
+
+	// (Re)create the buffers if the first step does not fit in them:
+	uint first_width  = (width +1) / 2;
+	uint first_height = (height+1) / 2;
+
+	if(first_width > buffers_width || first_height > buffers_height)
+	{
+		deleteBuffers();
+		createBuffers(glm::max(first_width, buffers_width), glm::max(first_height, buffers_height));
+	}
+
+	// Operations, 2 bits each:
+	GLint reduce_ops = 0;
+	for(uint i=0 ; i < nb_ops ; i++)
+		reduce_ops |= GLint(ops[i]) << (2*i);
+
+	// Disable the depth test:
+	glutil::Disable<GL_DEPTH_TEST> depth_test_state;
+
+	reduce_program->use();
+	reduce_program->sendUniform("nb_ops", GLint(nb_ops));
+	reduce_program->sendUniform("reduce_ops", reduce_ops);
+
+	glutil::bindVertexArray(id_vao);
+
+	static const GLenum draw_buffers[] = {
+		GL_COLOR_ATTACHMENT0 + TEXTURE_REDUCER_FRAG_DATA_OUTPUT0,
+		GL_COLOR_ATTACHMENT0 + TEXTURE_REDUCER_FRAG_DATA_OUTPUT1,
+		GL_COLOR_ATTACHMENT0 + TEXTURE_REDUCER_FRAG_DATA_OUTPUT2,
+		GL_COLOR_ATTACHMENT0 + TEXTURE_REDUCER_FRAG_DATA_OUTPUT3,
+	};
+
+	uint w = width;
+	uint h = height;
+	uint num_step = 0;
+
+	// At least one step, even for a single texel (e.g. for the average):
+	do
+	{
+		uint num_output = num_step % 2;
+		uint num_input = 1 - num_output;
+
+		uint next_w = (w+1) / 2;
+		uint next_h = (h+1) / 2;
+		bool last_step = (next_w == 1 && next_h == 1);
+
+		glutil::BindFramebuffer fbo_binding(id_buffer_fbo[num_output]);
+		glDrawBuffers(nb_ops, draw_buffers);
+
+		glutil::SetViewport viewport(0, 0, next_w, next_h);
+
+		// The first step reads the texture for all the operations, the next ones their previous results:
+		for(uint i=0 ; i < nb_ops ; i++)
+		{
+			glutil::activeTexture(GL_TEXTURE0 + i);
+			glutil::bindTexture(GL_TEXTURE_RECTANGLE, num_step == 0 ? id_tex : id_buffer_tex[num_input][i]);
+			reduce_program->sendUniform(tex_input_handles[i], GLint(i));
+		}
+
+		reduce_program->sendUniform("input_width",  GLint(w));
+		reduce_program->sendUniform("input_height", GLint(h));
+		reduce_program->sendUniform("output_scale", last_step ? 1.0f / (float(width) * float(height)) : 1.0f);
+
+		// Draw
+		const uint nb_vertices = 6;
+		glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
+
+		num_result = num_output;
+		w = next_w;
+		h = next_h;
+		num_step++;
+	} while(w > 1 || h > 1);
+
+	nb_result_ops = nb_ops;
+
+	GL_CHECK();
+}
+
+GLuint TextureReducer::getResultTex(uint num_op) const
+{
+	assert(num_op < nb_result_ops);
+	return id_buffer_tex[num_result][num_op];
+}
+
+void TextureReducer::readResults(vec4* results)
+{
+	assert(nb_result_ops != 0);
+
+	glutil::BindFramebuffer fbo_binding(id_buffer_fbo[num_result]);
+
+	for(uint i=0 ; i < nb_result_ops ; i++)
+	{
+		glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+		glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, &results[i]);
+	}
+
+	GL_CHECK();
+}
+
+void TextureReducer::startReadback()
+{
+	assert(nb_result_ops != 0);
+	assert(readback_fence == NULL);
+
+	glutil::BindFramebuffer fbo_binding(id_buffer_fbo[num_result]);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, id_readback_pbo);
+
+	// The copies to the PBO do not wait for the rendering:
+	for(uint i=0 ; i < nb_result_ops ; i++)
+	{
+		glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+		glReadPixels(0, 0, 1, 1, GL_RGBA, GL_FLOAT, (GLvoid*)(i*sizeof(vec4)));
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	readback_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	GL_CHECK();
+}
+
+bool TextureReducer::finishReadback(vec4* results, bool wait)
+{
+	assert(readback_fence != NULL);
+
+	GLbitfield flags = wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+	GLuint64 timeout = wait ? GL_TIMEOUT_IGNORED : 0;
+	GLenum status = glClientWaitSync(readback_fence, flags, timeout);
+
+	if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return false;
+
+	glDeleteSync(readback_fence);
+	readback_fence = NULL;
+
+	// Copy the results:
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, id_readback_pbo);
+
+	const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, nb_result_ops*sizeof(vec4), GL_MAP_READ_BIT);
+	assert(data != NULL);
+	memcpy(results, data, nb_result_ops*sizeof(vec4));
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	GL_CHECK();
+
+	return true;
 }
 
 // ---------------------------------------------------------------------
@@ -86,7 +283,7 @@ void TextureReducer::run(GLRaytracer* gl_raytracer, uint offset_x)
 
 	// Bind the VAO and draw
 	const uint nb_vertices = 6;
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 	glDrawArrays(GL_TRIANGLES, 0, nb_vertices);
 }
 
@@ -149,6 +346,89 @@ void TextureReducer::createProgram()
 	program->validate();
 }
 
+void TextureReducer::createReduceProgram()
+{
+	bool ok = false;
+
+	reduce_program = new glutil::GPUProgram(	"media/shaders/reduce.vert",
+												"media/shaders/reduce.frag");
+
+	// Compile, attach, set the locations, link
+	ok = reduce_program->compileAndAttach();
+	assert(ok);
+
+	reduce_program->bindAttribLocations(TEXTURE_REDUCER_ATTRIB_POSITION, "vertex_position",
+										0,                               NULL);
+
+	reduce_program->bindFragDataLocations(TEXTURE_REDUCER_FRAG_DATA_OUTPUT0, "frag_output_0",
+										  TEXTURE_REDUCER_FRAG_DATA_OUTPUT1, "frag_output_1",
+										  TEXTURE_REDUCER_FRAG_DATA_OUTPUT2, "frag_output_2",
+										  TEXTURE_REDUCER_FRAG_DATA_OUTPUT3, "frag_output_3",
+										  0,                                 NULL);
+
+	ok &= reduce_program->link();
+	assert(ok);
+
+	// Set the uniform names
+	reduce_program->setUniformNames("input_width", "input_height", "nb_ops", "reduce_ops", "output_scale", NULL);
+
+	// The names of the inputs are built at runtime:
+	stringstream ss;
+	for(uint i=0 ; i < MAX_REDUCE_OPS ; i++)
+	{
+		ss.str(""); ss << "tex_input_" << i << flush;
+		tex_input_handles[i] = reduce_program->getUniformHandle(ss.str().c_str(), Hash::AT_RUNTIME);
+	}
+
+	// Validate
+	reduce_program->validate();
+}
+
+// ---------------------------------------------------------------------
+void TextureReducer::createBuffers(uint width, uint height)
+{
+	buffers_width = width;
+	buffers_height = height;
+
+	for(uint i=0 ; i < 2 ; i++)
+	{
+		glGenFramebuffers(1, &id_buffer_fbo[i]);
+		glutil::BindFramebuffer fbo_binding(id_buffer_fbo[i]);
+
+		for(uint j=0 ; j < MAX_REDUCE_OPS ; j++)
+		{
+			id_buffer_tex[i][j] = glutil::createTextureRectRGBAF(width, height, false);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + j, GL_TEXTURE_RECTANGLE, id_buffer_tex[i][j], 0);
+		}
+
+		GLenum fbo_status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+		if(fbo_status != GL_FRAMEBUFFER_COMPLETE)
+			logError("FBO not complete");
+	}
+
+	GL_CHECK();
+}
+
+void TextureReducer::deleteBuffers()
+{
+	for(uint i=0 ; i < 2 ; i++)
+	{
+		if(id_buffer_fbo[i] != 0)
+			glutil::deleteFramebuffers(1, &id_buffer_fbo[i]);
+		id_buffer_fbo[i] = 0;
+
+		if(id_buffer_tex[i][0] != 0)
+			glutil::deleteTextures(MAX_REDUCE_OPS, id_buffer_tex[i]);
+
+		for(uint j=0 ; j < MAX_REDUCE_OPS ; j++)
+			id_buffer_tex[i][j] = 0;
+	}
+
+	buffers_width = 0;
+	buffers_height = 0;
+}
+
 // ---------------------------------------------------------------------
 void TextureReducer::createVBOAndVAO()
 {
@@ -156,7 +436,7 @@ void TextureReducer::createVBOAndVAO()
 	glGenVertexArrays(1, &id_vao);
 
 	// Bind the VAO:
-	glBindVertexArray(id_vao);
+	glutil::bindVertexArray(id_vao);
 
 	// Vertex and coordinates:
 	GLfloat buffer_data[] = {	// Vertex coordinates (x, y)
@@ -1,4 +1,13 @@
 // TextureReducer.h
+// - reduce(): generic reduction of the texels of an RGBA float rectangle texture, e.g. for
+//   normalizing the energy of the photons, computing the exposure or debugging statistics without
+//   reading the whole texture back. Up to MAX_REDUCE_OPS operations (see ReduceOp) are computed at
+//   once, each one into its own render target. Each step halves the size of the textures
+//   (log2(max(width, height)) steps), and the results end up in the texel (0, 0) of getResultTex().
+//   They can be read back synchronously with readResults(), or asynchronously through a PBO with
+//   startReadback() and finishReadback(), a few frames later for not stalling the pipeline.
+// - run(): special-purpose "reduction" of the output of a GLRaytracer: for each line, the first
+//   texel with some power.
 
 #ifndef TEXTUREREDUCER_H
 #define TEXTUREREDUCER_H
@@ -8,6 +17,18 @@
 
 class GLRaytracer;
 
+// Maximum number of operations of a call to TextureReducer::reduce()
+#define MAX_REDUCE_OPS 4
+
+// NB: the values are used by reduce.frag
+enum ReduceOp
+{
+	REDUCE_SUM = 0,
+	REDUCE_MIN,
+	REDUCE_MAX,
+	REDUCE_AVERAGE,
+};
+
 class TextureReducer
 {
 private:
@@ -19,16 +40,54 @@ private:
 	GLuint id_vao;
 	GLuint id_vbo;
 
+	// Generic reduction:
+	glutil::GPUProgram* reduce_program;
+	glutil::GPUProgram::UniformHandle tex_input_handles[MAX_REDUCE_OPS];
+
+	uint buffers_width;		// size of the ping-pong buffers
+	uint buffers_height;
+	GLuint id_buffer_tex[2][MAX_REDUCE_OPS];	// RGBA32F rectangle textures
+	GLuint id_buffer_fbo[2];
+
+	uint num_result;	// index of the ping-pong buffers containing the results
+	uint nb_result_ops;
+
+	GLuint id_readback_pbo;
+	GLsync readback_fence;	// NULL if there is no pending readback
+
 public:
-	TextureReducer(uint target_width, uint target_height);
+	// target_width, target_height: size of the output of the GLRaytracer, only used by run()
+	TextureReducer(uint target_width=0, uint target_height=0);
 	virtual ~TextureReducer();
 
 	void setup();
 	void cleanup();
 
+	// Reduce the width*height texels of id_tex with the nb_ops given operations
+	void reduce(GLuint id_tex, uint width, uint height, const ReduceOp* ops, uint nb_ops);
+
+	// Result of the num_op-th operation of the last call to reduce(), in the texel (0, 0)
+	GLuint getResultTex(uint num_op) const;
+
+	// Read the results of the last call to reduce() (nb_ops values), waiting for them
+	void readResults(vec4* results);
+
+	// Asynchronous readback: start copying the results of the last call to reduce() to a PBO,
+	// then get them (returns false if they are not available yet and wait is false).
+	// A readback must be finished before starting another one.
+	void startReadback();
+	bool finishReadback(vec4* results, bool wait=false);
+	bool isReadbackPending() const {return readback_fence != NULL;}
+
 	void run(GLRaytracer* gl_raytracer, uint offset_x=0);
 	void createProgram();
 	void createVBOAndVAO();
+
+private:
+	void createReduceProgram();
+
+	void createBuffers(uint width, uint height);
+	void deleteBuffers();
 };
 
 #endif // TEXTUREREDUCER_H
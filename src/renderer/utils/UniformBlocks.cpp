@@ -0,0 +1,167 @@
+// UniformBlocks.cpp
+
+#include "UniformBlocks.h"
+#include "ShadowMap.h"
+#include "../../Boundaries.h"
+#include "../../CommonIndices.h"
+#include "../../ShaderLocations.h"
+#include "../../scene/ArrayElementContainer.h"
+#include "../../scene/Camera.h"
+#include "../../scene/Light.h"
+#include "../../scene/Scene.h"
+#include <cassert>
+
+// Index of the camera's viewpoint in the buffer of the "CameraBlock"s
+// (the viewpoint of the light i is at index i+1)
+#define CAMERA_VIEW_INDEX 0
+#define NB_VIEWS (NB_MAX_LIGHTS + 1)
+
+// Buffer containing one "CameraBlock" per viewpoint
+static GLuint id_ubo_views = 0;
+
+// Offset between 2 viewpoints in id_ubo_views: sizeof(CameraBlock) rounded up to
+// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, as required by glBindBufferRange()
+static GLsizeiptr view_stride = 0;
+
+// Copy of id_ubo_views on the CPU, filled before uploading it
+static uchar* views_data = NULL;
+
+// Buffer containing the "LightsBlock"
+static GLuint id_ubo_lights = 0;
+
+// ---------------------------------------------------------------------
+void UniformBlocks::init()
+{
+	assert(id_ubo_views == 0 && id_ubo_lights == 0);
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	assert(alignment > 0);
+
+	view_stride = ((sizeof(CameraBlock) + alignment - 1) / alignment) * alignment;
+	views_data = new uchar[NB_VIEWS * view_stride];
+
+	glGenBuffers(1, &id_ubo_views);
+	glBindBuffer(GL_UNIFORM_BUFFER, id_ubo_views);
+	glBufferData(GL_UNIFORM_BUFFER, NB_VIEWS * view_stride, NULL, GL_DYNAMIC_DRAW);
+
+	glGenBuffers(1, &id_ubo_lights);
+	glBindBuffer(GL_UNIFORM_BUFFER, id_ubo_lights);
+	glBufferData(GL_UNIFORM_BUFFER, NB_MAX_SHADOWED_LIGHTS * sizeof(LightBlock), NULL, GL_DYNAMIC_DRAW);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// The lights block never moves:
+	glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_BINDING_LIGHTS, id_ubo_lights);
+	bindCameraView();
+}
+
+void UniformBlocks::shutdown()
+{
+	if(id_ubo_views != 0)
+		glDeleteBuffers(1, &id_ubo_views);
+	if(id_ubo_lights != 0)
+		glDeleteBuffers(1, &id_ubo_lights);
+
+	delete [] views_data;
+
+	id_ubo_views = 0;
+	id_ubo_lights = 0;
+	view_stride = 0;
+	views_data = NULL;
+}
+
+// ---------------------------------------------------------------------
+void UniformBlocks::setupProgram(glutil::GPUProgram* program)
+{
+	program->bindUniformBlock(UNIFORM_BLOCK_BINDING_CAMERA, "CameraBlock");
+	program->bindUniformBlock(UNIFORM_BLOCK_BINDING_LIGHTS, "LightsBlock");
+}
+
+// ---------------------------------------------------------------------
+void UniformBlocks::update(const Scene* scene)
+{
+	assert(id_ubo_views != 0);
+
+	// Bias matrix, used for shadow mapping. Lets us switch from the range [-1, 1] to [0, 1]
+	// (0.5*x + 0.5)
+	const mat4 bias_matrix = mat4(	vec4(0.5, 0.0, 0.0, 0.0),
+									vec4(0.0, 0.5, 0.0, 0.0),
+									vec4(0.0, 0.0, 0.5, 0.0),
+									vec4(0.5, 0.5, 0.5, 1.0));
+
+	// Gather the data of all the viewpoints and lights, and upload it at once:
+	LightBlock lights_data[NB_MAX_SHADOWED_LIGHTS];
+	uint nb_views = 1;
+
+	// - camera:
+	const Camera* camera = scene->getCamera();
+	CameraBlock* camera_block = (CameraBlock*)(&views_data[CAMERA_VIEW_INDEX * view_stride]);
+	camera_block->view_matrix       = camera->computeViewMatrix();
+	camera_block->projection_matrix = camera->computeProjectionMatrix();
+	camera_block->inv_view_matrix   = glm::inverse(camera_block->view_matrix);
+
+	// - lights (only the array container gives access to them):
+	uint nb_shadowed_lights = 0;
+	if(scene->getElements()->getType() == ElementContainer::ARRAY)
+	{
+		const ArrayElementContainer* elements = (const ArrayElementContainer*)(scene->getElements());
+		Light** lights = elements->getLights();
+		uint nb_lights = elements->getNbLights();
+		nb_shadowed_lights = elements->getNbShadowedLights();
+
+		for(uint i=0 ; i < nb_lights ; i++)
+		{
+			const Light* l = lights[i];
+
+			CameraBlock* view_block = (CameraBlock*)(&views_data[(i+1) * view_stride]);
+			view_block->view_matrix       = l->computeViewMatrix();
+			view_block->projection_matrix = l->computeProjectionMatrix();
+			view_block->inv_view_matrix   = glm::inverse(view_block->view_matrix);
+
+			// Only the shadowed lights are in the lights block:
+			if(i >= nb_shadowed_lights)
+				continue;
+
+			LightBlock& light_block = lights_data[i];
+			light_block.position = vec4(l->getPosition(), 1.0f);
+			light_block.color = vec4(l->getColor(), 1.0f);
+			light_block.shadow_matrix = bias_matrix * view_block->projection_matrix * view_block->view_matrix;
+
+			const ShadowMap* shadow_map = (const ShadowMap*)(l->getUserData(LIGHT_DATA_SHADOW_MAP));
+			if(shadow_map != NULL)
+				light_block.shadow_rect = shadow_map->getAtlasRect();
+			else
+				light_block.shadow_rect = vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		}
+
+		nb_views += nb_lights;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, id_ubo_views);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, nb_views * view_stride, views_data);
+
+	if(nb_shadowed_lights != 0)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, id_ubo_lights);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, nb_shadowed_lights * sizeof(LightBlock), lights_data);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	bindCameraView();
+}
+
+// ---------------------------------------------------------------------
+void UniformBlocks::bindCameraView()
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_BINDING_CAMERA, id_ubo_views,
+					  CAMERA_VIEW_INDEX * view_stride, sizeof(CameraBlock));
+}
+
+void UniformBlocks::bindLightView(uint light_index)
+{
+	assert(light_index < NB_MAX_LIGHTS);
+	glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_BINDING_CAMERA, id_ubo_views,
+					  (light_index+1) * view_stride, sizeof(CameraBlock));
+}
@@ -0,0 +1,59 @@
+// UniformBlocks.h
+// Uniform buffer objects shared by all the programs (std140 layout, see
+// media/shaders/library/uniform_blocks.shader):
+// - "CameraBlock": view and projection matrices of the current viewpoint.
+//   The buffer contains one block for the camera and one for each light, so that rendering
+//   from another viewpoint only binds another range of the buffer.
+// - "LightsBlock": position, color, shadow matrix and shadow atlas region of each shadowed
+//   light (see NB_MAX_SHADOWED_LIGHTS).
+// Both buffers are uploaded once per frame by Renderer::render(), and the blocks are bound
+// to the fixed binding points defined in ShaderLocations.h.
+
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include "../../Common.h"
+#include "../../glutil/GPUProgram.h"
+
+class Scene;
+class Camera;
+class Light;
+
+class UniformBlocks
+{
+public:
+	// Layout of "CameraBlock" (std140):
+	struct CameraBlock
+	{
+		mat4 view_matrix;
+		mat4 projection_matrix;
+		mat4 inv_view_matrix;
+	};
+
+	// Layout of one element of "LightsBlock" (std140):
+	struct LightBlock
+	{
+		vec4 position;		// world space, w = 1
+		vec4 color;			// rgb, a is unused
+		mat4 shadow_matrix;	// world space => shadow map space
+		vec4 shadow_rect;	// region of the shadow map in the shadow atlas: offset (xy) and scale (zw)
+	};
+
+public:
+	// Create / delete the buffers (needs an OpenGL context)
+	static void init();
+	static void shutdown();
+
+	// Bind the blocks used by the given program to their binding points (after linking)
+	static void setupProgram(glutil::GPUProgram* program);
+
+	// Upload the blocks of the camera and the lights of the given scene, and bind
+	// the camera's viewpoint
+	static void update(const Scene* scene);
+
+	// Bind the viewpoint of the camera or the light used for rendering
+	static void bindCameraView();
+	static void bindLightView(uint light_index);
+};
+
+#endif // UNIFORM_BLOCKS_H
@@ -4,12 +4,16 @@
 #include "profiles/GPUProfile.h"
 #include "Object.h"
 #include "Light.h"
+#include "Frustum.h"
 #include "Material.h"
+#include "MeshObject.h"
 #include "../scene/GPUProgramManager.h"
 #include "../glutil/GPUProgram.h"
-#include "../utils/List.h"
+#include "../utils/JobPool.h"
+#include "../utils/RadixSort.h"
 #include <cassert>
 #include <cstring>
+#include <map>
 using namespace std;
 
 ArrayElementContainer::ArrayElementContainer()
@@ -19,7 +23,17 @@ ArrayElementContainer::ArrayElementContainer()
   nb_opaque_objects(0),
   nb_transparent_objects(0),
   lights(NULL),
-  nb_lights(0)
+  nb_lights(0),
+  world_aabbs(NULL),
+  sphere_centers_x(NULL),
+  sphere_centers_y(NULL),
+  sphere_centers_z(NULL),
+  sphere_radii(NULL),
+  bounds_stamps(NULL),
+  visible_objects(NULL),
+  moves_stamp(0),
+  prev_moves_stamp(0),
+  last_moves_bounds()
 {
 }
 
@@ -74,10 +88,19 @@ void ArrayElementContainer::endFilling()
 	nb_lights = building_lights.size();
 
 	assert(nb_objects == nb_opaque_objects + nb_transparent_objects);
+	assert(nb_lights <= NB_MAX_LIGHTS);
 
 	objects = new Object*[nb_objects];
 	lights = new Light*[nb_lights];
 
+	world_aabbs = new AABB[nb_objects];
+	sphere_centers_x = new float[nb_objects];
+	sphere_centers_y = new float[nb_objects];
+	sphere_centers_z = new float[nb_objects];
+	sphere_radii = new float[nb_objects];
+	bounds_stamps = new uint[nb_objects];
+	visible_objects = new uchar[nb_objects];
+
 	// Copy the building lists to the arrays
 	uint i=0;
 	ObjectList::iterator it_end_obj = building_objects.end();
@@ -129,6 +152,81 @@ void ArrayElementContainer::clear()
 	delete [] lights;
 	nb_lights = 0;
 	lights = NULL;
+
+	// Delete bounds :
+	delete [] world_aabbs;
+	delete [] sphere_centers_x;
+	delete [] sphere_centers_y;
+	delete [] sphere_centers_z;
+	delete [] sphere_radii;
+	delete [] bounds_stamps;
+	delete [] visible_objects;
+	world_aabbs = NULL;
+	sphere_centers_x = sphere_centers_y = sphere_centers_z = sphere_radii = NULL;
+	bounds_stamps = NULL;
+	visible_objects = NULL;
+}
+
+// ---------------------------------------------------------------------
+// Update the world bounds of the objects whose transformation changed
+void ArrayElementContainer::updateBounds()
+{
+	AABB moves_bounds;
+	bool moved = false;
+
+	for(uint i=0 ; i < nb_objects ; i++)
+	{
+		uint stamp = objects[i]->getTransformStamp();
+		if(stamp != bounds_stamps[i])
+		{
+			// Keep track of the bounds before and after the move:
+			if(bounds_stamps[i] != 0)
+				moves_bounds.extend(world_aabbs[i]);
+			moved = true;
+
+			computeObjectBounds(i);
+			moves_bounds.extend(world_aabbs[i]);
+		}
+	}
+
+	if(moved)
+	{
+		prev_moves_stamp = moves_stamp;
+		moves_stamp = Element::newTransformStamp();
+		last_moves_bounds = moves_bounds;
+	}
+}
+
+// Compute the world bounds of the object "index", without recording a move
+void ArrayElementContainer::computeObjectBounds(uint index)
+{
+	BoundingSphere sphere;
+	objects[index]->computeWorldBounds(&world_aabbs[index], &sphere);
+
+	sphere_centers_x[index] = sphere.center.x;
+	sphere_centers_y[index] = sphere.center.y;
+	sphere_centers_z[index] = sphere.center.z;
+	sphere_radii[index] = sphere.radius;
+
+	bounds_stamps[index] = objects[index]->getTransformStamp();
+}
+
+BoundingSphere ArrayElementContainer::getWorldBoundingSphere(uint index) const
+{
+	assert(index < nb_objects);
+	return BoundingSphere(vec3(sphere_centers_x[index], sphere_centers_y[index], sphere_centers_z[index]),
+						  sphere_radii[index]);
+}
+
+// Frustum culling of the objects:
+const uchar* ArrayElementContainer::cullObjects(const Frustum& frustum, uint* nb_visible)
+{
+	uint n = frustum.cullSpheres(sphere_centers_x, sphere_centers_y, sphere_centers_z, sphere_radii,
+								 nb_objects, visible_objects);
+	if(nb_visible != NULL)
+		*nb_visible = n;
+
+	return visible_objects;
 }
 
 // ---------------------------------------------------------------------
@@ -166,83 +264,121 @@ void ArrayElementContainer::separateOpaqueTransparentObjects()
 	assert(index == nb_objects);
 
 	delete [] objects_copy;
+
+	// The objects changed places in the array, so that their bounds have to be recomputed
+	// (this is not a move: the shadow maps are still valid):
+	for(uint i=0 ; i < nb_objects ; i++)
+		computeObjectBounds(i);
 }
 
 // ---------------------------------------------------------------------
-// This structure is used to group together objects which share the
-// same GPUProgram in a given profile
-struct ObjectsAndProgram
-{
-	List<Object*> objects;
-	const glutil::GPUProgram* program;
-};
-
+// The objects are sorted with a radix sort, with keys made of:
+// - the rank of the program of the object (in the order of the first object using it)
+// - in the low bits: the index of the first object using the same program and geometry,
+//   so that the objects sharing the same geometry are next to each other, for instancing.
+// The sort is stable, so that the objects keep their relative order inside a group.
 void ArrayElementContainer::sortObjectsByProgram(uint index_profile)
 {
 	// Special case of no objects
 	if(nb_objects == 0)
 		return;
 
-	// ------ First step : store "categories" of objects in a list -------
-	List<ObjectsAndProgram> sorted_objects;
+	typedef pair<const glutil::GPUProgram*, const Geometry*> ProgramAndGeometry;
+
+	map<const glutil::GPUProgram*, uint> program_ranks;
+	map<ProgramAndGeometry, uint> first_objects;
+
+	SortItem* items = new SortItem[nb_objects];
+	SortItem* tmp_items = new SortItem[nb_objects];
 
-	// For each object:
 	for(uint i=0 ; i < nb_objects ; i++)
 	{
 		Object* obj = objects[i];
 		const GPUProfile* gpu_profile = (const GPUProfile*)(obj->getMaterial()->getProfile(index_profile));
 		const glutil::GPUProgram* program = gpu_profile->getProgram();
 
-		bool found = false;
+		// Rank of the program:
+		map<const glutil::GPUProgram*, uint>::iterator it_rank = program_ranks.find(program);
+		if(it_rank == program_ranks.end())
+			it_rank = program_ranks.insert(make_pair(program, uint(program_ranks.size()))).first;
 
-		// For each ObjectsAndProgram in the temporary list:
-		List<ObjectsAndProgram>::Iterator it_end = sorted_objects.end();
-		for(List<ObjectsAndProgram>::Iterator it = sorted_objects.begin() ;
-			it != it_end ;
-			it++)
+		// First object of the group (objects without geometry are not grouped):
+		uint first = i;
+		if(obj->getType() == Object::MESH && ((MeshObject*)obj)->getGeometry() != NULL)
 		{
-			// If the object has the same GPUProgram, add it to the "category"
-			ObjectsAndProgram& obj_and_prog = (*it);
-			if(program == obj_and_prog.program)
-			{
-				obj_and_prog.objects.pushBack(obj);
-				found = true;
-				break;
-			}
+			ProgramAndGeometry group(program, ((MeshObject*)obj)->getGeometry());
+			first = first_objects.insert(make_pair(group, i)).first->second;
 		}
 
-		// If we did not find a corresponding "category", we create a new one
-		if(!found)
-		{
-			ObjectsAndProgram obj_and_prog;
-			obj_and_prog.objects.pushBack(obj);
-			obj_and_prog.program = program;
-			sorted_objects.pushBack(obj_and_prog);
-		}
+		items[i].key = (uint64(it_rank->second) << 32) | first;
+		items[i].value = i;
 	}
 
-	// ----- Second step : copy the list back to the original objects array ------
-	uint index = 0;
-	List<ObjectsAndProgram>::Iterator it_end = sorted_objects.end();
-	for(List<ObjectsAndProgram>::Iterator it = sorted_objects.begin() ;
-		it != it_end ;
-		it++)
+	radixSort(items, tmp_items, nb_objects);
+
+	// Copy the sorted objects back to the objects array:
+	Object** objects_copy = new Object*[nb_objects];
+	memcpy(objects_copy, objects, nb_objects * sizeof(Object*));
+
+	for(uint i=0 ; i < nb_objects ; i++)
+		objects[i] = objects_copy[items[i].value];
+
+	delete [] objects_copy;
+	delete [] items;
+	delete [] tmp_items;
+
+	// Separate opaque and transparent objects, as we may have broken
+	// the separation:
+	separateOpaqueTransparentObjects();
+}
+
+// ---------------------------------------------------------------------
+// Job decoding one texture of a profile:
+class DecodeTextureJob : public Job
+{
+private:
+	GPUProfile* profile;
+	uint index;
+
+public:
+	DecodeTextureJob(GPUProfile* profile, uint index)
+	: profile(profile), index(index)
 	{
-		ObjectsAndProgram& obj_and_prog = (*it);
-		List<Object*>::Iterator it_obj_end = obj_and_prog.objects.end();
-		for(List<Object*>::Iterator it_obj = obj_and_prog.objects.begin() ;
-			it_obj != it_obj_end ;
-			it_obj++)
+	}
+
+	virtual void run()
+	{
+		profile->decodeTexture(index);
+	}
+};
+
+void ArrayElementContainer::decodeTextures(uint index_profile)
+{
+	list<Job*> jobs;
+
+	// Push one job per texture which is not on the GPU yet:
+	for(uint i=0 ; i < nb_objects ; i++)
+	{
+		Object* obj = objects[i];
+
+		if(obj->getType() != Object::MESH)
+			continue;
+
+		GPUProfile* profile = (GPUProfile*)(obj->getMaterial()->getProfile(index_profile));
+		if(profile == NULL || profile->areTexturesLoaded())
+			continue;
+
+		for(uint j=0 ; j < profile->getNbTextures() ; j++)
 		{
-			Object* obj = (*it_obj);
-			objects[index] = obj;
-			index++;
+			Job* job = new DecodeTextureJob(profile, j);
+			jobs.push_back(job);
+			getJobPool().push(job);
 		}
 	}
 
-	assert(index == nb_objects);
+	// Wait for them:
+	getJobPool().wait();
 
-	// Separate opaque and transparent objects, as we may have broken
-	// the separation:
-	separateOpaqueTransparentObjects();
+	for(list<Job*>::iterator it = jobs.begin() ; it != jobs.end() ; it++)
+		delete (*it);
 }
@@ -4,11 +4,14 @@
 #define ARRAY_ELEMENT_CONTAINER_H
 
 #include "ElementContainer.h"
+#include "Bounds.h"
 #include "../Common.h"
+#include "../Boundaries.h"
 #include <list>
 
 class Object;
 class Light;
+class Frustum;
 
 class ArrayElementContainer : public ElementContainer
 {
@@ -22,6 +25,23 @@ private:
 	Light** lights;
 	uint nb_lights;
 
+	// World bounds of the objects, in the same order as "objects".
+	// The bounding spheres are stored as separate arrays (SoA) for the SIMD culling.
+	AABB* world_aabbs;
+	float* sphere_centers_x;
+	float* sphere_centers_y;
+	float* sphere_centers_z;
+	float* sphere_radii;
+	uint* bounds_stamps;	// transform stamp of each object when its bounds were computed (0: never)
+
+	uchar* visible_objects;	// result of cullObjects()
+
+	// Tracking of the moves of the objects (e.g. for caching the shadow maps):
+	uint moves_stamp;		// changes each time updateBounds() finds objects which moved
+	uint prev_moves_stamp;	// value of moves_stamp before its last change
+	AABB last_moves_bounds;	// world bounds of the objects which moved at the last change,
+							// before and after moving
+
 	typedef std::list<Object*> ObjectList;
 	typedef std::list<Light*> LightList;
 
@@ -45,14 +65,33 @@ public:
 
 	virtual void clear();
 
+	// Update the world bounds of the objects whose transformation changed
+	virtual void updateBounds();
+
+	// Moves of the objects: getMovesStamp() changes each time objects move. If it changed only
+	// once since a previous value "stamp" (i.e. stamp == getPrevMovesStamp()), the objects which
+	// moved are inside getLastMovesBounds().
+	uint getMovesStamp() const               {return moves_stamp;}
+	uint getPrevMovesStamp() const           {return prev_moves_stamp;}
+	const AABB& getLastMovesBounds() const   {return last_moves_bounds;}
+
+	// Test the bounding spheres of the objects against a view frustum. Returns an array
+	// with 1 for each object which may be visible and 0 otherwise (same indices as getObjects()).
+	// NB: the array is overwritten by the next call.
+	const uchar* cullObjects(const Frustum& frustum, uint* nb_visible=NULL);
+
 	// Puts opaque objects in the front of the objects array and
 	// transparent objects at the end, without changing the relative order.
 	void separateOpaqueTransparentObjects();
 
-	// Sorts objects by program for a given profile
-	// and calls separateOpaqueTransparentObjects() in the end.
+	// Sorts objects by program for a given profile, puts the objects sharing the same geometry
+	// next to each other (for instancing) and calls separateOpaqueTransparentObjects() in the end.
 	void sortObjectsByProgram(uint index_profile);
 
+	// Decodes in parallel the textures of a given profile for all the mesh objects,
+	// so that GPUProfile::loadTextures() only has to upload them afterwards.
+	void decodeTextures(uint index_profile);
+
 	// RTTI :
 	virtual ElementContainer::Type getType() const {return ElementContainer::ARRAY;}
 
@@ -72,6 +111,16 @@ public:
 	// - lights:
 	Light** getLights() const {return lights;}
 	uint getNbLights() const  {return nb_lights;}
+
+	// - shadowed lights: the first lights (see NB_MAX_SHADOWED_LIGHTS)
+	uint getNbShadowedLights() const {return (nb_lights < NB_MAX_SHADOWED_LIGHTS ? nb_lights : NB_MAX_SHADOWED_LIGHTS);}
+
+	// - world bounds of the objects (same indices as getObjects()):
+	const AABB* getWorldAABBs() const {return world_aabbs;}
+	BoundingSphere getWorldBoundingSphere(uint index) const;
+
+private:
+	void computeObjectBounds(uint index);
 };
 
 #endif // ARRAY_ELEMENT_CONTAINER_H
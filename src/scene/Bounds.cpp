@@ -0,0 +1,119 @@
+// Bounds.cpp
+
+#include "Bounds.h"
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define BOUNDS_USE_SSE
+	#include <xmmintrin.h>
+#endif
+
+// ---------------------------------------------------------------------
+// AABB
+AABB::AABB()
+: min_corner(FLT_MAX), max_corner(-FLT_MAX)
+{
+}
+
+void AABB::extend(const vec3& p)
+{
+	min_corner = glm::min(min_corner, p);
+	max_corner = glm::max(max_corner, p);
+}
+
+void AABB::extend(const AABB& box)
+{
+	min_corner = glm::min(min_corner, box.min_corner);
+	max_corner = glm::max(max_corner, box.max_corner);
+}
+
+AABB AABB::fromPoints(const float* points, uint nb_points)
+{
+	AABB box;
+	if(nb_points == 0)
+		return box;
+
+#ifdef BOUNDS_USE_SSE
+	// Each point is loaded as (x, y, z, <x of the next point>): the 4th component is ignored.
+	// The last point is loaded separately, so that we do not read past the end of the array.
+	__m128 v_min = _mm_set1_ps(FLT_MAX);
+	__m128 v_max = _mm_set1_ps(-FLT_MAX);
+
+	for(uint i=0 ; i < nb_points-1 ; i++)
+	{
+		__m128 p = _mm_loadu_ps(&points[i*3]);
+		v_min = _mm_min_ps(v_min, p);
+		v_max = _mm_max_ps(v_max, p);
+	}
+
+	const float* last = &points[(nb_points-1)*3];
+	__m128 p = _mm_set_ps(0.0f, last[2], last[1], last[0]);
+	v_min = _mm_min_ps(v_min, p);
+	v_max = _mm_max_ps(v_max, p);
+
+	float result_min[4], result_max[4];
+	_mm_storeu_ps(result_min, v_min);
+	_mm_storeu_ps(result_max, v_max);
+
+	box.min_corner = vec3(result_min[0], result_min[1], result_min[2]);
+	box.max_corner = vec3(result_max[0], result_max[1], result_max[2]);
+#else
+	for(uint i=0 ; i < nb_points ; i++)
+		box.extend(vec3(points[i*3+0], points[i*3+1], points[i*3+2]));
+#endif
+
+	return box;
+}
+
+// Transformation of the box (Arvo's method): the new extents are the absolute values
+// of the orientation matrix multiplied by the extents.
+AABB AABB::transform(const mat3& orientation, const vec3& position) const
+{
+	if(isEmpty())
+		return *this;
+
+	vec3 center = orientation * getCenter() + position;
+	vec3 extents = getExtents();
+
+	mat3 abs_orientation;
+	for(uint i=0 ; i < 3 ; i++)
+		abs_orientation[i] = glm::abs(orientation[i]);
+
+	vec3 new_extents = abs_orientation * extents;
+
+	return AABB(center - new_extents, center + new_extents);
+}
+
+// ---------------------------------------------------------------------
+// BoundingSphere
+BoundingSphere BoundingSphere::fromPoints(const float* points, uint nb_points, const AABB& box)
+{
+	if(nb_points == 0 || box.isEmpty())
+		return BoundingSphere();
+
+	vec3 center = box.getCenter();
+	float max_dist2 = 0.0f;
+
+	for(uint i=0 ; i < nb_points ; i++)
+	{
+		vec3 d = vec3(points[i*3+0], points[i*3+1], points[i*3+2]) - center;
+		float dist2 = glm::dot(d, d);
+		if(dist2 > max_dist2)
+			max_dist2 = dist2;
+	}
+
+	return BoundingSphere(center, sqrtf(max_dist2));
+}
+
+BoundingSphere BoundingSphere::transform(const mat3& orientation, const vec3& position) const
+{
+	if(isEmpty())
+		return *this;
+
+	// Take into account a possible scaling:
+	float scale = glm::max(glm::length(orientation[0]),
+						   glm::max(glm::length(orientation[1]), glm::length(orientation[2])));
+
+	return BoundingSphere(orientation * center + position, radius * scale);
+}
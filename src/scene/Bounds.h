@@ -0,0 +1,55 @@
+// Bounds.h
+// Bounding volumes: axis-aligned bounding boxes and bounding spheres.
+// The local bounds of a Geometry are computed once in Geometry::setVertices(), and the
+// world bounds of the objects are kept by ArrayElementContainer, in contiguous arrays.
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include "../Common.h"
+
+// Axis-aligned bounding box
+struct AABB
+{
+	vec3 min_corner;
+	vec3 max_corner;
+
+	// The default box is empty (min_corner > max_corner)
+	AABB();
+	AABB(const vec3& min_corner, const vec3& max_corner) : min_corner(min_corner), max_corner(max_corner) {}
+
+	bool isEmpty() const {return min_corner.x > max_corner.x || min_corner.y > max_corner.y || min_corner.z > max_corner.z;}
+
+	vec3 getCenter() const  {return 0.5f * (min_corner + max_corner);}
+	vec3 getExtents() const {return 0.5f * (max_corner - min_corner);}	// half-size
+
+	void extend(const vec3& p);
+	void extend(const AABB& box);
+
+	// Box of the given points (x1, y1, z1, x2, y2, z2, ...etc), computed with a SIMD
+	// min/max reduction when SSE is available
+	static AABB fromPoints(const float* points, uint nb_points);
+
+	// Box containing this box once transformed
+	AABB transform(const mat3& orientation, const vec3& position) const;
+};
+
+// Bounding sphere
+struct BoundingSphere
+{
+	vec3 center;
+	float radius;	// negative for an empty sphere
+
+	BoundingSphere() : center(0.0f), radius(-1.0f) {}
+	BoundingSphere(const vec3& center, float radius) : center(center), radius(radius) {}
+
+	bool isEmpty() const {return radius < 0.0f;}
+
+	// Sphere of the given points, centered on their bounding box
+	static BoundingSphere fromPoints(const float* points, uint nb_points, const AABB& box);
+
+	// Sphere containing this sphere once transformed (the orientation can have a scaling)
+	BoundingSphere transform(const mat3& orientation, const vec3& position) const;
+};
+
+#endif // BOUNDS_H
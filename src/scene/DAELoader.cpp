@@ -8,8 +8,10 @@
 #include "MeshObject.h"
 #include "Scene.h"
 #include "Sphere.h"
+#include "TransformHierarchy.h"
 #include "../log/Log.h"
 #include "../tinyxml/tinyxml.h"
+#include "../utils/JobPool.h"
 #include "../utils/StrManip.h"
 #include "../Common.h"
 #include <string>
@@ -17,6 +19,82 @@
 #include "../glm/gtc/matrix_transform.hpp"
 using namespace std;
 
+// ---------------------------------------------------------------------
+// Jobs used for loading the geometries and the materials in parallel.
+// run() is called from a worker thread and only does CPU work, apply() is
+// called from the loading thread once all the jobs are done.
+class DAELoader::LoadJob : public Job
+{
+public:
+	virtual void apply() = 0;
+};
+
+class DAELoader::GeometryJob : public DAELoader::LoadJob
+{
+private:
+	DAELoader* loader;
+	TiXmlElement* geometry_element;
+	std::list<MeshObject*> objects;	// all the instances of the <geometry>
+	Geometry* geo;
+
+public:
+	GeometryJob(DAELoader* loader, TiXmlElement* geometry_element)
+	: loader(loader), geometry_element(geometry_element), geo(NULL)
+	{
+	}
+
+	void addObject(MeshObject* obj)
+	{
+		objects.push_back(obj);
+	}
+
+	virtual void run()
+	{
+		geo = loader->loadGeometry(geometry_element);
+	}
+
+	// The geometry is shared by all the objects instancing it
+	virtual void apply()
+	{
+		if(geo == NULL)
+			return;
+
+		for(std::list<MeshObject*>::iterator it = objects.begin() ; it != objects.end() ; it++)
+			(*it)->setGeometry(geo);
+	}
+};
+
+class DAELoader::MaterialJob : public DAELoader::LoadJob
+{
+private:
+	std::string filename;
+	Object* obj;
+	Material* material;
+
+public:
+	MaterialJob(const std::string& filename, Object* obj)
+	: filename(filename), obj(obj), material(NULL)
+	{
+	}
+
+	virtual void run()
+	{
+		material = new Material();
+		if(!material->loadFromXML(filename))
+		{
+			delete material;
+			material = NULL;
+		}
+	}
+
+	virtual void apply()
+	{
+		if(material != NULL)
+			obj->setMaterial(material);
+	}
+};
+
+// ---------------------------------------------------------------------
 DAELoader::DAELoader()
 {
 }
@@ -36,14 +114,22 @@ void DAELoader::resetInternalState()
 	geometries_library = NULL;
 	base_dir = "";
 	elements = NULL;
+	transforms = NULL;
+
+	assert(jobs.empty());
+	assert(objects.empty());
+	geometry_jobs.clear();
 }
 
 // ---------------------------------------------------------------------
-template <class T>
-void readTransformation(TiXmlElement* node_element, T* obj)
+// Reads the transformation of a <node>, relative to its parent node
+static void readTransformation(TiXmlElement* node_element, vec3* position, mat3* orientation)
 {
 	TiXmlHandle node_handle(node_element);
 
+	*position = vec3(0.0f);
+	*orientation = mat3(1.0f);
+
 	if(	node_element->FirstChildElement("matrix") &&
 		node_element->FirstChildElement("matrix")->GetText())
 	{
@@ -51,8 +137,8 @@ void readTransformation(TiXmlElement* node_element, T* obj)
 		getNumbersArray(node_handle.FirstChildElement("matrix").ToElement()->GetText(), &transform[0][0], NULL);
 		transform = glm::transpose(transform);
 
-		obj->setOrientation(mat3(transform));
-		obj->setPosition(vec3(transform[3]));
+		*orientation = mat3(transform);
+		*position = vec3(transform[3]);
 	}
 }
 
@@ -109,6 +195,11 @@ void DAELoader::load(Scene* scene, const char* filename, ElementContainer::Type
 	this->elements->beginFilling();
 	scene->setElements(elements);
 
+	// Create the hierarchy of the nodes' transformations
+	this->transforms = new TransformHierarchy();
+	this->transforms->beginBuilding();
+	scene->setTransforms(transforms);
+
 	// Load the first <visual_scene>, and emit a warning if there are more or less than 1 :
 	TiXmlElement* visual_scene_element = visual_scenes_library->FirstChildElement("visual_scene");
 
@@ -124,6 +215,27 @@ void DAELoader::load(Scene* scene, const char* filename, ElementContainer::Type
 	scene->setName(filename);
 	loadVisualScene(scene, visual_scene_element);
 
+	// Compute the world transformations and attach the elements to their nodes
+	this->transforms->endBuilding();
+
+	// Wait for the geometries and the materials being loaded by the JobPool,
+	// and give them to their objects :
+	getJobPool().wait();
+
+	for(list<LoadJob*>::iterator it = jobs.begin() ; it != jobs.end() ; it++)
+	{
+		(*it)->apply();
+		delete (*it);
+	}
+	jobs.clear();
+	geometry_jobs.clear();
+
+	// Now that the objects are constructed, add them to the container.
+	// NB: it's important to do this in the end, as addObject() can rely on object's properties.
+	for(list<Object*>::iterator it = objects.begin() ; it != objects.end() ; it++)
+		this->elements->addObject(*it);
+	objects.clear();
+
 	// End of the filling of the elements of the scene :
 	this->elements->endFilling();
 }
@@ -131,42 +243,61 @@ void DAELoader::load(Scene* scene, const char* filename, ElementContainer::Type
 // ---------------------------------------------------------------------
 
 // Loads a <COLLADA>/<library_visual_scenes>/<visual_scene> (called by load())
-// NB : we do not support hierarchical scene nodes, so that only the root nodes are read !
 void DAELoader::loadVisualScene(Scene* scene, TiXmlElement* visual_scene_element)
 {
-	// For each node :
+	// For each root node :
 	for(TiXmlElement* node_element = visual_scene_element->FirstChildElement("node") ;
 		node_element != NULL ;
 		node_element = node_element->NextSiblingElement("node"))
 	{
-		TiXmlHandle node_handle = node_element;
+		loadNode(scene, node_element, -1);
+	}
+}
 
-		// Check the type of the node :
-		// - case it's a camera :
-		if(node_element->FirstChildElement("instance_camera"))
-		{
-			loadCamera(scene, node_element);
-		}
-		// - case it's a light :
-		else if(node_element->FirstChildElement("instance_light"))
-		{
-			loadLight(scene, node_element);
-		}
-		// - case it's a mesh :
-		else if(node_element->FirstChildElement("instance_geometry"))
-		{
-			loadMeshObject(scene, node_element);
-		}
-		// - case it's something else (sphere...)
-		else if(node_element->FirstChildElement("extra"))
-		{
-			loadOther(scene, node_element);
-		}
+// Loads a <node> and its children, recursively
+void DAELoader::loadNode(Scene* scene, TiXmlElement* node_element, int parent_node)
+{
+	// Add the node to the hierarchy, with its transformation relative to its parent :
+	vec3 position;
+	mat3 orientation;
+	readTransformation(node_element, &position, &orientation);
+
+	int transform_node = transforms->addNode(parent_node, position, orientation);
+
+	// Check the type of the node :
+	// - case it's a camera :
+	if(node_element->FirstChildElement("instance_camera"))
+	{
+		loadCamera(scene, node_element, transform_node);
+	}
+	// - case it's a light :
+	else if(node_element->FirstChildElement("instance_light"))
+	{
+		loadLight(scene, node_element, transform_node);
+	}
+	// - case it's a mesh :
+	else if(node_element->FirstChildElement("instance_geometry"))
+	{
+		loadMeshObject(scene, node_element, transform_node);
+	}
+	// - case it's something else (sphere...)
+	else if(node_element->FirstChildElement("extra"))
+	{
+		loadOther(scene, node_element, transform_node);
+	}
+	// - otherwise it only groups its children
+
+	// Children nodes :
+	for(TiXmlElement* child_element = node_element->FirstChildElement("node") ;
+		child_element != NULL ;
+		child_element = child_element->NextSiblingElement("node"))
+	{
+		loadNode(scene, child_element, transform_node);
 	}
 }
 
 // ---------------------------------------------------------------------
-void DAELoader::loadCamera(Scene* scene, TiXmlElement* node_element)
+void DAELoader::loadCamera(Scene* scene, TiXmlElement* node_element, int transform_node)
 {
 	// If we haven't found a <library_cameras>, return
 	if(!cameras_library)
@@ -208,7 +339,12 @@ void DAELoader::loadCamera(Scene* scene, TiXmlElement* node_element)
 		scene->setCamera(cam);
 
 		// Get the position and orientation of the camera :
-		readTransformation(node_element, cam);
+		// the camera is not in the hierarchy, so that we give it its world transformation.
+		vec3 cam_position;
+		mat3 cam_orientation;
+		transforms->computeWorldTransform(transform_node, &cam_position, &cam_orientation);
+		cam->setPosition(cam_position);
+		cam->setOrientation(cam_orientation);
 
 		// Parse the camera's properties
 		TiXmlElement* yfov_element = perspective_element->FirstChildElement("yfov");
@@ -236,7 +372,7 @@ void DAELoader::loadCamera(Scene* scene, TiXmlElement* node_element)
 }
 
 // ---------------------------------------------------------------------
-void DAELoader::loadLight(Scene* scene, TiXmlElement* node_element)
+void DAELoader::loadLight(Scene* scene, TiXmlElement* node_element, int transform_node)
 {
 	if(!lights_library)
 		return;
@@ -266,8 +402,8 @@ void DAELoader::loadLight(Scene* scene, TiXmlElement* node_element)
 		light->setName(id);
 		elements->addLight(light);
 
-		// Get its transformation :
-		readTransformation(node_element, light);
+		// Attach it to its node :
+		transforms->setElement(transform_node, light);
 
 		// If we found a <node>/<extra>/<technique>/<param type="STRING" name="light">,
 		// load the light's XML file.
@@ -296,7 +432,7 @@ void DAELoader::loadLight(Scene* scene, TiXmlElement* node_element)
 }
 
 // ---------------------------------------------------------------------
-void DAELoader::loadMeshObject(Scene* scene, TiXmlElement* node_element)
+void DAELoader::loadMeshObject(Scene* scene, TiXmlElement* node_element, int transform_node)
 {
 	TiXmlHandle node_handle = node_element;
 
@@ -305,8 +441,8 @@ void DAELoader::loadMeshObject(Scene* scene, TiXmlElement* node_element)
 	MeshObject* obj = new MeshObject();
 	obj->setName(name);
 
-	// Get its transformation :
-	readTransformation(node_element, obj);
+	// Attach it to its node :
+	transforms->setElement(transform_node, obj);
 
 	// We get the corresponding <geometry> node
 	TiXmlElement* geometry_element = NULL;
@@ -326,24 +462,26 @@ void DAELoader::loadMeshObject(Scene* scene, TiXmlElement* node_element)
 		logWarn("<geometry id=\"", geometry_url, "\" not found");
 	else
 	{
-		// We load the geometry
-		Geometry* geo = loadGeometry(geometry_element);
-
-		// We assign the geometry to the object
-		obj->setGeometry(geo);
+		// We load each geometry only once, in a job which assigns it to all its instances once done
+		GeometryJob*& job = geometry_jobs[geometry_url];
+		if(job == NULL)
+		{
+			job = new GeometryJob(this, geometry_element);
+			jobs.push_back(job);
+			getJobPool().push(job);
+		}
+		job->addObject(obj);
 	}
 
 	// Read the material
 	readMaterial(node_element, obj);
 
-	// Finally, add the object to the container.
-	// NB: it's important to do this in the end, once the object is constructed,
-	// as addObject() can rely on object's properties.
-	elements->addObject(obj);
+	// The object is added to the container by load(), once its jobs are done
+	objects.push_back(obj);
 }
 
 // ---------------------------------------------------------------------
-void DAELoader::loadOther(Scene* scene, TiXmlElement* node_element)
+void DAELoader::loadOther(Scene* scene, TiXmlElement* node_element, int transform_node)
 {
 	TiXmlHandle node_handle = node_element;
 
@@ -386,13 +524,15 @@ void DAELoader::loadOther(Scene* scene, TiXmlElement* node_element)
 		Sphere* sphere = new Sphere();
 		sphere->setName(name);
 		sphere->setRadius(radius);
-		elements->addObject(sphere);
 
-		// Get its transformation
-		readTransformation(node_element, sphere);
+		// Attach it to its node
+		transforms->setElement(transform_node, sphere);
 
 		// Get its material
 		readMaterial(node_element, sphere);
+
+		// The object is added to the container by load(), once its jobs are done
+		objects.push_back(sphere);
 	}
 }
 
@@ -670,12 +810,10 @@ void DAELoader::readMaterial(TiXmlElement* node_element, Object* obj)
 			{
 				string material_name = safeString(param_element->GetText());
 
-				// Load the material, if there is one :
-				Material* material = new Material();
-				if(!material->loadFromXML(base_dir + string("/materials/") + material_name))
-					delete material;
-				else
-					obj->setMaterial(material);
+				// Load the material in a job, which assigns it to the object if there is one :
+				LoadJob* job = new MaterialJob(base_dir + string("/materials/") + material_name, obj);
+				jobs.push_back(job);
+				getJobPool().push(job);
 			}
 		}
 	}
@@ -4,6 +4,8 @@
 #define DAE_LOADER_H
 
 #include <string>
+#include <list>
+#include <map>
 #include "ElementContainer.h"
 
 class Scene;
@@ -12,6 +14,7 @@ class Material;
 class TiXmlElement;
 class ElementContainer;
 class Object;
+class TransformHierarchy;
 
 class DAELoader
 {
@@ -30,23 +33,35 @@ private:
 	// Internal functions called by load() :
 
 	// Loads a <COLLADA>/<library_visual_scenes>/<visual_scene> (called by load())
-	// NB : we do not support hierarchical scene nodes, so that only the root nodes are read !
 	void loadVisualScene(Scene* scene, TiXmlElement* visual_scene_element);
 
-	void loadCamera(Scene* scene, TiXmlElement* node_element);
+	// Loads a <node> and its children, recursively. "parent_node" is the index of the
+	// parent's node in the TransformHierarchy (-1 for root nodes).
+	void loadNode(Scene* scene, TiXmlElement* node_element, int parent_node);
 
-	void loadLight(Scene* scene, TiXmlElement* node_element);
+	// The following functions get the index of the node in the TransformHierarchy:
+	void loadCamera(Scene* scene, TiXmlElement* node_element, int transform_node);
 
-	void loadMeshObject(Scene* scene, TiXmlElement* node_element);
+	void loadLight(Scene* scene, TiXmlElement* node_element, int transform_node);
 
-	void loadOther(Scene* scene, TiXmlElement* node_element);
+	void loadMeshObject(Scene* scene, TiXmlElement* node_element, int transform_node);
+
+	void loadOther(Scene* scene, TiXmlElement* node_element, int transform_node);
 
 	// This function creates the Geometry, based on the information coming from the COLLADA file.
 	// It "decompresses" the information.
+	// NB: it is called from the JobPool's workers, so it must not use the internal variables.
 	Geometry* loadGeometry(TiXmlElement* geometry_element);
 
 	void readMaterial(TiXmlElement* node_element, Object* obj);
 
+	// The geometries and the materials are parsed in parallel by the JobPool:
+	// loadMeshObject() and readMaterial() only push jobs, and load() waits for them
+	// and applies their results before adding the objects to the container.
+	class LoadJob;
+	class GeometryJob;
+	class MaterialJob;
+
 	// Internal variables used only when we load
 	int nb_lights;
 	TiXmlElement* root;	// <COLLADA>
@@ -56,6 +71,10 @@ private:
 	TiXmlElement* geometries_library;	// <library_geometries>
 	std::string base_dir;	// directory of the .dae file
 	ElementContainer* elements;	// elements of the scene : objects + lights
+	TransformHierarchy* transforms;	// hierarchy of the transformations of the nodes
+	std::list<LoadJob*> jobs;	// jobs pushed while reading the visual scene, in document order
+	std::list<Object*> objects;	// objects waiting for their jobs before being added to "elements"
+	std::map<std::string, GeometryJob*> geometry_jobs;	// jobs loading the geometries, by <geometry> id
 };
 
 #endif // DAE_LOADER_H
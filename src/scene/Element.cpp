@@ -1,8 +1,11 @@
 // Element.cpp
 
 #include "Element.h"
+#include "TransformHierarchy.h"
+#include <cstdlib>
 
 Element::Element()
+: transforms(NULL), transform_node(0), transform_stamp(newTransformStamp())
 {
 }
 
@@ -13,22 +16,53 @@ Element::~Element()
 // Position
 void Element::setPosition(const vec3& pos)
 {
-	this->position = pos;
+	if(transforms != NULL)
+		transforms->setLocalPosition(transform_node, pos);
+	else
+	{
+		this->position = pos;
+		this->transform_stamp = newTransformStamp();
+	}
 }
 
 const vec3& Element::getPosition() const
 {
+	if(transforms != NULL)
+		return transforms->getWorldPosition(transform_node);
 	return position;
 }
 
 // Orientation
 void Element::setOrientation(const mat3& orientation)
 {
-	this->orientation = orientation;
+	if(transforms != NULL)
+		transforms->setLocalOrientation(transform_node, orientation);
+	else
+	{
+		this->orientation = orientation;
+		this->transform_stamp = newTransformStamp();
+	}
 }
 
 const mat3& Element::getOrientation() const
 {
+	if(transforms != NULL)
+		return transforms->getWorldOrientation(transform_node);
+	return orientation;
+}
+
+// Transformation relative to the parent node
+const vec3& Element::getLocalPosition() const
+{
+	if(transforms != NULL)
+		return transforms->getLocalPosition(transform_node);
+	return position;
+}
+
+const mat3& Element::getLocalOrientation() const
+{
+	if(transforms != NULL)
+		return transforms->getLocalOrientation(transform_node);
 	return orientation;
 }
 
@@ -42,3 +76,29 @@ const std::string& Element::getName() const
 {
 	return name;
 }
+
+// Hierarchy :
+void Element::attachToTransformNode(TransformHierarchy* transforms, uint node)
+{
+	this->transforms = transforms;
+	this->transform_node = node;
+}
+
+// Transform stamp :
+uint Element::getTransformStamp() const
+{
+	if(transforms != NULL)
+		return transforms->getTransformStamp(transform_node);
+	return transform_stamp;
+}
+
+uint Element::newTransformStamp()
+{
+	static uint last_stamp = 0;
+
+	last_stamp++;
+	if(last_stamp == 0)
+		last_stamp++;
+
+	return last_stamp;
+}
@@ -1,4 +1,10 @@
 // Element.h
+// NB: when the element is attached to a node of a TransformHierarchy, setPosition() and
+// setOrientation() are relative to the parent node, whereas getPosition() and getOrientation()
+// return the world transformation, as computed by the last TransformHierarchy::update().
+// Otherwise both are in world space.
+// The "transform stamp" changes each time the world transformation changes, so that
+// the data depending on it (e.g. the world bounds) can be updated only when needed.
 
 #ifndef ELEMENT_H
 #define ELEMENT_H
@@ -6,6 +12,8 @@
 #include "../Common.h"
 #include <string>
 
+class TransformHierarchy;
+
 class Element
 {
 private:
@@ -13,6 +21,11 @@ private:
 	mat3 orientation;
 	std::string name;
 
+	TransformHierarchy* transforms;	// hierarchy the element is attached to (or NULL)
+	uint transform_node;
+
+	uint transform_stamp;	// used when not attached to a hierarchy
+
 public:
 	Element();
 	virtual ~Element();
@@ -23,8 +36,21 @@ public:
 	void setOrientation(const mat3& orientation);
 	const mat3& getOrientation() const;
 
+	// Transformation relative to the parent node:
+	const vec3& getLocalPosition() const;
+	const mat3& getLocalOrientation() const;
+
 	void setName(const std::string& name);
 	const std::string& getName() const;
+
+	// Hierarchy (called by TransformHierarchy::endBuilding()):
+	void attachToTransformNode(TransformHierarchy* transforms, uint node);
+	TransformHierarchy* getTransformHierarchy() const {return transforms;}
+	uint getTransformNode() const {return transform_node;}
+
+	// Transform stamp:
+	uint getTransformStamp() const;
+	static uint newTransformStamp();	// returns a new unique value (never 0)
 };
 
 #endif // ELEMENT_H
@@ -23,6 +23,9 @@ public:
 
 	virtual void clear() = 0;
 
+	// Update the world bounds of the objects whose transformation changed
+	virtual void updateBounds() = 0;
+
 	// RTTI :
 	enum Type
 	{
@@ -0,0 +1,117 @@
+// Frustum.cpp
+
+#include "Frustum.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define FRUSTUM_USE_SSE
+	#include <xmmintrin.h>
+#endif
+
+Frustum::Frustum()
+{
+	// Default frustum: everything is visible
+	for(uint i=0 ; i < 6 ; i++)
+		planes[i] = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+Frustum::Frustum(const mat4& view_proj_matrix)
+{
+	setFromMatrix(view_proj_matrix);
+}
+
+// Extract the planes from a projection * view matrix (Gribb & Hartmann's method)
+void Frustum::setFromMatrix(const mat4& m)
+{
+	// Rows of the matrix (glm matrices are column-major):
+	vec4 rows[4];
+	for(uint i=0 ; i < 4 ; i++)
+		rows[i] = vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+	planes[0] = rows[3] + rows[0];	// left
+	planes[1] = rows[3] - rows[0];	// right
+	planes[2] = rows[3] + rows[1];	// bottom
+	planes[3] = rows[3] - rows[1];	// top
+	planes[4] = rows[3] + rows[2];	// near
+	planes[5] = rows[3] - rows[2];	// far
+
+	// Normalize them, so that we can compare the distances with the radii:
+	for(uint i=0 ; i < 6 ; i++)
+	{
+		float len = glm::length(vec3(planes[i]));
+		if(len > 0.0f)
+			planes[i] /= len;
+	}
+}
+
+// ---------------------------------------------------------------------
+bool Frustum::isSphereVisible(const vec3& center, float radius) const
+{
+	if(radius < 0.0f)
+		return false;
+
+	for(uint i=0 ; i < 6 ; i++)
+		if(glm::dot(vec3(planes[i]), center) + planes[i].w < -radius)
+			return false;
+
+	return true;
+}
+
+uint Frustum::cullSpheres(const float* centers_x, const float* centers_y, const float* centers_z,
+						  const float* radii, uint nb_spheres, uchar* visible) const
+{
+	uint nb_visible = 0;
+	uint i = 0;
+
+#ifdef FRUSTUM_USE_SSE
+	// 4 spheres at a time:
+	__m128 plane_a[6], plane_b[6], plane_c[6], plane_d[6];
+	for(uint p=0 ; p < 6 ; p++)
+	{
+		plane_a[p] = _mm_set1_ps(planes[p].x);
+		plane_b[p] = _mm_set1_ps(planes[p].y);
+		plane_c[p] = _mm_set1_ps(planes[p].z);
+		plane_d[p] = _mm_set1_ps(planes[p].w);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+
+	for( ; i+4 <= nb_spheres ; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&centers_x[i]);
+		__m128 y = _mm_loadu_ps(&centers_y[i]);
+		__m128 z = _mm_loadu_ps(&centers_z[i]);
+		__m128 r = _mm_loadu_ps(&radii[i]);
+		__m128 minus_r = _mm_sub_ps(zero, r);
+
+		// Empty spheres are not visible:
+		__m128 inside = _mm_cmpge_ps(r, zero);
+
+		for(uint p=0 ; p < 6 ; p++)
+		{
+			// Same order of the operations as isSphereVisible(), so that the results are the same
+			// for the spheres tangent to the planes:
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_a[p], x),
+														   _mm_mul_ps(plane_b[p], y)),
+												_mm_mul_ps(plane_c[p], z)),
+									 plane_d[p]);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, minus_r));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for(uint j=0 ; j < 4 ; j++)
+		{
+			visible[i+j] = uchar((mask >> j) & 1);
+			nb_visible += visible[i+j];
+		}
+	}
+#endif
+
+	// Remaining spheres:
+	for( ; i < nb_spheres ; i++)
+	{
+		visible[i] = isSphereVisible(vec3(centers_x[i], centers_y[i], centers_z[i]), radii[i]) ? 1 : 0;
+		nb_visible += visible[i];
+	}
+
+	return nb_visible;
+}
@@ -0,0 +1,36 @@
+// Frustum.h
+// View frustum, extracted from a projection * view matrix, used for culling the objects
+// against the view of the camera or of a light.
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "../Common.h"
+
+class Frustum
+{
+private:
+	// Planes (a, b, c, d) such that a*x + b*y + c*z + d >= 0 inside the frustum,
+	// with (a, b, c) normalized. Order: left, right, bottom, top, near, far.
+	vec4 planes[6];
+
+public:
+	Frustum();
+	Frustum(const mat4& view_proj_matrix);
+
+	// Extract the planes from a projection * view matrix
+	void setFromMatrix(const mat4& view_proj_matrix);
+
+	const vec4& getPlane(uint index) const {return planes[index];}
+
+	// Test one sphere
+	bool isSphereVisible(const vec3& center, float radius) const;
+
+	// Test several spheres stored as separate arrays of coordinates (SoA), with SSE when
+	// available. Write 1 in visible[i] if the sphere i may be visible and 0 otherwise,
+	// and return the number of visible spheres. Empty spheres (negative radius) are not visible.
+	uint cullSpheres(const float* centers_x, const float* centers_y, const float* centers_z,
+					 const float* radii, uint nb_spheres, uchar* visible) const;
+};
+
+#endif // FRUSTUM_H
@@ -13,10 +13,15 @@ Geometry::Geometry()
   normals(NULL),
   texcoords(NULL),
   nb_vertices(0),
+  nb_references(0),
   id_vbo(0)
 {
 	for(uint i=0 ; i < NB_MAX_VAO ; i++)
+	{
 		id_vaos[i] = 0;
+		first_vertices[i] = 0;
+		shared_vaos[i] = false;
+	}
 }
 
 Geometry::~Geometry()
@@ -34,6 +39,20 @@ void Geometry::setVertices(uint nb_vertices, float* vertices, float* normals, fl
 	this->vertices    = vertices;
 	this->normals     = normals;
 	this->texcoords   = texcoords;
+
+	// Compute the bounds:
+	aabb = AABB::fromPoints(vertices, nb_vertices);
+	bounding_sphere = BoundingSphere::fromPoints(vertices, nb_vertices, aabb);
+}
+
+// Reference counting:
+void Geometry::removeReference()
+{
+	assert(nb_references != 0);
+
+	nb_references--;
+	if(nb_references == 0)
+		delete this;
 }
 
 // VBO management:
@@ -48,13 +67,32 @@ void Geometry::buildVBO()
 		return;
 	}
 
+	// Generate an array containing the interleaved data for passing it to the
+	// VBO (TODO: maybe we should use glMapBuffer() / glUnmapBuffer() for better performance...)
+	GLfloat* interleaved_data = buildInterleavedData();
+	GLsizeiptr total_size = GLsizeiptr(nb_vertices) * getVertexSize();
+
+	// Create a VBO
+	glGenBuffers(1, &id_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, id_vbo);
+
+	// Allocate space for the VBO and put data inside:
+	glBufferData(GL_ARRAY_BUFFER, total_size, (const GLvoid*)interleaved_data, GL_STATIC_DRAW);
+
+	// Cleanup:
+	delete [] interleaved_data;
+}
+
+// Interleaved data, as stored in the VBO:
+GLfloat* Geometry::buildInterleavedData() const
+{
+	assert(vertices != NULL);
+
 	// Get the size of a single vertex in bytes:
 	GLint vertex_size = getVertexSize();
 	GLint vertex_size_in_floats = vertex_size / sizeof(GLfloat);
 	uint nb_floats = uint(nb_vertices * vertex_size_in_floats);
 
-	// Generate an array containing the interleaved data for passing it to the
-	// VBO (TODO: maybe we should use glMapBuffer() / glUnmapBuffer() for better performance...)
 	GLfloat* interleaved_data = new GLfloat[nb_floats];
 
 	// - vertices:
@@ -99,16 +137,7 @@ void Geometry::buildVBO()
 		start_offset += 2;
 	}
 
-	// Create a VBO
-	glGenBuffers(1, &id_vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, id_vbo);
-
-	// Allocate space for the VBO and put data inside:
-	GLsizeiptr total_size = sizeof(GLfloat) * nb_floats;
-	glBufferData(GL_ARRAY_BUFFER, total_size, (const GLvoid*)interleaved_data, GL_STATIC_DRAW);
-
-	// Cleanup:
-	delete [] interleaved_data;
+	return interleaved_data;
 }
 
 void Geometry::deleteVBO()
@@ -117,7 +146,7 @@ void Geometry::deleteVBO()
 #ifndef NDEBUG
 	for(uint i=0 ; i < NB_MAX_VAO ; i++)
 	{
-		assert(id_vaos[i] == 0);
+		assert(id_vaos[i] == 0 || shared_vaos[i]);
 	}
 #endif
 
@@ -139,14 +168,14 @@ void Geometry::buildVAO(uint index,
 	// If the VAO is already created, just bind it and discard.
 	if(id_vaos[index] != 0)
 	{
-		glBindVertexArray(id_vaos[index]);
+		glutil::bindVertexArray(id_vaos[index]);
 		return;
 	}
 
 	// Build the VAO:
 	// - create the VAO
 	glGenVertexArrays(1, &id_vaos[index]);
-	glBindVertexArray(id_vaos[index]);
+	glutil::bindVertexArray(id_vaos[index]);
 
 	// - build the VBO in case it is not already built, and let it bound:
 	buildVBO();
@@ -183,11 +212,22 @@ void Geometry::buildVAO(uint index,
 void Geometry::deleteVAO(uint index)
 {
 	assert(index < NB_MAX_VAO);
-	if(id_vaos[index] != 0)
-	{
-		glDeleteVertexArrays(1, &id_vaos[index]);
-		id_vaos[index] = 0;
-	}
+	if(id_vaos[index] != 0 && !shared_vaos[index])
+		glutil::deleteVertexArrays(1, &id_vaos[index]);
+
+	id_vaos[index] = 0;
+	first_vertices[index] = 0;
+	shared_vaos[index] = false;
+}
+
+void Geometry::setSharedVAO(uint index, GLuint id_vao, uint first_vertex)
+{
+	assert(index < NB_MAX_VAO);
+	assert(id_vaos[index] == 0);
+
+	id_vaos[index] = id_vao;
+	first_vertices[index] = first_vertex;
+	shared_vaos[index] = true;
 }
 
 // Clear everything: memory, VBO, VAOs...
@@ -210,11 +250,14 @@ void Geometry::clear()
 
 	nb_vertices = 0;
 	vertices = normals = texcoords = NULL;
+
+	aabb = AABB();
+	bounding_sphere = BoundingSphere();
 }
 
 // ---------------------------------------------------------------------
-// Helper function for computing the strides for the VBO.
-inline uint Geometry::getVertexSize() const
+// Size of one vertex in the VBO in bytes
+uint Geometry::getVertexSize() const
 {
 	assert(vertices != NULL);
 	GLint stride = 0;
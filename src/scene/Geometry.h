@@ -12,6 +12,13 @@
 // - buildVAO() can be called several times on the same slot, but only builds the VAO the first time
 // - deleteVAO() effectively deletes the given VAO, no matter the number of previous calls to buildVAO()
 // - they are deleted when calling setVertices(), clear() or ~Geometry()
+// - a VAO slot can also refer to a VAO shared with other geometries (see setSharedVAO() and
+//   MeshPool): the vertices are then drawn from getFirstVertex(), and the VAO is not owned
+//   by the geometry (deleteVAO() only forgets it).
+// Sharing:
+// - a geometry can be shared between several MeshObjects (e.g. several instances of the same
+//   <geometry> in a COLLADA file), so that it is reference counted: MeshObject::setGeometry()
+//   adds a reference, and the geometry is deleted when its last reference is removed.
 // TODO: add tangent vectors.
 // TODO: change the behavior so that to keep track of the number of calls to buildVAO()/deleteVAO()
 // and buildVBO()/deleteVBO()
@@ -22,6 +29,7 @@
 #include "../glutil/glxw.h"
 #include "../Common.h"
 #include "../Boundaries.h"
+#include "Bounds.h"
 
 class Geometry
 {
@@ -34,7 +42,15 @@ private:
 
 	uint nb_vertices;
 
+	uint nb_references;	// number of MeshObjects using the geometry
+
+	// Local bounds, computed by setVertices():
+	AABB aabb;
+	BoundingSphere bounding_sphere;
+
 	GLuint id_vaos[NB_MAX_VAO];
+	uint first_vertices[NB_MAX_VAO];	// index of the first vertex in the VAO (0 if not shared)
+	bool shared_vaos[NB_MAX_VAO];		// is the VAO shared, i.e. not owned by the geometry?
 
 	GLuint id_vbo;	// We only have one VBO which contains all the data in an interleaved fashion, i.e:
 					// x1,y1,z1, nx1,ny1,nz1, u1,v1,   x2,y2,z2, nx2,ny2,nz2, u2,v2, etc.
@@ -56,6 +72,14 @@ public:
 
 	uint getNbVertices() const {return nb_vertices;}
 
+	const AABB& getAABB() const                     {return aabb;}
+	const BoundingSphere& getBoundingSphere() const {return bounding_sphere;}
+
+	// Reference counting:
+	void addReference() {nb_references++;}
+	void removeReference();	// deletes the geometry when there are no more references
+	uint getNbReferences() const {return nb_references;}
+
 	// VBO management:
 	void buildVBO();
 	void deleteVBO();
@@ -69,14 +93,19 @@ public:
 	void deleteVAO(uint index);
 	GLuint getVAO(uint index) const {return id_vaos[index];}
 
+	// Use a VAO shared with other geometries, where the vertices of this geometry start at "first_vertex"
+	void setSharedVAO(uint index, GLuint id_vao, uint first_vertex);
+	uint getFirstVertex(uint index) const {return first_vertices[index];}
+
+	// Interleaved data, as stored in the VBO (the caller deletes the returned array)
+	GLfloat* buildInterleavedData() const;
+
+	// Size of one vertex in the VBO in bytes (which is the same thing as the stride
+	// for glVertexAttribPointer())
+	uint getVertexSize() const;
+
 	// Clear everything: memory, VBO, VAOs...
 	void clear();
-
-private:
-	// Helper function for computing the strides for the VBO.
-	// Returns the total size needed for specifying one vertex (which is the same
-	// think as the stride for glVertexAttribPointer()).
-	inline uint getVertexSize() const;
 };
 
 #endif // GEOMETRY_H
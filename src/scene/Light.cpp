@@ -19,12 +19,13 @@ using namespace std;
 #define DEFAULT_BOUNCE_MAP_SIZE 1024
 
 #define LIGHT_ZNEAR 0.5f
-#define LIGHT_ZFAR  12.0f
+#define DEFAULT_LIGHT_RANGE 12.0f
 
 Light::Light()
 : Element(),
   color(),
   angle(0.0f),
+  range(DEFAULT_LIGHT_RANGE),
   shadow_map_size(DEFAULT_SHADOW_MAP_SIZE),
   bounce_map_size(DEFAULT_BOUNCE_MAP_SIZE)
 {
@@ -72,6 +73,10 @@ bool Light::loadFromXML(const string& filename)
 	if((value_element = light_element->FirstChildElement("angle")) != NULL)
 		readXMLValue(&angle, value_element);
 
+	// - range:
+	if((value_element = light_element->FirstChildElement("range")) != NULL)
+		readXMLValue(&range, value_element);
+
 	// - shadow_map_size:
 	if((value_element = light_element->FirstChildElement("shadow_map_size")) != NULL)
 		readXMLValue(&shadow_map_size, value_element);
@@ -95,7 +100,7 @@ mat4 Light::computeViewMatrix() const
 // Projection matrix
 mat4 Light::computeProjectionMatrix() const
 {
-	return glm::perspective(angle, 1.0f, LIGHT_ZNEAR, LIGHT_ZFAR);
+	return glm::perspective(angle, 1.0f, LIGHT_ZNEAR, range);
 }
 
 // Debug drawing of the light:
@@ -119,8 +124,8 @@ void Light::debugDrawFrustum(const mat4& proj_matrix,
 	vec3 corners[] = {
 		LIGHT_ZNEAR * down_left, LIGHT_ZNEAR * down_right,
 		LIGHT_ZNEAR * up_right,  LIGHT_ZNEAR * up_left,
-		LIGHT_ZFAR  * down_left, LIGHT_ZFAR  * down_right,
-		LIGHT_ZFAR  * up_right,  LIGHT_ZFAR  * up_left
+		range       * down_left, range       * down_right,
+		range       * up_right,  range       * up_left
 	};
 
 	// Move the points to the light space:
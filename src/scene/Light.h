@@ -16,6 +16,7 @@ private:
 	vec3 color;
 	float angle;	// total angle (not half-angle), in degrees
 					// 0.0 means omnidirectional light (shadow cubemaps for those are NOT supported!)
+	float range;	// distance beyond which the light has no effect (far plane of the light's frustum)
 	uint shadow_map_size;	// size of the shadow map (e.g. 512 for 512x512)
 	uint bounce_map_size;	// size of the bounce map
 
@@ -34,6 +35,10 @@ public:
 	void  setAngle(float angle) {this->angle = angle;}
 	float getAngle() const      {return angle;}
 
+	// - range of the light:
+	void  setRange(float range) {this->range = range;}
+	float getRange() const      {return range;}
+
 	// - direction of the light:
 	vec3 getDirection() const {return -getOrientation()[2];}
 
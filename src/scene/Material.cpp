@@ -3,6 +3,7 @@
 #include "Material.h"
 #include "profiles/Profile.h"
 #include "../Common.h"
+#include "../glutil/Hash.h"
 #include "../log/Log.h"
 #include "../tinyxml/tinyxml.h"
 #include "../utils/XMLManip.h"
@@ -14,7 +15,8 @@ using namespace std;
 
 // ---------------------------------------------------------------------
 Material::Material()
-: flags(0)
+: filename_hash(0),
+  flags(0)
 {
 	for(uint i=0 ; i < NB_MAX_MATERIAL_PROFILES ; i++)
 		profiles[i] = NULL;
@@ -55,14 +57,40 @@ bool Material::loadFromXML(const string& filename)
 
 	// Load the file and check if it is valid
 	this->filename = filename;
+	this->filename_hash = Hash(filename, Hash::AT_RUNTIME).val;
 	if(!doc.LoadFile(filename))
 	{
 		logFailed("unable to load the requested file \"", filename, "\"");
 		return false;
 	}
 
+	return loadFromDocument(&doc);
+}
+
+bool Material::loadFromXMLText(const string& name, const string& xml_text)
+{
+	logInfo("loading material \"", name, "\"");
+
+	TiXmlDocument doc;
+
+	// Parse the contents and check if they are valid
+	this->filename = name;
+	this->filename_hash = Hash(name, Hash::AT_RUNTIME).val;
+	doc.Parse(xml_text.c_str());
+	if(doc.Error())
+	{
+		logFailed("unable to parse the material \"", name, "\": ", doc.ErrorDesc());
+		return false;
+	}
+
+	return loadFromDocument(&doc);
+}
+
+// ---------------------------------------------------------------------
+bool Material::loadFromDocument(TiXmlDocument* doc)
+{
 	// Read/check the <material> mark:
-	TiXmlElement* material_element = doc.FirstChildElement("material");
+	TiXmlElement* material_element = doc->FirstChildElement("material");
 
 	if(!material_element)
 	{
@@ -8,6 +8,7 @@
 #include "../scene/GPUProgramManager.h"
 #include <string>
 
+class TiXmlDocument;
 class TiXmlElement;
 class Profile;
 
@@ -27,6 +28,7 @@ public:
 
 private:
 	std::string filename;
+	int filename_hash;	// used for sorting the draw calls by material (see RenderQueue)
 	Profile* profiles[NB_MAX_MATERIAL_PROFILES];
 	Flags flags;
 
@@ -35,6 +37,7 @@ public:
 	virtual ~Material();
 
 	const std::string& getFilename() const {return filename;}
+	int getFilenameHash() const {return filename_hash;}
 
 	Profile* getProfile(uint index);
 	const Profile* getProfile(uint index) const;
@@ -42,12 +45,18 @@ public:
 	// Load the material's profiles from an XML file
 	bool loadFromXML(const std::string& filename);
 
+	// Same thing, from XML contents generated in memory (e.g. from a .mtl file).
+	// "name" is used in place of the filename.
+	bool loadFromXMLText(const std::string& name, const std::string& xml_text);
+
 	// Flags:
 	void setFlags(Flags flags) {this->flags = flags;}
 	void addFlags(Flags flags) {this->flags |= flags;}
 	Flags getFlags() const {return flags;}
 
 private:
+	bool loadFromDocument(TiXmlDocument* doc);
+
 	static bool replaceCopyContentsMarks(TiXmlElement* material_element);
 	static bool isSymbolDefined(const char* symbol_name, const Preprocessor::SymbolList& preproc_sym);
 };
@@ -2,6 +2,7 @@
 
 #include "MeshObject.h"
 #include "Geometry.h"
+#include "Bounds.h"
 #include <cstdlib>
 
 MeshObject::MeshObject()
@@ -11,13 +12,19 @@ MeshObject::MeshObject()
 
 MeshObject::~MeshObject()
 {
-	delete this->geometry;
+	if(this->geometry != NULL)
+		this->geometry->removeReference();
 }
 
-// Geometry :
+// Geometry (shared, see Geometry.h) :
 void MeshObject::setGeometry(Geometry* geo)
 {
-	delete this->geometry;
+	if(geo != NULL)
+		geo->addReference();
+
+	if(this->geometry != NULL)
+		this->geometry->removeReference();
+
 	this->geometry = geo;
 }
 
@@ -31,6 +38,21 @@ const Geometry* MeshObject::getGeometry() const
 	return geometry;
 }
 
+// Bounds of the geometry (empty without geometry) :
+void MeshObject::computeLocalBounds(AABB* aabb, BoundingSphere* sphere) const
+{
+	if(geometry != NULL)
+	{
+		*aabb = geometry->getAABB();
+		*sphere = geometry->getBoundingSphere();
+	}
+	else
+	{
+		*aabb = AABB();
+		*sphere = BoundingSphere();
+	}
+}
+
 // RTTI :
 Object::Type MeshObject::getType() const
 {
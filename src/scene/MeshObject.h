@@ -21,6 +21,9 @@ public:
 	Geometry* getGeometry();
 	const Geometry* getGeometry() const;
 
+	// Bounds of the geometry:
+	virtual void computeLocalBounds(AABB* aabb, BoundingSphere* sphere) const;
+
 	// RTTI :
 	virtual Object::Type getType() const;
 };
@@ -1,14 +1,387 @@
 // OBJLoader.cpp
 
 #include "OBJLoader.h"
-#include <fstream>
-#include <string>
-#include <iostream>
+#include "OBJParseHelpers.h"
+#include "Camera.h"
+#include "Geometry.h"
+#include "Light.h"
+#include "Material.h"
+#include "MeshObject.h"
+#include "Scene.h"
 #include "../log/Log.h"
+#include "../utils/Clock.h"
+#include "../utils/JobPool.h"
+#include "../utils/MappedFile.h"
+#include "../utils/StrManip.h"
 #include "../Common.h"
-#include "Scene.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <climits>
 using namespace std;
 
+// Chunks smaller than this are not worth a job of their own:
+#define OBJ_MIN_CHUNK_SIZE (1 << 20)
+
+// Number of chunks per worker thread, for balancing the load:
+#define OBJ_CHUNKS_PER_THREAD 4
+
+// ---------------------------------------------------------------------
+// Material switch ("usemtl") inside a chunk
+struct OBJMaterialSwitch
+{
+	uint first_triangle;	// first triangle using the material
+	string name;
+};
+
+// Data read from a part of the file
+struct OBJChunk
+{
+	const char* begin;
+	const char* end;
+
+	vector<float> positions;	// x, y, z
+	vector<float> normals;		// x, y, z
+	vector<float> texcoords;	// u, v
+	vector<int> corners;		// position, texcoords, normal indices for each corner of each triangle
+
+	vector<OBJMaterialSwitch> material_switches;
+	vector<string> mtllibs;
+
+	uint nb_ignored_lines;
+
+	// Number of elements in the previous chunks:
+	uint positions_offset;
+	uint normals_offset;
+	uint texcoords_offset;
+
+	OBJChunk()
+	: begin(NULL), end(NULL), nb_ignored_lines(0), positions_offset(0), normals_offset(0), texcoords_offset(0)
+	{
+	}
+
+	uint getNbTriangles() const {return corners.size() / 9;}
+};
+
+// Range of triangles of a chunk using the same material
+struct OBJRange
+{
+	uint chunk;
+	uint first_triangle;
+	uint end_triangle;
+};
+
+// Triangles using the same material, spread over the chunks
+struct OBJGroup
+{
+	string material_name;
+	vector<OBJRange> ranges;
+	Geometry* geo;	// built by a job
+	uint nb_invalid_triangles;
+};
+
+// ---------------------------------------------------------------------
+// Parse the lines of a chunk
+static void parseChunk(OBJChunk* chunk)
+{
+	const char* p = chunk->begin;
+	const char* end = chunk->end;
+
+	// Corners of the current face:
+	vector<int> face;
+
+	while(p < end)
+	{
+		const char* line_end = (const char*)memchr(p, '\n', end - p);
+		if(line_end == NULL)
+			line_end = end;
+
+		p = skipBlanks(p, line_end);
+
+		if(p == line_end || *p == '#')
+		{
+			// Blank line or comment
+		}
+		// Vertex position:
+		else if(startsWithWord(p, line_end, "v", 1))
+		{
+			p += 1;
+			float x=0.0f, y=0.0f, z=0.0f;
+			parseFloat(&p, line_end, &x);
+			parseFloat(&p, line_end, &y);
+			parseFloat(&p, line_end, &z);
+
+			chunk->positions.push_back(x);
+			chunk->positions.push_back(y);
+			chunk->positions.push_back(z);
+		}
+		// Normal:
+		else if(startsWithWord(p, line_end, "vn", 2))
+		{
+			p += 2;
+			float x=0.0f, y=0.0f, z=0.0f;
+			parseFloat(&p, line_end, &x);
+			parseFloat(&p, line_end, &y);
+			parseFloat(&p, line_end, &z);
+
+			chunk->normals.push_back(x);
+			chunk->normals.push_back(y);
+			chunk->normals.push_back(z);
+		}
+		// Texture coordinates (the optional 3rd coordinate is ignored):
+		else if(startsWithWord(p, line_end, "vt", 2))
+		{
+			p += 2;
+			float u=0.0f, v=0.0f;
+			parseFloat(&p, line_end, &u);
+			parseFloat(&p, line_end, &v);
+
+			chunk->texcoords.push_back(u);
+			chunk->texcoords.push_back(v);
+		}
+		// Face: "v", "v/vt", "v//vn" or "v/vt/vn" for each corner.
+		// Polygons are triangulated as fans.
+		else if(startsWithWord(p, line_end, "f", 1))
+		{
+			p += 1;
+			face.clear();
+
+			uint nb_positions = chunk->positions.size() / 3;
+			uint nb_normals   = chunk->normals.size() / 3;
+			uint nb_texcoords = chunk->texcoords.size() / 2;
+
+			for(;;)
+			{
+				p = skipBlanks(p, line_end);
+
+				int position = 0, texcoord = 0, normal = 0;
+				if(!parseInt(&p, line_end, &position))
+					break;
+
+				if(p < line_end && *p == '/')
+				{
+					p++;
+					parseInt(&p, line_end, &texcoord);	// may be missing ("v//vn")
+
+					if(p < line_end && *p == '/')
+					{
+						p++;
+						parseInt(&p, line_end, &normal);
+					}
+				}
+
+				face.push_back(encodeIndex(position, nb_positions));
+				face.push_back(encodeIndex(texcoord, nb_texcoords));
+				face.push_back(encodeIndex(normal,   nb_normals));
+
+				// Skip anything unexpected until the next corner:
+				while(p < line_end && !isBlank(*p))
+					p++;
+			}
+
+			uint nb_corners = face.size() / 3;
+			for(uint i=2 ; i < nb_corners ; i++)
+			{
+				chunk->corners.insert(chunk->corners.end(), &face[0],       &face[0]       + 3);
+				chunk->corners.insert(chunk->corners.end(), &face[(i-1)*3], &face[(i-1)*3] + 3);
+				chunk->corners.insert(chunk->corners.end(), &face[i*3],     &face[i*3]     + 3);
+			}
+		}
+		// Material:
+		else if(startsWithWord(p, line_end, "usemtl", 6))
+		{
+			OBJMaterialSwitch material_switch;
+			material_switch.first_triangle = chunk->getNbTriangles();
+			material_switch.name = readName(p + 6, line_end);
+			chunk->material_switches.push_back(material_switch);
+		}
+		// Material library:
+		else if(startsWithWord(p, line_end, "mtllib", 6))
+		{
+			chunk->mtllibs.push_back(readName(p + 6, line_end));
+		}
+		// Objects, groups and smoothing groups are not used:
+		else if(startsWithWord(p, line_end, "o", 1) ||
+				startsWithWord(p, line_end, "g", 1) ||
+				startsWithWord(p, line_end, "s", 1))
+		{
+		}
+		else
+			chunk->nb_ignored_lines++;
+
+		p = line_end + 1;
+	}
+}
+
+// Build the Geometry of a group of triangles
+static void buildGroupGeometry(OBJGroup* group, const vector<OBJChunk*>& chunks,
+							   const vector<float>& positions,
+							   const vector<float>& normals,
+							   const vector<float>& texcoords)
+{
+	uint nb_positions = positions.size() / 3;
+	uint nb_normals   = normals.size() / 3;
+	uint nb_texcoords = texcoords.size() / 2;
+
+	// First pass: count the valid triangles and check if we need texture coordinates
+	uint nb_triangles = 0;
+	bool has_texcoords = false;
+	group->nb_invalid_triangles = 0;
+
+	for(uint r=0 ; r < group->ranges.size() ; r++)
+	{
+		const OBJRange& range = group->ranges[r];
+		const OBJChunk* chunk = chunks[range.chunk];
+
+		for(uint t=range.first_triangle ; t < range.end_triangle ; t++)
+		{
+			const int* corners = &chunk->corners[t*9];
+			bool valid = true;
+
+			for(uint c=0 ; c < 3 ; c++)
+			{
+				uint index = 0;
+				if(!decodeIndex(corners[c*3+0], chunk->positions_offset, nb_positions, &index))
+					valid = false;
+				if(decodeIndex(corners[c*3+1], chunk->texcoords_offset, nb_texcoords, &index))
+					has_texcoords = true;
+			}
+
+			if(valid)
+				nb_triangles++;
+			else
+				group->nb_invalid_triangles++;
+		}
+	}
+
+	group->geo = NULL;
+	if(nb_triangles == 0)
+		return;
+
+	// Second pass: "decompress" the triangles
+	uint nb_created_vertices = nb_triangles * 3;
+	float* out_vertices  = new float[nb_created_vertices*3];
+	float* out_normals   = new float[nb_created_vertices*3];
+	float* out_texcoords = has_texcoords ? new float[nb_created_vertices*2] : NULL;
+
+	uint num_vertex = 0;
+	for(uint r=0 ; r < group->ranges.size() ; r++)
+	{
+		const OBJRange& range = group->ranges[r];
+		const OBJChunk* chunk = chunks[range.chunk];
+
+		for(uint t=range.first_triangle ; t < range.end_triangle ; t++)
+		{
+			const int* corners = &chunk->corners[t*9];
+
+			// Positions:
+			uint position_indices[3];
+			bool valid = true;
+			for(uint c=0 ; c < 3 ; c++)
+				if(!decodeIndex(corners[c*3+0], chunk->positions_offset, nb_positions, &position_indices[c]))
+					valid = false;
+
+			if(!valid)
+				continue;
+
+			vec3 v[3];
+			for(uint c=0 ; c < 3 ; c++)
+			{
+				const float* src = &positions[position_indices[c]*3];
+				v[c] = vec3(src[0], src[1], src[2]);
+			}
+
+			// Face normal, used for the corners without normal:
+			vec3 face_normal = glm::cross(v[1] - v[0], v[2] - v[0]);
+			float len = glm::length(face_normal);
+			face_normal = (len > 0.0f ? face_normal / len : vec3(0.0f, 0.0f, 1.0f));
+
+			for(uint c=0 ; c < 3 ; c++, num_vertex++)
+			{
+				out_vertices[num_vertex*3 + 0] = v[c].x;
+				out_vertices[num_vertex*3 + 1] = v[c].y;
+				out_vertices[num_vertex*3 + 2] = v[c].z;
+
+				uint index = 0;
+				if(decodeIndex(corners[c*3+2], chunk->normals_offset, nb_normals, &index))
+				{
+					out_normals[num_vertex*3 + 0] = normals[index*3 + 0];
+					out_normals[num_vertex*3 + 1] = normals[index*3 + 1];
+					out_normals[num_vertex*3 + 2] = normals[index*3 + 2];
+				}
+				else
+				{
+					out_normals[num_vertex*3 + 0] = face_normal.x;
+					out_normals[num_vertex*3 + 1] = face_normal.y;
+					out_normals[num_vertex*3 + 2] = face_normal.z;
+				}
+
+				if(out_texcoords != NULL)
+				{
+					if(decodeIndex(corners[c*3+1], chunk->texcoords_offset, nb_texcoords, &index))
+					{
+						out_texcoords[num_vertex*2 + 0] = texcoords[index*2 + 0];
+						out_texcoords[num_vertex*2 + 1] = texcoords[index*2 + 1];
+					}
+					else
+					{
+						out_texcoords[num_vertex*2 + 0] = 0.0f;
+						out_texcoords[num_vertex*2 + 1] = 0.0f;
+					}
+				}
+			}
+		}
+	}
+
+	assert(num_vertex == nb_created_vertices);
+
+	group->geo = new Geometry();
+	group->geo->setVertices(nb_created_vertices, out_vertices, out_normals, out_texcoords);
+}
+
+// ---------------------------------------------------------------------
+// Jobs:
+class ParseChunkJob : public Job
+{
+private:
+	OBJChunk* chunk;
+
+public:
+	ParseChunkJob(OBJChunk* chunk) : chunk(chunk) {}
+
+	virtual void run()
+	{
+		parseChunk(chunk);
+	}
+};
+
+class BuildGroupJob : public Job
+{
+private:
+	OBJGroup* group;
+	const vector<OBJChunk*>* chunks;
+	const vector<float>* positions;
+	const vector<float>* normals;
+	const vector<float>* texcoords;
+
+public:
+	BuildGroupJob(OBJGroup* group, const vector<OBJChunk*>* chunks,
+				  const vector<float>* positions, const vector<float>* normals, const vector<float>* texcoords)
+	: group(group), chunks(chunks), positions(positions), normals(normals), texcoords(texcoords)
+	{
+	}
+
+	virtual void run()
+	{
+		buildGroupGeometry(group, *chunks, *positions, *normals, *texcoords);
+	}
+};
+
+// ---------------------------------------------------------------------
 OBJLoader::OBJLoader()
 {
 }
@@ -20,76 +393,399 @@ OBJLoader::~OBJLoader()
 // Load a scene from a .obj file:
 void OBJLoader::load(Scene* scene, const char* filename, ElementContainer::Type container_type)
 {
-	logError("not implemented !");
-/*	scene->free();
+	logInfo("loading scene \"", filename, "\"");
+
+	double t0 = Clock::getSeconds();
+
+	scene->free();
 	scene->setName(filename);
 
-	// Open the file
-	ifstream f(filename);
-	if(!f.is_open())
+	base_dir = getBaseDirectory(filename);
+	mtl_materials.clear();
+
+	// Map the file
+	MappedFile file;
+	if(!file.open(filename))
 	{
 		logFailed("unable to load the requested file \"", filename, "\"");
 		return;
 	}
 
-	// Create an element container, associate it with the scene
-	// and start filling it:
+	const char* data = file.getData();
+	size_t size = file.getSize();
+
+	// ------ Split the file on line boundaries and parse the chunks in parallel ------
+	JobPool& pool = getJobPool();
+
+	size_t nb_chunks = size / OBJ_MIN_CHUNK_SIZE + 1;
+	size_t max_nb_chunks = pool.getNbThreads() * OBJ_CHUNKS_PER_THREAD;
+	if(nb_chunks > max_nb_chunks)
+		nb_chunks = max_nb_chunks;
+
+	vector<OBJChunk*> chunks;
+	list<Job*> jobs;
+
+	const char* chunk_begin = data;
+	for(size_t i=0 ; i < nb_chunks && chunk_begin < data + size ; i++)
+	{
+		const char* chunk_end = data + size;
+
+		if(i != nb_chunks-1)
+		{
+			chunk_end = data + (size * (i+1)) / nb_chunks;
+			if(chunk_end < chunk_begin)
+				chunk_end = chunk_begin;
+
+			// Move the end of the chunk just after the end of the line:
+			const char* eol = (const char*)memchr(chunk_end, '\n', (data + size) - chunk_end);
+			chunk_end = (eol == NULL ? data + size : eol + 1);
+		}
+
+		OBJChunk* chunk = new OBJChunk();
+		chunk->begin = chunk_begin;
+		chunk->end = chunk_end;
+		chunks.push_back(chunk);
+
+		Job* job = new ParseChunkJob(chunk);
+		jobs.push_back(job);
+		pool.push(job);
+
+		chunk_begin = chunk_end;
+	}
+
+	pool.wait();
+
+	for(list<Job*>::iterator it = jobs.begin() ; it != jobs.end() ; it++)
+		delete (*it);
+	jobs.clear();
+
+	// ------ Merge the chunks ------
+	// - offsets of the chunks and material groups:
+	uint nb_positions = 0, nb_normals = 0, nb_texcoords = 0, nb_ignored_lines = 0;
+
+	vector<OBJGroup*> groups;
+	map<string, OBJGroup*> groups_by_name;
+	string current_material = "";
+
+	for(uint i=0 ; i < chunks.size() ; i++)
+	{
+		OBJChunk* chunk = chunks[i];
+
+		chunk->positions_offset = nb_positions;
+		chunk->normals_offset   = nb_normals;
+		chunk->texcoords_offset = nb_texcoords;
+
+		nb_positions += chunk->positions.size() / 3;
+		nb_normals   += chunk->normals.size() / 3;
+		nb_texcoords += chunk->texcoords.size() / 2;
+		nb_ignored_lines += chunk->nb_ignored_lines;
+
+		// Split the triangles of the chunk according to the "usemtl":
+		uint first_triangle = 0;
+		for(uint j=0 ; j <= chunk->material_switches.size() ; j++)
+		{
+			uint end_triangle = (j < chunk->material_switches.size() ?
+									chunk->material_switches[j].first_triangle :
+									chunk->getNbTriangles());
+
+			if(end_triangle > first_triangle)
+			{
+				OBJGroup*& group = groups_by_name[current_material];
+				if(group == NULL)
+				{
+					group = new OBJGroup();
+					group->material_name = current_material;
+					group->geo = NULL;
+					group->nb_invalid_triangles = 0;
+					groups.push_back(group);
+				}
+
+				OBJRange range;
+				range.chunk = i;
+				range.first_triangle = first_triangle;
+				range.end_triangle = end_triangle;
+				group->ranges.push_back(range);
+			}
+
+			if(j < chunk->material_switches.size())
+			{
+				current_material = chunk->material_switches[j].name;
+				first_triangle = end_triangle;
+			}
+		}
+	}
+
+	if(nb_ignored_lines != 0)
+		logWarn(nb_ignored_lines, " lines not handled in \"", filename, "\"");
+
+	// - gather the vertex data of all the chunks:
+	vector<float> positions, normals, texcoords;
+	positions.reserve(nb_positions*3);
+	normals.reserve(nb_normals*3);
+	texcoords.reserve(nb_texcoords*2);
+
+	for(uint i=0 ; i < chunks.size() ; i++)
+	{
+		OBJChunk* chunk = chunks[i];
+		positions.insert(positions.end(), chunk->positions.begin(), chunk->positions.end());
+		normals.insert(normals.end(),     chunk->normals.begin(),   chunk->normals.end());
+		texcoords.insert(texcoords.end(), chunk->texcoords.begin(), chunk->texcoords.end());
+
+		// Free the memory we do not need anymore:
+		vector<float>().swap(chunk->positions);
+		vector<float>().swap(chunk->normals);
+		vector<float>().swap(chunk->texcoords);
+	}
+
+	// ------ Build the geometries of the groups in parallel ------
+	for(uint i=0 ; i < groups.size() ; i++)
+	{
+		Job* job = new BuildGroupJob(groups[i], &chunks, &positions, &normals, &texcoords);
+		jobs.push_back(job);
+		pool.push(job);
+	}
+
+	// Meanwhile, read the material libraries:
+	for(uint i=0 ; i < chunks.size() ; i++)
+		for(uint j=0 ; j < chunks[i]->mtllibs.size() ; j++)
+			loadMTL(base_dir + "/" + chunks[i]->mtllibs[j]);
+
+	pool.wait();
+
+	for(list<Job*>::iterator it = jobs.begin() ; it != jobs.end() ; it++)
+		delete (*it);
+	jobs.clear();
+
+	// ------ Create the elements of the scene ------
 	ElementContainer* elements = ElementContainer::create(container_type);
 	elements->beginFilling();
 	scene->setElements(elements);
 
-	// For each line in the file:
-	uint num_line=0;
-	while(!f.eof())
+	uint nb_triangles = 0;
+	for(uint i=0 ; i < groups.size() ; i++)
 	{
-		num_line++;
+		OBJGroup* group = groups[i];
 
-		// Get a line and remove '\r' and/or '\n':
-		string line;
-		getline(f, line);
-		line = line.substr(0, line.find_first_of("\n\r"));
+		if(group->nb_invalid_triangles != 0)
+			logWarn(group->nb_invalid_triangles, " triangles with invalid indices ignored for material \"",
+					group->material_name, "\"");
 
-		if(line.empty())
+		if(group->geo == NULL)
 			continue;
 
-		// Get the starting position (position of the first non-whitespace character)
-		uint start_pos = line.find_first_not_of(" \t");
-		if(start_pos == string::npos)
-			continue;	// case of a blank line
+		nb_triangles += group->geo->getNbVertices() / 3;
 
-		// Case of a commentary:
-		if(line[start_pos] == '#')
-			continue;
+		MeshObject* obj = new MeshObject();
+		obj->setName(group->material_name.empty() ? string("default") : group->material_name);
+		obj->setGeometry(group->geo);
+		obj->setMaterial(createMaterial(group->material_name));
+
+		elements->addObject(obj);
+	}
+
+	// ------ Default camera and light, looking at the mesh from the front ------
+	vec3 bbox_min(0.0f), bbox_max(0.0f);
+	for(uint i=0 ; i < nb_positions ; i++)
+	{
+		vec3 p(positions[i*3+0], positions[i*3+1], positions[i*3+2]);
+		bbox_min = (i == 0 ? p : glm::min(bbox_min, p));
+		bbox_max = (i == 0 ? p : glm::max(bbox_max, p));
+	}
 
-		// Get the first word of the line, which represents the type of command:
-		string id_command = line.substr(start_pos, line.find_first_of(' '));
+	vec3 center = 0.5f * (bbox_min + bbox_max);
+	float radius = 0.5f * glm::length(bbox_max - bbox_min);
+	if(radius <= 0.0f)
+		radius = 1.0f;
 
-		// Object:
-		if(id_command == "o")
+	vec3 eye = center + vec3(0.0f, 0.0f, 2.5f*radius);
+
+	Camera* cam = new Camera();
+	cam->setPosition(eye);
+	cam->setProjection(45.0f, 640.0f / 480.0f, 0.01f*radius, 10.0f*radius);
+	scene->setCamera(cam);
+
+	Light* light = new Light();
+	light->setName("default_light");
+	light->setPosition(eye);
+	elements->addLight(light);
+
+	elements->endFilling();
+
+	// Cleanup:
+	for(uint i=0 ; i < groups.size() ; i++)
+		delete groups[i];
+
+	for(uint i=0 ; i < chunks.size() ; i++)
+		delete chunks[i];
+
+	logSuccess("scene \"", filename, "\": ", nb_triangles, " triangles in ", groups.size(), " groups, ",
+			   chunks.size(), " chunks, ", Clock::getSeconds() - t0, "s");
+}
+
+// ---------------------------------------------------------------------
+// Read the materials of a .mtl file and add them to mtl_materials
+void OBJLoader::loadMTL(const string& filename)
+{
+	ifstream f(filename.c_str());
+	if(!f.is_open())
+	{
+		logWarn("unable to load the material library \"", filename, "\"");
+		return;
+	}
+
+	MTLMaterial* current = NULL;
+	string line;
+
+	while(getline(f, line))
+	{
+		const char* p = line.c_str();
+		const char* line_end = p + line.size();
+
+		p = skipBlanks(p, line_end);
+		if(p == line_end || *p == '#')
+			continue;
+
+		if(startsWithWord(p, line_end, "newmtl", 6))
 		{
-			// We do not do anything interesting of this line, as the name
-			// of the scene is already given using the file name...
+			current = &mtl_materials[readName(p + 6, line_end)];
+			*current = MTLMaterial();
 		}
-		// Vertex:
-		else if(id_command == "v")
+		else if(current == NULL)
+			continue;
+		else if(startsWithWord(p, line_end, "Kd", 2))
 		{
+			p += 2;
+			parseFloat(&p, line_end, &current->diffuse.r);
+			parseFloat(&p, line_end, &current->diffuse.g);
+			parseFloat(&p, line_end, &current->diffuse.b);
 		}
-		// Material:
-		else if(id_command == "usemtl")
+		else if(startsWithWord(p, line_end, "Ks", 2))
 		{
+			p += 2;
+			parseFloat(&p, line_end, &current->specular.r);
+			parseFloat(&p, line_end, &current->specular.g);
+			parseFloat(&p, line_end, &current->specular.b);
 		}
-		// Face:
-		else if(id_command == "f")
+		else if(startsWithWord(p, line_end, "Ke", 2))
 		{
+			p += 2;
+			parseFloat(&p, line_end, &current->emissive.r);
+			parseFloat(&p, line_end, &current->emissive.g);
+			parseFloat(&p, line_end, &current->emissive.b);
 		}
-		// Texture coordinate:
-		else if(id_command == "vt")
+		else if(startsWithWord(p, line_end, "Ns", 2))
 		{
+			p += 2;
+			parseFloat(&p, line_end, &current->shininess);
+		}
+		else if(startsWithWord(p, line_end, "d", 1))
+		{
+			p += 1;
+			parseFloat(&p, line_end, &current->opacity);
+		}
+		else if(startsWithWord(p, line_end, "Tr", 2))
+		{
+			p += 2;
+			float transparency = 0.0f;
+			if(parseFloat(&p, line_end, &transparency))
+				current->opacity = 1.0f - transparency;
+		}
+		else if(startsWithWord(p, line_end, "map_Kd", 6))
+		{
+			current->diffuse_map = readName(p + 6, line_end);
 		}
-		else
-			logWarn("command \"", id_command, "\" not handled at line ", num_line);
 	}
 
-	elements->endFilling();
-*/
+	logSuccess("material library \"", filename, "\"");
+}
+
+// ---------------------------------------------------------------------
+// Escape a string for putting it in an XML attribute
+static string escapeXML(const string& s)
+{
+	string result;
+	for(uint i=0 ; i < s.size() ; i++)
+	{
+		switch(s[i])
+		{
+		case '&':  result += "&amp;";  break;
+		case '<':  result += "&lt;";   break;
+		case '>':  result += "&gt;";   break;
+		case '"':  result += "&quot;"; break;
+		default:   result += s[i];     break;
+		}
+	}
+	return result;
+}
+
+// Create the material for a given "usemtl" name
+Material* OBJLoader::createMaterial(const string& name) const
+{
+	Material* material = new Material();
+
+	// If there is a material file with the same name, it overrides the .mtl description:
+	string xml_filename = base_dir + "/materials/" + name + ".material.xml";
+	if(!name.empty() && ifstream(xml_filename.c_str()).is_open())
+	{
+		if(material->loadFromXML(xml_filename))
+			return material;
+
+		delete material;
+		material = new Material();
+	}
+
+	// Get the .mtl description, or the default one:
+	MTLMaterial mtl;
+	MTLMaterialMap::const_iterator it = mtl_materials.find(name);
+	if(it != mtl_materials.end())
+		mtl = it->second;
+	else if(!name.empty())
+		logWarn("material \"", name, "\" not found in the material libraries, using the default one");
+
+	// Textures are looked for in media/textures/, like for the other materials, and only TGA
+	// is supported:
+	string texture_name = mtl.diffuse_map.substr(mtl.diffuse_map.find_last_of("/\\") + 1);
+	string extension = (texture_name.size() >= 4 ? texture_name.substr(texture_name.size() - 4) : "");
+	for(uint i=0 ; i < extension.size() ; i++)
+		extension[i] = tolower(extension[i]);
+
+	bool texture_mapping = (extension == ".tga");
+	if(!mtl.diffuse_map.empty() && !texture_mapping)
+		logWarn("texture \"", mtl.diffuse_map, "\" of material \"", name, "\" is not a TGA file: ignored");
+
+	// Generate the material's XML description:
+	stringstream ss;
+	ss	<< "<material>"
+		<< "<flag value=\"" << (mtl.opacity < 1.0f ? MATERIAL_TRANSPARENT_STR : MATERIAL_OPAQUE_STR) << "\"/>"
+		<< "<profile name=\"raytrace\">"
+		<< "<diffuse r=\"" << mtl.diffuse.r << "\" g=\"" << mtl.diffuse.g << "\" b=\"" << mtl.diffuse.b << "\"/>"
+		<< "<emissive r=\"" << mtl.emissive.r << "\" g=\"" << mtl.emissive.g << "\" b=\"" << mtl.emissive.b << "\"/>"
+		<< "<reflection value=\"0.0\"/>"
+		<< "</profile>"
+		<< "<profile name=\"general\">"
+		<< "<program vertex=\"general.vert\" fragment=\"general.frag\"/>";
+
+	if(texture_mapping)
+		ss	<< "<symbol name=\"TEXTURE_MAPPING\"/>"
+			<< "<texture name=\"" << escapeXML(texture_name) << "\" unit=\"0\"/>"
+			<< "<sampler2D name=\"tex_diffuse\" value=\"0\"/>";
+
+	ss	<< "<vec4 name=\"material_diffuse\" r=\"" << mtl.diffuse.r << "\" g=\"" << mtl.diffuse.g
+		<< "\" b=\"" << mtl.diffuse.b << "\" a=\"" << mtl.opacity << "\"/>"
+		<< "<vec4 name=\"material_specular\" r=\"" << mtl.specular.r << "\" g=\"" << mtl.specular.g
+		<< "\" b=\"" << mtl.specular.b << "\" a=\"" << mtl.shininess << "\"/>"
+		<< "</profile>"
+		<< "<profile name=\"depth_peeling\">"
+		<< "<program vertex=\"depth_peeling.vert\" fragment=\"depth_peeling.frag\"/>"
+		<< "</profile>"
+		<< "<profile name=\"general_depth_peeling\">"
+		<< "<copy_contents name=\"general\"/>"
+		<< "<symbol name=\"DEPTH_PEELING\"/>"
+		<< "</profile>"
+		<< "</material>";
+
+	string material_name = (name.empty() ? string("default") : name);
+	material->loadFromXMLText(base_dir + "/" + material_name + ".mtl", ss.str());
+
+	return material;
 }
@@ -1,20 +1,62 @@
 // OBJLoader.h
+// Loader for Wavefront .obj files and their .mtl material libraries.
+// - the file is memory-mapped, split on line boundaries and the chunks are parsed
+//   in parallel by the JobPool (only "v", "vn", "vt", "f", "usemtl" and "mtllib" are read)
+// - the faces are grouped by material ("usemtl"): each group gives one MeshObject
+// - the material of a group is read from "<obj directory>/materials/<name>.material.xml" if it
+//   exists, otherwise it is generated from the .mtl description.
+// As .obj files have no camera nor lights, a default camera and a default light are created,
+// looking at the mesh.
 
 #ifndef OBJ_LOADER_H
 #define OBJ_LOADER_H
 
 #include "ElementContainer.h"
+#include "../Common.h"
+#include <map>
+#include <string>
 
 class Scene;
+class Material;
 
 class OBJLoader
 {
+private:
+	// Material read from a .mtl file
+	struct MTLMaterial
+	{
+		vec3 diffuse;		// Kd
+		vec3 specular;		// Ks
+		vec3 emissive;		// Ke
+		float shininess;	// Ns
+		float opacity;		// d (or 1 - Tr)
+		std::string diffuse_map;	// map_Kd
+
+		MTLMaterial()
+		: diffuse(0.8f), specular(0.0f), emissive(0.0f), shininess(10.0f), opacity(1.0f), diffuse_map()
+		{
+		}
+	};
+
+	typedef std::map<std::string, MTLMaterial> MTLMaterialMap;
+
 public:
 	OBJLoader();
 	virtual ~OBJLoader();
 
 	// Load a scene from a .obj file:
 	void load(Scene* scene, const char* filename, ElementContainer::Type container_type=ElementContainer::ARRAY);
+
+private:
+	// Read the materials of a .mtl file and add them to mtl_materials
+	void loadMTL(const std::string& filename);
+
+	// Create the material for a given "usemtl" name
+	Material* createMaterial(const std::string& name) const;
+
+	// Internal variables used only when we load
+	std::string base_dir;	// directory of the .obj file
+	MTLMaterialMap mtl_materials;
 };
 
 #endif // OBJ_LOADER_H
@@ -0,0 +1,200 @@
+// OBJParseHelpers.h
+// Helpers of OBJLoader for parsing the lines of .obj and .mtl files, and for encoding the face
+// indices while the chunks of a file are parsed in parallel.
+
+#ifndef OBJ_PARSE_HELPERS_H
+#define OBJ_PARSE_HELPERS_H
+
+#include "../Common.h"
+#include <string>
+#include <cstring>
+#include <cmath>
+#include <climits>
+
+// ---------------------------------------------------------------------
+// Encoding of the face indices while parsing the chunks:
+// - index >= 0: absolute index (0-based)
+// - OBJ_INDEX_NONE: no index (e.g. no texture coordinates given)
+// - otherwise: negative (relative) .obj index, converted to an index relative to the
+//   first element of the chunk: (index - OBJ_INDEX_CHUNK_BASE). It is converted to an
+//   absolute index once the number of elements in the previous chunks is known.
+#define OBJ_INDEX_NONE INT_MIN
+#define OBJ_INDEX_CHUNK_BASE (INT_MIN / 2)
+
+// ---------------------------------------------------------------------
+// Fast parsing helpers. All of them stop at "end" and never read past it.
+static inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* skipBlanks(const char* p, const char* end)
+{
+	while(p < end && isBlank(*p))
+		p++;
+	return p;
+}
+
+static inline bool startsWithWord(const char* p, const char* end, const char* word, uint len)
+{
+	return uint(end - p) > len && memcmp(p, word, len) == 0 && isBlank(p[len]);
+}
+
+// Parse a floating point number, returns false if there is none
+static inline bool parseFloat(const char** pp, const char* end, float* result)
+{
+	static const double powers_of_10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char* p = skipBlanks(*pp, end);
+
+	bool negative = false;
+	if(p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	// Mantissa: we keep up to 19 significant digits
+	unsigned long long mantissa = 0;
+	int nb_digits = 0;
+	int exponent = 0;
+	bool has_digits = false;
+
+	for(; p < end && *p >= '0' && *p <= '9' ; p++)
+	{
+		has_digits = true;
+		if(nb_digits < 19)
+		{
+			mantissa = mantissa*10 + (*p - '0');
+			if(mantissa != 0)
+				nb_digits++;
+		}
+		else
+			exponent++;
+	}
+
+	if(p < end && *p == '.')
+	{
+		p++;
+		for(; p < end && *p >= '0' && *p <= '9' ; p++)
+		{
+			has_digits = true;
+			if(nb_digits < 19)
+			{
+				mantissa = mantissa*10 + (*p - '0');
+				if(mantissa != 0)
+					nb_digits++;
+				exponent--;
+			}
+		}
+	}
+
+	if(!has_digits)
+		return false;
+
+	// Exponent:
+	if(p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* q = p+1;
+		bool negative_exponent = false;
+		if(q < end && (*q == '-' || *q == '+'))
+		{
+			negative_exponent = (*q == '-');
+			q++;
+		}
+
+		if(q < end && *q >= '0' && *q <= '9')
+		{
+			int e = 0;
+			for(; q < end && *q >= '0' && *q <= '9' ; q++)
+				if(e < 10000)
+					e = e*10 + (*q - '0');
+
+			exponent += (negative_exponent ? -e : e);
+			p = q;
+		}
+	}
+
+	double value = double(mantissa);
+	if(exponent != 0 && mantissa != 0)
+	{
+		if(exponent > 0 && exponent <= 22)
+			value *= powers_of_10[exponent];
+		else if(exponent < 0 && exponent >= -22)
+			value /= powers_of_10[-exponent];
+		else
+			value *= pow(10.0, double(exponent));
+	}
+
+	*result = float(negative ? -value : value);
+	*pp = p;
+	return true;
+}
+
+// Parse an integer, returns false if there is none
+static inline bool parseInt(const char** pp, const char* end, int* result)
+{
+	const char* p = *pp;
+
+	bool negative = false;
+	if(p < end && (*p == '-' || *p == '+'))
+	{
+		negative = (*p == '-');
+		p++;
+	}
+
+	if(p >= end || *p < '0' || *p > '9')
+		return false;
+
+	int value = 0;
+	for(; p < end && *p >= '0' && *p <= '9' ; p++)
+		value = value*10 + (*p - '0');
+
+	*result = (negative ? -value : value);
+	*pp = p;
+	return true;
+}
+
+// Convert a .obj index (1-based, or negative for relative indices) to our encoding
+static inline int encodeIndex(int obj_index, uint nb_elements_in_chunk)
+{
+	if(obj_index > 0)
+		return obj_index - 1;
+	else if(obj_index < 0)
+		return OBJ_INDEX_CHUNK_BASE + int(nb_elements_in_chunk) + obj_index;
+	else
+		return OBJ_INDEX_NONE;	// 0 is not a valid .obj index
+}
+
+// Convert an encoded index to an absolute index, returns false if there is no
+// (valid) index
+static inline bool decodeIndex(int index, uint chunk_offset, uint nb_elements, uint* result)
+{
+	if(index == OBJ_INDEX_NONE)
+		return false;
+
+	long long absolute = index;
+	if(index < 0)
+		absolute = (long long)(index - OBJ_INDEX_CHUNK_BASE) + (long long)chunk_offset;
+
+	if(absolute < 0 || absolute >= (long long)nb_elements)
+		return false;
+
+	*result = uint(absolute);
+	return true;
+}
+
+// Read the rest of the line as a name, without the surrounding blanks
+static inline std::string readName(const char* p, const char* line_end)
+{
+	p = skipBlanks(p, line_end);
+	const char* q = line_end;
+	while(q > p && isBlank(q[-1]))
+		q--;
+	return std::string(p, q);
+}
+
+#endif // OBJ_PARSE_HELPERS_H
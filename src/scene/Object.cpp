@@ -2,6 +2,7 @@
 
 #include "Object.h"
 #include "Material.h"
+#include "Bounds.h"
 #include <cstdlib>
 
 Object::Object()
@@ -46,3 +47,14 @@ const Material* Object::getMaterial() const
 {
 	return material;
 }
+
+// Bounds in world space
+void Object::computeWorldBounds(AABB* aabb, BoundingSphere* sphere) const
+{
+	AABB local_aabb;
+	BoundingSphere local_sphere;
+	computeLocalBounds(&local_aabb, &local_sphere);
+
+	*aabb = local_aabb.transform(getOrientation(), getPosition());
+	*sphere = local_sphere.transform(getOrientation(), getPosition());
+}
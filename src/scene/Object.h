@@ -6,6 +6,8 @@
 #include "Element.h"
 
 class Material;
+struct AABB;
+struct BoundingSphere;
 
 class Object : public Element
 {
@@ -30,6 +32,12 @@ public:
 	void setMaterial(Material* material);
 	Material* getMaterial();
 	const Material* getMaterial() const;
+
+	// Bounds in the object's space:
+	virtual void computeLocalBounds(AABB* aabb, BoundingSphere* sphere) const = 0;
+
+	// Bounds in world space, for the current transformation:
+	void computeWorldBounds(AABB* aabb, BoundingSphere* sphere) const;
 };
 
 #endif // OBJECT_H
@@ -3,11 +3,12 @@
 #include "Scene.h"
 #include "Camera.h"
 #include "ElementContainer.h"
+#include "TransformHierarchy.h"
 #include <cstdlib>
 using namespace std;
 
 Scene::Scene()
-: camera(NULL), elements(NULL)
+: camera(NULL), elements(NULL), transforms(NULL)
 {
 }
 
@@ -24,6 +25,9 @@ void Scene::free()
 
 	delete elements;
 	this->elements = NULL;
+
+	delete transforms;
+	this->transforms = NULL;
 }
 
 // Camera
@@ -50,6 +54,32 @@ ElementContainer* Scene::getElements()
 	return elements;
 }
 
+const ElementContainer* Scene::getElements() const
+{
+	return elements;
+}
+
+// Hierarchy of the transformations
+void Scene::setTransforms(TransformHierarchy* transforms)
+{
+	delete this->transforms;
+	this->transforms = transforms;
+}
+
+TransformHierarchy* Scene::getTransforms() const
+{
+	return transforms;
+}
+
+void Scene::updateTransforms()
+{
+	if(transforms != NULL)
+		transforms->update();
+
+	if(elements != NULL)
+		elements->updateBounds();
+}
+
 // Scene name :
 void Scene::setName(const string& name)
 {
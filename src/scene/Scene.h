@@ -7,12 +7,14 @@
 
 class Camera;
 class ElementContainer;
+class TransformHierarchy;
 
 class Scene
 {
 private:
 	Camera* camera;
 	ElementContainer* elements;	// Elements : objects + lights
+	TransformHierarchy* transforms;	// Hierarchy of the elements' transformations (or NULL)
 	std::string name;
 
 public:
@@ -28,6 +30,13 @@ public:
 	ElementContainer* getElements();
 	const ElementContainer* getElements() const;
 
+	void setTransforms(TransformHierarchy* transforms);
+	TransformHierarchy* getTransforms() const;
+
+	// Update the world transformations of the elements and the bounds of the objects
+	// (to be called once per frame, after the animators)
+	void updateTransforms();
+
 	void setName(const std::string& name);
 	const std::string& getName() const;
 };
@@ -1,6 +1,7 @@
 // Sphere.cpp
 
 #include "Sphere.h"
+#include "Bounds.h"
 
 Sphere::Sphere()
 : Object()
@@ -22,6 +23,13 @@ float Sphere::getRadius() const
 	return radius;
 }
 
+// Bounds :
+void Sphere::computeLocalBounds(AABB* aabb, BoundingSphere* sphere) const
+{
+	*aabb = AABB(vec3(-radius), vec3(radius));
+	*sphere = BoundingSphere(vec3(0.0f), radius);
+}
+
 // RTTI :
 Object::Type Sphere::getType() const
 {
@@ -15,6 +15,9 @@ public:
 	void setRadius(float radius);
 	float getRadius() const;
 
+	// Bounds :
+	virtual void computeLocalBounds(AABB* aabb, BoundingSphere* sphere) const;
+
 	// RTTI :
 	virtual Object::Type getType() const;
 };
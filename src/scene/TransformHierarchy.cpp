@@ -0,0 +1,215 @@
+// TransformHierarchy.cpp
+
+#include "TransformHierarchy.h"
+#include "Element.h"
+#include <cassert>
+#include <cstring>
+using namespace std;
+
+TransformHierarchy::TransformHierarchy()
+: nb_nodes(0),
+  parents(NULL),
+  subtree_ends(NULL),
+  local_positions(NULL),
+  local_orientations(NULL),
+  world_positions(NULL),
+  world_orientations(NULL),
+  dirty(NULL),
+  stamps(NULL),
+  has_dirty_nodes(false)
+{
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+	clear();
+}
+
+// ---------------------------------------------------------------------
+void TransformHierarchy::beginBuilding()
+{
+	clear();
+}
+
+int TransformHierarchy::addNode(int parent, const vec3& position, const mat3& orientation)
+{
+#ifndef NDEBUG
+	// Check the depth-first order: the parent must be the last node or one of its ancestors
+	if(parent >= 0)
+	{
+		int ancestor = int(building_nodes.size()) - 1;
+		while(ancestor >= 0 && ancestor != parent)
+			ancestor = building_nodes[ancestor].parent;
+		assert(ancestor == parent);
+	}
+#endif
+
+	BuildingNode n;
+	n.parent = parent;
+	n.position = position;
+	n.orientation = orientation;
+	n.element = NULL;
+	building_nodes.push_back(n);
+
+	return int(building_nodes.size()) - 1;
+}
+
+void TransformHierarchy::setElement(int node, Element* element)
+{
+	assert(node >= 0 && node < int(building_nodes.size()));
+	assert(building_nodes[node].element == NULL);
+
+	building_nodes[node].element = element;
+}
+
+void TransformHierarchy::computeWorldTransform(int node, vec3* position, mat3* orientation) const
+{
+	assert(node >= 0 && node < int(building_nodes.size()));
+
+	*position = building_nodes[node].position;
+	*orientation = building_nodes[node].orientation;
+
+	for(int parent = building_nodes[node].parent ; parent >= 0 ; parent = building_nodes[parent].parent)
+	{
+		*position = building_nodes[parent].position + building_nodes[parent].orientation * (*position);
+		*orientation = building_nodes[parent].orientation * (*orientation);
+	}
+}
+
+void TransformHierarchy::endBuilding()
+{
+	nb_nodes = building_nodes.size();
+
+	parents            = new int[nb_nodes];
+	subtree_ends       = new uint[nb_nodes];
+	local_positions    = new vec3[nb_nodes];
+	local_orientations = new mat3[nb_nodes];
+	world_positions    = new vec3[nb_nodes];
+	world_orientations = new mat3[nb_nodes];
+	dirty              = new uchar[nb_nodes];
+	stamps             = new uint[nb_nodes];
+
+	for(uint i=0 ; i < nb_nodes ; i++)
+	{
+		parents[i] = building_nodes[i].parent;
+		subtree_ends[i] = i+1;
+		local_positions[i] = building_nodes[i].position;
+		local_orientations[i] = building_nodes[i].orientation;
+		dirty[i] = 1;
+	}
+
+	// The subtrees are contiguous, so that a node's subtree ends where its last child's ends:
+	for(int i = int(nb_nodes)-1 ; i >= 0 ; i--)
+		if(parents[i] >= 0 && subtree_ends[parents[i]] < subtree_ends[i])
+			subtree_ends[parents[i]] = subtree_ends[i];
+
+	has_dirty_nodes = true;
+	update();
+
+	// Attach the elements:
+	for(uint i=0 ; i < nb_nodes ; i++)
+		if(building_nodes[i].element != NULL)
+			building_nodes[i].element->attachToTransformNode(this, i);
+
+	building_nodes.clear();
+}
+
+void TransformHierarchy::clear()
+{
+	delete [] parents;
+	delete [] subtree_ends;
+	delete [] local_positions;
+	delete [] local_orientations;
+	delete [] world_positions;
+	delete [] world_orientations;
+	delete [] dirty;
+	delete [] stamps;
+
+	parents = NULL;
+	subtree_ends = NULL;
+	local_positions = NULL;
+	local_orientations = NULL;
+	world_positions = NULL;
+	world_orientations = NULL;
+	dirty = NULL;
+	stamps = NULL;
+
+	nb_nodes = 0;
+	has_dirty_nodes = false;
+	building_nodes.clear();
+}
+
+// ---------------------------------------------------------------------
+void TransformHierarchy::update()
+{
+	if(!has_dirty_nodes)
+		return;
+
+	uint i = 0;
+	while(i < nb_nodes)
+	{
+		if(!dirty[i])
+		{
+			i++;
+			continue;
+		}
+
+		// Update the whole subtree: the parents are always updated before their children.
+		uint end = subtree_ends[i];
+		uint stamp = Element::newTransformStamp();
+
+		for(uint j=i ; j < end ; j++)
+		{
+			int parent = parents[j];
+			if(parent < 0)
+			{
+				world_positions[j] = local_positions[j];
+				world_orientations[j] = local_orientations[j];
+			}
+			else
+			{
+				world_positions[j] = world_positions[parent] + world_orientations[parent] * local_positions[j];
+				world_orientations[j] = world_orientations[parent] * local_orientations[j];
+			}
+			dirty[j] = 0;
+			stamps[j] = stamp;
+		}
+
+		i = end;
+	}
+
+	has_dirty_nodes = false;
+}
+
+// ---------------------------------------------------------------------
+// NB: the world transformation of root nodes is updated immediately, so that
+// they behave like elements which are not in a hierarchy.
+void TransformHierarchy::setLocalPosition(uint node, const vec3& position)
+{
+	assert(node < nb_nodes);
+
+	local_positions[node] = position;
+	if(parents[node] < 0)
+	{
+		world_positions[node] = position;
+		stamps[node] = Element::newTransformStamp();
+	}
+
+	dirty[node] = 1;
+	has_dirty_nodes = true;
+}
+
+void TransformHierarchy::setLocalOrientation(uint node, const mat3& orientation)
+{
+	assert(node < nb_nodes);
+
+	local_orientations[node] = orientation;
+	if(parents[node] < 0)
+	{
+		world_orientations[node] = orientation;
+		stamps[node] = Element::newTransformStamp();
+	}
+
+	dirty[node] = 1;
+	has_dirty_nodes = true;
+}
@@ -0,0 +1,95 @@
+// TransformHierarchy.h
+// Hierarchy of the transformations of the scene nodes.
+// The nodes are stored in flat arrays, in depth-first order: the parent of a node is always
+// before it and the subtree of a node is contiguous. The world transformations are thus
+// updated in one linear pass by update(), which only recomputes the subtrees of the nodes
+// whose local transformation changed.
+// An Element attached to a node reads its world transformation from these arrays, and
+// writes its local transformation to them (see Element).
+
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include "../Common.h"
+#include <vector>
+
+class Element;
+
+class TransformHierarchy
+{
+private:
+	uint nb_nodes;
+
+	int* parents;			// index of the parent of each node, -1 for root nodes
+	uint* subtree_ends;		// index after the last node of the subtree of each node
+	vec3* local_positions;
+	mat3* local_orientations;
+	vec3* world_positions;
+	mat3* world_orientations;
+	uchar* dirty;			// the local transformation of the node changed since the last update()
+	uint* stamps;			// transform stamps of the nodes (see Element::getTransformStamp())
+	bool has_dirty_nodes;
+
+	// Temporary data used when building the hierarchy.
+	// Only used between beginBuilding() and endBuilding().
+	struct BuildingNode
+	{
+		int parent;
+		vec3 position;
+		mat3 orientation;
+		Element* element;
+	};
+	std::vector<BuildingNode> building_nodes;
+
+public:
+	TransformHierarchy();
+	virtual ~TransformHierarchy();
+
+	// Functions for building the hierarchy:
+	void beginBuilding();
+
+	// Add a node, given its transformation relative to its parent (-1 for a root node), and
+	// return its index. The nodes must be added in depth-first order: "parent" is the last
+	// added node or one of its ancestors.
+	int addNode(int parent, const vec3& position, const mat3& orientation);
+
+	// Attach an element to a node (at most one per node)
+	void setElement(int node, Element* element);
+
+	// World transformation of a node, while building the hierarchy (used e.g. for the camera,
+	// which is not attached to the hierarchy)
+	void computeWorldTransform(int node, vec3* position, mat3* orientation) const;
+
+	// Fill the arrays, compute the world transformations and attach the elements to their nodes
+	void endBuilding();
+
+	void clear();
+
+	// Update the world transformations of the nodes whose transformation changed, and of
+	// their children
+	void update();
+
+	uint getNbNodes() const {return nb_nodes;}
+
+	int getParent(uint node) const {return parents[node];}
+
+	// Local transformation, relative to the parent node:
+	void setLocalPosition(uint node, const vec3& position);
+	void setLocalOrientation(uint node, const mat3& orientation);
+
+	const vec3& getLocalPosition(uint node) const    {return local_positions[node];}
+	const mat3& getLocalOrientation(uint node) const {return local_orientations[node];}
+
+	// World transformation (valid after update()):
+	const vec3& getWorldPosition(uint node) const    {return world_positions[node];}
+	const mat3& getWorldOrientation(uint node) const {return world_orientations[node];}
+
+	// Changes each time the world transformation of the node changes
+	uint getTransformStamp(uint node) const {return stamps[node];}
+
+	// Get access to the internal arrays:
+	const vec3* getWorldPositions() const    {return world_positions;}
+	const mat3* getWorldOrientations() const {return world_orientations;}
+};
+
+#endif // TRANSFORM_HIERARCHY_H
@@ -8,6 +8,7 @@
 #include "../../utils/StdListManip.h"
 #include "../../utils/StrManip.h"
 #include "../../utils/TGALoader.h"
+#include "../../glutil/StateCache.h"
 using namespace std;
 
 GPUProfile::GPUProfile()
@@ -82,6 +83,7 @@ void GPUProfile::loadFromXML(const string& filename, const TiXmlElement *profile
 		texture_element->Attribute("unit", &unit);
 		t.unit = uint(unit);
 		t.id = 0;	// texture not loaded by default
+		t.image = NULL;	// nor decoded
 
 		textures.push_back(t);
 	}
@@ -166,6 +168,13 @@ void GPUProfile::unload()
 	if(textures_loaded)
 		unloadTextures();
 
+	// Free the images which have been decoded but never uploaded:
+	for(uint i=0 ; i < nb_textures ; i++)
+	{
+		delete textures[i].image;
+		textures[i].image = NULL;
+	}
+
 	delete [] textures;           nb_textures = 0;           textures = NULL;
 	delete [] uniforms_float;     nb_uniforms_float = 0;     uniforms_float = NULL;
 	delete [] uniforms_vec3;      nb_uniforms_vec3 = 0;      uniforms_vec3 = NULL;
@@ -193,33 +202,56 @@ void GPUProfile::assertTexunitsUnused(const uint* texunits, uint nb_texunits)
 // ---------------------------------------------------------------------
 // Load/unload to/from GPU
 // - textures:
+void GPUProfile::decodeTexture(uint index)
+{
+	assert(index < this->nb_textures);
+
+	Texture& texture = this->textures[index];
+	if(texture.image != NULL)
+		return;
+
+	string path = string("media/textures/") + texture.name;
+
+	TGALoader* tga = new TGALoader();
+	TGAErrorCode error = tga->loadFile(path.c_str());
+
+	if(error == TGA_OK)
+		texture.image = tga;
+	else
+	{
+		logError("unable to load the texture \"", path, "\": ", error);
+		delete tga;
+	}
+}
+
 void GPUProfile::loadTextures()
 {
 	assert(!this->textures_loaded);
 
-	TGALoader tga;
-
-	glActiveTexture(GL_TEXTURE0);
+	glutil::activeTexture(GL_TEXTURE0);
 	for(uint i=0 ; i < this->nb_textures ; i++)
 	{
 		Texture& texture = this->textures[i];
-		string path = string("media/textures/") + texture.name;
 
-		if(tga.loadFile(path.c_str()) == TGA_OK)
+		// Decode the texture, if it has not been done in parallel before:
+		decodeTexture(i);
+
+		TGALoader* tga = texture.image;
+		if(tga != NULL)
 		{
 			glGenTextures(1, &texture.id);
-			glBindTexture(GL_TEXTURE_2D, texture.id);
+			glutil::bindTexture(GL_TEXTURE_2D, texture.id);
 
 			GLuint internal_format = GL_RGBA;
 			GLuint format = GL_RGBA;
 
-			if(tga.getBpp() == 3)
+			if(tga->getBpp() == 3)
 			{
 				logWarn("image \"", texture.name, "\" doesn't have an alpha channel");
 				format = GL_RGB;
 				internal_format = GL_RGB;
 			}
-			else if(tga.getBpp() != 4)
+			else if(tga->getBpp() != 4)
 			{
 				assert(false);
 			}
@@ -228,11 +260,11 @@ void GPUProfile::loadTextures()
 			glTexImage2D(GL_TEXTURE_2D,
 						 0,	// level
 						 internal_format,	// internal format
-						 tga.getWidth(), tga.getHeight(),
+						 tga->getWidth(), tga->getHeight(),
 						 0,	// border
 						 format,
 						 GL_UNSIGNED_BYTE,
-						 tga.getData());
+						 tga->getData());
 
 			// Set the filter:
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -242,6 +274,10 @@ void GPUProfile::loadTextures()
 
 			// Generate the mipmaps:
 			glGenerateMipmap(GL_TEXTURE_2D);
+
+			// The image is on the GPU, free the CPU copy:
+			delete tga;
+			texture.image = NULL;
 		}
 	}
 
@@ -256,7 +292,7 @@ void GPUProfile::unloadTextures()
 	for(uint i=0 ; i < this->nb_textures ; i++)
 	{
 		Texture& texture = this->textures[i];
-		glDeleteTextures(1, &texture.id);
+		glutil::deleteTextures(1, &texture.id);
 		texture.id = 0;
 	}
 
@@ -303,8 +339,8 @@ void GPUProfile::bind()
 	for(uint i = 0 ; i < nb_textures ; i++)
 	{
 		Texture& texture = textures[i];
-		glActiveTexture(GL_TEXTURE0 + texture.unit);
-		glBindTexture(GL_TEXTURE_2D, texture.id);
+		glutil::activeTexture(GL_TEXTURE0 + texture.unit);
+		glutil::bindTexture(GL_TEXTURE_2D, texture.id);
 	}
 
 	// Bind the uniforms:
@@ -8,11 +8,14 @@
 #include "../../glutil/glxw.h"
 #include "../GPUProgramManager.h"
 
+class TGALoader;
+
 class GPUProfile : public Profile
 {
 public:
 	// NB: Texture::unit ranges from 0 to 31 (OpenGL defines GL_TEXTURE0 through GL_TEXTURE31).
-	struct Texture			{std::string name; GLuint id; uint unit;};
+	// NB: Texture::image is the decoded image waiting to be uploaded, NULL otherwise.
+	struct Texture			{std::string name; GLuint id; uint unit; TGALoader* image;};
 	struct UniformFloat		{std::string name; float value;};
 	struct UniformVec3		{std::string name; vec3 value;};
 	struct UniformVec4		{std::string name; vec4 value;};
@@ -61,6 +64,10 @@ public:
 
 	// Load/unload to/from GPU.
 	// - textures:
+	// decodeTexture() only reads and decodes the file on the CPU, so that it can be called
+	// from a JobPool's worker, for different textures at the same time.
+	// loadTextures() decodes the textures which are not decoded yet and uploads them all.
+	void decodeTexture(uint index);
 	virtual void loadTextures();
 	virtual void unloadTextures();
 	inline bool areTexturesLoaded() const {return textures_loaded;}
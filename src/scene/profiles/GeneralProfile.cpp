@@ -4,6 +4,7 @@
 #include "../../Boundaries.h"
 #include "../../ShaderLocations.h"
 #include "../../utils/StdListManip.h"
+#include <cassert>
 using namespace std;
 
 GeneralProfile::GeneralProfile()
@@ -23,6 +24,8 @@ void GeneralProfile::onNewProgram(glutil::GPUProgram* program)
 		program->bindAttribLocation(GENERAL_PROFILE_ATTRIB_NORMAL, "vertex_normal");
 	if(this->hasTextureMapping())
 		program->bindAttribLocation(GENERAL_PROFILE_ATTRIB_TEXCOORDS, "vertex_texcoords");
+	if(isSymbolDefined("_INSTANCING_", program_id))
+		program->bindAttribLocation(GENERAL_PROFILE_ATTRIB_INSTANCE_MODEL_MATRIX, "instance_model_matrix");
 
 	// - set the frag data locations:
 	// -> if "_RENDER_TO_GBUFFER_" is defined (deferred shading):
@@ -56,6 +59,10 @@ void GeneralProfile::onNewProgram(glutil::GPUProgram* program)
 	bool ok = program->link();
 	assert(ok);
 
+	// - bind the uniform blocks (camera and lights):
+	program->bindUniformBlock(UNIFORM_BLOCK_BINDING_CAMERA, "CameraBlock");
+	program->bindUniformBlock(UNIFORM_BLOCK_BINDING_LIGHTS, "LightsBlock");
+
 	// - set the uniform names:
 
 	// We consider mixing all the possible combinations for uniform names.
@@ -65,35 +72,14 @@ void GeneralProfile::onNewProgram(glutil::GPUProgram* program)
 	// specified uniform variable will not be changed.")
 
 	list<string> uniform_names_list;
-	uniform_names_list.push_back("view_matrix");
 	uniform_names_list.push_back("model_matrix");
-	uniform_names_list.push_back("projection_matrix");
 	uniform_names_list.push_back("tex_diffuse");
 	uniform_names_list.push_back("material_diffuse");
 	uniform_names_list.push_back("material_specular");
 	uniform_names_list.push_back("tex_normal");
 	uniform_names_list.push_back("tex_debug");
 	uniform_names_list.push_back("tex_prev_depth_layer");
-
-	stringstream ss;
-	for(uint i=0 ; i < NB_MAX_LIGHTS ; i++)
-	{
-		ss.str("");
-		ss << "light_pos_" << i << flush;
-		uniform_names_list.push_back(ss.str());
-
-		ss.str("");
-		ss << "light_color_" << i << flush;
-		uniform_names_list.push_back(ss.str());
-
-		ss.str("");
-		ss << "shadow_map_" << i << flush;
-		uniform_names_list.push_back(ss.str());
-
-		ss.str("");
-		ss << "shadow_matrix_" << i << flush;
-		uniform_names_list.push_back(ss.str());
-	}
+	uniform_names_list.push_back("shadow_atlas");
 
 	const string* uniform_names = listToArray(uniform_names_list);
 	program->setUniformNames(uniform_names, uniform_names_list.size());
@@ -4,7 +4,10 @@
 #define GENERAL_PROFILE_H
 
 #include "GPUProfile.h"
+#include "../../Boundaries.h"
 
+// NB: the data of the lights is in the "LightsBlock" uniform block (see UniformBlocks), and
+// their shadow maps are all in the same atlas (uniform "shadow_atlas", see ShadowMap).
 class GeneralProfile : public GPUProfile
 {
 public:
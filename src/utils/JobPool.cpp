@@ -0,0 +1,128 @@
+// JobPool.cpp
+
+#include "JobPool.h"
+#include <cassert>
+
+#ifdef WIN32
+	#include <windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+JobPool& getJobPool()
+{
+	static JobPool pool;
+	return pool;
+}
+
+// ---------------------------------------------------------------------
+// - wrapping for C :
+void* _jobPoolThreadWrapper(void* p)
+{
+	((JobPool*)p)->workerLoop();
+	return NULL;
+}
+
+JobPool::JobPool(uint nb_threads)
+: threads(NULL),
+  nb_threads(nb_threads != 0 ? nb_threads : getNbCores()),
+  pending_jobs(),
+  nb_running_jobs(0),
+  quit(false)
+{
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&cond_job_pushed, NULL);
+	pthread_cond_init(&cond_jobs_done, NULL);
+
+	// Launch the workers:
+	threads = new pthread_t[this->nb_threads];
+	for(uint i=0 ; i < this->nb_threads ; i++)
+		pthread_create(&threads[i], NULL, &_jobPoolThreadWrapper, this);
+}
+
+JobPool::~JobPool()
+{
+	// Tell the workers to quit once the pending jobs are done, and wait for them:
+	pthread_mutex_lock(&mutex);
+	quit = true;
+	pthread_cond_broadcast(&cond_job_pushed);
+	pthread_mutex_unlock(&mutex);
+
+	for(uint i=0 ; i < nb_threads ; i++)
+		pthread_join(threads[i], NULL);
+
+	delete [] threads;
+
+	pthread_cond_destroy(&cond_jobs_done);
+	pthread_cond_destroy(&cond_job_pushed);
+	pthread_mutex_destroy(&mutex);
+}
+
+// ---------------------------------------------------------------------
+void JobPool::push(Job* job)
+{
+	assert(job != NULL);
+
+	pthread_mutex_lock(&mutex);
+	pending_jobs.push_back(job);
+	pthread_cond_signal(&cond_job_pushed);
+	pthread_mutex_unlock(&mutex);
+}
+
+// Wait until all the pushed jobs are done
+void JobPool::wait()
+{
+	pthread_mutex_lock(&mutex);
+	while(!pending_jobs.empty() || nb_running_jobs != 0)
+		pthread_cond_wait(&cond_jobs_done, &mutex);
+	pthread_mutex_unlock(&mutex);
+}
+
+// ---------------------------------------------------------------------
+// Number of cores available on the machine (at least 1)
+uint JobPool::getNbCores()
+{
+#ifdef WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long nb_cores = long(info.dwNumberOfProcessors);
+#else
+	long nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	return (nb_cores < 1 ? 1 : uint(nb_cores));
+}
+
+// ---------------------------------------------------------------------
+// Thread
+void JobPool::workerLoop()
+{
+	pthread_mutex_lock(&mutex);
+
+	for(;;)
+	{
+		// Wait for a job:
+		while(pending_jobs.empty() && !quit)
+			pthread_cond_wait(&cond_job_pushed, &mutex);
+
+		if(pending_jobs.empty())
+			break;	// quit
+
+		Job* job = pending_jobs.front();
+		pending_jobs.pop_front();
+		nb_running_jobs++;
+
+		// Run the job without holding the lock:
+		pthread_mutex_unlock(&mutex);
+		job->run();
+		pthread_mutex_lock(&mutex);
+
+		nb_running_jobs--;
+		if(pending_jobs.empty() && nb_running_jobs == 0)
+			pthread_cond_broadcast(&cond_jobs_done);
+	}
+
+	pthread_mutex_unlock(&mutex);
+}
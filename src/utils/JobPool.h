@@ -0,0 +1,73 @@
+// JobPool.h
+// Pool of worker threads used for CPU-side work which can be done in parallel,
+// such as parsing and decoding the data of a scene while loading it.
+// - jobs are executed in the order they are pushed, by the first available worker
+// - wait() blocks the calling thread until all the pushed jobs are done
+// - jobs are not owned by the pool: the caller deletes them after wait()
+// - there is no OpenGL context on the worker threads: a job must never call
+//   OpenGL, the uploads have to be done by the caller once the jobs are done.
+
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include "../Common.h"
+#include <list>
+#include <pthread.h>
+
+// ---------------------------------------------------------------------
+class Job
+{
+public:
+	Job() {}
+	virtual ~Job() {}
+
+	// Called from one of the worker threads:
+	virtual void run() = 0;
+};
+
+// ---------------------------------------------------------------------
+class JobPool;
+
+// Pool shared by the whole program, with one worker per core.
+JobPool& getJobPool();
+
+class JobPool
+{
+private:
+	pthread_t* threads;
+	uint nb_threads;
+
+	std::list<Job*> pending_jobs;
+	uint nb_running_jobs;
+	bool quit;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_job_pushed;	// signaled when a job is pushed or when we quit
+	pthread_cond_t cond_jobs_done;	// signaled when the last running job is done
+
+public:
+	// nb_threads == 0 means one worker per core
+	JobPool(uint nb_threads=0);
+	~JobPool();
+
+	void push(Job* job);
+
+	// Wait until all the pushed jobs are done
+	void wait();
+
+	uint getNbThreads() const {return nb_threads;}
+
+	// Number of cores available on the machine (at least 1)
+	static uint getNbCores();
+
+private:
+	// Not copyable
+	JobPool(const JobPool& ref);
+	JobPool& operator=(const JobPool& ref);
+
+	void workerLoop();
+
+	friend void* _jobPoolThreadWrapper(void* p);
+};
+
+#endif // JOB_POOL_H
@@ -0,0 +1,139 @@
+// MappedFile.cpp
+
+#include "MappedFile.h"
+
+#ifndef WIN32
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+: data(NULL),
+  size(0),
+#ifdef WIN32
+  file_handle(INVALID_HANDLE_VALUE),
+  mapping_handle(NULL)
+#else
+  fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+// ---------------------------------------------------------------------
+#ifdef WIN32
+
+bool MappedFile::open(const char* filename)
+{
+	close();
+
+	file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+							  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file_handle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(file_handle, &file_size))
+	{
+		close();
+		return false;
+	}
+
+	size = size_t(file_size.QuadPart);
+
+	// Empty files cannot be mapped, but they are valid:
+	if(size == 0)
+		return true;
+
+	mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mapping_handle == NULL)
+	{
+		close();
+		return false;
+	}
+
+	data = (const char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if(data == NULL)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if(data != NULL)
+		UnmapViewOfFile(data);
+
+	if(mapping_handle != NULL)
+		CloseHandle(mapping_handle);
+
+	if(file_handle != INVALID_HANDLE_VALUE)
+		CloseHandle(file_handle);
+
+	data = NULL;
+	size = 0;
+	mapping_handle = NULL;
+	file_handle = INVALID_HANDLE_VALUE;
+}
+
+// ---------------------------------------------------------------------
+#else
+
+bool MappedFile::open(const char* filename)
+{
+	close();
+
+	fd = ::open(filename, O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		close();
+		return false;
+	}
+
+	size = size_t(st.st_size);
+
+	// Empty files cannot be mapped, but they are valid:
+	if(size == 0)
+		return true;
+
+	void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(p == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+
+	// We read the file from the beginning to the end:
+	madvise(p, size, MADV_SEQUENTIAL);
+
+	data = (const char*)p;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if(data != NULL)
+		munmap((void*)data, size);
+
+	if(fd >= 0)
+		::close(fd);
+
+	data = NULL;
+	size = 0;
+	fd = -1;
+}
+
+#endif
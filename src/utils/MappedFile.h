@@ -0,0 +1,45 @@
+// MappedFile.h
+// Read-only memory mapping of a whole file, used for parsing big files
+// (e.g. .obj meshes) without copying them into memory first.
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdlib>
+
+#ifdef WIN32
+	#include <windows.h>
+#endif
+
+class MappedFile
+{
+private:
+	const char* data;
+	size_t size;
+
+#ifdef WIN32
+	HANDLE file_handle;
+	HANDLE mapping_handle;
+#else
+	int fd;
+#endif
+
+public:
+	MappedFile();
+	virtual ~MappedFile();
+
+	// Map the given file, returns false if it cannot be done
+	bool open(const char* filename);
+	void close();
+
+	// Contents of the file (NOT null-terminated)
+	const char* getData() const {return data;}
+	size_t getSize() const {return size;}
+
+private:
+	// Not copyable
+	MappedFile(const MappedFile& ref);
+	MappedFile& operator=(const MappedFile& ref);
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,58 @@
+// RadixSort.cpp
+
+#include "RadixSort.h"
+#include <cstring>
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define NB_RADIX_PASSES (64 / RADIX_BITS)
+
+void radixSort(SortItem* items, SortItem* tmp, uint nb_items)
+{
+	if(nb_items <= 1)
+		return;
+
+	// Compute the histograms of all the passes in one go:
+	uint histograms[NB_RADIX_PASSES][RADIX_SIZE];
+	memset(histograms, 0, sizeof(histograms));
+
+	for(uint i=0 ; i < nb_items ; i++)
+	{
+		uint64 key = items[i].key;
+		for(uint pass=0 ; pass < NB_RADIX_PASSES ; pass++)
+			histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE-1)]++;
+	}
+
+	SortItem* src = items;
+	SortItem* dst = tmp;
+
+	for(uint pass=0 ; pass < NB_RADIX_PASSES ; pass++)
+	{
+		uint* histogram = histograms[pass];
+		uint shift = pass * RADIX_BITS;
+
+		// Skip the pass if all the items have the same byte:
+		if(histogram[(src[0].key >> shift) & (RADIX_SIZE-1)] == nb_items)
+			continue;
+
+		// Histogram -> offsets of the first item of each bucket
+		uint offset = 0;
+		for(uint b=0 ; b < RADIX_SIZE ; b++)
+		{
+			uint count = histogram[b];
+			histogram[b] = offset;
+			offset += count;
+		}
+
+		for(uint i=0 ; i < nb_items ; i++)
+			dst[histogram[(src[i].key >> shift) & (RADIX_SIZE-1)]++] = src[i];
+
+		SortItem* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	// Make sure the result is in "items":
+	if(src != items)
+		memcpy(items, src, nb_items * sizeof(SortItem));
+}
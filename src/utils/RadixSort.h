@@ -0,0 +1,22 @@
+// RadixSort.h
+// Sorting of items with 64-bit keys (e.g. the sort keys of the draw calls, see RenderQueue).
+// This is a LSD radix sort, with 8 passes of 8 bits:
+// - it is stable: items with the same key keep their relative order
+// - the passes where all the items have the same byte are skipped, so that keys using
+//   only a few bits are sorted with only a few passes.
+
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include "../Common.h"
+
+struct SortItem
+{
+	uint64 key;
+	uint value;	// payload, e.g. the index of an object
+};
+
+// Sort "items" by increasing key. "tmp" is a temporary array of at least "nb_items" items.
+void radixSort(SortItem* items, SortItem* tmp, uint nb_items);
+
+#endif // RADIX_SORT_H
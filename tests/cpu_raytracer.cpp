@@ -0,0 +1,387 @@
+// cpu_raytracer.cpp
+// Regression test and benchmark of CPURaytracer, on a synthetic scene (no GPU needed):
+// - cpu_raytracer                     : checks the outputs of both traversals against the scene, and
+//                                       compares them with the golden files
+// - cpu_raytracer --update            : (re)writes the golden files
+// - cpu_raytracer --benchmark [runs]  : times both traversals on a bigger configuration
+// The scene seen from the eye (at the origin, looking towards -z) is a floor, a back wall and
+// a box in front of the wall. There are 2 depth layers: the closest surfaces and the ones behind.
+// The photons leave the floor (in a grid below the light) in pseudo-random directions.
+// NB: the golden files are written by CPURaytracer itself (--update), so they only detect changes
+// of its results. The intersections are also checked independently, against the planes of the
+// scene (see checkScene()).
+
+#include "../src/renderer/utils/CPURaytracer.h"
+#include "../src/utils/Clock.h"
+#include "../src/glm/gtc/matrix_transform.hpp"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+using namespace std;
+
+// ---------------------------------------------------------------------
+#define GOLDEN_LINEAR       "golden/cpu_raytracer_linear.raw"
+#define GOLDEN_HIERARCHICAL "golden/cpu_raytracer_hierarchical.raw"
+
+#define TEST_SCREEN_WIDTH     160
+#define TEST_SCREEN_HEIGHT    120
+#define TEST_BOUNCE_MAP_SIZE  32
+
+#define BENCH_SCREEN_WIDTH    1024
+#define BENCH_SCREEN_HEIGHT   768
+#define BENCH_BOUNCE_MAP_SIZE 256
+
+#define POSITION_TOLERANCE 1e-3f
+#define MAX_MISMATCHES_RATIO 0.005f	// differences allowed between compilers/platforms
+
+#define SCENE_THICKNESS 0.1f		// CPU_RAYTRACER_THICKNESS
+#define SCENE_TOLERANCE 0.05f
+#define SCENE_MIN_DISTANCE 0.1f		// CPU_RAYTRACER_MIN_DISTANCE
+#define SCENE_MAX_DISTANCE 5.0f		// CPU_RAYTRACER_MAX_DISTANCE
+
+// ---------------------------------------------------------------------
+// Portable pseudo-random numbers (rand() differs between the C libraries):
+static uint random_state = 12345;
+
+float rand1()
+{
+	random_state = random_state * 1664525 + 1013904223;
+	return float(random_state >> 8) / float(1 << 24);
+}
+
+// ---------------------------------------------------------------------
+struct TestScene
+{
+	uint screen_width;
+	uint screen_height;
+	mat4 eye_proj;
+
+	vector<float> depth_layers[2];
+
+	uint bounce_map_size;
+	mat4 light_to_eye;
+	vector<float> bounce_map_0;
+	vector<float> bounce_map_1;
+	vector<float> light_positions;
+};
+
+// Distance along the ray (origin: the eye) to the planes of the scene, or -1.0f:
+static float intersectFloor(const vec3& dir)
+{
+	return (dir.y < -1e-6f ? -1.0f / dir.y : -1.0f);				// y = -1
+}
+
+static float intersectWall(const vec3& dir)
+{
+	return (dir.z < -1e-6f ? -8.0f / dir.z : -1.0f);				// z = -8
+}
+
+static float intersectBox(const vec3& dir)
+{
+	if(dir.z > -1e-6f)
+		return -1.0f;
+
+	float t = -4.0f / dir.z;										// z = -4, x in [-1, 1], y in [-1, 0.5]
+	vec3 p = t*dir;
+	return (p.x >= -1.0f && p.x <= 1.0f && p.y >= -1.0f && p.y <= 0.5f ? t : -1.0f);
+}
+
+static float distanceToDepth(const vec3& pos, const mat4& proj)
+{
+	vec4 clip = proj * vec4(pos, 1.0f);
+	return 0.5f * clip.z / clip.w + 0.5f;
+}
+
+void buildScene(TestScene* scene, uint screen_width, uint screen_height, uint bounce_map_size)
+{
+	random_state = 12345;
+
+	scene->screen_width = screen_width;
+	scene->screen_height = screen_height;
+	scene->eye_proj = glm::perspective(glm::radians(60.0f), float(screen_width) / float(screen_height), 0.1f, 100.0f);
+
+	// Depth layers: the surfaces intersected by the ray of each pixel, sorted by distance
+	mat4 inv_proj = glm::inverse(scene->eye_proj);
+
+	for(uint i=0 ; i < 2 ; i++)
+		scene->depth_layers[i].resize(screen_width*screen_height);
+
+	for(uint y=0 ; y < screen_height ; y++)
+		for(uint x=0 ; x < screen_width ; x++)
+		{
+			vec4 ndc(2.0f * (float(x) + 0.5f) / float(screen_width)  - 1.0f,
+					 2.0f * (float(y) + 0.5f) / float(screen_height) - 1.0f,
+					 1.0f, 1.0f);
+			vec4 far_pos = inv_proj * ndc;
+			vec3 dir = vec3(far_pos) / far_pos.w;
+
+			float t[3] = {intersectBox(dir), intersectFloor(dir), intersectWall(dir)};
+			float layer_t[2] = {-1.0f, -1.0f};
+			for(uint j=0 ; j < 3 ; j++)
+			{
+				if(t[j] < 0.0f)
+					continue;
+
+				if(layer_t[0] < 0.0f || t[j] < layer_t[0])
+				{
+					layer_t[1] = layer_t[0];
+					layer_t[0] = t[j];
+				}
+				else if(layer_t[1] < 0.0f || t[j] < layer_t[1])
+					layer_t[1] = t[j];
+			}
+
+			for(uint j=0 ; j < 2 ; j++)
+				scene->depth_layers[j][y*screen_width + x] = (layer_t[j] < 0.0f ? 1.0f
+				                                              : distanceToDepth(layer_t[j]*dir, scene->eye_proj));
+		}
+
+	// Light above the floor, with the same orientation as the eye:
+	scene->bounce_map_size = bounce_map_size;
+	scene->light_to_eye = glm::translate(mat4(1.0f), vec3(0.0f, 1.5f, -3.0f));
+
+	uint nb_texels = bounce_map_size*bounce_map_size;
+	scene->bounce_map_0.resize(4*nb_texels);
+	scene->bounce_map_1.resize(4*nb_texels);
+	scene->light_positions.resize(4*nb_texels);
+
+	for(uint y=0 ; y < bounce_map_size ; y++)
+		for(uint x=0 ; x < bounce_map_size ; x++)
+		{
+			uint i = y*bounce_map_size + x;
+
+			// Position on the floor, in light space (one photon out of 8 has no power):
+			vec3 pos(4.0f * (float(x) + 0.5f) / float(bounce_map_size) - 2.0f,
+					 -2.5f,
+					 4.0f * (float(y) + 0.5f) / float(bounce_map_size) - 2.0f);
+			float power = (i % 8 == 7 ? 0.0f : 1.0f);
+
+			// Cosine-distributed direction around +y:
+			float e0 = rand1();
+			float e1 = rand1();
+			float sin_theta = sqrtf(1.0f - e0);
+			float cos_theta = sqrtf(e0);
+			float phi = 6.28318531f * e1;
+			vec3 dir(cosf(phi) * sin_theta, cos_theta, sinf(phi) * sin_theta);
+
+			for(uint c=0 ; c < 3 ; c++)
+			{
+				scene->bounce_map_0[4*i+c] = power;
+				scene->bounce_map_1[4*i+c] = dir[c];
+				scene->light_positions[4*i+c] = pos[c];
+			}
+			scene->bounce_map_0[4*i+3] = 0.0f;
+			scene->bounce_map_1[4*i+3] = 1.0f;	// path density
+			scene->light_positions[4*i+3] = 1.0f;
+		}
+}
+
+void runRaytracer(CPURaytracer* raytracer, const TestScene& scene, CPURaytracer::Traversal traversal)
+{
+	raytracer->run(&scene.bounce_map_0[0], &scene.bounce_map_1[0], &scene.light_positions[0],
+	               scene.bounce_map_size, scene.light_to_eye, scene.eye_proj, traversal);
+}
+
+// ---------------------------------------------------------------------
+// Analytic intersections, for checking the raytracer independently of the golden files:
+
+// Distance from a point to the closest surface of the scene
+static float distanceToScene(const vec3& pos)
+{
+	float d = glm::min(fabsf(pos.y + 1.0f), fabsf(pos.z + 8.0f));		// floor, wall
+
+	vec3 box_pos(glm::clamp(pos.x, -1.0f, 1.0f), glm::clamp(pos.y, -1.0f, 0.5f), -4.0f);
+	return glm::min(d, glm::length(pos - box_pos));
+}
+
+// Distance along the photon ray (pos + s*dir, s in [min, max distance]) to the first surface it
+// crosses, or -1.0f. The photons go up from the floor, so only the wall and the box can be crossed.
+static float intersectPhoton(const vec3& pos, const vec3& dir)
+{
+	if(fabsf(dir.z) < 1e-6f)
+		return -1.0f;
+
+	float s = -1.0f;
+
+	float s_wall = (-8.0f - pos.z) / dir.z;
+	if(s_wall >= SCENE_MIN_DISTANCE && s_wall <= SCENE_MAX_DISTANCE)
+		s = s_wall;
+
+	float s_box = (-4.0f - pos.z) / dir.z;
+	vec3 p = pos + s_box*dir;
+	if(s_box >= SCENE_MIN_DISTANCE && s_box <= SCENE_MAX_DISTANCE &&
+	   p.x >= -1.0f && p.x <= 1.0f && p.y >= -1.0f && p.y <= 0.5f && (s < 0.0f || s_box < s))
+		s = s_box;
+
+	return s;
+}
+
+// - each intersection found by the raytracer must be on a surface (up to its thickness)
+// - each photon crossing a surface on the screen must have an intersection
+bool checkScene(const TestScene& scene, const CPURaytracer& raytracer, const char* name)
+{
+	const vec4* output1 = raytracer.getOutput1();
+	uint nb_texels = scene.bounce_map_size*scene.bounce_map_size;
+	uint nb_wrong_hits = 0;
+	uint nb_visible = 0;
+	uint nb_missed = 0;
+
+	for(uint i=0 ; i < nb_texels ; i++)
+	{
+		if(output1[i].w == 1.0f && distanceToScene(vec3(output1[i])) > SCENE_THICKNESS + SCENE_TOLERANCE)
+			nb_wrong_hits++;
+
+		if(scene.bounce_map_0[4*i] == 0.0f)
+			continue;
+
+		vec3 light_space_pos(scene.light_positions[4*i+0], scene.light_positions[4*i+1], scene.light_positions[4*i+2]);
+		vec3 light_space_dir(scene.bounce_map_1[4*i+0], scene.bounce_map_1[4*i+1], scene.bounce_map_1[4*i+2]);
+		vec3 pos = vec3(scene.light_to_eye * vec4(light_space_pos, 1.0f));
+		vec3 dir = mat3(scene.light_to_eye) * light_space_dir;
+
+		float s = intersectPhoton(pos, dir);
+		if(s < 0.0f)
+			continue;
+
+		vec4 clip = scene.eye_proj * vec4(pos + s*dir, 1.0f);
+		vec2 win = (0.5f*vec2(clip) / clip.w + vec2(0.5f)) * vec2(float(scene.screen_width), float(scene.screen_height));
+		if(clip.w <= 0.0f || win.x < 0.0f || win.y < 0.0f ||
+		   win.x >= float(scene.screen_width) || win.y >= float(scene.screen_height))
+			continue;
+
+		nb_visible++;
+		if(output1[i].w != 1.0f)
+			nb_missed++;
+	}
+
+	bool ok = (nb_wrong_hits == 0 && float(nb_missed) <= MAX_MISMATCHES_RATIO * float(nb_visible));
+	cout << name << ": " << nb_wrong_hits << " hits outside the surfaces, "
+	     << nb_missed << "/" << nb_visible << " visible intersections missed -> " << (ok ? "OK" : "FAILED") << endl;
+	return ok;
+}
+
+// ---------------------------------------------------------------------
+// Golden files: output1 (intersections) of the raytracer, as raw floats
+bool writeGolden(const char* filename, const CPURaytracer& raytracer)
+{
+	ofstream f(filename, ios::binary);
+	if(!f)
+		return false;
+
+	uint size = raytracer.getBounceMapSize();
+	f.write((const char*)(raytracer.getOutput1()), size*size*sizeof(vec4));
+	return true;
+}
+
+bool compareGolden(const char* filename, const CPURaytracer& raytracer)
+{
+	uint size = raytracer.getBounceMapSize();
+	vector<vec4> golden(size*size);
+
+	ifstream f(filename, ios::binary);
+	if(!f.read((char*)(&golden[0]), size*size*sizeof(vec4)))
+	{
+		cerr << "unable to read \"" << filename << "\"" << endl;
+		return false;
+	}
+
+	const vec4* output1 = raytracer.getOutput1();
+	uint nb_mismatches = 0;
+
+	for(uint i=0 ; i < size*size ; i++)
+	{
+		vec4 diff = glm::abs(output1[i] - golden[i]);
+		if(glm::max(glm::max(diff.x, diff.y), glm::max(diff.z, diff.w)) > POSITION_TOLERANCE)
+			nb_mismatches++;
+	}
+
+	bool ok = (float(nb_mismatches) <= MAX_MISMATCHES_RATIO * float(size*size));
+	cout << filename << ": " << nb_mismatches << " mismatches -> " << (ok ? "OK" : "FAILED") << endl;
+	return ok;
+}
+
+void printStats(const char* name, const CPURaytracer& raytracer)
+{
+	cout << name << ": " << raytracer.getNbRays() << " rays, "
+	     << raytracer.getNbHits() << " hits, "
+	     << double(raytracer.getNbIterations()) / double(glm::max(raytracer.getNbRays(), 1U))
+	     << " iterations per ray" << endl;
+}
+
+// ---------------------------------------------------------------------
+int test(bool update)
+{
+	TestScene scene;
+	buildScene(&scene, TEST_SCREEN_WIDTH, TEST_SCREEN_HEIGHT, TEST_BOUNCE_MAP_SIZE);
+
+	const float* layers[2] = {&scene.depth_layers[0][0], &scene.depth_layers[1][0]};
+
+	CPURaytracer linear(TEST_SCREEN_WIDTH, TEST_SCREEN_HEIGHT);
+	linear.setDepthLayers(layers, 2, glm::inverse(scene.eye_proj));
+	runRaytracer(&linear, scene, CPURaytracer::LINEAR);
+	printStats("linear", linear);
+
+	CPURaytracer hierarchical(TEST_SCREEN_WIDTH, TEST_SCREEN_HEIGHT);
+	hierarchical.setDepthLayers(layers, 2, glm::inverse(scene.eye_proj));
+	runRaytracer(&hierarchical, scene, CPURaytracer::HIERARCHICAL);
+	printStats("hierarchical", hierarchical);
+
+	if(update)
+	{
+		bool ok = writeGolden(GOLDEN_LINEAR, linear) && writeGolden(GOLDEN_HIERARCHICAL, hierarchical);
+		cout << "golden files " << (ok ? "written" : "NOT written") << endl;
+		return (ok ? 0 : 1);
+	}
+
+	bool ok = checkScene(scene, linear, "linear");
+	ok &= checkScene(scene, hierarchical, "hierarchical");
+	ok &= compareGolden(GOLDEN_LINEAR, linear);
+	ok &= compareGolden(GOLDEN_HIERARCHICAL, hierarchical);
+	return (ok ? 0 : 1);
+}
+
+int benchmark(uint nb_runs)
+{
+	TestScene scene;
+	buildScene(&scene, BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT, BENCH_BOUNCE_MAP_SIZE);
+
+	const float* layers[2] = {&scene.depth_layers[0][0], &scene.depth_layers[1][0]};
+	static const char* names[] = {"linear", "hierarchical"};
+
+	for(uint nb_layers=1 ; nb_layers <= 2 ; nb_layers++)
+	{
+		CPURaytracer raytracer(BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT);
+		raytracer.setDepthLayers(layers, nb_layers, glm::inverse(scene.eye_proj));
+
+		for(uint t=0 ; t < 2 ; t++)
+		{
+			CPURaytracer::Traversal traversal = (t == 0 ? CPURaytracer::LINEAR : CPURaytracer::HIERARCHICAL);
+
+			double t0 = Clock::getSeconds();
+			for(uint i=0 ; i < nb_runs ; i++)
+				runRaytracer(&raytracer, scene, traversal);
+			double elapsed = Clock::getSeconds() - t0;
+
+			cout << nb_layers << " layer(s), ";
+			printStats(names[t], raytracer);
+			cout << "  " << 1000.0 * elapsed / double(nb_runs) << " ms per run, "
+			     << double(raytracer.getNbRays()) * double(nb_runs) / glm::max(elapsed, 1e-3) / 1e6
+			     << " Mrays/s" << endl;
+		}
+	}
+
+	return 0;
+}
+
+// ---------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	string arg = (argc >= 2 ? argv[1] : "");
+
+	if(arg == "--benchmark")
+		return benchmark(argc >= 3 ? uint(atoi(argv[2])) : 10);
+
+	return test(arg == "--update");
+}
@@ -0,0 +1,159 @@
+// frustum.cpp
+// Unit test of the frustum culling: Frustum::cullSpheres() (SSE, 4 spheres at a time, when
+// available) must give the same results as Frustum::isSphereVisible(), sphere by sphere:
+// - random spheres around a perspective frustum, with some empty ones (negative radius)
+// - spheres tangent to the planes, where the rounding of the distances matters
+// - every number of spheres modulo 4, and arrays which are not aligned on 16 bytes
+
+#include "../src/scene/Frustum.h"
+#include "../src/glm/gtc/matrix_transform.hpp"
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// ---------------------------------------------------------------------
+#define NB_RANDOM_SPHERES 10000
+
+// Portable pseudo-random numbers (rand() differs between the C libraries):
+static uint random_state = 12345;
+
+float rand1()
+{
+	random_state = random_state * 1664525 + 1013904223;
+	return float(random_state >> 8) / float(1 << 24);
+}
+
+float randRange(float a, float b)
+{
+	return a + (b - a) * rand1();
+}
+
+// ---------------------------------------------------------------------
+// Spheres stored as separate arrays, with "offset" unused floats before them so that the
+// arrays are not always aligned
+struct SphereArrays
+{
+	uint offset;
+	vector<float> x, y, z, r;
+
+	SphereArrays(uint offset) : offset(offset), x(offset), y(offset), z(offset), r(offset) {}
+
+	void push(const vec3& center, float radius)
+	{
+		x.push_back(center.x);
+		y.push_back(center.y);
+		z.push_back(center.z);
+		r.push_back(radius);
+	}
+
+	uint size() const {return x.size() - offset;}
+};
+
+// Compare cullSpheres() with isSphereVisible() on the "nb" first spheres
+bool compare(const Frustum& frustum, const SphereArrays& spheres, uint nb, const char* name)
+{
+	vector<uchar> visible(nb + 1, 2);	// 2: not written, the last one must not be written
+
+	uint nb_visible = frustum.cullSpheres(&spheres.x[spheres.offset], &spheres.y[spheres.offset],
+	                                      &spheres.z[spheres.offset], &spheres.r[spheres.offset],
+	                                      nb, &visible[0]);
+
+	uint nb_mismatches = 0;
+	uint nb_expected_visible = 0;
+
+	for(uint i=0 ; i < nb ; i++)
+	{
+		uint k = spheres.offset + i;
+		bool expected = frustum.isSphereVisible(vec3(spheres.x[k], spheres.y[k], spheres.z[k]), spheres.r[k]);
+
+		nb_expected_visible += (expected ? 1 : 0);
+		if(visible[i] != (expected ? 1 : 0))
+			nb_mismatches++;
+	}
+
+	bool ok = (nb_mismatches == 0 && nb_visible == nb_expected_visible && visible[nb] == 2);
+	if(!ok)
+		cout << name << " (" << nb << " spheres, offset " << spheres.offset << "): "
+		     << nb_mismatches << " mismatches, " << nb_visible << " visible instead of "
+		     << nb_expected_visible << " -> FAILED" << endl;
+	return ok;
+}
+
+// ---------------------------------------------------------------------
+void addRandomSpheres(SphereArrays* spheres, uint nb)
+{
+	for(uint i=0 ; i < nb ; i++)
+	{
+		vec3 center(randRange(-60.0f, 60.0f), randRange(-60.0f, 60.0f), randRange(-120.0f, 20.0f));
+		float radius = randRange(0.0f, 10.0f);
+		if(i % 16 == 15)
+			radius = -1.0f;		// empty object
+		spheres->push(center, radius);
+	}
+}
+
+// Spheres tangent to the planes (or about to be), on both sides. "inside_a" and "inside_b" are
+// points of the frustum.
+void addTangentSpheres(SphereArrays* spheres, const Frustum& frustum, const vec3& inside_a, const vec3& inside_b, uint nb)
+{
+	for(uint i=0 ; i < nb ; i++)
+	{
+		const vec4& plane = frustum.getPlane(i % 6);
+		vec3 normal = vec3(plane);
+
+		// Point in the frustum, moved outside the plane by "radius":
+		vec3 inside = glm::mix(inside_a, inside_b, rand1()) +
+		              vec3(randRange(-0.5f, 0.5f), randRange(-0.5f, 0.5f), randRange(-0.5f, 0.5f));
+		float radius = randRange(0.1f, 5.0f);
+
+		float dist = glm::dot(normal, inside) + plane.w;
+		vec3 center = inside - (dist + radius) * normal;
+
+		// Exact radius for the distance computed from the center, and its neighbours:
+		float d = glm::dot(normal, center) + plane.w;
+		float r = -d;
+		if(i % 3 == 1)
+			r = r * (1.0f + 1e-7f);
+		else if(i % 3 == 2)
+			r = r * (1.0f - 1e-7f);
+
+		spheres->push(center, r);
+	}
+}
+
+// ---------------------------------------------------------------------
+int main()
+{
+	mat4 proj = glm::perspective(glm::radians(60.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+	vec3 eye(1.0f, 2.0f, 3.0f);
+	vec3 target(0.0f, 0.0f, -20.0f);
+	mat4 view = glm::lookAt(eye, target, vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(proj * view);
+
+	bool ok = true;
+
+	for(uint offset=0 ; offset < 4 ; offset++)
+	{
+		// Random spheres:
+		SphereArrays random_spheres(offset);
+		addRandomSpheres(&random_spheres, NB_RANDOM_SPHERES);
+		ok &= compare(frustum, random_spheres, random_spheres.size(), "random spheres");
+
+		// Spheres tangent to the planes:
+		SphereArrays tangent_spheres(offset);
+		addTangentSpheres(&tangent_spheres, frustum, glm::mix(eye, target, 0.1f), glm::mix(eye, target, 2.0f), NB_RANDOM_SPHERES);
+		ok &= compare(frustum, tangent_spheres, tangent_spheres.size(), "tangent spheres");
+
+		// Every number of spheres modulo 4 (the last ones are not tested with SSE):
+		for(uint nb=0 ; nb <= 9 ; nb++)
+			ok &= compare(frustum, random_spheres, nb, "few spheres");
+	}
+
+	// Default frustum: everything but the empty spheres is visible
+	SphereArrays spheres(0);
+	addRandomSpheres(&spheres, 64);
+	ok &= compare(Frustum(), spheres, spheres.size(), "default frustum");
+
+	cout << (ok ? "OK" : "FAILED") << endl;
+	return (ok ? 0 : 1);
+}
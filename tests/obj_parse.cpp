@@ -0,0 +1,191 @@
+// obj_parse.cpp
+// Unit test of the parsing helpers of OBJLoader (see OBJParseHelpers.h):
+// - parseFloat() against strtod(), including exponents and mantissas of more than 19 digits
+// - parseInt() on the corners of the faces ("v/vt/vn", "v//vn", negative indices)
+// - encodeIndex() / decodeIndex() for absolute and relative (negative) indices, with the
+//   elements of the previous chunks
+
+#include "../src/scene/OBJParseHelpers.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+// ---------------------------------------------------------------------
+#define FLOAT_TOLERANCE 1e-6f	// relative
+
+static uint nb_failures = 0;
+
+void check(bool ok, const string& what)
+{
+	if(!ok)
+	{
+		cout << "FAILED: " << what << endl;
+		nb_failures++;
+	}
+}
+
+// ---------------------------------------------------------------------
+// Parse "str" with parseFloat() and compare with strtod(), and with the end of the number
+void checkFloat(const char* str)
+{
+	const char* end = str + strlen(str);
+	const char* p = str;
+	float value = 0.0f;
+
+	char* expected_end = NULL;
+	float expected = float(strtod(str, &expected_end));
+
+	bool ok = parseFloat(&p, end, &value);
+
+	float error = fabsf(value - expected);
+	float tolerance = FLOAT_TOLERANCE * fabsf(expected);
+
+	check(ok, string("parseFloat(\"") + str + "\") found no number");
+	check(error <= tolerance || value == expected,
+	      string("parseFloat(\"") + str + "\") gives a wrong value");
+	check(p == expected_end, string("parseFloat(\"") + str + "\") stops at the wrong character");
+}
+
+void checkNoFloat(const char* str)
+{
+	const char* p = str;
+	float value = 0.0f;
+
+	bool ok = parseFloat(&p, str + strlen(str), &value);
+	check(!ok && p == str, string("parseFloat(\"") + str + "\") should find no number");
+}
+
+void testParseFloat()
+{
+	// Simple numbers:
+	checkFloat("0");
+	checkFloat("1");
+	checkFloat("-1");
+	checkFloat("+2.5");
+	checkFloat("  3.25");
+	checkFloat("0.1");
+	checkFloat(".5");
+	checkFloat("-.75");
+	checkFloat("5.");
+	checkFloat("123456.789");
+	checkFloat("-0.000123");
+
+	// Exponents:
+	checkFloat("1e3");
+	checkFloat("1E3");
+	checkFloat("1.5e+3");
+	checkFloat("-2.5e-2");
+	checkFloat("6.02214076e23");
+	checkFloat("1.6e-19");
+	checkFloat("3.4e38");
+	checkFloat("1e-30");
+	checkFloat("7e0");
+	checkFloat("1e400");	// infinity
+	checkFloat("1e-400");	// 0
+
+	// Incomplete exponents are not part of the number:
+	checkFloat("2e");
+	checkFloat("2e+");
+	checkFloat("2e-x");
+
+	// More than 19 significant digits:
+	checkFloat("12345678901234567890123");
+	checkFloat("123456789012345678901.5");
+	checkFloat("0.12345678901234567890123");
+	checkFloat("0.0000000000000000000000012345678901234567890123");
+	checkFloat("99999999999999999999999999");
+	checkFloat("-1.000000000000000000000000001");
+	checkFloat("100000000000000000000000000e-26");
+
+	// Followed by something else:
+	checkFloat("1.5 2.5");
+	checkFloat("4/5");
+
+	// Not numbers:
+	checkNoFloat("");
+	checkNoFloat("x");
+	checkNoFloat("-");
+	checkNoFloat(".");
+	checkNoFloat("e5");
+	checkNoFloat("-.e5");
+}
+
+// ---------------------------------------------------------------------
+void testParseInt()
+{
+	// Corner "v/vt/vn" with a negative index:
+	const char* str = "7/-2/3 x";
+	const char* end = str + strlen(str);
+	const char* p = str;
+	int position = 0, texcoord = 0, normal = 0;
+
+	check(parseInt(&p, end, &position) && position == 7, "parseInt(): position of \"7/-2/3\"");
+	check(*p == '/', "parseInt(): stops at the '/'");
+	p++;
+	check(parseInt(&p, end, &texcoord) && texcoord == -2, "parseInt(): texcoords of \"7/-2/3\"");
+	p++;
+	check(parseInt(&p, end, &normal) && normal == 3, "parseInt(): normal of \"7/-2/3\"");
+	check(*p == ' ', "parseInt(): stops at the blank");
+
+	// Corner "v//vn": no texture coordinates
+	str = "-12//+4";
+	end = str + strlen(str);
+	p = str;
+
+	check(parseInt(&p, end, &position) && position == -12, "parseInt(): position of \"-12//+4\"");
+	p++;
+	const char* before = p;
+	check(!parseInt(&p, end, &texcoord) && p == before, "parseInt(): missing texcoords of \"-12//+4\"");
+	p++;
+	check(parseInt(&p, end, &normal) && normal == 4, "parseInt(): normal of \"-12//+4\"");
+	check(p == end, "parseInt(): stops at the end");
+
+	// Not numbers:
+	str = "-/";
+	p = str;
+	check(!parseInt(&p, str + strlen(str), &position) && p == str, "parseInt(\"-/\") should find no number");
+}
+
+// ---------------------------------------------------------------------
+// Encode the .obj index "obj_index" read in a chunk after "nb_in_chunk" elements of the chunk, and
+// decode it with "chunk_offset" elements in the previous chunks and "nb_elements" in total
+bool encodeDecode(int obj_index, uint nb_in_chunk, uint chunk_offset, uint nb_elements, uint* result)
+{
+	return decodeIndex(encodeIndex(obj_index, nb_in_chunk), chunk_offset, nb_elements, result);
+}
+
+void testIndices()
+{
+	uint index = 0;
+
+	// Absolute indices are 1-based:
+	check(encodeDecode(1, 0, 0, 10, &index) && index == 0, "absolute index 1");
+	check(encodeDecode(10, 5, 100, 200, &index) && index == 9, "absolute index, not in the first chunk");
+	check(!encodeDecode(11, 0, 0, 10, &index), "absolute index out of range");
+	check(!encodeDecode(0, 3, 0, 10, &index), "index 0 is not valid");
+
+	// Relative indices: -1 is the last element read so far, counting the previous chunks
+	check(encodeDecode(-1, 3, 0, 10, &index) && index == 2, "relative index -1 in the first chunk");
+	check(encodeDecode(-3, 3, 0, 10, &index) && index == 0, "relative index -3 in the first chunk");
+	check(!encodeDecode(-4, 3, 0, 10, &index), "relative index before the first element");
+	check(encodeDecode(-1, 3, 100, 200, &index) && index == 102, "relative index -1 in the next chunks");
+	check(encodeDecode(-5, 3, 100, 200, &index) && index == 98, "relative index to a previous chunk");
+	check(encodeDecode(-1, 0, 100, 200, &index) && index == 99, "relative index at the start of a chunk");
+	check(!encodeDecode(-1, 0, 0, 10, &index), "relative index without element");
+
+	// No index ("v//vn"):
+	check(encodeIndex(0, 0) == OBJ_INDEX_NONE, "encoding of a missing index");
+	check(!decodeIndex(OBJ_INDEX_NONE, 0, 10, &index), "decoding of a missing index");
+}
+
+// ---------------------------------------------------------------------
+int main()
+{
+	testParseFloat();
+	testParseInt();
+	testIndices();
+
+	cout << (nb_failures == 0 ? "OK" : "FAILED") << endl;
+	return (nb_failures == 0 ? 0 : 1);
+}
@@ -0,0 +1,289 @@
+// render_queue.cpp
+// Unit test of the sorting of the draw calls:
+// - radixSort() against std::stable_sort(), on keys using all the bits or only a few of them
+//   (skipped passes), with duplicated keys (stability) and various numbers of items
+// - RenderQueue::makeKey(): order of the passes, opaque draws grouped by state and sorted
+//   front to back, transparent draws after them and sorted back to front
+// - RenderQueue: sorting of random draws
+
+#include "../src/utils/RadixSort.h"
+#include "../src/renderer/utils/RenderQueue.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// ---------------------------------------------------------------------
+// Portable pseudo-random numbers (rand() differs between the C libraries):
+static uint random_state = 12345;
+
+uint rand32()
+{
+	random_state = random_state * 1664525 + 1013904223;
+	return random_state;
+}
+
+uint64 rand64()
+{
+	return (uint64(rand32() >> 8) << 40) ^ (uint64(rand32() >> 8) << 20) ^ uint64(rand32() >> 8) ^ (uint64(rand32()) << 32);
+}
+
+float randDepth()
+{
+	return 100.0f * float(rand32() >> 8) / float(1 << 24);
+}
+
+static uint nb_failures = 0;
+
+void check(bool ok, const char* what)
+{
+	if(!ok)
+	{
+		cout << "FAILED: " << what << endl;
+		nb_failures++;
+	}
+}
+
+// ---------------------------------------------------------------------
+bool lessKey(const SortItem& a, const SortItem& b)
+{
+	return a.key < b.key;
+}
+
+// Sort the items with radixSort() and std::stable_sort(), and compare the results (keys and values,
+// the values being the initial positions, so that the stability is checked too)
+void checkRadixSort(vector<uint64> keys, const char* what)
+{
+	uint nb = keys.size();
+	vector<SortItem> items(nb + 1);
+	vector<SortItem> tmp(nb + 1);
+
+	for(uint i=0 ; i < nb ; i++)
+	{
+		items[i].key = keys[i];
+		items[i].value = i;
+	}
+
+	vector<SortItem> expected(items.begin(), items.begin() + nb);
+	stable_sort(expected.begin(), expected.end(), lessKey);
+
+	radixSort(&items[0], &tmp[0], nb);
+
+	bool ok = true;
+	for(uint i=0 ; i < nb ; i++)
+		ok &= (items[i].key == expected[i].key && items[i].value == expected[i].value);
+
+	check(ok, what);
+}
+
+void testRadixSort()
+{
+	static const uint sizes[] = {0, 1, 2, 3, 255, 256, 257, 1000, 100000};
+
+	for(uint s=0 ; s < sizeof(sizes) / sizeof(uint) ; s++)
+	{
+		uint nb = sizes[s];
+		vector<uint64> keys(nb);
+
+		// All the bits:
+		for(uint i=0 ; i < nb ; i++)
+			keys[i] = rand64();
+		checkRadixSort(keys, "radixSort(): random keys");
+
+		// Only a few bits (most of the passes are skipped), many duplicates:
+		for(uint i=0 ; i < nb ; i++)
+			keys[i] = rand32() & 0x0F;
+		checkRadixSort(keys, "radixSort(): 4-bit keys");
+
+		// Only the most significant byte, and one byte in the middle:
+		for(uint i=0 ; i < nb ; i++)
+			keys[i] = (uint64(rand32() & 0xFF) << 56) | (uint64(rand32() & 0x3) << 24);
+		checkRadixSort(keys, "radixSort(): sparse bytes");
+
+		// All the keys equal (every pass is skipped):
+		for(uint i=0 ; i < nb ; i++)
+			keys[i] = 0x0123456789ABCDEFULL;
+		checkRadixSort(keys, "radixSort(): equal keys");
+
+		// Already sorted, and reversed:
+		for(uint i=0 ; i < nb ; i++)
+			keys[i] = uint64(i) * 0x0000010000010001ULL;
+		checkRadixSort(keys, "radixSort(): sorted keys");
+
+		reverse(keys.begin(), keys.end());
+		checkRadixSort(keys, "radixSort(): reversed keys");
+	}
+}
+
+// ---------------------------------------------------------------------
+void testMakeKey()
+{
+	// Passes:
+	for(uint pass=0 ; pass+1 < RenderQueue::NB_PASSES ; pass++)
+	{
+		uint64 last_of_pass = RenderQueue::makeKey(pass, true, 1023, 16383, 16383, 0.0f);
+		uint64 first_of_next = RenderQueue::makeKey(pass+1, false, 0, 0, 0, 0.0f);
+		check(last_of_pass < first_of_next, "makeKey(): the passes are in order");
+	}
+
+	for(uint pass=0 ; pass < RenderQueue::NB_PASSES ; pass++)
+	{
+		uint64 opaque = RenderQueue::makeKey(pass, false, 5, 6, 7, 1.0f);
+		uint64 transparent = RenderQueue::makeKey(pass, true, 5, 6, 7, 1.0f);
+		check(RenderQueue::getPass(opaque) == pass && RenderQueue::getPass(transparent) == pass,
+		      "getPass()");
+		check(!RenderQueue::isTransparent(opaque) && RenderQueue::isTransparent(transparent),
+		      "isTransparent()");
+	}
+
+	// Opaque draws before the transparent ones:
+	uint64 last_opaque = RenderQueue::makeKey(1, false, 1023, 16383, 16383, 1e30f);
+	uint64 first_transparent = RenderQueue::makeKey(1, true, 0, 0, 0, 1e30f);
+	check(last_opaque < first_transparent, "makeKey(): opaque draws before the transparent ones");
+
+	// Opaque draws: grouped by program, then material, then VAO, then front to back
+	check(RenderQueue::makeKey(0, false, 1, 1000, 1000, 50.0f) < RenderQueue::makeKey(0, false, 2, 0, 0, 1.0f),
+	      "makeKey(): opaque draws grouped by program");
+	check(RenderQueue::makeKey(0, false, 1, 1, 1000, 50.0f) < RenderQueue::makeKey(0, false, 1, 2, 0, 1.0f),
+	      "makeKey(): opaque draws grouped by material");
+	check(RenderQueue::makeKey(0, false, 1, 1, 1, 50.0f) < RenderQueue::makeKey(0, false, 1, 1, 2, 1.0f),
+	      "makeKey(): opaque draws grouped by VAO");
+
+	// Depths: front to back for the opaque draws, back to front for the transparent ones, and
+	// the state bits do not depend on the depth
+	bool front_to_back = true;
+	bool back_to_front = true;
+	bool same_state_bits = true;
+
+	for(uint i=0 ; i < 10000 ; i++)
+	{
+		float a = randDepth();
+		float b = randDepth();
+		if(a > b)
+			swap(a, b);
+
+		uint64 opaque_a = RenderQueue::makeKey(0, false, 3, 4, 5, a);
+		uint64 opaque_b = RenderQueue::makeKey(0, false, 3, 4, 5, b);
+		front_to_back &= (opaque_a <= opaque_b);
+
+		// The transparent draws ignore the state when their depths are different enough:
+		uint64 transparent_a = RenderQueue::makeKey(0, true, 1000, 4, 5, a);
+		uint64 transparent_b = RenderQueue::makeKey(0, true, 3, 4, 5, b);
+		back_to_front &= (b - a < 0.01f || transparent_b < transparent_a);
+
+		same_state_bits &= (RenderQueue::getStateBits(opaque_a) == RenderQueue::getStateBits(opaque_b));
+		same_state_bits &= (RenderQueue::getStateBits(RenderQueue::makeKey(0, true, 3, 4, 5, a)) == RenderQueue::getStateBits(transparent_b));
+	}
+
+	check(front_to_back, "makeKey(): opaque draws front to back");
+	check(back_to_front, "makeKey(): transparent draws back to front");
+	check(same_state_bits, "getStateBits(): independent of the depth");
+
+	// Negative and null depths are clamped:
+	check(RenderQueue::makeKey(0, false, 3, 4, 5, -10.0f) == RenderQueue::makeKey(0, false, 3, 4, 5, 0.0f),
+	      "makeKey(): negative depths are clamped");
+	check(RenderQueue::makeKey(0, false, 3, 4, 5, 0.0f) < RenderQueue::makeKey(0, false, 3, 4, 5, 1e-6f),
+	      "makeKey(): null depth first");
+
+	// Different states have different state bits:
+	check(RenderQueue::getStateBits(RenderQueue::makeKey(0, false, 3, 4, 5, 1.0f)) !=
+	      RenderQueue::getStateBits(RenderQueue::makeKey(0, false, 3, 4, 6, 1.0f)),
+	      "getStateBits(): different states");
+}
+
+// ---------------------------------------------------------------------
+struct Draw
+{
+	uint pass;
+	bool transparent;
+	uint program;
+	uint material;
+	uint vao;
+	float depth;
+};
+
+// Are the depths closer than the precision of the keys? (DEPTH_BITS bits of the float, i.e. 15 bits
+// of mantissa)
+bool isSameDepth(float a, float b)
+{
+	return fabsf(a - b) <= 1e-4f * max(a, b);
+}
+
+// Can draw a come before draw b?
+bool isOrdered(const Draw& a, const Draw& b)
+{
+	if(a.pass != b.pass)
+		return a.pass < b.pass;
+	if(a.transparent != b.transparent)
+		return !a.transparent;
+
+	// Transparent draws: back to front, then by state
+	if(a.transparent && !isSameDepth(a.depth, b.depth))
+		return a.depth > b.depth;
+
+	if(a.program != b.program)
+		return a.program < b.program;
+	if(a.material != b.material)
+		return a.material < b.material;
+	if(a.vao != b.vao)
+		return a.vao < b.vao;
+
+	// Opaque draws with the same state: front to back
+	return a.transparent || isSameDepth(a.depth, b.depth) || a.depth < b.depth;
+}
+
+void testRenderQueue()
+{
+	const uint nb_draws = 5000;
+
+	vector<Draw> draws(nb_draws);
+	RenderQueue queue;
+	queue.reserve(nb_draws);
+	queue.clear();
+
+	for(uint i=0 ; i < nb_draws ; i++)
+	{
+		Draw& d = draws[i];
+		d.pass = rand32() % RenderQueue::NB_PASSES;
+		d.transparent = (rand32() % 4 == 0);
+		d.program = rand32() % 8;
+		d.material = rand32() % 32;
+		d.vao = rand32() % 4;
+		d.depth = randDepth();
+
+		queue.push(RenderQueue::makeKey(d.pass, d.transparent, d.program, d.material, d.vao, d.depth), i);
+	}
+
+	queue.sort();
+	check(queue.getNbItems() == nb_draws, "RenderQueue: number of items");
+
+	const SortItem* items = queue.getItems();
+	vector<bool> seen(nb_draws, false);
+	bool ordered = true;
+	bool permutation = true;
+
+	for(uint i=0 ; i < queue.getNbItems() ; i++)
+	{
+		permutation &= (items[i].value < nb_draws && !seen[items[i].value]);
+		if(items[i].value < nb_draws)
+			seen[items[i].value] = true;
+
+		if(i > 0)
+			ordered &= isOrdered(draws[items[i-1].value], draws[items[i].value]);
+	}
+
+	check(permutation, "RenderQueue: the values are a permutation of the draws");
+	check(ordered, "RenderQueue: the draws are in order");
+}
+
+// ---------------------------------------------------------------------
+int main()
+{
+	testRadixSort();
+	testMakeKey();
+	testRenderQueue();
+
+	cout << (nb_failures == 0 ? "OK" : "FAILED") << endl;
+	return (nb_failures == 0 ? 0 : 1);
+}